@@ -0,0 +1,147 @@
+#!/usr/bin/env python3
+# Compare the kernel's benchmark results in the serial output against a stored
+# baseline and fail on regressions.
+#
+# Usage: ./Compare_Benchmarks.py [serial log] [baseline json] [--metric M]
+#                                [--threshold PERCENT] [--accelerator A]
+#                                [--cpu MODEL] [--update]
+#
+# The results are logged by benchmark_run_all, in TSC cycles per iteration:
+#     BENCH BEGIN tsc_hz=<hz> overhead=<cycles>
+#     BENCH name=<name> ops=<operations> min=<> median=<> p99=<>
+#     BENCH END count=<benchmarks run>
+# The last complete run in the log is compared. The baseline keeps the results
+# of a known good run, the QEMU accelerator and CPU model it ran on, plus
+# optional per benchmark thresholds:
+#     {"tsc_hz": ..., "accelerator": "kvm", "cpu": "<model>",
+#      "benchmarks": {"<name>": {"ops": ..., "min": ..., ...}},
+#      "thresholds": {"<name>": <percent>}}
+# --update writes the run as the new baseline and keeps its thresholds.
+#
+# Exits 1 when a benchmark got slower than its threshold allows, 2 when the log
+# has no complete run or a baseline benchmark is missing from it and 3 when the
+# given accelerator or CPU model is not the baseline's, whose cycle counts are
+# not comparable.
+
+import argparse
+import json
+import os
+import re
+import sys
+
+METRICS = ("min", "median", "p99")
+RESULT_PATTERN = re.compile(r"BENCH name=(\S+) ops=(\d+) min=(\d+) median=(\d+) p99=(\d+)")
+BEGIN_PATTERN = re.compile(r"BENCH BEGIN tsc_hz=(\d+) overhead=(\d+)")
+END_PATTERN = re.compile(r"BENCH END count=(\d+)")
+
+def read_last_run(lines):
+    run = None
+    last_complete = None
+    for line in lines:
+        match = BEGIN_PATTERN.search(line)
+        if match:
+            run = {"tsc_hz": int(match.group(1)), "overhead": int(match.group(2)), "benchmarks": {}}
+            continue
+        if run is None:
+            continue
+        match = RESULT_PATTERN.search(line)
+        if match:
+            run["benchmarks"][match.group(1)] = {"ops": int(match.group(2)), "min": int(match.group(3)),
+                                                 "median": int(match.group(4)), "p99": int(match.group(5))}
+        elif END_PATTERN.search(line):
+            last_complete = run
+            run = None
+    return last_complete
+
+def write_baseline(path, run, environment, thresholds):
+    baseline = {"tsc_hz": run["tsc_hz"], "benchmarks": run["benchmarks"]}
+    baseline.update(environment)
+    if thresholds:
+        baseline["thresholds"] = thresholds
+    with open(path, "w") as baseline_file:
+        json.dump(baseline, baseline_file, indent=4, sort_keys=True)
+        baseline_file.write("\n")
+
+def main():
+    parser = argparse.ArgumentParser(description="Kernel benchmark regression check.")
+    parser.add_argument("log", nargs="?", default="bench.log")
+    parser.add_argument("baseline", nargs="?", default="Benchmark_Baseline.json")
+    parser.add_argument("--metric", choices=METRICS, default="median")
+    parser.add_argument("--threshold", type=float, default=10.0,
+                        help="allowed slowdown in percent when the baseline has none for the benchmark")
+    parser.add_argument("--accelerator", help="QEMU accelerator of the run, e.g. kvm or tcg")
+    parser.add_argument("--cpu", help="QEMU CPU model of the run")
+    parser.add_argument("--update", action="store_true")
+    arguments = parser.parse_args()
+
+    with open(arguments.log, errors="replace") as log_file:
+        run = read_last_run(log_file)
+    if run is None or not run["benchmarks"]:
+        print("No complete benchmark run in " + arguments.log, file=sys.stderr)
+        return 2
+
+    baseline = None
+    if os.path.exists(arguments.baseline):
+        with open(arguments.baseline) as baseline_file:
+            baseline = json.load(baseline_file)
+
+    environment = {}
+    if arguments.accelerator:
+        environment["accelerator"] = arguments.accelerator
+    if arguments.cpu:
+        environment["cpu"] = arguments.cpu
+
+    if arguments.update:
+        write_baseline(arguments.baseline, run, environment, baseline.get("thresholds", {}) if baseline else {})
+        print("Wrote %d benchmarks to %s" % (len(run["benchmarks"]), arguments.baseline))
+        return 0
+    if baseline is None:
+        print("No baseline at %s, record one with --update" % arguments.baseline, file=sys.stderr)
+        return 2
+
+    for key, value in sorted(environment.items()):
+        if baseline.get(key) != value:
+            print("Run on %s %s, the baseline on %s, record a baseline for it with --update" %
+                  (key, value, baseline.get(key, "an unrecorded one")), file=sys.stderr)
+            return 3
+
+    if baseline.get("tsc_hz") and baseline["tsc_hz"] != run["tsc_hz"]:
+        print("note: TSC runs at %d Hz, the baseline was taken at %d Hz" % (run["tsc_hz"], baseline["tsc_hz"]))
+
+    metric = arguments.metric
+    thresholds = baseline.get("thresholds", {})
+    num_of_regressions = 0
+    num_of_missing = 0
+
+    print("%-24s %12s %12s %9s %9s  %s" % ("benchmark", "baseline", metric, "change", "allowed", "status"))
+    for name in sorted(set(baseline["benchmarks"]) | set(run["benchmarks"])):
+        expected = baseline["benchmarks"].get(name)
+        actual = run["benchmarks"].get(name)
+        if actual is None:
+            print("%-24s %12d %12s %9s %9s  MISSING" % (name, expected[metric], "-", "-", "-"))
+            num_of_missing += 1
+            continue
+        if expected is None:
+            print("%-24s %12s %12d %9s %9s  new" % (name, "-", actual[metric], "-", "-"))
+            continue
+
+        allowed = float(thresholds.get(name, arguments.threshold))
+        change = 100.0 * (actual[metric] - expected[metric]) / max(expected[metric], 1)
+        status = "ok"
+        if change > allowed:
+            status = "REGRESSED"
+            num_of_regressions += 1
+        elif change < -allowed:
+            status = "improved"
+        print("%-24s %12d %12d %+8.1f%% %8.1f%%  %s" % (name, expected[metric], actual[metric], change, allowed, status))
+
+    if num_of_missing:
+        print("%d baseline benchmarks missing from the run" % num_of_missing, file=sys.stderr)
+        return 2
+    if num_of_regressions:
+        print("%d benchmarks regressed" % num_of_regressions, file=sys.stderr)
+        return 1
+    return 0
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,34 @@
+# Builds the same disk image as Make_Image.sh without root or loop devices:
+# the EFI System Partition is formatted and filled as a plain file with
+# mtools, then written into the GPT disk at the 2048 sector.
+# Needs sgdisk and mtools (mformat, mmd, mcopy).
+#
+# Usage: ./Make_Image_Unprivileged.sh [image name]
+
+set -e
+
+IMAGE=${1:-cosmos.img}
+PARTITION=$(mktemp)
+trap 'rm -f "$PARTITION"' EXIT
+
+# Creates a file full of zero bytes.
+dd if=/dev/zero of="$IMAGE" bs=1048576 count=128 status=none
+
+# Formats the file with GPT disk image data - creating 
+# an EFI System partition aligned to the 2048 sector.
+sgdisk -og "$IMAGE" > /dev/null
+sgdisk -n 1:2048:67584 -c 1:"EFI System Partition" -t 1:ef00 "$IMAGE" > /dev/null
+
+# Creates the FAT filesystem in a file the size of the loopback device
+# Make_Image.sh uses, mformat picks FAT 16 at this size.
+dd if=/dev/zero of="$PARTITION" bs=1048576 count=32 status=none
+mformat -i "$PARTITION" ::
+
+# Copy over bootloader, kernel image and font file to EFI/BOOT.
+mmd -i "$PARTITION" ::/EFI ::/EFI/BOOT
+mcopy -i "$PARTITION" bootloader/BOOTX64.EFI ::/EFI/BOOT
+mcopy -i "$PARTITION" kernel/kernel.bin ::/EFI/BOOT
+mcopy -i "$PARTITION" shared/graphics/fonts/zap-ext-light16.psf ::/EFI/BOOT
+
+# Place the filesystem at the partition's 1 MiB offset.
+dd if="$PARTITION" of="$IMAGE" bs=1048576 seek=1 conv=notrunc status=none
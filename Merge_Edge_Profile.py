@@ -0,0 +1,69 @@
+#!/usr/bin/env python3
+# Write the edge counters an instrumented kernel (make CONFIG=instrument)
+# dumped to its serial output as the .gcda files next to the kernel's objects,
+# which the pgo build (make CONFIG=pgo) then reads.
+#
+# Usage: ./Merge_Edge_Profile.py [serial log] [--root DIR]
+#
+# The counters are written by edge_profile_dump, each object's .gcda contents
+# hex encoded after the path the compiler gave it:
+#     GCOV BEGIN
+#     GCOV FILE <path of the .gcda>
+#     GCOV <hex bytes>
+#     GCOV END <objects> <bytes>
+# The last complete dump in the log is written, replacing the counts of an
+# earlier run. --root writes the files under DIR instead, e.g. to combine runs
+# with gcov-tool merge.
+
+import argparse
+import os
+import sys
+
+def read_last_dump(lines):
+    dump = None
+    last_complete = None
+    for line in lines:
+        start = line.find("GCOV ")
+        if start < 0:
+            continue
+        fields = line[start:].split(None, 2)
+        if len(fields) < 2:
+            continue
+        if fields[1] == "BEGIN":
+            dump = []
+        elif dump is None:
+            continue
+        elif fields[1] == "FILE" and len(fields) == 3:
+            dump.append((fields[2].strip(), bytearray()))
+        elif fields[1] == "END" and len(fields) == 3:
+            num_of_objects, num_of_bytes = (int(field) for field in fields[2].split())
+            if len(dump) != num_of_objects or sum(len(data) for _, data in dump) != num_of_bytes:
+                sys.exit("Edge profile dump is incomplete, the serial output lost lines")
+            last_complete = dump
+            dump = None
+        elif len(fields) == 2 and dump:
+            dump[-1][1].extend(bytes.fromhex(fields[1]))
+    return last_complete
+
+def main():
+    parser = argparse.ArgumentParser(description="Write kernel edge counters to .gcda files.")
+    parser.add_argument("log", nargs="?", default="stdio.log")
+    parser.add_argument("--root")
+    arguments = parser.parse_args()
+
+    with open(arguments.log, errors="replace") as log_file:
+        dump = read_last_dump(log_file)
+    if dump is None:
+        sys.exit("No complete edge profile in " + arguments.log)
+
+    for path, data in dump:
+        if arguments.root:
+            path = os.path.join(arguments.root, path.lstrip("/"))
+        os.makedirs(os.path.dirname(path) or ".", exist_ok=True)
+        with open(path, "wb") as gcda_file:
+            gcda_file.write(data)
+
+    print("Wrote %d .gcda files, %d bytes" % (len(dump), sum(len(data) for _, data in dump)))
+
+if __name__ == "__main__":
+    main()
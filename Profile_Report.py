@@ -0,0 +1,139 @@
+#!/usr/bin/env python3
+# Symbolize the kernel's profile samples in the serial output (stdio.log by
+# default) against kernel/kernel.elf and print where kernel time goes.
+#
+# Usage: ./Profile_Report.py [serial log] [kernel elf] [--top N] [--lines]
+#                            [--folded FILE]
+#
+# The samples are streamed by profiler_stream:
+#     PROFILE START <frequency hz> <address of profiler_stream>
+#     PROFILE <cpu> <rip> [<return address> ...]
+#     PROFILE STOP <samples> <dropped>
+# kernel.bin runs wherever the bootloader loaded it, the address of
+# profiler_stream in the START line gives the offset from the ELF's addresses.
+# The last profile in the log is reported. --lines adds the source line of the
+# hottest addresses, --folded writes stacks for flamegraph.pl.
+
+import argparse
+import bisect
+import collections
+import shutil
+import subprocess
+import sys
+
+ANCHOR_PREFIX = "profiler_stream("
+
+def find_tool(name):
+    for candidate in ("x86_64-elf-" + name, name):
+        if shutil.which(candidate):
+            return candidate
+    sys.exit("Neither x86_64-elf-%s nor %s found" % (name, name))
+
+def read_last_profile(lines):
+    profile = None
+    for line in lines:
+        fields = line.split()
+        if len(fields) < 2 or fields[0] != "PROFILE":
+            continue
+        if fields[1] == "START" and len(fields) == 4:
+            profile = {"frequency_hz": int(fields[2]), "anchor": int(fields[3], 16), "samples": [], "dropped": None}
+        elif fields[1] == "STOP" and len(fields) == 4:
+            if profile is not None:
+                profile["dropped"] = int(fields[3])
+        elif profile is not None and len(fields) >= 3:
+            try:
+                profile["samples"].append((int(fields[1]), [int(address, 16) for address in fields[2:]]))
+            except ValueError:
+                continue
+    return profile
+
+class Symbols:
+    def __init__(self, elf_path):
+        output = subprocess.run([find_tool("nm"), "-n", "-C", "--defined-only", elf_path],
+                                capture_output=True, text=True, check=True).stdout
+        self.addresses = []
+        self.names = []
+        for line in output.splitlines():
+            fields = line.split(" ", 2)
+            if len(fields) != 3 or fields[1] not in "tTwW":
+                continue
+            self.addresses.append(int(fields[0], 16))
+            self.names.append(fields[2])
+
+    def address_of(self, prefix):
+        for address, name in zip(self.addresses, self.names):
+            if name.startswith(prefix):
+                return address
+        sys.exit("No %s... symbol in the ELF" % prefix)
+
+    def name_of(self, address):
+        idx = bisect.bisect_right(self.addresses, address) - 1
+        return self.names[idx] if idx >= 0 else "[unknown]"
+
+def print_table(title, counter, num_of_samples, top):
+    print("\n%s" % title)
+    print("%8s %7s  %s" % ("samples", "%", "function"))
+    for name, count in counter.most_common(top):
+        print("%8d %6.2f%%  %s" % (count, 100.0 * count / num_of_samples, name))
+
+def main():
+    parser = argparse.ArgumentParser(description="Kernel sampling profile report.")
+    parser.add_argument("log", nargs="?", default="stdio.log")
+    parser.add_argument("elf", nargs="?", default="kernel/kernel.elf")
+    parser.add_argument("--top", type=int, default=25)
+    parser.add_argument("--lines", action="store_true")
+    parser.add_argument("--folded")
+    arguments = parser.parse_args()
+
+    with open(arguments.log, errors="replace") as log_file:
+        profile = read_last_profile(log_file)
+    if profile is None or not profile["samples"]:
+        sys.exit("No profile samples in " + arguments.log)
+
+    symbols = Symbols(arguments.elf)
+    bias = profile["anchor"] - symbols.address_of(ANCHOR_PREFIX)
+
+    samples = profile["samples"]
+    self_counts = collections.Counter()
+    inclusive_counts = collections.Counter()
+    address_counts = collections.Counter()
+    cpu_counts = collections.Counter()
+    stacks = collections.Counter()
+
+    for cpu, addresses in samples:
+        # Return addresses point after the call, step back into it.
+        elf_addresses = [addresses[0] - bias] + [address - bias - 1 for address in addresses[1:]]
+        names = [symbols.name_of(address) for address in elf_addresses]
+
+        cpu_counts[cpu] += 1
+        address_counts[elf_addresses[0]] += 1
+        self_counts[names[0]] += 1
+        for name in set(names):
+            inclusive_counts[name] += 1
+        stacks[";".join(reversed(names))] += 1
+
+    dropped = "unknown" if profile["dropped"] is None else str(profile["dropped"])
+    print("%d samples at %d Hz per processor, %s dropped, image loaded at offset %#x" %
+          (len(samples), profile["frequency_hz"], dropped, bias))
+    print("per cpu: " + ", ".join("%d: %d" % (cpu, count) for cpu, count in sorted(cpu_counts.items())))
+
+    print_table("Self (sampled instruction in the function):", self_counts, len(samples), arguments.top)
+    print_table("Inclusive (function anywhere in the call chain):", inclusive_counts, len(samples), arguments.top)
+
+    if arguments.lines:
+        hottest = [address for address, _ in address_counts.most_common(arguments.top)]
+        output = subprocess.run([find_tool("addr2line"), "-f", "-C", "-e", arguments.elf] + ["%#x" % address for address in hottest],
+                                capture_output=True, text=True, check=True).stdout.splitlines()
+        print("\nHottest instructions:")
+        print("%8s %7s  %s" % ("samples", "%", "location"))
+        for idx, address in enumerate(hottest):
+            count = address_counts[address]
+            print("%8d %6.2f%%  %#x %s %s" % (count, 100.0 * count / len(samples), address, output[2 * idx], output[2 * idx + 1]))
+
+    if arguments.folded:
+        with open(arguments.folded, "w") as folded_file:
+            for stack, count in stacks.items():
+                folded_file.write("%s %d\n" % (stack, count))
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,84 @@
+# Benchmark pipeline: builds the benchmark kernel and an auto-launching
+# bootloader, makes the disk image without root, boots it headless under QEMU
+# and compares the BENCH lines in the serial output against the baseline.
+# The kernel leaves QEMU through isa-debug-exit once the results are out.
+#
+# Usage: ./Run_Benchmarks.sh [Compare_Benchmarks.py options, e.g. --update]
+#
+# Environment:
+#     COSMOS_QEMU           QEMU binary (qemu-system-x86_64).
+#     COSMOS_BENCH_CPU      Fixed CPU model so runs stay comparable (Skylake-Client-v4).
+#     COSMOS_BENCH_CPUS     Number of processors (1).
+#     COSMOS_BENCH_TIMEOUT  Seconds before the run is treated as hung (300).
+#     COSMOS_BENCH_LOG      Serial output (bench.log).
+#     COSMOS_BENCH_BASELINE Baseline JSON (Benchmark_Baseline.json).
+#     COSMOS_KERNEL_CONFIG  Kernel build configuration, see kernel/Config_Makefile (release).
+#     COSMOS_NO_BUILD       Set to reuse the images already built.
+#     COSMOS_NO_COMPARE     Set to only capture the serial output, e.g. for an
+#                           instrument build's edge counters.
+
+set -e
+
+QEMU=${COSMOS_QEMU:-qemu-system-x86_64}
+LOG=${COSMOS_BENCH_LOG:-bench.log}
+BASELINE=${COSMOS_BENCH_BASELINE:-Benchmark_Baseline.json}
+IMAGE=bench.img
+
+if [ -z "$COSMOS_NO_BUILD" ]; then
+    make -C bootloader clean > /dev/null
+    make -C bootloader all AUTO_LAUNCH=1
+    make -C kernel -f Bin_Makefile clean > /dev/null
+    make -C kernel -f Bin_Makefile all BENCH=1 CONFIG=${COSMOS_KERNEL_CONFIG:-release}
+    make -C kernel -f ELF_Makefile clean > /dev/null
+    make -C kernel -f ELF_Makefile all BENCH=1 CONFIG=${COSMOS_KERNEL_CONFIG:-release}
+fi
+
+./Make_Image_Unprivileged.sh "$IMAGE"
+
+# OVMF writes its variable store, keep the checked out one untouched.
+VARS=$(mktemp)
+trap 'rm -f "$VARS"' EXIT
+cp ovmf/ovmf-vars-x86_64.fd "$VARS"
+
+# KVM when it is available, numbers are only comparable with a baseline taken
+# on the same accelerator.
+ACCELERATOR=tcg
+if [ -w /dev/kvm ]; then
+    ACCELERATOR=kvm
+fi
+CPU=${COSMOS_BENCH_CPU:-Skylake-Client-v4}
+echo "Benchmarking on $ACCELERATOR with $CPU"
+
+rm -f "$LOG"
+set +e
+timeout ${COSMOS_BENCH_TIMEOUT:-300} "$QEMU" \
+-accel $ACCELERATOR \
+-cpu $CPU \
+-drive file="$IMAGE",unit=0,format=raw \
+-drive if=pflash,unit=0,format=raw,file=ovmf/ovmf-code-x86_64.fd,readonly=on \
+-drive if=pflash,unit=1,format=raw,file="$VARS" \
+-display none \
+-m 2048M \
+-smp ${COSMOS_BENCH_CPUS:-1} \
+-serial file:"$LOG" \
+-monitor none \
+-no-reboot \
+-device isa-debug-exit,iobase=0xf4,iosize=0x04
+STATUS=$?
+set -e
+
+# isa-debug-exit exits with (status << 1) | 1, the kernel writes 0.
+if [ $STATUS -eq 124 ]; then
+    echo "QEMU timed out, see $LOG" >&2
+    exit 2
+elif [ $STATUS -ne 1 ]; then
+    echo "QEMU exited with $STATUS before the benchmarks finished, see $LOG" >&2
+    exit 2
+fi
+
+if [ -n "$COSMOS_NO_COMPARE" ]; then
+    exit 0
+fi
+# The baseline records the accelerator and CPU model, comparing against one
+# taken on others fails.
+python3 Compare_Benchmarks.py "$LOG" "$BASELINE" --accelerator $ACCELERATOR --cpu "$CPU" "$@"
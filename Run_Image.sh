@@ -2,8 +2,10 @@
 -drive file=cosmos.img,unit=0,format=raw \
 -drive if=pflash,unit=0,format=raw,file=ovmf/ovmf-code-x86_64.fd,readonly=on \
 -drive if=pflash,unit=1,format=raw,file=ovmf/ovmf-vars-x86_64.fd \
--display gtk \
+-display ${COSMOS_DISPLAY:-gtk} \
 -m 2048M \
+-smp ${COSMOS_NUM_OF_CPUS:-4} \
+${COSMOS_NUMA_OPTIONS} \
 -d in_asm,cpu_reset,op,int \
 -D qemu_log.log \
 -chardev stdio,mux=on,id=char0,logfile=stdio.log,signal=off \
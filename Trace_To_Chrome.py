@@ -0,0 +1,78 @@
+#!/usr/bin/env python3
+# Convert the kernel's trace dump in the serial output (stdio.log by default)
+# into Chrome trace event JSON, viewable in chrome://tracing or Perfetto.
+#
+# Usage: ./Trace_To_Chrome.py [serial log] [output json]
+#
+# The dump is written by kernel_trace_dump:
+#     TRACE BEGIN <tsc frequency hz>
+#     <cpu> <tsc> <B|E|I|C> <value> <name>
+#     TRACE END <records> <dropped>
+# The last complete dump in the log is converted. Timestamps are microseconds
+# from the earliest record, one thread per processor.
+
+import json
+import sys
+
+def read_last_dump(lines):
+    dump = None
+    current = None
+    for line in lines:
+        line = line.strip()
+        if line.startswith("TRACE BEGIN "):
+            current = {"frequency_hz": int(line.split()[2]), "records": [], "dropped": 0}
+        elif line.startswith("TRACE END ") and current is not None:
+            current["dropped"] = int(line.split()[3])
+            dump = current
+            current = None
+        elif current is not None:
+            fields = line.split(" ", 4)
+            if len(fields) != 5 or fields[2] not in "BEIC":
+                continue
+            current["records"].append((int(fields[1]), int(fields[0]), fields[2], int(fields[3]), fields[4]))
+    return dump
+
+def to_chrome_events(dump):
+    # Buffers are dumped one after another and interrupts can reorder records
+    # within one, so order by timestamp before Chrome pairs begins and ends.
+    records = sorted(dump["records"], key=lambda record: record[0])
+    if not records:
+        return []
+
+    cycles_per_us = dump["frequency_hz"] / 1000000.0
+    first_tsc = records[0][0]
+
+    events = []
+    for cpu in sorted({record[1] for record in records}):
+        events.append({"name": "thread_name", "ph": "M", "pid": 0, "tid": cpu, "args": {"name": "cpu %d" % cpu}})
+
+    for tsc, cpu, event_type, value, name in records:
+        event = {"name": name, "ph": event_type, "ts": (tsc - first_tsc) / cycles_per_us, "pid": 0, "tid": cpu}
+        if event_type == "I":
+            event["ph"] = "i"
+            event["s"] = "t"
+        elif event_type == "C":
+            event["args"] = {"value": value}
+        events.append(event)
+
+    return events
+
+def main():
+    input_path = sys.argv[1] if len(sys.argv) > 1 else "stdio.log"
+    output_path = sys.argv[2] if len(sys.argv) > 2 else "trace.json"
+
+    with open(input_path, errors="replace") as input_file:
+        dump = read_last_dump(input_file)
+
+    if dump is None:
+        sys.exit("No complete trace dump in " + input_path)
+    if dump["frequency_hz"] == 0:
+        sys.exit("Trace dump has no TSC frequency")
+
+    with open(output_path, "w") as output_file:
+        json.dump({"traceEvents": to_chrome_events(dump), "displayTimeUnit": "ns"}, output_file)
+
+    print("%d records, %d dropped, written to %s" % (len(dump["records"]), dump["dropped"], output_path))
+
+if __name__ == "__main__":
+    main()
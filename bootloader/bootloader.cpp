@@ -7,6 +7,8 @@
 #include "../shared/assembly_wrappers/registers.h"
 #include "../shared/graphics/fonts/pc_screen_font_v1_renderer.h"
 #include "../shared/memory/paging.h"
+#include "../shared/trace/trace.h"
+#include "../shared/trace/boot_timing.h"
 #include <stddef.h>
 
 #define UP_ARROW_SCANCODE          1
@@ -16,6 +18,13 @@
 #define DEFAULT_BACKGROUND_COLOR   UEFI_BACKGROUND_CYAN
 #define HIGHLIGHT_FOREGROUND_COLOR UEFI_FOREGROUND_YELLOW
 #define HIGHLIGHT_BACKGROUND_COLOR UEFI_BACKGROUND_BLACK
+#define BOOT_TRACE_BUFFER_NUM_OF_PAGES 64 // 8191 records after the buffer header.
+#define MAX_NUM_OF_EXIT_BOOT_SERVICES_ATTEMPTS 8
+
+/* Phase timestamps, handed to the kernel. The bootloader image stays in loader
+memory the kernel never reuses, so the kernel keeps writing here. */
+static boot_timing   bootloader_boot_timing;
+static trace_buffer* bootloader_trace_buffer;
 
 /*******************************************************************************
 PRINT DATE TIME FUNCTION
@@ -311,6 +320,89 @@ UEFI_STATUS display_memory_map (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE* Syst
 
 }
 
+/*******************************************************************************
+COMPARE GUIDS FUNCTION
+*******************************************************************************/
+static bool compare_guids (const UEFI_GUID* a, const UEFI_GUID* b) {
+
+    const uint8_t* a_bytes = (const uint8_t*)a;
+    const uint8_t* b_bytes = (const uint8_t*)b;
+
+    for (uint64_t idx = 0; idx < sizeof(UEFI_GUID); idx++) {
+        if (a_bytes[idx] != b_bytes[idx]) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+FIND ACPI RSDP FUNCTION
+
+Search the UEFI configuration table for the ACPI root system description 
+pointer, preferring the ACPI 2.0+ entry (XSDT) over the ACPI 1.0 entry (RSDT).
+Returns nullptr if neither is present.
+*******************************************************************************/
+void* find_acpi_rsdp (UEFI_SYSTEM_TABLE* SystemTable) {
+
+    UEFI_GUID acpi_20_guid = UEFI_ACPI_20_TABLE_GUID;
+    UEFI_GUID acpi_10_guid = UEFI_ACPI_TABLE_GUID;
+    void*     acpi_10_rsdp = nullptr;
+
+    for (uint64_t idx = 0; idx < SystemTable->NumberOfTableEntries; idx++) {
+
+        UEFI_CONFIGURATION_TABLE* table = &SystemTable->ConfigurationTable[idx];
+
+        if (compare_guids(&table->VendorGuid, &acpi_20_guid)) {
+            return table->VendorTable;
+        }
+
+        if (compare_guids(&table->VendorGuid, &acpi_10_guid)) {
+            acpi_10_rsdp = table->VendorTable;
+        }
+    }
+
+    return acpi_10_rsdp;
+
+}
+
+/*******************************************************************************
+SETUP BOOT TRACE BUFFER FUNCTION
+
+Allocate the trace buffer of the bootstrap processor and make it the default
+buffer. The header and records share loader data pages, which the kernel keeps,
+so the kernel continues recording into the same buffer. Returns nullptr if the
+pages could not be allocated, tracepoints then drop their records.
+*******************************************************************************/
+static trace_buffer* Setup_Boot_Trace_Buffer (UEFI_SYSTEM_TABLE* SystemTable) {
+
+    void* trace_memory = nullptr;
+    UEFI_STATUS status = SystemTable->BootServices->AllocatePages (
+        UEFI_ALLOCATE_TYPE::AllocateAnyPages,
+        UEFI_MEMORY_TYPE::UefiLoaderData,
+        BOOT_TRACE_BUFFER_NUM_OF_PAGES,
+        (UEFI_PHYSICAL_ADDRESS*)&trace_memory
+    );
+
+    if (UEFI_IS_ERROR(status)) {
+        return nullptr;
+    }
+
+    // The header takes the first record's slot.
+    static_assert(sizeof(trace_buffer) <= sizeof(trace_record), "Trace buffer header larger than a record.");
+    trace_buffer* buffer  = (trace_buffer*)trace_memory;
+    trace_record* records = (trace_record*)(((uint8_t*)trace_memory) + sizeof(trace_record));
+    uint64_t num_of_records = ((BOOT_TRACE_BUFFER_NUM_OF_PAGES * 4096) / sizeof(trace_record)) - 1;
+
+    trace_buffer_initialize(buffer, records, num_of_records, 0);
+    trace_set_default_buffer(buffer);
+
+    return buffer;
+
+}
+
 /*******************************************************************************
 LAUNCH COSMOS FUNCTION
 *******************************************************************************/
@@ -323,6 +415,8 @@ UEFI_STATUS UEFI_API launch_cosmOS (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE*
     );
     SystemTable->ConOut->ClearScreen(SystemTable->ConOut);
 
+    boot_timing_end(&bootloader_boot_timing, boot_phase_menu);
+
     // Kill the date and time event before loading kernel.
     SystemTable->BootServices->CloseEvent(datetime_event);
 
@@ -334,6 +428,7 @@ UEFI_STATUS UEFI_API launch_cosmOS (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE*
     UEFI_PRINT_ERROR (SystemTable, status, u"Could not locate GOP protocol");
 
     // Read the kernel binary executable into a buffer.
+    boot_timing_begin(&bootloader_boot_timing, boot_phase_read_kernel);
     uint64_t file_buffer_size;
     void* kernel_buffer = read_esp_file_into_buffer (
         ImageHandle, 
@@ -341,16 +436,21 @@ UEFI_STATUS UEFI_API launch_cosmOS (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE*
         u"\\EFI\\BOOT\\kernel.bin", 
         &file_buffer_size
     );
+    boot_timing_end(&bootloader_boot_timing, boot_phase_read_kernel);
 
     /* Obtain the memory map in order to get the maximum memory address when 
     setting up kernel page tables. */ 
     uint64_t PML4Address = 0;
-    Memory_Map_Info* mmap_info;
-    uefi_get_memory_map (SystemTable, mmap_info);
+    Memory_Map_Info mmap_info;
+    boot_timing_begin(&bootloader_boot_timing, boot_phase_memory_map);
+    uefi_get_memory_map (SystemTable, &mmap_info);
+    boot_timing_end(&bootloader_boot_timing, boot_phase_memory_map);
     
     // Setup the kernel page tables and free the memory map memory.
-    Setup_Kernel_Page_Tables(SystemTable, PML4Address, mmap_info);
-    SystemTable->BootServices->FreePool(mmap_info);
+    boot_timing_begin(&bootloader_boot_timing, boot_phase_page_tables);
+    Setup_Kernel_Page_Tables(SystemTable, PML4Address, &mmap_info);
+    boot_timing_end(&bootloader_boot_timing, boot_phase_page_tables);
+    SystemTable->BootServices->FreePool(mmap_info.map);
 
     Kernel_Handover k;
 
@@ -371,10 +471,20 @@ UEFI_STATUS UEFI_API launch_cosmOS (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE*
     /* Populate kernel handover parameters object with memory map and GOP mode
     for access to framebuffer.*/
     k.gop = *gop->Mode;
-    uefi_get_memory_map (SystemTable, &k.memory_map);
+
+    /* Pass the ACPI RSDP, the tables it points to stay in ACPI memory after
+    boot services are exited. */
+    k.acpi_rsdp = find_acpi_rsdp(SystemTable);
+    if (k.acpi_rsdp == nullptr) {
+        uefi_printf(SystemTable, u"Could not find the ACPI RSDP\r\n");
+    }
+
+    k.boot_trace_buffer = bootloader_trace_buffer;
+    k.boot_timings      = &bootloader_boot_timing;
 
     /* Initialize PC_Screen_Font_v1_Renderer and populate the respective kernel
     handover field. */
+    boot_timing_begin(&bootloader_boot_timing, boot_phase_font_load);
     PC_Screen_Font_v1_Renderer font_renderer (
         ImageHandle, 
         SystemTable, 
@@ -383,6 +493,7 @@ UEFI_STATUS UEFI_API launch_cosmOS (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE*
         16
     );
     k.font_renderer = &font_renderer;
+    boot_timing_end(&bootloader_boot_timing, boot_phase_font_load);
 
     /* Establish a function pointer pointing to the kinary binary's executable
     code. */
@@ -391,8 +502,30 @@ UEFI_STATUS UEFI_API launch_cosmOS (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE*
 
     uefi_printf(SystemTable, u"Address of Entry Point: %h\r\n", entry_point);
 
-    // Exit UEFI boot services.
-    SystemTable->BootServices->ExitBootServices(ImageHandle, k.memory_map.key);
+    /* Take the memory map last, after the font's allocations, so its key is
+    still current when boot services are exited. */
+    boot_timing_begin(&bootloader_boot_timing, boot_phase_memory_map);
+    uefi_get_memory_map (SystemTable, &k.memory_map);
+    boot_timing_end(&bootloader_boot_timing, boot_phase_memory_map);
+
+    /* Exit UEFI boot services. The firmware may still change the map in
+    between, e.g. from a timer event, in which case take it again and retry.
+    After a failed attempt only GetMemoryMap may be called, so the map is taken
+    into the buffer already allocated and errors go to the framebuffer. */
+    boot_timing_begin(&bootloader_boot_timing, boot_phase_exit_boot_services);
+    uint64_t num_of_exit_attempts = 1;
+    while (UEFI_IS_ERROR(SystemTable->BootServices->ExitBootServices(ImageHandle, k.memory_map.key))) {
+        if ((num_of_exit_attempts >= MAX_NUM_OF_EXIT_BOOT_SERVICES_ATTEMPTS) ||
+            UEFI_IS_ERROR(uefi_refresh_memory_map(SystemTable, &k.memory_map))) {
+            font_renderer.print_string(0x00FF0000, (char*)"Could not exit UEFI boot services", 10, 10);
+            disable_interrupts();
+            while (true) {
+                __asm__ __volatile__ ("hlt");
+            }
+        }
+        num_of_exit_attempts++;
+    }
+    boot_timing_end(&bootloader_boot_timing, boot_phase_exit_boot_services);
 
     /* Write the PML4's address to the CR3 register, use our own page tables 
     rather than UEFI's. Avoids situation like UEFI marks memory as read only in
@@ -416,6 +549,11 @@ BOOTLOADER ENTRY POINT FUNCTION
 extern "C" { // Avoids name mangling of the UEFI entry point.
 UEFI_STATUS UEFI_API uefi_main (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE* SystemTable) {
 
+    // Boot phases are timed from here, the trace starts with the menu.
+    boot_timing_initialize(&bootloader_boot_timing, read_tsc());
+    bootloader_trace_buffer = Setup_Boot_Trace_Buffer(SystemTable);
+    boot_timing_begin(&bootloader_boot_timing, boot_phase_menu);
+
     /* Reset Console Device, clear screen to background color, and set cursor
     to (0,0) */
     SystemTable->ConOut->Reset(SystemTable->ConOut, false);
@@ -445,6 +583,12 @@ UEFI_STATUS UEFI_API uefi_main (UEFI_HANDLE ImageHandle, UEFI_SYSTEM_TABLE* Syst
 
     uint64_t selected_menu_option = 0;
 
+    /* Headless builds (make AUTO_LAUNCH=1) skip the menu and launch straight
+    away, nothing waits for a keystroke on the way to the kernel. */
+#ifdef BOOTLOADER_AUTO_LAUNCH
+    launch_cosmOS (ImageHandle, SystemTable, datetime_event);
+#endif
+
     while(true) {
 
         // Clear screen to the default background color.
@@ -0,0 +1,450 @@
+#include "acpi.h"
+
+#define ACPI_MADT_FLAGS_PCAT_COMPAT           (1U << 0)
+#define ACPI_MADT_LOCAL_APIC                  0
+#define ACPI_MADT_IO_APIC                     1
+#define ACPI_MADT_INTERRUPT_SOURCE_OVERRIDE   2
+#define ACPI_MADT_LOCAL_APIC_ADDRESS_OVERRIDE 5
+#define ACPI_MADT_LOCAL_X2APIC                9
+#define ACPI_MADT_PROCESSOR_ENABLED           (1U << 0)
+#define ACPI_MADT_PROCESSOR_ONLINE_CAPABLE    (1U << 1)
+
+#define ACPI_SRAT_PROCESSOR_AFFINITY          0
+#define ACPI_SRAT_MEMORY_AFFINITY             1
+#define ACPI_SRAT_X2APIC_AFFINITY             2
+#define ACPI_SRAT_ENABLED                     (1U << 0)
+#define ACPI_SRAT_MEMORY_HOT_PLUGGABLE        (1U << 1)
+#define ACPI_SRAT_MEMORY_NON_VOLATILE         (1U << 2)
+
+typedef struct {
+    acpi_sdt_header header;
+    uint32_t        local_apic_address;
+    uint32_t        flags;
+} __attribute__((packed)) acpi_madt;
+
+typedef struct {
+    uint8_t type;
+    uint8_t length;
+} __attribute__((packed)) acpi_subtable_header;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint8_t              acpi_processor_uid;
+    uint8_t              apic_id;
+    uint32_t             flags;
+} __attribute__((packed)) acpi_madt_local_apic;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint8_t              io_apic_id;
+    uint8_t              reserved;
+    uint32_t             io_apic_address;
+    uint32_t             global_system_interrupt_base;
+} __attribute__((packed)) acpi_madt_io_apic;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint8_t              bus;
+    uint8_t              source;
+    uint32_t             global_system_interrupt;
+    uint16_t             flags;
+} __attribute__((packed)) acpi_madt_interrupt_source_override;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint16_t             reserved;
+    uint64_t             local_apic_address;
+} __attribute__((packed)) acpi_madt_local_apic_address_override;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint16_t             reserved;
+    uint32_t             x2apic_id;
+    uint32_t             flags;
+    uint32_t             acpi_processor_uid;
+} __attribute__((packed)) acpi_madt_local_x2apic;
+
+typedef struct {
+    acpi_sdt_header      header;
+    uint32_t             event_timer_block_id;
+    acpi_generic_address base_address;
+    uint8_t              hpet_number;
+    uint16_t             minimum_tick;
+    uint8_t              page_protection;
+} __attribute__((packed)) acpi_hpet_table;
+
+typedef struct {
+    acpi_sdt_header header;
+    uint32_t        reserved_0;
+    uint64_t        reserved_1;
+} __attribute__((packed)) acpi_srat;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint8_t              proximity_domain_low;
+    uint8_t              apic_id;
+    uint32_t             flags;
+    uint8_t              local_sapic_eid;
+    uint8_t              proximity_domain_high[3];
+    uint32_t             clock_domain;
+} __attribute__((packed)) acpi_srat_processor_affinity;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint32_t             proximity_domain;
+    uint16_t             reserved_0;
+    uint64_t             base_address;
+    uint64_t             length;
+    uint32_t             reserved_1;
+    uint32_t             flags;
+    uint64_t             reserved_2;
+} __attribute__((packed)) acpi_srat_memory_affinity;
+
+typedef struct {
+    acpi_subtable_header header;
+    uint16_t             reserved_0;
+    uint32_t             proximity_domain;
+    uint32_t             x2apic_id;
+    uint32_t             flags;
+    uint32_t             clock_domain;
+    uint32_t             reserved_1;
+} __attribute__((packed)) acpi_srat_x2apic_affinity;
+
+// Filled once by the bootstrap processor, read only afterwards.
+static acpi_tables acpi_cache;
+
+// XSDT (8 byte entries) or RSDT (4 byte entries), nullptr before initialization.
+static acpi_sdt_header* acpi_root_table;
+static uint64_t         acpi_root_entry_size;
+
+/*******************************************************************************
+Checksum Function
+Every byte of a valid table, including its checksum byte, sums to zero.
+*******************************************************************************/
+static bool Checksum (const void* table, uint64_t length) {
+
+    const uint8_t* bytes = (const uint8_t*)table;
+    uint8_t sum = 0;
+
+    for (uint64_t idx = 0; idx < length; idx++) {
+        sum += bytes[idx];
+    }
+
+    return (sum == 0);
+
+}
+
+/*******************************************************************************
+Signature Matches Function
+*******************************************************************************/
+static bool Signature_Matches (const char* signature, const char* expected, uint64_t length) {
+
+    for (uint64_t idx = 0; idx < length; idx++) {
+        if (signature[idx] != expected[idx]) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Parse MADT Function
+Cache the enabled processors, the I/O APICs and the legacy IRQ overrides.
+Processors that are disabled but online capable can only be hot added, they
+are counted but not cached, since nothing starts them at boot.
+*******************************************************************************/
+static void Parse_MADT (acpi_madt* madt) {
+
+    acpi_cache.local_apic_address = madt->local_apic_address;
+    acpi_cache.has_legacy_pics    = ((madt->flags & ACPI_MADT_FLAGS_PCAT_COMPAT) != 0);
+
+    uint8_t* entry = (uint8_t*)(madt + 1);
+    uint8_t* end   = ((uint8_t*)madt) + madt->header.length;
+
+    while ((entry + sizeof(acpi_subtable_header)) <= end) {
+
+        acpi_subtable_header* header = (acpi_subtable_header*)entry;
+        if ((header->length < sizeof(acpi_subtable_header)) || ((entry + header->length) > end)) {
+            break;
+        }
+
+        if (header->type == ACPI_MADT_LOCAL_APIC) {
+
+            acpi_madt_local_apic* local_apic = (acpi_madt_local_apic*)entry;
+            if (!(local_apic->flags & ACPI_MADT_PROCESSOR_ENABLED)) {
+                if (local_apic->flags & ACPI_MADT_PROCESSOR_ONLINE_CAPABLE) {
+                    acpi_cache.num_of_online_capable_processors++;
+                }
+            } else if (acpi_cache.num_of_processors < ACPI_MAX_NUM_OF_PROCESSORS) {
+                acpi_processor* processor     = &acpi_cache.processors[acpi_cache.num_of_processors++];
+                processor->apic_id            = local_apic->apic_id;
+                processor->acpi_processor_uid = local_apic->acpi_processor_uid;
+                processor->proximity_domain   = ACPI_NO_PROXIMITY_DOMAIN;
+            }
+
+        } else if (header->type == ACPI_MADT_LOCAL_X2APIC) {
+
+            acpi_madt_local_x2apic* local_x2apic = (acpi_madt_local_x2apic*)entry;
+            if (!(local_x2apic->flags & ACPI_MADT_PROCESSOR_ENABLED)) {
+                if (local_x2apic->flags & ACPI_MADT_PROCESSOR_ONLINE_CAPABLE) {
+                    acpi_cache.num_of_online_capable_processors++;
+                }
+            } else if (acpi_cache.num_of_processors < ACPI_MAX_NUM_OF_PROCESSORS) {
+                acpi_processor* processor     = &acpi_cache.processors[acpi_cache.num_of_processors++];
+                processor->apic_id            = local_x2apic->x2apic_id;
+                processor->acpi_processor_uid = local_x2apic->acpi_processor_uid;
+                processor->proximity_domain   = ACPI_NO_PROXIMITY_DOMAIN;
+            }
+
+        } else if (header->type == ACPI_MADT_IO_APIC) {
+
+            acpi_madt_io_apic* io_apic = (acpi_madt_io_apic*)entry;
+            if (acpi_cache.num_of_io_apics < ACPI_MAX_NUM_OF_IO_APICS) {
+                acpi_io_apic* cached                 = &acpi_cache.io_apics[acpi_cache.num_of_io_apics++];
+                cached->id                           = io_apic->io_apic_id;
+                cached->address                      = io_apic->io_apic_address;
+                cached->global_system_interrupt_base = io_apic->global_system_interrupt_base;
+            }
+
+        } else if (header->type == ACPI_MADT_INTERRUPT_SOURCE_OVERRIDE) {
+
+            acpi_madt_interrupt_source_override* override = (acpi_madt_interrupt_source_override*)entry;
+            if (acpi_cache.num_of_interrupt_overrides < ACPI_MAX_NUM_OF_INTERRUPT_OVERRIDES) {
+                acpi_interrupt_override* cached = &acpi_cache.interrupt_overrides[acpi_cache.num_of_interrupt_overrides++];
+                cached->bus                     = override->bus;
+                cached->source_irq              = override->source;
+                cached->global_system_interrupt = override->global_system_interrupt;
+                cached->flags                   = override->flags;
+            }
+
+        } else if (header->type == ACPI_MADT_LOCAL_APIC_ADDRESS_OVERRIDE) {
+
+            acpi_cache.local_apic_address = ((acpi_madt_local_apic_address_override*)entry)->local_apic_address;
+
+        }
+
+        entry += header->length;
+
+    }
+}
+
+/*******************************************************************************
+Parse HPET Function
+*******************************************************************************/
+static void Parse_HPET (acpi_hpet_table* hpet) {
+
+    // Only a memory mapped event timer block is usable.
+    if (hpet->base_address.address_space_id != 0) {
+        return;
+    }
+
+    acpi_cache.hpet.present      = true;
+    acpi_cache.hpet.address      = hpet->base_address.address;
+    acpi_cache.hpet.hpet_number  = hpet->hpet_number;
+    acpi_cache.hpet.minimum_tick = hpet->minimum_tick;
+
+}
+
+/*******************************************************************************
+Set Processor Proximity Domain Function
+*******************************************************************************/
+static void Set_Processor_Proximity_Domain (uint32_t apic_id, uint32_t proximity_domain) {
+
+    for (uint64_t idx = 0; idx < acpi_cache.num_of_processors; idx++) {
+        if (acpi_cache.processors[idx].apic_id == apic_id) {
+            acpi_cache.processors[idx].proximity_domain = proximity_domain;
+            return;
+        }
+    }
+}
+
+/*******************************************************************************
+Parse SRAT Function
+
+Attach a proximity domain to each processor found in the MADT and cache the
+memory ranges of each domain. Must run after the MADT has been parsed. Domains
+are assumed to be numbered densely from zero, as firmware does in practice.
+*******************************************************************************/
+static void Parse_SRAT (acpi_srat* srat) {
+
+    uint8_t* entry = (uint8_t*)(srat + 1);
+    uint8_t* end   = ((uint8_t*)srat) + srat->header.length;
+
+    uint32_t max_proximity_domain = 0;
+    bool     found_domain         = false;
+
+    while ((entry + sizeof(acpi_subtable_header)) <= end) {
+
+        acpi_subtable_header* header = (acpi_subtable_header*)entry;
+        if ((header->length < sizeof(acpi_subtable_header)) || ((entry + header->length) > end)) {
+            break;
+        }
+
+        uint32_t proximity_domain = ACPI_NO_PROXIMITY_DOMAIN;
+
+        if (header->type == ACPI_SRAT_PROCESSOR_AFFINITY) {
+
+            acpi_srat_processor_affinity* affinity = (acpi_srat_processor_affinity*)entry;
+            if (affinity->flags & ACPI_SRAT_ENABLED) {
+                proximity_domain = affinity->proximity_domain_low                  |
+                                   ((uint32_t)affinity->proximity_domain_high[0] << 8)  |
+                                   ((uint32_t)affinity->proximity_domain_high[1] << 16) |
+                                   ((uint32_t)affinity->proximity_domain_high[2] << 24);
+                Set_Processor_Proximity_Domain(affinity->apic_id, proximity_domain);
+            }
+
+        } else if (header->type == ACPI_SRAT_X2APIC_AFFINITY) {
+
+            acpi_srat_x2apic_affinity* affinity = (acpi_srat_x2apic_affinity*)entry;
+            if (affinity->flags & ACPI_SRAT_ENABLED) {
+                proximity_domain = affinity->proximity_domain;
+                Set_Processor_Proximity_Domain(affinity->x2apic_id, proximity_domain);
+            }
+
+        } else if (header->type == ACPI_SRAT_MEMORY_AFFINITY) {
+
+            acpi_srat_memory_affinity* affinity = (acpi_srat_memory_affinity*)entry;
+            if ((affinity->flags & ACPI_SRAT_ENABLED) && (affinity->length != 0) &&
+                (acpi_cache.num_of_memory_affinities < ACPI_MAX_NUM_OF_MEMORY_AFFINITIES)) {
+                proximity_domain = affinity->proximity_domain;
+                acpi_memory_affinity* cached = &acpi_cache.memory_affinities[acpi_cache.num_of_memory_affinities++];
+                cached->base_address     = affinity->base_address;
+                cached->length           = affinity->length;
+                cached->proximity_domain = proximity_domain;
+                cached->hot_pluggable    = ((affinity->flags & ACPI_SRAT_MEMORY_HOT_PLUGGABLE) != 0);
+                cached->non_volatile     = ((affinity->flags & ACPI_SRAT_MEMORY_NON_VOLATILE) != 0);
+            }
+
+        }
+
+        if (proximity_domain != ACPI_NO_PROXIMITY_DOMAIN) {
+            found_domain = true;
+            if (proximity_domain > max_proximity_domain) {
+                max_proximity_domain = proximity_domain;
+            }
+        }
+
+        entry += header->length;
+
+    }
+
+    acpi_cache.num_of_proximity_domains = found_domain ? (max_proximity_domain + 1) : 0;
+
+}
+
+/*******************************************************************************
+Initialize ACPI Function
+
+Validate the RSDP handed over by the bootloader, select the XSDT (or the RSDT
+on ACPI 1.0 firmware) and cache the MADT, HPET and SRAT contents so later users
+never walk firmware tables again. Tables that are missing or fail their checksum
+are skipped. Returns false if the RSDP or root table is unusable.
+*******************************************************************************/
+bool Initialize_ACPI (void* rsdp) {
+
+    uint8_t* cache_bytes = (uint8_t*)&acpi_cache;
+    for (uint64_t idx = 0; idx < sizeof(acpi_tables); idx++) {
+        cache_bytes[idx] = 0;
+    }
+
+    acpi_root_table = nullptr;
+
+    acpi_rsdp* root_pointer = (acpi_rsdp*)rsdp;
+    if ((root_pointer == nullptr) || !Signature_Matches(root_pointer->signature, "RSD PTR ", 8) ||
+        !Checksum(root_pointer, 20)) {
+        return false;
+    }
+
+    acpi_cache.revision = root_pointer->revision;
+
+    if ((root_pointer->revision >= 2) && (root_pointer->xsdt_address != 0) &&
+        Checksum(root_pointer, root_pointer->length)) {
+        acpi_root_table      = (acpi_sdt_header*)root_pointer->xsdt_address;
+        acpi_root_entry_size = 8;
+    } else {
+        acpi_root_table      = (acpi_sdt_header*)(uint64_t)root_pointer->rsdt_address;
+        acpi_root_entry_size = 4;
+    }
+
+    if (!Checksum(acpi_root_table, acpi_root_table->length)) {
+        acpi_root_table = nullptr;
+        return false;
+    }
+
+    acpi_madt* madt = (acpi_madt*)acpi_find_table("APIC");
+    if (madt != nullptr) {
+        Parse_MADT(madt);
+    }
+
+    acpi_hpet_table* hpet = (acpi_hpet_table*)acpi_find_table("HPET");
+    if (hpet != nullptr) {
+        Parse_HPET(hpet);
+    }
+
+    acpi_srat* srat = (acpi_srat*)acpi_find_table("SRAT");
+    if (srat != nullptr) {
+        Parse_SRAT(srat);
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Get ACPI Tables Function
+*******************************************************************************/
+const acpi_tables* get_acpi_tables () {
+    return &acpi_cache;
+}
+
+/*******************************************************************************
+ACPI Find Table Function
+Returns the first table with a valid checksum and the given four character
+signature, or nullptr.
+*******************************************************************************/
+acpi_sdt_header* acpi_find_table (const char* signature) {
+
+    if (acpi_root_table == nullptr) {
+        return nullptr;
+    }
+
+    uint64_t num_of_entries = (acpi_root_table->length - sizeof(acpi_sdt_header)) / acpi_root_entry_size;
+    uint8_t* entries        = (uint8_t*)(acpi_root_table + 1);
+
+    for (uint64_t idx = 0; idx < num_of_entries; idx++) {
+
+        // Entries are only 4 byte aligned in the XSDT.
+        uint64_t address = 0;
+        for (uint64_t byte = 0; byte < acpi_root_entry_size; byte++) {
+            address |= ((uint64_t)entries[(idx * acpi_root_entry_size) + byte]) << (byte * 8);
+        }
+
+        acpi_sdt_header* table = (acpi_sdt_header*)address;
+        if ((table != nullptr) && Signature_Matches(table->signature, signature, 4) && Checksum(table, table->length)) {
+            return table;
+        }
+
+    }
+
+    return nullptr;
+
+}
+
+/*******************************************************************************
+ACPI Get Proximity Domain Function
+The NUMA node of the processor with the given APIC ID, or
+ACPI_NO_PROXIMITY_DOMAIN if the SRAT does not say.
+*******************************************************************************/
+uint32_t acpi_get_proximity_domain (uint32_t apic_id) {
+
+    for (uint64_t idx = 0; idx < acpi_cache.num_of_processors; idx++) {
+        if (acpi_cache.processors[idx].apic_id == apic_id) {
+            return acpi_cache.processors[idx].proximity_domain;
+        }
+    }
+
+    return ACPI_NO_PROXIMITY_DOMAIN;
+
+}
@@ -0,0 +1,107 @@
+#pragma once
+#include <stdint.h>
+
+#define ACPI_MAX_NUM_OF_PROCESSORS          256
+#define ACPI_MAX_NUM_OF_IO_APICS            16
+#define ACPI_MAX_NUM_OF_INTERRUPT_OVERRIDES 32
+#define ACPI_MAX_NUM_OF_MEMORY_AFFINITIES   64
+#define ACPI_NO_PROXIMITY_DOMAIN            UINT32_MAX
+
+/*******************************************************************************
+Firmware table layouts (ACPI Specification 6.5 chapter 5).
+*******************************************************************************/
+typedef struct {
+    char     signature[8]; // "RSD PTR "
+    uint8_t  checksum;
+    char     oem_id[6];
+    uint8_t  revision;     // 0 for ACPI 1.0 (RSDT only), 2 for ACPI 2.0+.
+    uint32_t rsdt_address;
+    uint32_t length;
+    uint64_t xsdt_address;
+    uint8_t  extended_checksum;
+    uint8_t  reserved[3];
+} __attribute__((packed)) acpi_rsdp;
+
+typedef struct {
+    char     signature[4];
+    uint32_t length;
+    uint8_t  revision;
+    uint8_t  checksum;
+    char     oem_id[6];
+    char     oem_table_id[8];
+    uint32_t oem_revision;
+    uint32_t creator_id;
+    uint32_t creator_revision;
+} __attribute__((packed)) acpi_sdt_header;
+
+typedef struct {
+    uint8_t  address_space_id; // 0 = system memory.
+    uint8_t  register_bit_width;
+    uint8_t  register_bit_offset;
+    uint8_t  access_size;
+    uint64_t address;
+} __attribute__((packed)) acpi_generic_address;
+
+/*******************************************************************************
+Cached topology, flattened out of the MADT, HPET and SRAT.
+*******************************************************************************/
+typedef struct {
+    uint32_t apic_id;
+    uint32_t acpi_processor_uid;
+    uint32_t proximity_domain; // From the SRAT, ACPI_NO_PROXIMITY_DOMAIN if unknown.
+} acpi_processor;
+
+typedef struct {
+    uint32_t id;
+    uint64_t address;
+    uint32_t global_system_interrupt_base;
+} acpi_io_apic;
+
+typedef struct {
+    uint8_t  bus;
+    uint8_t  source_irq;
+    uint32_t global_system_interrupt;
+    uint16_t flags; // Polarity (bits 0-1) and trigger mode (bits 2-3).
+} acpi_interrupt_override;
+
+typedef struct {
+    bool     present;
+    uint64_t address;
+    uint8_t  hpet_number;
+    uint16_t minimum_tick;
+} acpi_hpet;
+
+typedef struct {
+    uint64_t base_address;
+    uint64_t length;
+    uint32_t proximity_domain;
+    bool     hot_pluggable;
+    bool     non_volatile;
+} acpi_memory_affinity;
+
+typedef struct {
+    uint8_t                 revision;
+    uint64_t                local_apic_address;
+    bool                    has_legacy_pics;
+
+    acpi_processor          processors[ACPI_MAX_NUM_OF_PROCESSORS]; // Enabled only.
+    uint64_t                num_of_processors;
+    uint64_t                num_of_online_capable_processors;       // Disabled, may be hot added later.
+
+    acpi_io_apic            io_apics[ACPI_MAX_NUM_OF_IO_APICS];
+    uint64_t                num_of_io_apics;
+
+    acpi_interrupt_override interrupt_overrides[ACPI_MAX_NUM_OF_INTERRUPT_OVERRIDES];
+    uint64_t                num_of_interrupt_overrides;
+
+    acpi_hpet               hpet;
+
+    acpi_memory_affinity    memory_affinities[ACPI_MAX_NUM_OF_MEMORY_AFFINITIES];
+    uint64_t                num_of_memory_affinities;
+    uint32_t                num_of_proximity_domains;
+} acpi_tables;
+
+bool               Initialize_ACPI            (void* rsdp);
+const acpi_tables* get_acpi_tables            ();
+acpi_sdt_header*   acpi_find_table            (const char* signature);
+uint32_t           acpi_get_proximity_domain  (uint32_t apic_id);
@@ -0,0 +1,232 @@
+#include "benchmark.h"
+#include "../log/kernel_log.h"
+#include "../../shared/assembly_wrappers/registers.h"
+#include "../../shared/assembly_wrappers/port_io.h"
+
+static benchmark benchmarks[BENCHMARK_MAX_NUM_OF_BENCHMARKS];
+static uint64_t  num_of_benchmarks;
+static uint64_t* benchmark_samples;        // Cycles of each timed iteration of the running benchmark.
+static uint64_t  benchmark_overhead_cycles; // Cost of the timing itself, the fastest empty region.
+static bool      benchmark_has_rdtscp;
+
+/*******************************************************************************
+Begin and End Region Functions
+rdtscp waits for the timed instructions without the full serialization of
+cpuid; without it a fenced rdtsc does the same job on current processors.
+*******************************************************************************/
+static inline uint64_t Begin_Region () {
+    return read_tsc_fenced();
+}
+
+static inline uint64_t End_Region () {
+    return benchmark_has_rdtscp ? read_tscp_fenced() : read_tsc_fenced();
+}
+
+/*******************************************************************************
+Sift Down Function
+*******************************************************************************/
+static void Sift_Down (uint64_t* values, uint64_t root, uint64_t count) {
+
+    while (true) {
+
+        uint64_t largest = root;
+        uint64_t left    = (2 * root) + 1;
+        uint64_t right   = left + 1;
+
+        if ((left < count) && (values[left] > values[largest])) {
+            largest = left;
+        }
+        if ((right < count) && (values[right] > values[largest])) {
+            largest = right;
+        }
+        if (largest == root) {
+            return;
+        }
+
+        uint64_t swap   = values[root];
+        values[root]    = values[largest];
+        values[largest] = swap;
+        root            = largest;
+
+    }
+}
+
+/*******************************************************************************
+Sort Function
+Heap sort, in place and without recursion.
+*******************************************************************************/
+static void Sort (uint64_t* values, uint64_t count) {
+
+    for (uint64_t idx = count / 2; idx != 0; idx--) {
+        Sift_Down(values, idx - 1, count);
+    }
+
+    for (uint64_t end = count; end > 1; end--) {
+        uint64_t swap   = values[0];
+        values[0]       = values[end - 1];
+        values[end - 1] = swap;
+        Sift_Down(values, 0, end - 1);
+    }
+
+}
+
+/*******************************************************************************
+Setup Benchmarks Function
+Allocate room for the samples and measure what timing an empty region costs.
+*******************************************************************************/
+bool Setup_Benchmarks (Physical_Memory_Manager* pmm) {
+
+    benchmark_samples = (uint64_t*)pmm->allocate_physical_frames(BENCHMARK_MAX_NUM_OF_ITERATIONS * sizeof(uint64_t));
+    if (benchmark_samples == nullptr) {
+        return false;
+    }
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(0x80000000, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= 0x80000001) {
+        cpuid(0x80000001, 0, &eax, &ebx, &ecx, &edx);
+        benchmark_has_rdtscp = ((edx & (1U << 27)) != 0);
+    }
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    benchmark_overhead_cycles = UINT64_MAX;
+    for (uint64_t idx = 0; idx < BENCHMARK_NUM_OF_OVERHEAD_SAMPLES; idx++) {
+        uint64_t start  = Begin_Region();
+        uint64_t cycles = End_Region() - start;
+        if (cycles < benchmark_overhead_cycles) {
+            benchmark_overhead_cycles = cycles;
+        }
+    }
+
+    restore_interrupts(rflags);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Benchmark Register Function
+Add a benchmark to those benchmark_run_all runs, in registration order. The
+iterations are capped at BENCHMARK_MAX_NUM_OF_ITERATIONS. Returns false when
+the table is full.
+*******************************************************************************/
+bool benchmark_register (const char* name, benchmark_function function, void* context, uint64_t num_of_iterations, uint64_t operations_per_iteration, uint32_t flags) {
+
+    if ((num_of_benchmarks >= BENCHMARK_MAX_NUM_OF_BENCHMARKS) || (function == nullptr)) {
+        return false;
+    }
+
+    benchmark* bench                = &benchmarks[num_of_benchmarks++];
+    bench->name                     = name;
+    bench->function                 = function;
+    bench->context                  = context;
+    bench->num_of_iterations        = (num_of_iterations == 0) ? BENCHMARK_DEFAULT_NUM_OF_ITERATIONS : num_of_iterations;
+    bench->operations_per_iteration = (operations_per_iteration == 0) ? 1 : operations_per_iteration;
+    bench->flags                    = flags;
+
+    if (bench->num_of_iterations > BENCHMARK_MAX_NUM_OF_ITERATIONS) {
+        bench->num_of_iterations = BENCHMARK_MAX_NUM_OF_ITERATIONS;
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Benchmark Run Function
+Warm caches, TLBs and branch predictors up, then time each iteration on its
+own. Interrupts stay disabled throughout so timer and device interrupts do not
+land in the samples; the benchmark must not wait on them unless it was
+registered with BENCHMARK_FLAG_INTERRUPTS_ENABLED. Benchmarks timed only a few
+times, whole multi-phase runs, are warmed up as often as they are timed.
+*******************************************************************************/
+bool benchmark_run (const benchmark* bench, benchmark_result* result) {
+
+    if (benchmark_samples == nullptr) {
+        return false;
+    }
+
+    bool     interrupts_enabled = ((bench->flags & BENCHMARK_FLAG_INTERRUPTS_ENABLED) != 0);
+    uint64_t rflags             = interrupts_enabled ? 0 : save_and_disable_interrupts();
+
+    uint64_t num_of_warmups = (bench->num_of_iterations < BENCHMARK_DEFAULT_NUM_OF_WARMUPS) ? bench->num_of_iterations : BENCHMARK_DEFAULT_NUM_OF_WARMUPS;
+    for (uint64_t idx = 0; idx < num_of_warmups; idx++) {
+        bench->function(bench->context);
+    }
+
+    for (uint64_t idx = 0; idx < bench->num_of_iterations; idx++) {
+        uint64_t start  = Begin_Region();
+        bench->function(bench->context);
+        uint64_t cycles = End_Region() - start;
+        benchmark_samples[idx] = (cycles > benchmark_overhead_cycles) ? (cycles - benchmark_overhead_cycles) : 0;
+    }
+
+    if (!interrupts_enabled) {
+        restore_interrupts(rflags);
+    }
+
+    uint64_t count = bench->num_of_iterations;
+    Sort(benchmark_samples, count);
+
+    result->num_of_iterations = count;
+    result->min_cycles        = benchmark_samples[0];
+    result->median_cycles     = benchmark_samples[count / 2];
+    result->p99_cycles        = benchmark_samples[(((count * 99) + 99) / 100) - 1];
+    result->max_cycles        = benchmark_samples[count - 1];
+
+    return true;
+
+}
+
+/*******************************************************************************
+Benchmark Run All Function
+
+Run every registered benchmark and log one line per benchmark for the host to
+parse, cycles per iteration:
+
+    BENCH BEGIN tsc_hz=<hz> overhead=<cycles>
+    BENCH name=<name> ops=<operations per iteration> min=<> median=<> p99=<>
+    BENCH END count=<benchmarks run>
+
+Returns the number of benchmarks run.
+*******************************************************************************/
+uint64_t benchmark_run_all (uint64_t tsc_frequency_hz) {
+
+    kernel_log("BENCH BEGIN tsc_hz=%u overhead=%u", tsc_frequency_hz, benchmark_overhead_cycles);
+
+    uint64_t num_of_ran = 0;
+
+    for (uint64_t idx = 0; idx < num_of_benchmarks; idx++) {
+
+        const benchmark* bench = &benchmarks[idx];
+
+        benchmark_result result;
+        if (!benchmark_run(bench, &result)) {
+            continue;
+        }
+
+        kernel_log("BENCH name=%s ops=%u min=%u median=%u p99=%u", bench->name, bench->operations_per_iteration,
+                   result.min_cycles, result.median_cycles, result.p99_cycles);
+        num_of_ran++;
+
+        // Keep the log ring from overflowing when many benchmarks run back to back.
+        kernel_log_drain(KERNEL_LOG_RING_SIZE);
+
+    }
+
+    kernel_log("BENCH END count=%u", num_of_ran);
+
+    return num_of_ran;
+
+}
+
+/*******************************************************************************
+Benchmark Exit Emulator Function
+End a headless run under QEMU with isa-debug-exit, QEMU's exit status becomes
+(status << 1) | 1. Without the device the write goes nowhere and the kernel
+carries on.
+*******************************************************************************/
+void benchmark_exit_emulator (uint32_t status) {
+    outl(BENCHMARK_EMULATOR_EXIT_PORT, status);
+}
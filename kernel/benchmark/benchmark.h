@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+
+#define BENCHMARK_MAX_NUM_OF_BENCHMARKS     32
+#define BENCHMARK_MAX_NUM_OF_ITERATIONS     4096 // Timed iterations kept for the percentiles.
+#define BENCHMARK_DEFAULT_NUM_OF_WARMUPS    16
+#define BENCHMARK_DEFAULT_NUM_OF_ITERATIONS 1000
+#define BENCHMARK_NUM_OF_OVERHEAD_SAMPLES   256
+#define BENCHMARK_EMULATOR_EXIT_PORT        0xF4 // QEMU isa-debug-exit, as Run_Benchmarks.sh sets it up.
+
+// Waits on other processors or threads, so it runs with interrupts enabled.
+#define BENCHMARK_FLAG_INTERRUPTS_ENABLED   (1U << 0)
+
+// One timed iteration, given the context it was registered with.
+typedef void (*benchmark_function) (void* context);
+
+/* A registered benchmark. Filled in at run time by benchmark_register, the
+kernel has no global constructors to do it statically. */
+typedef struct {
+    const char*        name;                     // Must outlive the run, e.g. a string literal.
+    benchmark_function function;
+    void*              context;
+    uint64_t           num_of_iterations;
+    uint64_t           operations_per_iteration; // Lets the host report cycles per operation.
+    uint32_t           flags;
+} benchmark;
+
+// Cycles per iteration, timer overhead already subtracted.
+typedef struct {
+    uint64_t num_of_iterations;
+    uint64_t min_cycles;
+    uint64_t median_cycles;
+    uint64_t p99_cycles;
+    uint64_t max_cycles;
+} benchmark_result;
+
+bool     Setup_Benchmarks        (Physical_Memory_Manager* pmm);
+bool     benchmark_register      (const char* name, benchmark_function function, void* context, uint64_t num_of_iterations, uint64_t operations_per_iteration, uint32_t flags);
+bool     benchmark_run           (const benchmark* bench, benchmark_result* result);
+uint64_t benchmark_run_all       (uint64_t tsc_frequency_hz);
+void     benchmark_exit_emulator (uint32_t status);
@@ -0,0 +1,226 @@
+#include "kernel_benchmarks.h"
+#include "benchmark.h"
+
+typedef struct {
+    framebuffer_surface surface;
+    uint32_t            color;
+} framebuffer_fill_context;
+
+typedef struct {
+    PC_Screen_Font_v1_Renderer* font_renderer;
+    uint64_t                    y;
+} glyph_context;
+
+typedef struct {
+    Virtual_Memory_Manager* vmm;
+    uint64_t                addresses[KERNEL_BENCHMARK_NUM_OF_WALK_ADDRESSES];
+} page_walk_context;
+
+// Contexts are filled in at registration, statics are zeroed and never constructed.
+static framebuffer_fill_context framebuffer_fill;
+static framebuffer_fill_context framebuffer_fill_string;
+static glyph_context            glyphs;
+static page_walk_context        page_walk;
+static kernel_benchmark_results last_results;
+
+/*******************************************************************************
+PMM Allocate Free Benchmark Functions
+One frame, then a larger block that splits and coalesces.
+*******************************************************************************/
+static void PMM_Allocate_Free_Frame (void* context) {
+
+    Physical_Memory_Manager* pmm = (Physical_Memory_Manager*)context;
+
+    pmm->free_physical_frames(pmm->allocate_physical_frames(4096));
+
+}
+
+static void PMM_Allocate_Free_1MB (void* context) {
+
+    Physical_Memory_Manager* pmm = (Physical_Memory_Manager*)context;
+
+    pmm->free_physical_frames(pmm->allocate_physical_frames(1024 * 1024));
+
+}
+
+/*******************************************************************************
+Framebuffer Fill Benchmark Functions
+The whole screen the way kernel_main clears it, with the surface's variant,
+and the per pixel loop it replaced for comparison.
+*******************************************************************************/
+static void Framebuffer_Fill (void* context) {
+
+    framebuffer_fill_context* fill = (framebuffer_fill_context*)context;
+
+    framebuffer_clear(&fill->surface, fill->color);
+
+}
+
+static void Framebuffer_Fill_Per_Pixel (void* context) {
+
+    framebuffer_fill_context* fill  = (framebuffer_fill_context*)context;
+    uint32_t*                 base  = fill->surface.base;
+    uint64_t                  pitch = fill->surface.pixels_per_scan_line;
+
+    for (uint64_t y = 0; y < fill->surface.height; y++)
+        for (uint64_t x = 0; x < pitch; x++)
+            base[((y * pitch) + x)] = fill->color;
+
+}
+
+/*******************************************************************************
+Framebuffer Scroll Benchmark Function
+The whole screen up by one line of glyphs, as a terminal scrolls.
+*******************************************************************************/
+static void Framebuffer_Scroll (void* context) {
+
+    framebuffer_fill_context* fill = (framebuffer_fill_context*)context;
+
+    framebuffer_scroll_region(&fill->surface, 0, 0, fill->surface.width, fill->surface.height, KERNEL_BENCHMARK_SCROLL_LINES, fill->color);
+
+}
+
+/*******************************************************************************
+Glyph Rendering Benchmark Function
+A line of glyphs through print_character, which print_string loops over.
+*******************************************************************************/
+static void Render_Glyphs (void* context) {
+
+    glyph_context* line = (glyph_context*)context;
+
+    for (uint64_t idx = 0; idx < KERNEL_BENCHMARK_NUM_OF_GLYPHS; idx++) {
+        line->font_renderer->print_character(0x00000000, (char)('A' + (idx % 26)), 10 + (idx * 8), line->y);
+    }
+
+}
+
+/*******************************************************************************
+Page Table Walk Benchmark Functions
+Full walks of addresses a stride apart, each in its own page table, and the
+same translations through the per-CPU translation cache.
+*******************************************************************************/
+static void Walk_Page_Tables (void* context) {
+
+    page_walk_context* walk = (page_walk_context*)context;
+
+    vmm_page_table_walk_result result;
+    for (uint64_t idx = 0; idx < KERNEL_BENCHMARK_NUM_OF_WALK_ADDRESSES; idx++) {
+        walk->vmm->walk_page_tables(walk->addresses[idx], &result);
+    }
+
+}
+
+static void Translate_Cached (void* context) {
+
+    page_walk_context* walk = (page_walk_context*)context;
+
+    for (uint64_t idx = 0; idx < KERNEL_BENCHMARK_NUM_OF_WALK_ADDRESSES; idx++) {
+        walk->vmm->virtual_to_physical(walk->addresses[idx]);
+    }
+
+}
+
+/*******************************************************************************
+Multi-Phase Benchmark Functions
+Each timed iteration is a whole run of a benchmark that measures its own
+phases, keeping the figures of the last run. Most hand work to other threads
+and processors and all run for long, so they run with interrupts enabled.
+*******************************************************************************/
+static void Context_Switch (void* context) {
+
+    (void)context;
+
+    last_results.context_switch_ran = Benchmark_Context_Switch(KERNEL_BENCHMARK_NUM_OF_ROUND_TRIPS, &last_results.context_switch);
+
+}
+
+static void Parallel_Framebuffer_Fill (void* context) {
+
+    framebuffer_fill_context* fill = (framebuffer_fill_context*)context;
+
+    last_results.parallel_fill_ran = Benchmark_Parallel_Framebuffer_Fill(fill->surface.base, fill->surface.pixels_per_scan_line, fill->surface.height,
+                                                                         fill->color, &last_results.parallel_fill);
+
+}
+
+static void Parallel_Frame_Scrub (void* context) {
+
+    Physical_Memory_Manager* pmm = (Physical_Memory_Manager*)context;
+
+    last_results.frame_scrub_ran = Benchmark_Parallel_Frame_Scrub(pmm, KERNEL_BENCHMARK_SCRUB_SIZE, &last_results.frame_scrub);
+
+}
+
+static void Memory_Operations (void* context) {
+
+    Physical_Memory_Manager* pmm = (Physical_Memory_Manager*)context;
+
+    last_results.memory_operations_ran = Benchmark_Memory_Operations(pmm, &last_results.memory_operations);
+
+}
+
+static void Lock_Contention (void* context) {
+
+    (void)context;
+
+    last_results.lock_contention_ran = Benchmark_Lock_Contention(KERNEL_BENCHMARK_NUM_OF_ACQUISITIONS, &last_results.lock_contention);
+
+}
+
+/*******************************************************************************
+Register Kernel Benchmarks Function
+Register the kernel's own benchmarks with the framework. The glyphs are drawn
+on the bottom line of the screen. Returns the number registered.
+*******************************************************************************/
+uint64_t Register_Kernel_Benchmarks (Physical_Memory_Manager* pmm, Virtual_Memory_Manager* vmm, PC_Screen_Font_v1_Renderer* font_renderer, UEFI_GRAPHICS_OUTPUT_PROTOCOL_MODE* gop) {
+
+    uint64_t num_of_registered = 0;
+
+    num_of_registered += benchmark_register("pmm_allocate_free_4k", PMM_Allocate_Free_Frame, pmm, 0, 1, 0);
+    num_of_registered += benchmark_register("pmm_allocate_free_1m", PMM_Allocate_Free_1MB, pmm, 0, 1, 0);
+
+    Initialize_Framebuffer_Surface(&framebuffer_fill.surface, (uint32_t*)gop->FrameBufferBase, gop->Info->HorizontalResolution,
+                                   gop->Info->VerticalResolution, gop->Info->PixelsPerScanLine);
+    framebuffer_fill.color = 0xFFDDDDDD;
+    uint64_t num_of_pixels = (uint64_t)framebuffer_fill.surface.pixels_per_scan_line * framebuffer_fill.surface.height;
+    num_of_registered += benchmark_register("framebuffer_fill", Framebuffer_Fill, &framebuffer_fill, 64, num_of_pixels, 0);
+    num_of_registered += benchmark_register("framebuffer_fill_per_pixel", Framebuffer_Fill_Per_Pixel, &framebuffer_fill, 64, num_of_pixels, 0);
+    num_of_registered += benchmark_register("framebuffer_scroll", Framebuffer_Scroll, &framebuffer_fill, 64, num_of_pixels, 0);
+
+    // The same fill with rep stosd, what interrupt handlers get.
+    framebuffer_fill_string                 = framebuffer_fill;
+    framebuffer_fill_string.surface.variant = memory_variant_rep_qword;
+    num_of_registered += benchmark_register("framebuffer_fill_rep_stosd", Framebuffer_Fill, &framebuffer_fill_string, 64, num_of_pixels, 0);
+
+    glyphs.font_renderer = font_renderer;
+    glyphs.y             = gop->Info->VerticalResolution - 20;
+    num_of_registered += benchmark_register("glyph_render", Render_Glyphs, &glyphs, 0, KERNEL_BENCHMARK_NUM_OF_GLYPHS, 0);
+
+    page_walk.vmm = vmm;
+    for (uint64_t idx = 0; idx < KERNEL_BENCHMARK_NUM_OF_WALK_ADDRESSES; idx++) {
+        page_walk.addresses[idx] = idx * KERNEL_BENCHMARK_WALK_STRIDE;
+    }
+    num_of_registered += benchmark_register("page_table_walk", Walk_Page_Tables, &page_walk, 0, KERNEL_BENCHMARK_NUM_OF_WALK_ADDRESSES, 0);
+    num_of_registered += benchmark_register("translate_cached", Translate_Cached, &page_walk, 0, KERNEL_BENCHMARK_NUM_OF_WALK_ADDRESSES, 0);
+
+    // The parallel fill repaints the clear color, the screen is unchanged.
+    num_of_registered += benchmark_register("context_switch", Context_Switch, nullptr, KERNEL_BENCHMARK_NUM_OF_RUNS,
+                                            KERNEL_BENCHMARK_NUM_OF_ROUND_TRIPS, BENCHMARK_FLAG_INTERRUPTS_ENABLED);
+    num_of_registered += benchmark_register("parallel_framebuffer_fill", Parallel_Framebuffer_Fill, &framebuffer_fill, KERNEL_BENCHMARK_NUM_OF_RUNS,
+                                            num_of_pixels, BENCHMARK_FLAG_INTERRUPTS_ENABLED);
+    num_of_registered += benchmark_register("parallel_frame_scrub", Parallel_Frame_Scrub, pmm, KERNEL_BENCHMARK_NUM_OF_RUNS,
+                                            KERNEL_BENCHMARK_SCRUB_SIZE / 4096, BENCHMARK_FLAG_INTERRUPTS_ENABLED);
+    num_of_registered += benchmark_register("memory_operations", Memory_Operations, pmm, 1, 1, BENCHMARK_FLAG_INTERRUPTS_ENABLED);
+    num_of_registered += benchmark_register("lock_contention", Lock_Contention, nullptr, KERNEL_BENCHMARK_NUM_OF_RUNS,
+                                            KERNEL_BENCHMARK_NUM_OF_ACQUISITIONS, BENCHMARK_FLAG_INTERRUPTS_ENABLED);
+
+    return num_of_registered;
+
+}
+
+/*******************************************************************************
+Get Kernel Benchmark Results Function
+*******************************************************************************/
+const kernel_benchmark_results* get_kernel_benchmark_results () {
+    return &last_results;
+}
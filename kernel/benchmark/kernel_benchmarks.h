@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include "../../shared/uefi/uefi.h"
+#include "../../shared/graphics/fonts/pc_screen_font_v1_renderer.h"
+#include "../../shared/graphics/framebuffer.h"
+#include "../memory/physical_memory_manager.h"
+#include "../memory/virtual_memory_manager.h"
+#include "../memory/memory_operations_benchmark.h"
+#include "../scheduler/context_switch_benchmark.h"
+#include "../executor/executor_benchmark.h"
+#include "../synchronization/lock_contention_benchmark.h"
+
+#define KERNEL_BENCHMARK_NUM_OF_GLYPHS          32
+#define KERNEL_BENCHMARK_SCROLL_LINES           16 // One line of glyphs.
+#define KERNEL_BENCHMARK_NUM_OF_WALK_ADDRESSES  64
+#define KERNEL_BENCHMARK_WALK_STRIDE            ((16 * 1024 * 1024) + 4096) // Own page table and translation cache line each.
+#define KERNEL_BENCHMARK_NUM_OF_ROUND_TRIPS     10000
+#define KERNEL_BENCHMARK_SCRUB_SIZE             (64 * 1024 * 1024)
+#define KERNEL_BENCHMARK_NUM_OF_ACQUISITIONS    10000
+#define KERNEL_BENCHMARK_NUM_OF_RUNS            4 // Timed runs of the multi-phase benchmarks below.
+
+/* Figures the multi-phase benchmarks report themselves, from their last timed
+run, for the screen and the log after benchmark_run_all. */
+typedef struct {
+    bool                               context_switch_ran;
+    context_switch_benchmark_result    context_switch;
+    bool                               parallel_fill_ran;
+    executor_benchmark_result          parallel_fill;
+    bool                               frame_scrub_ran;
+    executor_benchmark_result          frame_scrub;
+    bool                               memory_operations_ran;
+    memory_operations_benchmark_result memory_operations;
+    bool                               lock_contention_ran;
+    lock_contention_benchmark_result   lock_contention;
+} kernel_benchmark_results;
+
+uint64_t                        Register_Kernel_Benchmarks   (Physical_Memory_Manager* pmm, Virtual_Memory_Manager* vmm, PC_Screen_Font_v1_Renderer* font_renderer, UEFI_GRAPHICS_OUTPUT_PROTOCOL_MODE* gop);
+const kernel_benchmark_results* get_kernel_benchmark_results ();
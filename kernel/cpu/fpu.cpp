@@ -0,0 +1,307 @@
+#include "fpu.h"
+#include "per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+#define CR0_MONITOR_COPROCESSOR  (1ULL << 1)
+#define CR0_EMULATION            (1ULL << 2)
+#define CR0_TASK_SWITCHED        (1ULL << 3)
+#define CR0_NUMERIC_ERROR        (1ULL << 5)
+#define CR4_OSFXSR               (1ULL << 9)
+#define CR4_OSXMMEXCPT           (1ULL << 10)
+#define CR4_OSXSAVE              (1ULL << 18)
+
+#define IA32_XSS_MSR             0xDA0
+
+#define FPU_DEFAULT_FCW          0x037F // All x87 exceptions masked, 64-bit precision.
+#define FPU_DEFAULT_MXCSR        0x1F80 // All SSE exceptions masked, round to nearest.
+#define FPU_XCOMP_BV_COMPACTED   (1ULL << 63)
+
+// Same on every processor, the processors are assumed to be identical.
+static fpu_configuration fpu_config;
+
+/*******************************************************************************
+Save State Function
+*******************************************************************************/
+static void Save_State (uint8_t* save_area) {
+
+    uint32_t low  = (uint32_t)fpu_config.xcr0;
+    uint32_t high = (uint32_t)(fpu_config.xcr0 >> 32);
+
+    switch (fpu_config.mechanism) {
+        case fpu_save_xsaves:
+            __asm__ __volatile__ ("xsaves64 (%0)"   : : "r"(save_area), "a"(low), "d"(high) : "memory");
+            break;
+        case fpu_save_xsaveopt:
+            __asm__ __volatile__ ("xsaveopt64 (%0)" : : "r"(save_area), "a"(low), "d"(high) : "memory");
+            break;
+        case fpu_save_xsave:
+            __asm__ __volatile__ ("xsave64 (%0)"    : : "r"(save_area), "a"(low), "d"(high) : "memory");
+            break;
+        default:
+            __asm__ __volatile__ ("fxsave64 (%0)"   : : "r"(save_area) : "memory");
+            break;
+    }
+
+}
+
+/*******************************************************************************
+Restore State Function
+*******************************************************************************/
+static void Restore_State (uint8_t* save_area) {
+
+    uint32_t low  = (uint32_t)fpu_config.xcr0;
+    uint32_t high = (uint32_t)(fpu_config.xcr0 >> 32);
+
+    switch (fpu_config.mechanism) {
+        case fpu_save_xsaves:
+            __asm__ __volatile__ ("xrstors64 (%0)" : : "r"(save_area), "a"(low), "d"(high) : "memory");
+            break;
+        case fpu_save_xsaveopt:
+        case fpu_save_xsave:
+            __asm__ __volatile__ ("xrstor64 (%0)"  : : "r"(save_area), "a"(low), "d"(high) : "memory");
+            break;
+        default:
+            __asm__ __volatile__ ("fxrstor64 (%0)" : : "r"(save_area) : "memory");
+            break;
+    }
+
+}
+
+/*******************************************************************************
+Device Not Available Handler Function
+
+#NM, raised by the first x87/SSE/AVX instruction after a switch to a thread
+whose state is not in the registers. Saves the owner's state, loads the running
+thread's and makes it the owner, so threads that never touch vector registers
+never pay for a save or restore.
+*******************************************************************************/
+static void Device_Not_Available_Handler (interrupt_frame* frame) {
+
+    (void)frame;
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    __asm__ __volatile__ ("clts" : : : "memory");
+    cpu->fpu_trap_armed = false;
+
+    kernel_thread* current = cpu->run_queue.current;
+    if ((current == nullptr) || (cpu->fpu_owner == current)) {
+        return;
+    }
+
+    // A thread without a save area cannot share the registers, nothing sane is left to do.
+    if (current->fpu_state == nullptr) {
+        disable_interrupts();
+        while (true) {
+            __asm__ __volatile__ ("hlt");
+        }
+    }
+
+    if (cpu->fpu_owner != nullptr) {
+        Save_State(cpu->fpu_owner->fpu_state);
+    }
+
+    Restore_State(current->fpu_state);
+    cpu->fpu_owner = current;
+
+}
+
+/*******************************************************************************
+Setup FPU Function
+
+Once, on the bootstrap processor. Picks the state components and the save
+instruction from CPUID, configures the executing processor and installs the #NM
+handler that switches state lazily. x87, SSE and AVX are enabled, and AVX-512
+when it is complete. Returns false without SSE2 or FXSAVE.
+*******************************************************************************/
+bool Setup_FPU (Interrupt_Descriptor_Table* idt) {
+
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+
+    const uint32_t CPUID_1_EDX_FXSR  = (1U << 24);
+    const uint32_t CPUID_1_EDX_SSE2  = (1U << 26);
+    const uint32_t CPUID_1_ECX_XSAVE = (1U << 26);
+    const uint32_t CPUID_1_ECX_AVX   = (1U << 28);
+
+    if (((edx & CPUID_1_EDX_FXSR) == 0) || ((edx & CPUID_1_EDX_SSE2) == 0)) {
+        return false;
+    }
+
+    bool has_xsave = (ecx & CPUID_1_ECX_XSAVE) != 0;
+    bool has_avx   = (ecx & CPUID_1_ECX_AVX)   != 0;
+
+    fpu_config.mechanism      = fpu_save_fxsave;
+    fpu_config.xcr0           = 0;
+    fpu_config.save_area_size = FPU_LEGACY_AREA_SIZE;
+    fpu_config.has_avx        = false;
+    fpu_config.has_avx512     = false;
+
+    if (has_xsave) {
+
+        cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        uint64_t supported_xcr0 = (((uint64_t)edx) << 32) | eax;
+
+        const uint64_t AVX512_STATE = FPU_XCR0_AVX512_OPMASK | FPU_XCR0_AVX512_ZMM_HI | FPU_XCR0_AVX512_HI_ZMM;
+
+        fpu_config.xcr0 = FPU_XCR0_X87 | FPU_XCR0_SSE;
+        if (has_avx && (supported_xcr0 & FPU_XCR0_AVX)) {
+            fpu_config.xcr0   |= FPU_XCR0_AVX;
+            fpu_config.has_avx = true;
+            if ((supported_xcr0 & AVX512_STATE) == AVX512_STATE) {
+                fpu_config.xcr0      |= AVX512_STATE;
+                fpu_config.has_avx512 = true;
+            }
+        }
+
+        cpuid(0xD, 1, &eax, &ebx, &ecx, &edx);
+        if (eax & (1U << 3)) {
+            fpu_config.mechanism = fpu_save_xsaves;
+        } else if (eax & (1U << 0)) {
+            fpu_config.mechanism = fpu_save_xsaveopt;
+        } else {
+            fpu_config.mechanism = fpu_save_xsave;
+        }
+
+    }
+
+    // The area size depends on XCR0, so configure the processor first.
+    Initialize_FPU();
+
+    if (fpu_config.mechanism == fpu_save_xsaves) {
+        cpuid(0xD, 1, &eax, &ebx, &ecx, &edx);
+        fpu_config.save_area_size = ebx;
+    } else if (fpu_config.mechanism != fpu_save_fxsave) {
+        cpuid(0xD, 0, &eax, &ebx, &ecx, &edx);
+        fpu_config.save_area_size = ebx;
+    }
+
+    idt->register_handler(IDT_VECTOR_DEVICE_NOT_AVAILABLE, Device_Not_Available_Handler);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Initialize FPU Function
+
+On every processor, the bootstrap processor's runs from Setup_FPU. Enables
+native x87 errors, FXSAVE, unmasked SIMD exceptions as #XM and XSAVE with the
+configured components, then resets the state to its defaults.
+*******************************************************************************/
+void Initialize_FPU () {
+
+    uint64_t cr0 = read_cr0();
+    cr0 &= ~(CR0_EMULATION | CR0_TASK_SWITCHED);
+    cr0 |= CR0_MONITOR_COPROCESSOR | CR0_NUMERIC_ERROR;
+    write_cr0(cr0);
+
+    uint64_t cr4 = read_cr4() | CR4_OSFXSR | CR4_OSXMMEXCPT;
+    if (fpu_config.xcr0 != 0) {
+        cr4 |= CR4_OSXSAVE;
+    }
+    write_cr4(cr4);
+
+    if (fpu_config.xcr0 != 0) {
+        xsetbv(0, fpu_config.xcr0);
+    }
+
+    // No supervisor state components are used.
+    if (fpu_config.mechanism == fpu_save_xsaves) {
+        write_msr(IA32_XSS_MSR, 0);
+    }
+
+    uint32_t mxcsr = FPU_DEFAULT_MXCSR;
+    __asm__ __volatile__ (
+        "fninit\n\t"
+        "ldmxcsr %0"
+        : /* No output. */
+        : "m"(mxcsr)
+        : "memory"
+    );
+
+}
+
+/*******************************************************************************
+Get FPU Configuration Function
+*******************************************************************************/
+const fpu_configuration* get_fpu_configuration () {
+    return &fpu_config;
+}
+
+/*******************************************************************************
+Initialize Save Area Function
+Fill a save_area_size byte, 64 byte aligned area with the default state, which
+a thread's first vector instruction then loads.
+*******************************************************************************/
+void fpu_initialize_save_area (uint8_t* save_area) {
+
+    for (uint64_t idx = 0; idx < fpu_config.save_area_size; idx++) {
+        save_area[idx] = 0;
+    }
+
+    *((uint16_t*)(save_area + 0))  = FPU_DEFAULT_FCW;
+    *((uint32_t*)(save_area + 24)) = FPU_DEFAULT_MXCSR;
+
+    // A zero XSTATE_BV loads every component's init state; XRSTORS also needs the format.
+    if (fpu_config.mechanism == fpu_save_xsaves) {
+        *((uint64_t*)(save_area + FPU_LEGACY_AREA_SIZE + 8)) = FPU_XCOMP_BV_COMPACTED | fpu_config.xcr0;
+    }
+
+}
+
+/*******************************************************************************
+Take Ownership Function
+Declare the state now in the executing processor's registers to be thread's,
+for the thread that was running before the scheduler existed.
+*******************************************************************************/
+void fpu_take_ownership (kernel_thread* thread) {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    cpu->fpu_owner      = thread;
+    cpu->fpu_trap_armed = false;
+
+}
+
+/*******************************************************************************
+Switch To Function
+
+Called by the scheduler with interrupts disabled right before switching to
+next. Arms #NM unless next owns the registers already; CR0 is only written when
+that changes, so switches between threads that do not use vector registers
+leave it alone.
+*******************************************************************************/
+void fpu_switch_to (kernel_thread* next) {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    bool arm = (cpu->fpu_owner != next);
+    if (arm == cpu->fpu_trap_armed) {
+        return;
+    }
+
+    if (arm) {
+        write_cr0(read_cr0() | CR0_TASK_SWITCHED);
+    } else {
+        __asm__ __volatile__ ("clts" : : : "memory");
+    }
+
+    cpu->fpu_trap_armed = arm;
+
+}
+
+/*******************************************************************************
+Release Function
+Forget an exiting thread's state so it is never saved into freed memory.
+*******************************************************************************/
+void fpu_release (kernel_thread* thread) {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    if (cpu->fpu_owner == thread) {
+        cpu->fpu_owner = nullptr;
+    }
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include "../interrupts/interrupt_descriptor_table.h"
+#include "../scheduler/scheduler.h"
+
+#define FPU_SAVE_AREA_ALIGNMENT 64
+#define FPU_LEGACY_AREA_SIZE    512 // FXSAVE layout, also the start of every XSAVE area.
+
+// XCR0 state components.
+#define FPU_XCR0_X87            (1ULL << 0)
+#define FPU_XCR0_SSE            (1ULL << 1)
+#define FPU_XCR0_AVX            (1ULL << 2)
+#define FPU_XCR0_AVX512_OPMASK  (1ULL << 5)
+#define FPU_XCR0_AVX512_ZMM_HI  (1ULL << 6)
+#define FPU_XCR0_AVX512_HI_ZMM  (1ULL << 7)
+
+// Fastest save instruction the processor has, restored with its counterpart.
+enum fpu_save_mechanism {
+    fpu_save_fxsave   = 0,
+    fpu_save_xsave    = 1,
+    fpu_save_xsaveopt = 2, // Skips components unmodified since the last restore.
+    fpu_save_xsaves   = 3  // Compacted layout, also skips unmodified components.
+};
+
+typedef struct {
+    fpu_save_mechanism mechanism;
+    uint64_t           xcr0;           // 0 without XSAVE.
+    uint64_t           save_area_size;
+    bool               has_avx;
+    bool               has_avx512;
+} fpu_configuration;
+
+bool                     Setup_FPU                 (Interrupt_Descriptor_Table* idt);
+void                     Initialize_FPU            ();
+const fpu_configuration* get_fpu_configuration     ();
+void                     fpu_initialize_save_area  (uint8_t* save_area);
+void                     fpu_take_ownership        (kernel_thread* thread);
+void                     fpu_switch_to             (kernel_thread* next);
+void                     fpu_release               (kernel_thread* thread);
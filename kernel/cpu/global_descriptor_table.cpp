@@ -0,0 +1,91 @@
+#include "global_descriptor_table.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+#define IA32_GS_BASE_MSR 0xC0000101
+
+// Flat 64-bit kernel code and data segment descriptors.
+#define GDT_KERNEL_CODE_DESCRIPTOR 0x00AF9A000000FFFFULL
+#define GDT_KERNEL_DATA_DESCRIPTOR 0x00CF92000000FFFFULL
+#define GDT_TSS_DESCRIPTOR_TYPE    0x89ULL // Present, DPL 0, available 64-bit TSS.
+
+/*******************************************************************************
+Setup Global Descriptor Table Function
+
+Build the executing processor's GDT and TSS, allocate its interrupt stack table
+stacks from the PMM, load the GDT, reload every segment register and load the
+task register. The GS base is restored after the reload so per-CPU data stays
+reachable. Returns false if the stacks could not be allocated.
+*******************************************************************************/
+bool Setup_Global_Descriptor_Table (cpu_descriptor_tables* tables, Physical_Memory_Manager* pmm) {
+
+    task_state_segment* tss = &tables->tss;
+
+    uint8_t* tss_bytes = (uint8_t*)tss;
+    for (uint64_t idx = 0; idx < sizeof(task_state_segment); idx++) {
+        tss_bytes[idx] = 0;
+    }
+
+    // No I/O permission bitmap; the base points past the end of the TSS.
+    tss->io_map_base_address = sizeof(task_state_segment);
+
+    /* Allocate the stacks used for #DF, NMI and #MC so they run on a known good
+    stack regardless of the state of the interrupted stack. Stacks grow down,
+    the IST entry is the 16 byte aligned top. */
+    const uint64_t IST_STACKS[] = {GDT_IST_DOUBLE_FAULT, GDT_IST_NMI, GDT_IST_MACHINE_CHECK};
+    for (uint64_t idx = 0; idx < (sizeof(IST_STACKS) / sizeof(IST_STACKS[0])); idx++) {
+
+        uint8_t* stack = (uint8_t*)pmm->allocate_physical_frames(GDT_IST_STACK_SIZE);
+        if (stack == nullptr) {
+            return false;
+        }
+
+        tss->ist[IST_STACKS[idx] - 1] = ((uint64_t)(stack + GDT_IST_STACK_SIZE)) & ~0xFULL;
+
+    }
+
+    uint64_t tss_base  = (uint64_t)tss;
+    uint64_t tss_limit = sizeof(task_state_segment) - 1;
+
+    tables->gdt[0] = 0;
+    tables->gdt[1] = GDT_KERNEL_CODE_DESCRIPTOR;
+    tables->gdt[2] = GDT_KERNEL_DATA_DESCRIPTOR;
+    tables->gdt[3] = (tss_limit & 0xFFFF)                   |
+                     ((tss_base & 0xFFFFFF) << 16)          |
+                     (GDT_TSS_DESCRIPTOR_TYPE << 40)        |
+                     (((tss_limit >> 16) & 0xF) << 48)      |
+                     (((tss_base >> 24) & 0xFF) << 56);
+    tables->gdt[4] = (tss_base >> 32);
+
+    descriptor_table_register gdtr;
+    gdtr.limit = sizeof(tables->gdt) - 1;
+    gdtr.base  = (uint64_t)tables->gdt;
+
+    // Reloading GS clears its base, which points at the per-CPU data.
+    uint64_t gs_base = read_msr(IA32_GS_BASE_MSR);
+
+    /* Load the GDT, reload CS with a far return to the next instruction and
+    reload the data segment registers, then load the task register. */
+    __asm__ __volatile__ (
+        "lgdt %0\n\t"
+        "pushq %1\n\t"
+        "leaq 1f(%%rip), %%rax\n\t"
+        "pushq %%rax\n\t"
+        "lretq\n\t"
+        "1:\n\t"
+        "movw %w2, %%ax\n\t"
+        "movw %%ax, %%ds\n\t"
+        "movw %%ax, %%es\n\t"
+        "movw %%ax, %%ss\n\t"
+        "movw %%ax, %%fs\n\t"
+        "movw %%ax, %%gs\n\t"
+        "ltr %w3\n\t"
+        : /* No output. */
+        : "m"(gdtr), "i"(GDT_KERNEL_CODE_SELECTOR), "r"((uint64_t)GDT_KERNEL_DATA_SELECTOR), "r"((uint64_t)GDT_TSS_SELECTOR)
+        : "rax", "memory"
+    );
+
+    write_msr(IA32_GS_BASE_MSR, gs_base);
+
+    return true;
+
+}
@@ -0,0 +1,38 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+
+#define GDT_KERNEL_CODE_SELECTOR 0x08
+#define GDT_KERNEL_DATA_SELECTOR 0x10
+#define GDT_TSS_SELECTOR         0x18
+#define GDT_NUM_OF_ENTRIES       5 // Null, code, data and the 16 byte TSS descriptor.
+#define GDT_NUM_OF_IST_STACKS    7
+#define GDT_IST_STACK_SIZE       (4 * 4096)
+
+// Interrupt stack table indices, 0 means no stack switch.
+#define GDT_IST_DOUBLE_FAULT   1
+#define GDT_IST_NMI            2
+#define GDT_IST_MACHINE_CHECK  3
+
+typedef struct {
+    uint32_t reserved_0;
+    uint64_t rsp[3];
+    uint64_t reserved_1;
+    uint64_t ist[GDT_NUM_OF_IST_STACKS];
+    uint64_t reserved_2;
+    uint16_t reserved_3;
+    uint16_t io_map_base_address;
+} __attribute__((packed)) task_state_segment;
+
+typedef struct {
+    uint16_t limit;
+    uint64_t base;
+} __attribute__((packed)) descriptor_table_register;
+
+// Each processor has its own GDT since each needs its own TSS.
+typedef struct {
+    uint64_t           gdt[GDT_NUM_OF_ENTRIES];
+    task_state_segment tss;
+} __attribute__((aligned(16))) cpu_descriptor_tables;
+
+bool Setup_Global_Descriptor_Table (cpu_descriptor_tables* tables, Physical_Memory_Manager* pmm);
@@ -0,0 +1,80 @@
+#include "per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+#define IA32_GS_BASE_MSR 0xC0000101
+
+/* The bootstrap processor's area is static since it is needed before anything
+can be allocated; application processors allocate theirs as they start. */
+static per_cpu_data bsp_per_cpu_data;
+
+// Every installed area, indexed by CPU index, for reaching other processors.
+static per_cpu_data* per_cpu_data_table[PER_CPU_MAX_NUM_OF_CPUS];
+static uint64_t      num_of_cpus;
+
+/*******************************************************************************
+Get Per-CPU Data Function
+
+Returns the per-CPU data area of the processor executing this function. Only
+valid once Install_Per_CPU_Data has run on that processor.
+*******************************************************************************/
+per_cpu_data* get_per_cpu_data () {
+
+    per_cpu_data* cpu;
+
+    __asm__ __volatile__ (
+        "movq %%gs:0, %0"
+        : "=r"(cpu)
+        : /* No input. */
+        : /* No clobbered. */
+    );
+
+    return cpu;
+
+}
+
+/*******************************************************************************
+Get Bootstrap Per-CPU Data Function
+*******************************************************************************/
+per_cpu_data* get_bootstrap_per_cpu_data () {
+    return &bsp_per_cpu_data;
+}
+
+/*******************************************************************************
+Get Per-CPU Data Of Function
+Returns nullptr if no processor with the given index has been installed.
+*******************************************************************************/
+per_cpu_data* get_per_cpu_data_of (uint64_t cpu_index) {
+
+    if (cpu_index >= PER_CPU_MAX_NUM_OF_CPUS) {
+        return nullptr;
+    }
+
+    return __atomic_load_n(&per_cpu_data_table[cpu_index], __ATOMIC_ACQUIRE);
+
+}
+
+/*******************************************************************************
+Get Number Of CPUs Function
+*******************************************************************************/
+uint64_t get_num_of_cpus () {
+    return __atomic_load_n(&num_of_cpus, __ATOMIC_ACQUIRE);
+}
+
+/*******************************************************************************
+Install Per-CPU Data Function
+
+Point the executing processor's GS base at its per-CPU data area and publish the
+area. Setup_Global_Descriptor_Table preserves the GS base across its segment
+reload, so this may run before or after it.
+*******************************************************************************/
+void Install_Per_CPU_Data (per_cpu_data* cpu, uint64_t cpu_index) {
+
+    cpu->self      = cpu;
+    cpu->cpu_index = cpu_index;
+
+    write_msr(IA32_GS_BASE_MSR, (uint64_t)cpu);
+
+    __atomic_store_n(&per_cpu_data_table[cpu_index], cpu, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&num_of_cpus, 1, __ATOMIC_RELEASE);
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/virtual_memory_manager.h"
+#include "../memory/tlb_shootdown.h"
+#include "global_descriptor_table.h"
+#include "../time/time_stamp_counter.h"
+#include "../interrupts/local_apic.h"
+#include "../time/timer_wheel.h"
+#include "../scheduler/scheduler.h"
+#include "../synchronization/rcu.h"
+#include "../profiler/sampling_profiler.h"
+
+#define PER_CPU_MAX_NUM_OF_CPUS 256
+
+/* Data private to one processor; only ever touched by the processor it owns.
+Each processor's GS base points at its own area. */
+typedef struct per_cpu_data {
+    struct per_cpu_data*    self; // Must stay first, read through GS base.
+    uint64_t                cpu_index;
+    uint32_t                apic_id;
+    uint32_t                numa_node; // Node the PMM allocates from by default.
+    vmm_translation_cache   translation_cache;
+    cpu_descriptor_tables   descriptor_tables;
+    tsc_calibration         tsc;
+    local_apic              apic;
+    timer_wheel             timers;
+    scheduler_run_queue     run_queue;
+    kernel_thread*          fpu_owner;      // Thread whose vector state is in the registers.
+    bool                    fpu_trap_armed; // CR0.TS is set.
+    rcu_cpu_state           rcu;
+    profiler_cpu_state      profiler;
+    tlb_shootdown_cpu_state tlb_shootdown;
+} per_cpu_data;
+
+per_cpu_data* get_per_cpu_data            ();
+per_cpu_data* get_bootstrap_per_cpu_data  ();
+per_cpu_data* get_per_cpu_data_of         (uint64_t cpu_index);
+uint64_t      get_num_of_cpus             ();
+void          Install_Per_CPU_Data        (per_cpu_data* cpu, uint64_t cpu_index);
@@ -0,0 +1,404 @@
+#include "smp.h"
+#include "per_cpu.h"
+#include "fpu.h"
+#include "../synchronization/rcu.h"
+#include "../log/kernel_log.h"
+#include "../trace/kernel_trace.h"
+#include "../memory/tlb_shootdown.h"
+#include "../acpi/acpi.h"
+#include "../../shared/assembly_wrappers/registers.h"
+#include "../../shared/memory/paging.h"
+
+#define IA32_EFER_MSR           0xC0000080
+#define IA32_GS_BASE_MSR        0xC0000101
+#define SMP_FRAME_SIZE          4096
+#define SMP_PER_CPU_ALIGNMENT   64
+
+static_assert(sizeof(smp_trampoline_data) == 88, "Trampoline data layout must match the assembly.");
+
+/*******************************************************************************
+Application Processor Trampoline
+
+Copied to a page below 1MB, where a start up IPI makes each application
+processor begin executing it in real mode with CS = page >> 4. It loads a
+temporary GDT, enables PAE, loads a copy of the PML4 that sits below 4GB,
+enables long mode through EFER and enters 64-bit mode by setting PE and PG at
+once. In long mode it switches to the kernel's page tables, takes the boot lock
+(all processors share the one boot stack), claims a CPU index and calls the
+entry function with the index and the trampoline data.
+*******************************************************************************/
+extern "C" uint8_t ap_trampoline_start[];
+extern "C" uint8_t ap_trampoline_long_mode[];
+extern "C" uint8_t ap_trampoline_data[];
+extern "C" uint8_t ap_trampoline_end[];
+
+__asm__ (
+    ".text\n"
+    ".code16\n"
+    ".align 16\n"
+    ".global ap_trampoline_start\n"
+    "ap_trampoline_start:\n"
+    "    cli\n"
+    "    cld\n"
+    "    movw %cs, %ax\n"
+    "    movw %ax, %ds\n"
+    "    lgdtl (ap_trampoline_gdtr - ap_trampoline_start)\n"
+    "    movl %cr4, %eax\n"
+    "    orl $0x20, %eax\n"                                         // CR4.PAE
+    "    movl %eax, %cr4\n"
+    "    movl (ap_trampoline_low_cr3 - ap_trampoline_start), %eax\n"
+    "    movl %eax, %cr3\n"
+    "    movl $0xC0000080, %ecx\n"                                  // IA32_EFER
+    "    movl (ap_trampoline_efer - ap_trampoline_start), %eax\n"
+    "    movl (ap_trampoline_efer - ap_trampoline_start + 4), %edx\n"
+    "    wrmsr\n"
+    "    movl %cr0, %eax\n"
+    "    orl $0x80000001, %eax\n"                                   // CR0.PG | CR0.PE
+    "    movl %eax, %cr0\n"
+    "    ljmpl *(ap_trampoline_far_pointer - ap_trampoline_start)\n"
+    "\n"
+    ".code64\n"
+    ".global ap_trampoline_long_mode\n"
+    "ap_trampoline_long_mode:\n"
+    "    movw $0x10, %ax\n"
+    "    movw %ax, %ds\n"
+    "    movw %ax, %es\n"
+    "    movw %ax, %ss\n"
+    "    xorw %ax, %ax\n"
+    "    movw %ax, %fs\n"
+    "    movw %ax, %gs\n"
+    "    movq ap_trampoline_kernel_cr3(%rip), %rax\n"
+    "    movq %rax, %cr3\n"
+    "1:\n"
+    "    movl $1, %eax\n"
+    "    xchgl %eax, ap_trampoline_boot_lock(%rip)\n"
+    "    testl %eax, %eax\n"
+    "    jz 2f\n"
+    "    pause\n"
+    "    jmp 1b\n"
+    "2:\n"
+    "    movq ap_trampoline_boot_stack_top(%rip), %rsp\n"
+    "    movl ap_trampoline_next_cpu_index(%rip), %edi\n"
+    "    incl ap_trampoline_next_cpu_index(%rip)\n"
+    "    leaq ap_trampoline_data(%rip), %rsi\n"
+    "    xorl %ebp, %ebp\n"
+    "    movq ap_trampoline_entry(%rip), %rax\n"
+    "    call *%rax\n"
+    "    ud2\n"
+    "\n"
+    ".align 8\n"
+    ".global ap_trampoline_data\n"
+    "ap_trampoline_data:\n"
+    "    .quad 0, 0x00AF9A000000FFFF, 0x00CF92000000FFFF\n"         // Null, 64-bit code, data.
+    "ap_trampoline_gdtr:\n"
+    "    .word 23\n"
+    "    .long 0\n"
+    "    .word 0\n"
+    "ap_trampoline_far_pointer:\n"
+    "    .long 0\n"
+    "    .word 0x08\n"
+    "    .word 0\n"
+    "ap_trampoline_low_cr3:\n"
+    "    .long 0\n"
+    "    .long 0\n"
+    "ap_trampoline_efer:\n"
+    "    .quad 0\n"
+    "ap_trampoline_kernel_cr3:\n"
+    "    .quad 0\n"
+    "ap_trampoline_boot_stack_top:\n"
+    "    .quad 0\n"
+    "ap_trampoline_entry:\n"
+    "    .quad 0\n"
+    "ap_trampoline_boot_lock:\n"
+    "    .long 0\n"
+    "ap_trampoline_next_cpu_index:\n"
+    "    .long 0\n"
+    ".global ap_trampoline_end\n"
+    "ap_trampoline_end:\n"
+);
+
+/*******************************************************************************
+Switch Stack And Call
+
+Continue on a new stack by calling fn(argument) with rsp at stack_top. Never
+returns.
+*******************************************************************************/
+extern "C" void smp_switch_stack_and_call (uint64_t stack_top, void (*fn)(void*), void* argument);
+
+__asm__ (
+    ".text\n"
+    ".global smp_switch_stack_and_call\n"
+    "smp_switch_stack_and_call:\n"
+    "    movq %rdi, %rsp\n"
+    "    movq %rdx, %rdi\n"
+    "    xorl %ebp, %ebp\n"
+    "    call *%rsi\n"
+    "    ud2\n"
+);
+
+// State the bootstrap processor hands to the application processors.
+static Physical_Memory_Manager*    smp_pmm;
+static Virtual_Memory_Manager*     smp_vmm;
+static Interrupt_Descriptor_Table* smp_idt;
+static uint64_t                    smp_num_of_started_aps;
+
+/* Stands in for the per-CPU data of the processor being started until its own
+area is allocated, so those allocations already come from its NUMA node. Only
+one processor uses it at a time, under the boot lock. */
+static per_cpu_data smp_ap_boot_per_cpu_data;
+
+/*******************************************************************************
+Wake Up IPI Handler Function
+Only exists to pull a processor out of hlt.
+*******************************************************************************/
+static void Wake_Up_IPI_Handler (interrupt_frame* frame) {
+
+    (void)frame;
+    local_apic_end_of_interrupt(&get_per_cpu_data()->apic);
+
+}
+
+/*******************************************************************************
+Allocate Per-CPU Data Function
+Cache line aligned and zeroed.
+*******************************************************************************/
+static per_cpu_data* Allocate_Per_CPU_Data (Physical_Memory_Manager* pmm) {
+
+    uint8_t* memory = (uint8_t*)pmm->allocate_physical_frames(sizeof(per_cpu_data) + SMP_PER_CPU_ALIGNMENT);
+    if (memory == nullptr) {
+        return nullptr;
+    }
+
+    per_cpu_data* cpu = (per_cpu_data*)((((uint64_t)memory) + SMP_PER_CPU_ALIGNMENT - 1) & ~((uint64_t)SMP_PER_CPU_ALIGNMENT - 1));
+
+    uint8_t* bytes = (uint8_t*)cpu;
+    for (uint64_t idx = 0; idx < sizeof(per_cpu_data); idx++) {
+        bytes[idx] = 0;
+    }
+
+    return cpu;
+
+}
+
+/*******************************************************************************
+Halt Forever Function
+*******************************************************************************/
+static void Halt_Forever () {
+
+    disable_interrupts();
+    while (true) {
+        __asm__ __volatile__ ("hlt");
+    }
+
+}
+
+/*******************************************************************************
+Application Processor Main Function
+
+Runs on the processor's own stack, which becomes its idle thread. Releases the
+boot stack to the next processor, reports in and idles, sleeping until
+interrupts arrive. Threads handed over wake it and run from the interrupt exit.
+*******************************************************************************/
+static void AP_Main (void* argument) {
+
+    smp_trampoline_data* data = (smp_trampoline_data*)argument;
+
+    per_cpu_data* cpu = get_per_cpu_data();
+    Initialize_Run_Queue(&cpu->run_queue, &cpu->timers, cpu->cpu_index);
+    Initialize_RCU_State(&cpu->rcu);
+    Initialize_Kernel_Log_Ring(smp_pmm);
+    Initialize_Profiler_Ring(smp_pmm);
+    Initialize_Kernel_Trace_Buffer(smp_pmm);
+    tlb_shootdown_join();
+
+    __atomic_store_n(&data->boot_lock, 0, __ATOMIC_RELEASE);
+    __atomic_add_fetch(&smp_num_of_started_aps, 1, __ATOMIC_RELEASE);
+
+    // Halted, the processor is not waited for by RCU grace periods.
+    while (true) {
+        rcu_process_callbacks();
+        rcu_enter_idle();
+        enable_interrupts_and_halt();
+        disable_interrupts();
+        rcu_exit_idle();
+    }
+
+}
+
+/*******************************************************************************
+Application Processor Entry Function
+
+Called by the trampoline on the shared boot stack with the boot lock held, so
+application processors initialize one at a time. Sets up the processor's per-CPU
+data, GDT, IDT, local APIC and timer wheel, then moves to its own stack. A
+processor that cannot be set up releases the lock and halts.
+*******************************************************************************/
+extern "C" void AP_Entry (uint64_t cpu_index, smp_trampoline_data* data) {
+
+    per_cpu_data* cpu   = nullptr;
+    uint8_t*      stack = nullptr;
+
+    smp_ap_boot_per_cpu_data.self      = &smp_ap_boot_per_cpu_data;
+    smp_ap_boot_per_cpu_data.numa_node = smp_pmm->get_node_of_processor(local_apic_get_initial_id());
+    write_msr(IA32_GS_BASE_MSR, (uint64_t)&smp_ap_boot_per_cpu_data);
+
+    if (cpu_index < PER_CPU_MAX_NUM_OF_CPUS) {
+        cpu   = Allocate_Per_CPU_Data(smp_pmm);
+        stack = (uint8_t*)smp_pmm->allocate_physical_frames(SMP_AP_STACK_SIZE);
+    }
+
+    if ((cpu == nullptr) || (stack == nullptr) || (!Setup_Global_Descriptor_Table(&cpu->descriptor_tables, smp_pmm))) {
+        __atomic_store_n(&data->boot_lock, 0, __ATOMIC_RELEASE);
+        Halt_Forever();
+    }
+
+    smp_idt->load();
+    Initialize_FPU();
+    cpu->numa_node = smp_ap_boot_per_cpu_data.numa_node;
+    Install_Per_CPU_Data(cpu, cpu_index);
+
+    // TSCs are assumed synchronized, so every processor shares one time base.
+    cpu->tsc = get_bootstrap_per_cpu_data()->tsc;
+
+    Initialize_Local_APIC(&cpu->apic, smp_vmm, &cpu->tsc);
+    cpu->apic_id = local_apic_get_id(&cpu->apic);
+
+    Initialize_Timer_Wheel(&cpu->timers, &cpu->apic, &cpu->tsc);
+    cpu->apic.timer_callback = Timer_Wheel_Interrupt_Callback;
+
+    smp_switch_stack_and_call(((uint64_t)(stack + SMP_AP_STACK_SIZE)) & ~0xFULL, AP_Main, data);
+
+}
+
+/*******************************************************************************
+Start Application Processors Function
+
+Copy the trampoline and a copy of the PML4 below 1MB, then wake every other
+processor with a broadcast INIT-SIPI-SIPI sequence. Processors come up one at a
+time through the boot lock; start up ends once no new processor has reported in
+for a while. Returns the number of application processors started.
+*******************************************************************************/
+uint64_t Start_Application_Processors (Physical_Memory_Manager* pmm, Virtual_Memory_Manager* vmm, Interrupt_Descriptor_Table* idt) {
+
+    per_cpu_data* bsp = get_per_cpu_data();
+
+    idt->register_handler(SMP_WAKE_UP_VECTOR, Wake_Up_IPI_Handler);
+
+    // Two whole pages: the trampoline and the low PML4 copy.
+    uint8_t* low_memory = (uint8_t*)pmm->allocate_physical_frames_below(3 * SMP_FRAME_SIZE, SMP_TRAMPOLINE_ADDRESS_LIMIT);
+    uint8_t* boot_stack = (uint8_t*)pmm->allocate_physical_frames(SMP_AP_STACK_SIZE);
+
+    const uint64_t TRAMPOLINE_SIZE = (uint64_t)(ap_trampoline_end - ap_trampoline_start);
+
+    if ((low_memory == nullptr) || (boot_stack == nullptr) || (TRAMPOLINE_SIZE > SMP_FRAME_SIZE)) {
+        return 0;
+    }
+
+    uint8_t*  trampoline = (uint8_t*)((((uint64_t)low_memory) + SMP_FRAME_SIZE - 1) & ~((uint64_t)SMP_FRAME_SIZE - 1));
+    uint64_t* low_pml4   = (uint64_t*)(trampoline + SMP_FRAME_SIZE);
+
+    for (uint64_t idx = 0; idx < TRAMPOLINE_SIZE; idx++) {
+        trampoline[idx] = ap_trampoline_start[idx];
+    }
+
+    uint64_t* pml4 = (uint64_t*)(read_cr3() & PAGE_TABLES_ENTRY_ADDRESS_MASK);
+    for (uint64_t idx = 0; idx < PAGE_TABLES_NUM_OF_ENTRIES; idx++) {
+        low_pml4[idx] = pml4[idx];
+    }
+
+    smp_trampoline_data* data = (smp_trampoline_data*)(trampoline + (ap_trampoline_data - ap_trampoline_start));
+
+    data->gdtr_base              = (uint32_t)(uint64_t)data->gdt;
+    data->long_mode_entry_offset = (uint32_t)(uint64_t)(trampoline + (ap_trampoline_long_mode - ap_trampoline_start));
+    data->low_cr3                = (uint32_t)(uint64_t)low_pml4;
+    data->efer                   = read_msr(IA32_EFER_MSR);
+    data->kernel_cr3             = read_cr3();
+    data->boot_stack_top         = ((uint64_t)(boot_stack + SMP_AP_STACK_SIZE)) & ~0xFULL;
+    data->entry                  = (uint64_t)AP_Entry;
+    data->boot_lock              = 0;
+    data->next_cpu_index         = 1; // The bootstrap processor is CPU 0.
+
+    smp_pmm                = pmm;
+    smp_vmm                = vmm;
+    smp_idt                = idt;
+    smp_num_of_started_aps = 0;
+
+    // Make every patched field visible before any processor starts.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    const uint32_t STARTUP_VECTOR = (uint32_t)(((uint64_t)trampoline) / SMP_FRAME_SIZE);
+
+    local_apic_send_ipi(&bsp->apic, 0, LOCAL_APIC_ICR_DESTINATION_ALL_BUT_SELF | LOCAL_APIC_ICR_LEVEL_ASSERT | LOCAL_APIC_ICR_DELIVERY_INIT);
+    tsc_busy_wait_ns(&bsp->tsc, SMP_INIT_DELAY_NS);
+
+    for (uint64_t attempt = 0; attempt < 2; attempt++) {
+        local_apic_send_ipi(&bsp->apic, 0, LOCAL_APIC_ICR_DESTINATION_ALL_BUT_SELF | LOCAL_APIC_ICR_LEVEL_ASSERT | LOCAL_APIC_ICR_DELIVERY_STARTUP | STARTUP_VECTOR);
+        tsc_busy_wait_ns(&bsp->tsc, SMP_STARTUP_DELAY_NS);
+    }
+
+    // Zero when the firmware gave no processor count, leaving only the settle time.
+    uint64_t num_expected = get_acpi_tables()->num_of_processors;
+    num_expected          = (num_expected > 1) ? (num_expected - 1) : 0;
+
+    // Wait until every expected processor or no new processor has reported in for the settle time.
+    uint64_t start_ns       = get_monotonic_time_ns();
+    uint64_t last_change_ns = start_ns;
+    uint64_t num_started    = 0;
+
+    while (true) {
+
+        uint64_t now_ns  = get_monotonic_time_ns();
+        uint64_t started = __atomic_load_n(&smp_num_of_started_aps, __ATOMIC_ACQUIRE);
+
+        if (started != num_started) {
+            num_started    = started;
+            last_change_ns = now_ns;
+        }
+
+        bool all_started = (num_expected != 0) && (started >= num_expected);
+        bool settled     = (all_started || ((now_ns - last_change_ns) >= SMP_AP_SETTLE_TIME_NS)) &&
+                           (__atomic_load_n(&data->boot_lock, __ATOMIC_ACQUIRE) == 0);
+        if (settled || ((now_ns - start_ns) >= SMP_AP_START_UP_TIMEOUT_NS)) {
+            break;
+        }
+
+        __asm__ __volatile__ ("pause");
+
+    }
+
+    return num_started;
+
+}
+
+/*******************************************************************************
+SMP Send IPI Function
+Send a fixed interrupt to the processor with the given CPU index. Returns false
+if there is no such processor.
+*******************************************************************************/
+bool smp_send_ipi (uint64_t cpu_index, uint8_t vector) {
+
+    per_cpu_data* target = get_per_cpu_data_of(cpu_index);
+    if (target == nullptr) {
+        return false;
+    }
+
+    local_apic_send_ipi(&get_per_cpu_data()->apic, target->apic_id, LOCAL_APIC_ICR_DELIVERY_FIXED | LOCAL_APIC_ICR_LEVEL_ASSERT | vector);
+
+    return true;
+
+}
+
+/*******************************************************************************
+SMP Send IPI To All Others Function
+*******************************************************************************/
+void smp_send_ipi_to_all_others (uint8_t vector) {
+    local_apic_send_ipi(&get_per_cpu_data()->apic, 0, LOCAL_APIC_ICR_DESTINATION_ALL_BUT_SELF | LOCAL_APIC_ICR_DELIVERY_FIXED | LOCAL_APIC_ICR_LEVEL_ASSERT | vector);
+}
+
+/*******************************************************************************
+SMP Wake Up Function
+Pull an idle processor out of hlt, e.g. after handing it work.
+*******************************************************************************/
+void smp_wake_up (uint64_t cpu_index) {
+    smp_send_ipi(cpu_index, SMP_WAKE_UP_VECTOR);
+}
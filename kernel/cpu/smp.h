@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+#include "../memory/virtual_memory_manager.h"
+#include "../interrupts/interrupt_descriptor_table.h"
+
+#define SMP_TRAMPOLINE_ADDRESS_LIMIT 0x100000  // Start up IPIs can only address the first 1MB.
+#define SMP_AP_STACK_SIZE            (4 * 4096)
+#define SMP_INIT_DELAY_NS            10000000  // 10ms
+#define SMP_STARTUP_DELAY_NS         200000    // 200us
+#define SMP_AP_SETTLE_TIME_NS        50000000  // No new processor for 50ms ends start up.
+#define SMP_AP_START_UP_TIMEOUT_NS   1000000000
+
+#define SMP_WAKE_UP_VECTOR           0xF0
+
+/* Data block at the end of the trampoline, patched by the bootstrap processor.
+The layout is mirrored by the trampoline assembly. */
+typedef struct {
+    uint64_t gdt[3];
+    uint16_t gdtr_limit;
+    uint32_t gdtr_base;
+    uint16_t reserved_0;
+    uint32_t long_mode_entry_offset; // Far pointer used to enter long mode.
+    uint16_t long_mode_entry_selector;
+    uint16_t reserved_1;
+    uint32_t low_cr3;                // PML4 copy below 4GB for the 32-bit CR3 load.
+    uint32_t reserved_2;
+    uint64_t efer;
+    uint64_t kernel_cr3;
+    uint64_t boot_stack_top;
+    uint64_t entry;
+    uint32_t boot_lock;              // Held by the one processor running on the boot stack.
+    uint32_t next_cpu_index;
+} __attribute__((packed)) smp_trampoline_data;
+
+uint64_t Start_Application_Processors (Physical_Memory_Manager* pmm, Virtual_Memory_Manager* vmm, Interrupt_Descriptor_Table* idt);
+bool     smp_send_ipi                 (uint64_t cpu_index, uint8_t vector);
+void     smp_send_ipi_to_all_others   (uint8_t vector);
+void     smp_wake_up                  (uint64_t cpu_index);
@@ -0,0 +1,332 @@
+#include "serial_port.h"
+#include "../cpu/per_cpu.h"
+#include "../interrupts/io_apic.h"
+#include "../log/kernel_log.h"
+#include "../../shared/assembly_wrappers/port_io.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+#define SERIAL_BASE_CLOCK_HZ              115200 // Divisor 1.
+
+#define SERIAL_INTERRUPT_RECEIVED_DATA    (1U << 0)
+#define SERIAL_INTERRUPT_TRANSMIT_EMPTY   (1U << 1)
+
+#define SERIAL_INTERRUPT_ID_NONE_PENDING  (1U << 0)
+#define SERIAL_INTERRUPT_ID_FIFO_MASK     0xC0 // Both set when the FIFO works.
+
+#define SERIAL_FIFO_ENABLE                (1U << 0)
+#define SERIAL_FIFO_CLEAR_RECEIVE         (1U << 1)
+#define SERIAL_FIFO_CLEAR_TRANSMIT        (1U << 2)
+#define SERIAL_FIFO_TRIGGER_14_BYTES      (3U << 6)
+
+#define SERIAL_LINE_8_BITS_NO_PARITY      0x03
+#define SERIAL_LINE_DIVISOR_LATCH         (1U << 7)
+
+#define SERIAL_MODEM_DTR                  (1U << 0)
+#define SERIAL_MODEM_RTS                  (1U << 1)
+#define SERIAL_MODEM_OUT2                 (1U << 3) // Gates the IRQ line on PCs.
+
+#define SERIAL_LINE_STATUS_TRANSMIT_EMPTY (1U << 5) // THR, or the whole FIFO, is empty.
+
+// Ports taking interrupts, by legacy IRQ.
+static serial_port* serial_ports_of_irq[IO_APIC_NUM_OF_LEGACY_IRQS];
+
+/*******************************************************************************
+Drain Function
+
+Move up to one FIFO's worth of published bytes into the transmitter if it is
+empty. Only one drain runs at a time; a caller finding another drain under way
+leaves the bytes to it. The transmitter is checked once the drain is ours, so
+two drains never both fill the FIFO. Returns true while published bytes remain.
+*******************************************************************************/
+static bool Drain (serial_port* port) {
+
+    if (__atomic_exchange_n(&port->tx_consumer_busy, 1, __ATOMIC_ACQUIRE) != 0) {
+        return true;
+    }
+
+    uint64_t tail   = port->tx_tail;
+    uint64_t commit = __atomic_load_n(&port->tx_commit_head, __ATOMIC_ACQUIRE);
+    uint64_t count  = commit - tail;
+    if (count > port->fifo_size) {
+        count = port->fifo_size;
+    }
+    if ((count != 0) && ((inb(port->base_port + SERIAL_LINE_STATUS_REGISTER) & SERIAL_LINE_STATUS_TRANSMIT_EMPTY) == 0)) {
+        count = 0;
+    }
+
+    for (uint64_t idx = 0; idx < count; idx++) {
+        outb(port->base_port + SERIAL_TRANSMIT_REGISTER, port->tx_ring[(tail + idx) & (SERIAL_TX_RING_SIZE - 1)]);
+    }
+
+    __atomic_store_n(&port->tx_tail, tail + count, __ATOMIC_RELEASE);
+    __atomic_store_n(&port->tx_consumer_busy, 0, __ATOMIC_RELEASE);
+
+    return ((tail + count) != commit) || (__atomic_load_n(&port->tx_commit_head, __ATOMIC_ACQUIRE) != commit);
+
+}
+
+/*******************************************************************************
+Arm Transmit Interrupt Function
+Enabling the transmitter empty interrupt while the transmitter is empty raises
+it straight away, which starts the drain. Only the first producer after the
+ring ran dry does port I/O.
+*******************************************************************************/
+static void Arm_Transmit_Interrupt (serial_port* port) {
+
+    bool expected = false;
+    if (__atomic_compare_exchange_n(&port->tx_interrupt_armed, &expected, true, false, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+        outb(port->base_port + SERIAL_INTERRUPT_ENABLE_REGISTER, SERIAL_INTERRUPT_TRANSMIT_EMPTY);
+    }
+
+}
+
+/*******************************************************************************
+Serial Interrupt Handler Function
+Refill the FIFO while bytes are queued, else disarm. A producer publishing
+between the emptiness check and the disarm sees the interrupt still armed, so
+the ring is checked again after disarming.
+*******************************************************************************/
+static void Serial_Interrupt_Handler (interrupt_frame* frame) {
+
+    serial_port* port = serial_ports_of_irq[frame->vector - IO_APIC_LEGACY_VECTOR_BASE];
+
+    if (port != nullptr) {
+
+        port->num_of_interrupts++;
+
+        // Reading the ID register acknowledges a transmitter empty interrupt.
+        inb(port->base_port + SERIAL_INTERRUPT_ID_REGISTER);
+
+        if (!Drain(port)) {
+            outb(port->base_port + SERIAL_INTERRUPT_ENABLE_REGISTER, 0);
+            __atomic_store_n(&port->tx_interrupt_armed, false, __ATOMIC_SEQ_CST);
+            if (__atomic_load_n(&port->tx_commit_head, __ATOMIC_SEQ_CST) != __atomic_load_n(&port->tx_tail, __ATOMIC_RELAXED)) {
+                Arm_Transmit_Interrupt(port);
+            }
+        }
+
+    }
+
+    local_apic_end_of_interrupt(&get_per_cpu_data()->apic);
+
+}
+
+/*******************************************************************************
+Initialize Serial Port Function
+
+Program the UART for 8N1 at the given baud rate with its FIFOs enabled and
+cleared, interrupts off, and allocate the transmit ring. Returns false if no
+UART answers at the base port or the ring could not be allocated.
+*******************************************************************************/
+bool Initialize_Serial_Port (serial_port* port, uint16_t base_port, uint32_t baud_rate, Physical_Memory_Manager* pmm) {
+
+    // Nothing decodes the port if the scratch register does not hold a value.
+    outb(base_port + SERIAL_SCRATCH_REGISTER, 0xA5);
+    if (inb(base_port + SERIAL_SCRATCH_REGISTER) != 0xA5) {
+        return false;
+    }
+
+    port->tx_ring = (uint8_t*)pmm->allocate_physical_frames(SERIAL_TX_RING_SIZE);
+    if (port->tx_ring == nullptr) {
+        return false;
+    }
+
+    port->base_port            = base_port;
+    port->interrupt_driven     = false;
+    port->num_of_interrupts    = 0;
+    port->num_of_dropped_bytes = 0;
+    port->tx_reserve_head      = 0;
+    port->tx_commit_head       = 0;
+    port->tx_interrupt_armed   = false;
+    port->tx_tail              = 0;
+    port->tx_consumer_busy     = 0;
+
+    uint32_t divisor = SERIAL_BASE_CLOCK_HZ / ((baud_rate == 0) ? SERIAL_DEFAULT_BAUD_RATE : baud_rate);
+    if (divisor == 0) {
+        divisor = 1;
+    }
+
+    outb(base_port + SERIAL_INTERRUPT_ENABLE_REGISTER, 0);
+    outb(base_port + SERIAL_LINE_CONTROL_REGISTER,     SERIAL_LINE_DIVISOR_LATCH);
+    outb(base_port + SERIAL_DIVISOR_LOW_REGISTER,      (uint8_t)divisor);
+    outb(base_port + SERIAL_DIVISOR_HIGH_REGISTER,     (uint8_t)(divisor >> 8));
+    outb(base_port + SERIAL_LINE_CONTROL_REGISTER,     SERIAL_LINE_8_BITS_NO_PARITY);
+    outb(base_port + SERIAL_FIFO_CONTROL_REGISTER,     SERIAL_FIFO_ENABLE | SERIAL_FIFO_CLEAR_RECEIVE | SERIAL_FIFO_CLEAR_TRANSMIT | SERIAL_FIFO_TRIGGER_14_BYTES);
+    outb(base_port + SERIAL_MODEM_CONTROL_REGISTER,    SERIAL_MODEM_DTR | SERIAL_MODEM_RTS | SERIAL_MODEM_OUT2);
+
+    // A 16450 or a 16550 with the broken FIFO takes one byte at a time.
+    bool has_fifo   = ((inb(base_port + SERIAL_INTERRUPT_ID_REGISTER) & SERIAL_INTERRUPT_ID_FIFO_MASK) == SERIAL_INTERRUPT_ID_FIFO_MASK);
+    port->fifo_size = has_fifo ? SERIAL_FIFO_SIZE : 1;
+
+    return true;
+
+}
+
+/*******************************************************************************
+Serial Port Enable Interrupts Function
+Drain the ring from the transmitter empty interrupt of a legacy IRQ routed
+through the IO APIC to the given processor. Returns false if the IRQ could not
+be routed, the port then stays polled.
+*******************************************************************************/
+bool serial_port_enable_interrupts (serial_port* port, Interrupt_Descriptor_Table* idt, uint8_t irq, uint32_t destination_apic_id) {
+
+    if (irq >= IO_APIC_NUM_OF_LEGACY_IRQS) {
+        return false;
+    }
+
+    uint8_t vector = IO_APIC_LEGACY_VECTOR_BASE + irq;
+
+    serial_ports_of_irq[irq] = port;
+    if (!idt->register_handler(vector, Serial_Interrupt_Handler)) {
+        serial_ports_of_irq[irq] = nullptr;
+        return false;
+    }
+
+    if (!io_apic_route_legacy_irq(irq, vector, destination_apic_id)) {
+        idt->unregister_handler(vector);
+        serial_ports_of_irq[irq] = nullptr;
+        return false;
+    }
+
+    __atomic_store_n(&port->interrupt_driven, true, __ATOMIC_RELEASE);
+
+    // Start on whatever was queued while polled.
+    if (__atomic_load_n(&port->tx_commit_head, __ATOMIC_ACQUIRE) != __atomic_load_n(&port->tx_tail, __ATOMIC_ACQUIRE)) {
+        Arm_Transmit_Interrupt(port);
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Serial Port Write Function
+
+Queue bytes for transmission from any processor or interrupt handler. Never
+blocks on the UART; a write that does not fit is dropped whole and counted.
+Interrupts are disabled from reservation to publication so no handler can wait
+on an interrupted writer of its own processor. Returns the bytes queued.
+*******************************************************************************/
+uint64_t serial_port_write (serial_port* port, const char* data, uint64_t size) {
+
+    if ((size == 0) || (size > SERIAL_TX_RING_SIZE)) {
+        return 0;
+    }
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    uint64_t head = __atomic_load_n(&port->tx_reserve_head, __ATOMIC_RELAXED);
+    do {
+        if ((head + size - __atomic_load_n(&port->tx_tail, __ATOMIC_ACQUIRE)) > SERIAL_TX_RING_SIZE) {
+            __atomic_add_fetch(&port->num_of_dropped_bytes, size, __ATOMIC_RELAXED);
+            restore_interrupts(rflags);
+            return 0;
+        }
+    } while (!__atomic_compare_exchange_n(&port->tx_reserve_head, &head, head + size, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED));
+
+    for (uint64_t idx = 0; idx < size; idx++) {
+        port->tx_ring[(head + idx) & (SERIAL_TX_RING_SIZE - 1)] = (uint8_t)data[idx];
+    }
+
+    // Earlier reservations are other processors a copy away from publishing.
+    while (__atomic_load_n(&port->tx_commit_head, __ATOMIC_ACQUIRE) != head) {
+        __asm__ __volatile__ ("pause");
+    }
+    __atomic_store_n(&port->tx_commit_head, head + size, __ATOMIC_SEQ_CST);
+
+    if (__atomic_load_n(&port->interrupt_driven, __ATOMIC_ACQUIRE)) {
+        Arm_Transmit_Interrupt(port);
+    }
+
+    restore_interrupts(rflags);
+
+    return size;
+
+}
+
+/*******************************************************************************
+Serial Port Write String Function
+*******************************************************************************/
+uint64_t serial_port_write_string (serial_port* port, const char* string) {
+
+    uint64_t length = 0;
+    while (string[length] != '\0') {
+        length++;
+    }
+
+    return serial_port_write(port, string, length);
+
+}
+
+/*******************************************************************************
+Serial Port Get Free Space Function
+Bytes a write could queue right now. Other producers may take the space before
+the caller writes, so a single producer can rely on it, others only as a hint.
+*******************************************************************************/
+uint64_t serial_port_get_free_space (serial_port* port) {
+
+    uint64_t head = __atomic_load_n(&port->tx_reserve_head, __ATOMIC_RELAXED);
+    uint64_t tail = __atomic_load_n(&port->tx_tail, __ATOMIC_ACQUIRE);
+
+    return SERIAL_TX_RING_SIZE - (head - tail);
+
+}
+
+/*******************************************************************************
+Serial Port Poll Function
+Refill the FIFO if the transmitter is empty, for ports without interrupts.
+Returns true while queued bytes remain.
+*******************************************************************************/
+bool serial_port_poll (serial_port* port) {
+
+    if (__atomic_load_n(&port->tx_commit_head, __ATOMIC_ACQUIRE) == __atomic_load_n(&port->tx_tail, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    uint64_t rflags = save_and_disable_interrupts();
+    bool remaining = Drain(port);
+    restore_interrupts(rflags);
+
+    return remaining;
+
+}
+
+/*******************************************************************************
+Serial Port Flush Function
+Spin until every byte queued so far has gone to the UART, e.g. before a halt.
+*******************************************************************************/
+void serial_port_flush (serial_port* port) {
+
+    uint64_t target = __atomic_load_n(&port->tx_commit_head, __ATOMIC_ACQUIRE);
+
+    while ((int64_t)(__atomic_load_n(&port->tx_tail, __ATOMIC_ACQUIRE) - target) < 0) {
+        uint64_t rflags = save_and_disable_interrupts();
+        Drain(port);
+        restore_interrupts(rflags);
+        __asm__ __volatile__ ("pause");
+    }
+
+}
+
+/*******************************************************************************
+Serial Port Log Sink Function
+Kernel log sink, the context is the port. Queues the line with its CR LF as
+one write so lines from other writers do not split it.
+*******************************************************************************/
+void serial_port_log_sink (const char* line, uint64_t length, void* context) {
+
+    char buffer[KERNEL_LOG_MAX_LINE_LENGTH + 2];
+
+    if (length > KERNEL_LOG_MAX_LINE_LENGTH) {
+        length = KERNEL_LOG_MAX_LINE_LENGTH;
+    }
+
+    for (uint64_t idx = 0; idx < length; idx++) {
+        buffer[idx] = line[idx];
+    }
+    buffer[length]     = '\r';
+    buffer[length + 1] = '\n';
+
+    serial_port_write((serial_port*)context, buffer, length + 2);
+
+}
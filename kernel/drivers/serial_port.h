@@ -0,0 +1,52 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+#include "../interrupts/interrupt_descriptor_table.h"
+
+#define SERIAL_COM1_PORT          0x3F8
+#define SERIAL_COM1_IRQ           4
+#define SERIAL_DEFAULT_BAUD_RATE  115200
+#define SERIAL_FIFO_SIZE          16
+#define SERIAL_TX_RING_SIZE       (64 * 1024) // Power of two.
+
+// Register offsets from the base port (DLAB clear unless noted).
+#define SERIAL_TRANSMIT_REGISTER          0 // Write.
+#define SERIAL_RECEIVE_REGISTER           0 // Read.
+#define SERIAL_DIVISOR_LOW_REGISTER       0 // DLAB set.
+#define SERIAL_INTERRUPT_ENABLE_REGISTER  1
+#define SERIAL_DIVISOR_HIGH_REGISTER      1 // DLAB set.
+#define SERIAL_INTERRUPT_ID_REGISTER      2 // Read.
+#define SERIAL_FIFO_CONTROL_REGISTER      2 // Write.
+#define SERIAL_LINE_CONTROL_REGISTER      3
+#define SERIAL_MODEM_CONTROL_REGISTER     4
+#define SERIAL_LINE_STATUS_REGISTER       5
+#define SERIAL_SCRATCH_REGISTER           7
+
+/* A 16550 UART. Any processor queues bytes into the transmit ring without port
+I/O; the ring is drained 16 bytes at a time into the FIFO, by the transmitter
+empty interrupt once routed, else by serial_port_poll. Producers reserve space
+and publish it in reservation order, a full ring drops the write. */
+typedef struct {
+    uint16_t base_port;
+    uint64_t fifo_size;             // 1 for a UART without a working FIFO.
+    uint8_t* tx_ring;
+    bool     interrupt_driven;
+    uint64_t num_of_interrupts;
+    uint64_t num_of_dropped_bytes;
+
+    uint64_t tx_reserve_head  __attribute__((aligned(64))); // Next byte producers claim.
+    uint64_t tx_commit_head;                                // Bytes before it may be sent.
+    bool     tx_interrupt_armed;                            // Transmitter empty interrupt enabled.
+
+    uint64_t tx_tail          __attribute__((aligned(64))); // Next byte to send.
+    uint32_t tx_consumer_busy;                              // Held by whoever is draining.
+} serial_port;
+
+bool     Initialize_Serial_Port         (serial_port* port, uint16_t base_port, uint32_t baud_rate, Physical_Memory_Manager* pmm);
+bool     serial_port_enable_interrupts  (serial_port* port, Interrupt_Descriptor_Table* idt, uint8_t irq, uint32_t destination_apic_id);
+uint64_t serial_port_write              (serial_port* port, const char* data, uint64_t size);
+uint64_t serial_port_write_string       (serial_port* port, const char* string);
+uint64_t serial_port_get_free_space     (serial_port* port);
+bool     serial_port_poll               (serial_port* port);
+void     serial_port_flush              (serial_port* port);
+void     serial_port_log_sink           (const char* line, uint64_t length, void* context);
@@ -0,0 +1,448 @@
+#include "executor.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+#include "../../shared/synchronization/ticket_lock.h"
+
+// Workers in the order they were created, for stealing.
+static executor_worker* executor_worker_list[EXECUTOR_MAX_NUM_OF_WORKERS];
+static uint64_t         executor_num_of_workers;
+
+// Worker of each processor, nullptr where none runs.
+static executor_worker* executor_worker_of_cpu[EXECUTOR_MAX_NUM_OF_WORKERS];
+
+/* Tasks spawned by code that is not a worker, e.g. the idle thread handing out
+the first task of a parallel_for. Workers take from it before stealing. */
+static executor_task* executor_injection_head;
+static ticket_lock    executor_injection_lock;
+
+/*******************************************************************************
+Next Random Function
+xorshift64, only has to spread thieves over their victims.
+*******************************************************************************/
+static uint64_t Next_Random (uint64_t* state) {
+
+    uint64_t x = *state;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    *state = x;
+
+    return x;
+
+}
+
+/*******************************************************************************
+Current Worker Function
+The worker running on the executing processor if the caller is that worker,
+else nullptr.
+*******************************************************************************/
+static executor_worker* Current_Worker () {
+
+    uint64_t cpu_index = get_per_cpu_data()->cpu_index;
+    if (cpu_index >= EXECUTOR_MAX_NUM_OF_WORKERS) {
+        return nullptr;
+    }
+
+    executor_worker* worker = __atomic_load_n(&executor_worker_of_cpu[cpu_index], __ATOMIC_ACQUIRE);
+    if ((worker == nullptr) || (worker->thread != scheduler_current_thread())) {
+        return nullptr;
+    }
+
+    return worker;
+
+}
+
+/*******************************************************************************
+Pop Injected Task Function
+*******************************************************************************/
+static executor_task* Pop_Injected_Task () {
+
+    if (__atomic_load_n(&executor_injection_head, __ATOMIC_RELAXED) == nullptr) {
+        return nullptr;
+    }
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&executor_injection_lock);
+
+    executor_task* task = executor_injection_head;
+    if (task != nullptr) {
+        executor_injection_head = task->next;
+    }
+
+    ticket_lock_release_irq_restore(&executor_injection_lock, rflags);
+
+    return task;
+
+}
+
+/*******************************************************************************
+Find Task Function
+
+The caller's own newest task first, which keeps a joiner working on its own
+children, then injected tasks, then the oldest task of the other workers
+starting at a random one. worker is nullptr for callers that are not workers.
+*******************************************************************************/
+static executor_task* Find_Task (executor_worker* worker, uint64_t* random_state) {
+
+    executor_task* task = nullptr;
+
+    if (worker != nullptr) {
+        task = (executor_task*)work_stealing_deque_pop(&worker->deque);
+        if (task != nullptr) {
+            return task;
+        }
+    }
+
+    task = Pop_Injected_Task();
+    if (task != nullptr) {
+        return task;
+    }
+
+    uint64_t num_of_workers = __atomic_load_n(&executor_num_of_workers, __ATOMIC_ACQUIRE);
+    if (num_of_workers == 0) {
+        return nullptr;
+    }
+
+    uint64_t first_victim = Next_Random(random_state) % num_of_workers;
+    for (uint64_t idx = 0; idx < num_of_workers; idx++) {
+
+        executor_worker* victim = executor_worker_list[(first_victim + idx) % num_of_workers];
+        if (victim == worker) {
+            continue;
+        }
+
+        task = (executor_task*)work_stealing_deque_steal(&victim->deque);
+        if (task != nullptr) {
+            if (worker != nullptr) {
+                worker->num_of_steals++;
+            }
+            return task;
+        }
+
+    }
+
+    return nullptr;
+
+}
+
+/*******************************************************************************
+Any Work Available Function
+*******************************************************************************/
+static bool Any_Work_Available () {
+
+    if (__atomic_load_n(&executor_injection_head, __ATOMIC_SEQ_CST) != nullptr) {
+        return true;
+    }
+
+    uint64_t num_of_workers = __atomic_load_n(&executor_num_of_workers, __ATOMIC_ACQUIRE);
+    for (uint64_t idx = 0; idx < num_of_workers; idx++) {
+        if (!work_stealing_deque_is_empty(&executor_worker_list[idx]->deque)) {
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+/*******************************************************************************
+Wake Sleeping Worker Function
+Wake one sleeping worker other than the caller, after new work was published.
+*******************************************************************************/
+static void Wake_Sleeping_Worker (executor_worker* self) {
+
+    // Pairs with the fence of a worker going to sleep, one of the two sees the other.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint64_t num_of_workers = __atomic_load_n(&executor_num_of_workers, __ATOMIC_ACQUIRE);
+    for (uint64_t idx = 0; idx < num_of_workers; idx++) {
+
+        executor_worker* worker = executor_worker_list[idx];
+        if ((worker == self) || (!__atomic_load_n(&worker->sleeping, __ATOMIC_RELAXED))) {
+            continue;
+        }
+
+        if (__atomic_exchange_n(&worker->sleeping, false, __ATOMIC_SEQ_CST)) {
+            scheduler_wake(worker->thread);
+            return;
+        }
+
+    }
+
+}
+
+/*******************************************************************************
+Run Task Function
+The task belongs to the joiner once the group count drops, so it is not touched
+afterwards.
+*******************************************************************************/
+static void Run_Task (executor_worker* worker, executor_task* task) {
+
+    executor_task_group* group = task->group;
+
+    task->function(task->argument);
+
+    if (worker != nullptr) {
+        worker->num_of_tasks_run++;
+    }
+
+    __atomic_sub_fetch(&group->num_of_pending, 1, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Worker Thread Function
+Run tasks while there are any, else block until a spawner wakes the worker.
+*******************************************************************************/
+static void Worker_Thread (void* argument) {
+
+    executor_worker* worker = (executor_worker*)argument;
+    worker->thread = scheduler_current_thread();
+
+    while (true) {
+
+        executor_task* task = Find_Task(worker, &worker->random_state);
+        if (task != nullptr) {
+            Run_Task(worker, task);
+            continue;
+        }
+
+        // Announce the sleep before the last look so a spawner cannot miss it.
+        __atomic_store_n(&worker->sleeping, true, __ATOMIC_SEQ_CST);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+        if (Any_Work_Available()) {
+            __atomic_store_n(&worker->sleeping, false, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        scheduler_block();
+        __atomic_store_n(&worker->sleeping, false, __ATOMIC_RELAXED);
+
+    }
+
+}
+
+/*******************************************************************************
+Initialize Executor Function
+
+Start one worker thread on every processor with a run queue, its deque
+allocated on the processor's NUMA node. Called once on the bootstrap processor
+after the application processors are up. Returns false if no worker could be
+started.
+*******************************************************************************/
+bool Initialize_Executor (Physical_Memory_Manager* pmm) {
+
+    const uint64_t ALIGNMENT = WORK_STEALING_CACHE_LINE;
+
+    executor_num_of_workers = 0;
+    executor_injection_head = nullptr;
+    ticket_lock_initialize(&executor_injection_lock);
+
+    for (uint64_t idx = 0; idx < EXECUTOR_MAX_NUM_OF_WORKERS; idx++) {
+        executor_worker_list[idx]   = nullptr;
+        executor_worker_of_cpu[idx] = nullptr;
+    }
+
+    uint64_t num_of_cpus = get_num_of_cpus();
+    for (uint64_t cpu_index = 0; (cpu_index < num_of_cpus) && (cpu_index < EXECUTOR_MAX_NUM_OF_WORKERS); cpu_index++) {
+
+        per_cpu_data* cpu = get_per_cpu_data_of(cpu_index);
+        if ((cpu == nullptr) || (__atomic_load_n(&cpu->run_queue.current, __ATOMIC_ACQUIRE) == nullptr)) {
+            continue;
+        }
+
+        uint8_t* memory = (uint8_t*)pmm->allocate_physical_frames_on_node(sizeof(executor_worker) + ALIGNMENT, cpu->numa_node, true);
+        if (memory == nullptr) {
+            continue;
+        }
+
+        executor_worker* worker = (executor_worker*)((((uint64_t)memory) + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+        Initialize_Work_Stealing_Deque(&worker->deque);
+        worker->thread           = nullptr;
+        worker->cpu_index        = cpu_index;
+        worker->random_state     = read_tsc() | 1; // xorshift must not start at zero.
+        worker->sleeping         = false;
+        worker->num_of_tasks_run = 0;
+        worker->num_of_steals    = 0;
+
+        // Published before the thread exists, thieves only need the deque.
+        executor_worker_list[executor_num_of_workers] = worker;
+        __atomic_store_n(&executor_worker_of_cpu[cpu_index], worker, __ATOMIC_RELEASE);
+        __atomic_store_n(&executor_num_of_workers, executor_num_of_workers + 1, __ATOMIC_RELEASE);
+
+        /* A worker whose thread cannot be created never sleeps, so it is never
+        woken, and never pushes, so thieves always find its deque empty. */
+        Create_Kernel_Thread(Worker_Thread, worker, 0, cpu_index);
+
+    }
+
+    return executor_num_of_workers != 0;
+
+}
+
+/*******************************************************************************
+Get Number of Workers Function
+*******************************************************************************/
+uint64_t executor_get_num_of_workers () {
+    return __atomic_load_n(&executor_num_of_workers, __ATOMIC_ACQUIRE);
+}
+
+/*******************************************************************************
+Task Group Initialize Function
+*******************************************************************************/
+void executor_task_group_initialize (executor_task_group* group) {
+    group->num_of_pending = 0;
+}
+
+/*******************************************************************************
+Spawn Function
+
+Make a task available to every worker. A worker pushes onto its own deque and
+runs the task itself when the deque is full; anyone else hands it over through
+the injection list. Wakes a sleeping worker to pick it up.
+*******************************************************************************/
+void executor_spawn (executor_task_group* group, executor_task* task, executor_task_function function, void* argument) {
+
+    task->function = function;
+    task->argument = argument;
+    task->group    = group;
+    task->next     = nullptr;
+
+    __atomic_add_fetch(&group->num_of_pending, 1, __ATOMIC_RELAXED);
+
+    executor_worker* worker = Current_Worker();
+
+    if (worker != nullptr) {
+
+        if (!work_stealing_deque_push(&worker->deque, task)) {
+            Run_Task(worker, task);
+            return;
+        }
+
+    } else {
+
+        uint64_t rflags = ticket_lock_acquire_irq_save(&executor_injection_lock);
+        task->next              = executor_injection_head;
+        executor_injection_head = task;
+        ticket_lock_release_irq_restore(&executor_injection_lock, rflags);
+
+    }
+
+    Wake_Sleeping_Worker(worker);
+
+}
+
+/*******************************************************************************
+Join Function
+
+Return once every task spawned in the group has finished. The caller runs tasks
+while it waits, its own first, so joining never idles a processor while there
+is work. Callers that find nothing to do yield, letting the local worker run.
+*******************************************************************************/
+void executor_join (executor_task_group* group) {
+
+    executor_worker* worker       = Current_Worker();
+    uint64_t         random_state = read_tsc() | 1;
+
+    while (__atomic_load_n(&group->num_of_pending, __ATOMIC_ACQUIRE) != 0) {
+
+        executor_task* task = Find_Task(worker, (worker != nullptr) ? &worker->random_state : &random_state);
+
+        if (task != nullptr) {
+            Run_Task(worker, task);
+        } else {
+            __asm__ __volatile__ ("pause");
+            scheduler_yield();
+        }
+
+    }
+
+}
+
+// A half open index range still to be split or run.
+typedef struct {
+    uint64_t                begin;
+    uint64_t                end;
+    uint64_t                grain_size;
+    executor_range_function function;
+    void*                   argument;
+} executor_range;
+
+static void Run_Range (executor_range* range);
+
+/*******************************************************************************
+Range Task Function
+*******************************************************************************/
+static void Range_Task (void* argument) {
+    Run_Range((executor_range*)argument);
+}
+
+/*******************************************************************************
+Run Range Function
+Split the range in halves, offering the upper half to thieves and recursing
+into the lower half, until it is no larger than the grain size.
+*******************************************************************************/
+static void Run_Range (executor_range* range) {
+
+    uint64_t size = range->end - range->begin;
+
+    if (size <= range->grain_size) {
+        range->function(range->begin, range->end, range->argument);
+        return;
+    }
+
+    uint64_t middle = range->begin + (size / 2);
+
+    executor_range upper;
+    upper.begin      = middle;
+    upper.end        = range->end;
+    upper.grain_size = range->grain_size;
+    upper.function   = range->function;
+    upper.argument   = range->argument;
+
+    executor_range lower = upper;
+    lower.begin = range->begin;
+    lower.end   = middle;
+
+    executor_task_group group;
+    executor_task       task;
+    executor_task_group_initialize(&group);
+    executor_spawn(&group, &task, Range_Task, &upper);
+
+    Run_Range(&lower);
+
+    executor_join(&group);
+
+}
+
+/*******************************************************************************
+Parallel For Function
+
+Call function on disjoint sub-ranges covering [begin, end) across the workers
+and return once all calls returned. A grain size of zero picks one that gives
+every worker a few chunks to balance with.
+*******************************************************************************/
+void executor_parallel_for (uint64_t begin, uint64_t end, uint64_t grain_size, executor_range_function function, void* argument) {
+
+    if (begin >= end) {
+        return;
+    }
+
+    if (grain_size == 0) {
+        uint64_t num_of_chunks = (executor_get_num_of_workers() + 1) * EXECUTOR_GRAIN_SIZE_DIVISOR;
+        grain_size = (end - begin) / num_of_chunks;
+        if (grain_size == 0) {
+            grain_size = 1;
+        }
+    }
+
+    executor_range range;
+    range.begin      = begin;
+    range.end        = end;
+    range.grain_size = grain_size;
+    range.function   = function;
+    range.argument   = argument;
+
+    Run_Range(&range);
+
+}
@@ -0,0 +1,44 @@
+#pragma once
+#include <stdint.h>
+#include "work_stealing_deque.h"
+#include "../memory/physical_memory_manager.h"
+#include "../scheduler/scheduler.h"
+
+#define EXECUTOR_MAX_NUM_OF_WORKERS     256 // One per processor, indexed by processor index.
+#define EXECUTOR_GRAIN_SIZE_DIVISOR     8   // Default grain gives each worker about this many chunks.
+
+typedef void (*executor_task_function)  (void* argument);
+typedef void (*executor_range_function) (uint64_t begin, uint64_t end, void* argument);
+
+// Tasks that are joined together, counts the ones not yet finished.
+typedef struct {
+    uint64_t num_of_pending;
+} executor_task_group;
+
+/* A unit of work. Owned by the spawner, usually on its stack, and must stay
+alive until its group is joined. */
+typedef struct executor_task {
+    executor_task_function function;
+    void*                  argument;
+    executor_task_group*   group;
+    struct executor_task*  next; // Injection list link.
+} executor_task;
+
+/* One worker thread per processor. Tasks it spawns go onto its own deque, idle
+workers steal from the others. */
+typedef struct {
+    work_stealing_deque deque; // Must stay first, cache line aligned.
+    kernel_thread*      thread;
+    uint64_t            cpu_index;
+    uint64_t            random_state; // Victim selection.
+    bool                sleeping;
+    uint64_t            num_of_tasks_run;
+    uint64_t            num_of_steals;
+} executor_worker;
+
+bool     Initialize_Executor             (Physical_Memory_Manager* pmm);
+uint64_t executor_get_num_of_workers     ();
+void     executor_task_group_initialize  (executor_task_group* group);
+void     executor_spawn                  (executor_task_group* group, executor_task* task, executor_task_function function, void* argument);
+void     executor_join                   (executor_task_group* group);
+void     executor_parallel_for           (uint64_t begin, uint64_t end, uint64_t grain_size, executor_range_function function, void* argument);
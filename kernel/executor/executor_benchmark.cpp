@@ -0,0 +1,110 @@
+#include "executor_benchmark.h"
+#include "executor.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+#define EXECUTOR_BENCHMARK_FRAME_SIZE 4096
+
+typedef struct {
+    uint32_t* framebuffer;
+    uint64_t  pixels_per_scan_line;
+    uint32_t  color;
+} framebuffer_fill_job;
+
+/*******************************************************************************
+Fill Scan Lines Function
+*******************************************************************************/
+static void Fill_Scan_Lines (uint64_t begin, uint64_t end, void* argument) {
+
+    framebuffer_fill_job* job = (framebuffer_fill_job*)argument;
+
+    uint32_t* pixel = job->framebuffer + (begin * job->pixels_per_scan_line);
+    uint32_t* last  = job->framebuffer + (end   * job->pixels_per_scan_line);
+
+    while (pixel < last) {
+        *pixel++ = job->color;
+    }
+
+}
+
+/*******************************************************************************
+Scrub Frames Function
+Zero whole frames starting at the frame aligned base passed as the argument.
+*******************************************************************************/
+static void Scrub_Frames (uint64_t begin, uint64_t end, void* argument) {
+
+    uint64_t* word = (uint64_t*)(((uint8_t*)argument) + (begin * EXECUTOR_BENCHMARK_FRAME_SIZE));
+    uint64_t* last = (uint64_t*)(((uint8_t*)argument) + (end   * EXECUTOR_BENCHMARK_FRAME_SIZE));
+
+    while (word < last) {
+        *word++ = 0;
+    }
+
+}
+
+/*******************************************************************************
+Benchmark Parallel Framebuffer Fill Function
+Fill every scan line with one color, once on the calling processor and once
+split by scan line across the workers. Returns false if there are no workers.
+*******************************************************************************/
+bool Benchmark_Parallel_Framebuffer_Fill (uint32_t* framebuffer, uint64_t pixels_per_scan_line, uint64_t num_of_scan_lines, uint32_t color, executor_benchmark_result* result) {
+
+    result->num_of_workers = executor_get_num_of_workers();
+    if (result->num_of_workers == 0) {
+        return false;
+    }
+
+    framebuffer_fill_job job;
+    job.framebuffer          = framebuffer;
+    job.pixels_per_scan_line = pixels_per_scan_line;
+    job.color                = color;
+
+    uint64_t start_tsc = read_tsc();
+    Fill_Scan_Lines(0, num_of_scan_lines, &job);
+    result->serial_cycles = read_tsc() - start_tsc;
+
+    start_tsc = read_tsc();
+    executor_parallel_for(0, num_of_scan_lines, 0, Fill_Scan_Lines, &job);
+    result->parallel_cycles = read_tsc() - start_tsc;
+
+    return true;
+
+}
+
+/*******************************************************************************
+Benchmark Parallel Frame Scrub Function
+
+The PMM's own set up threads its free lists through the memory it manages and
+runs before any worker exists, so what is measured is the bulk of bringing
+fresh memory into service: zeroing its frames. A region of the given size is
+zeroed once on the calling processor and once split by frame across the
+workers. Returns false if there are no workers or the region cannot be
+allocated.
+*******************************************************************************/
+bool Benchmark_Parallel_Frame_Scrub (Physical_Memory_Manager* pmm, uint64_t size, executor_benchmark_result* result) {
+
+    result->num_of_workers = executor_get_num_of_workers();
+    if (result->num_of_workers == 0) {
+        return false;
+    }
+
+    uint8_t* memory = (uint8_t*)pmm->allocate_physical_frames(size + EXECUTOR_BENCHMARK_FRAME_SIZE);
+    if (memory == nullptr) {
+        return false;
+    }
+
+    uint8_t* frames        = (uint8_t*)((((uint64_t)memory) + EXECUTOR_BENCHMARK_FRAME_SIZE - 1) & ~((uint64_t)EXECUTOR_BENCHMARK_FRAME_SIZE - 1));
+    uint64_t num_of_frames = size / EXECUTOR_BENCHMARK_FRAME_SIZE;
+
+    uint64_t start_tsc = read_tsc();
+    Scrub_Frames(0, num_of_frames, frames);
+    result->serial_cycles = read_tsc() - start_tsc;
+
+    start_tsc = read_tsc();
+    executor_parallel_for(0, num_of_frames, 0, Scrub_Frames, frames);
+    result->parallel_cycles = read_tsc() - start_tsc;
+
+    pmm->free_physical_frames(memory);
+
+    return true;
+
+}
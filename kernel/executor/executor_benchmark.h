@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+
+typedef struct {
+    uint64_t num_of_workers;
+    uint64_t serial_cycles;
+    uint64_t parallel_cycles;
+} executor_benchmark_result;
+
+bool Benchmark_Parallel_Framebuffer_Fill (uint32_t* framebuffer, uint64_t pixels_per_scan_line, uint64_t num_of_scan_lines, uint32_t color, executor_benchmark_result* result);
+bool Benchmark_Parallel_Frame_Scrub      (Physical_Memory_Manager* pmm, uint64_t size, executor_benchmark_result* result);
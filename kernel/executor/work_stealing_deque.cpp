@@ -0,0 +1,117 @@
+#include "work_stealing_deque.h"
+
+#define WORK_STEALING_DEQUE_MASK (WORK_STEALING_DEQUE_CAPACITY - 1)
+
+static_assert((WORK_STEALING_DEQUE_CAPACITY & WORK_STEALING_DEQUE_MASK) == 0, "Capacity must be a power of two.");
+
+/*******************************************************************************
+Initialize Work Stealing Deque Function
+*******************************************************************************/
+void Initialize_Work_Stealing_Deque (work_stealing_deque* deque) {
+
+    deque->top    = 0;
+    deque->bottom = 0;
+
+    for (uint64_t idx = 0; idx < WORK_STEALING_DEQUE_CAPACITY; idx++) {
+        deque->slots[idx] = nullptr;
+    }
+
+}
+
+/*******************************************************************************
+Push Function
+Owner only. Returns false if the deque is full, the caller then runs the item
+itself.
+*******************************************************************************/
+bool work_stealing_deque_push (work_stealing_deque* deque, void* item) {
+
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED);
+    int64_t top    = __atomic_load_n(&deque->top,    __ATOMIC_ACQUIRE);
+
+    if ((bottom - top) >= WORK_STEALING_DEQUE_CAPACITY) {
+        return false;
+    }
+
+    __atomic_store_n(&deque->slots[bottom & WORK_STEALING_DEQUE_MASK], item, __ATOMIC_RELAXED);
+
+    // The item must be visible before a thief can see the new bottom.
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+    __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Pop Function
+
+Owner only. Takes the most recently pushed item, nullptr if there is none. The
+bottom is lowered before top is read so a thief racing for the last item sees
+the claim; the last item is then settled with a compare-and-swap on top.
+*******************************************************************************/
+void* work_stealing_deque_pop (work_stealing_deque* deque) {
+
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_RELAXED) - 1;
+    __atomic_store_n(&deque->bottom, bottom, __ATOMIC_RELAXED);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_RELAXED);
+
+    if (top > bottom) {
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+        return nullptr;
+    }
+
+    void* item = __atomic_load_n(&deque->slots[bottom & WORK_STEALING_DEQUE_MASK], __ATOMIC_RELAXED);
+
+    if (top == bottom) {
+        if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+            item = nullptr; // A thief won it.
+        }
+        __atomic_store_n(&deque->bottom, bottom + 1, __ATOMIC_RELAXED);
+    }
+
+    return item;
+
+}
+
+/*******************************************************************************
+Steal Function
+Any processor. Takes the oldest item, nullptr if there is none or another
+thief or the owner got it first.
+*******************************************************************************/
+void* work_stealing_deque_steal (work_stealing_deque* deque) {
+
+    int64_t top = __atomic_load_n(&deque->top, __ATOMIC_ACQUIRE);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_ACQUIRE);
+
+    if (top >= bottom) {
+        return nullptr;
+    }
+
+    void* item = __atomic_load_n(&deque->slots[top & WORK_STEALING_DEQUE_MASK], __ATOMIC_RELAXED);
+
+    if (!__atomic_compare_exchange_n(&deque->top, &top, top + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+        return nullptr;
+    }
+
+    return item;
+
+}
+
+/*******************************************************************************
+Is Empty Function
+A snapshot, only exact while nobody pushes or takes.
+*******************************************************************************/
+bool work_stealing_deque_is_empty (work_stealing_deque* deque) {
+
+    int64_t top    = __atomic_load_n(&deque->top,    __ATOMIC_SEQ_CST);
+    int64_t bottom = __atomic_load_n(&deque->bottom, __ATOMIC_SEQ_CST);
+
+    return top >= bottom;
+
+}
@@ -0,0 +1,21 @@
+#pragma once
+#include <stdint.h>
+
+#define WORK_STEALING_DEQUE_CAPACITY 1024 // Power of two.
+#define WORK_STEALING_CACHE_LINE     64
+
+/* Chase-Lev deque of task pointers with a fixed capacity. Only the owning
+worker pushes and pops, at the bottom; any processor may steal from the top.
+top and bottom sit on their own cache lines so thieves and the owner do not
+share one. Indices only ever grow, a slot is the index modulo the capacity. */
+typedef struct {
+    int64_t top    __attribute__((aligned(WORK_STEALING_CACHE_LINE)));
+    int64_t bottom __attribute__((aligned(WORK_STEALING_CACHE_LINE)));
+    void*   slots[WORK_STEALING_DEQUE_CAPACITY] __attribute__((aligned(WORK_STEALING_CACHE_LINE)));
+} work_stealing_deque;
+
+void  Initialize_Work_Stealing_Deque (work_stealing_deque* deque);
+bool  work_stealing_deque_push       (work_stealing_deque* deque, void* item);
+void* work_stealing_deque_pop        (work_stealing_deque* deque);
+void* work_stealing_deque_steal      (work_stealing_deque* deque);
+bool  work_stealing_deque_is_empty   (work_stealing_deque* deque);
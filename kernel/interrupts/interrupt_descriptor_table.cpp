@@ -0,0 +1,265 @@
+#include "interrupt_descriptor_table.h"
+#include "../cpu/global_descriptor_table.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+#define IDT_INTERRUPT_GATE_TYPE 0x8E // Present, DPL 0, 64-bit interrupt gate.
+
+// Handler called for each vector, indexed directly by the vector number.
+static interrupt_handler idt_handler_table[IDT_NUM_OF_VECTORS];
+
+// Entry to handler latency of each vector.
+static interrupt_latency_statistics idt_latency_statistics[IDT_NUM_OF_VECTORS];
+
+// Called after every handler, nullptr if none is installed.
+static interrupt_handler idt_exit_hook;
+
+/*******************************************************************************
+Interrupt Stubs
+
+One 16 byte aligned stub per vector so the stub of vector n is found at
+interrupt_stubs + (n * IDT_STUB_SIZE). Vectors where the processor does not push
+an error code push a zero so every frame has the same layout. The common entry
+saves only the caller-saved registers (and rbp), takes the entry timestamp and
+calls the dispatcher with a 16 byte aligned stack.
+*******************************************************************************/
+extern "C" uint8_t interrupt_stubs[];
+extern "C" void interrupt_dispatch (interrupt_frame* frame);
+
+__asm__ (
+    ".text\n"
+    ".align 16\n"
+    ".global interrupt_stubs\n"
+    "interrupt_stubs:\n"
+    ".set idt_stub_vector, 0\n"
+    ".rept 256\n"
+    "    .align 16\n"
+    "    .if (idt_stub_vector == 8) || ((idt_stub_vector >= 10) && (idt_stub_vector <= 14)) || (idt_stub_vector == 17) || (idt_stub_vector == 21) || (idt_stub_vector == 29) || (idt_stub_vector == 30)\n"
+    "    .else\n"
+    "    pushq $0\n"
+    "    .endif\n"
+    "    pushq $idt_stub_vector\n"
+    "    jmp interrupt_common_entry\n"
+    "    .set idt_stub_vector, idt_stub_vector + 1\n"
+    ".endr\n"
+    "\n"
+    "interrupt_common_entry:\n"
+    "    pushq %rax\n"
+    "    pushq %rcx\n"
+    "    pushq %rdx\n"
+    "    pushq %rsi\n"
+    "    pushq %rdi\n"
+    "    pushq %r8\n"
+    "    pushq %r9\n"
+    "    pushq %r10\n"
+    "    pushq %r11\n"
+    "    pushq %rbp\n"
+    "    rdtsc\n"
+    "    shlq $32, %rdx\n"
+    "    orq %rdx, %rax\n"
+    "    pushq %rax\n"
+    "    cld\n"
+    "    movq %rsp, %rdi\n"
+    "    call interrupt_dispatch\n"
+    "    addq $8, %rsp\n"
+    "    popq %rbp\n"
+    "    popq %r11\n"
+    "    popq %r10\n"
+    "    popq %r9\n"
+    "    popq %r8\n"
+    "    popq %rdi\n"
+    "    popq %rsi\n"
+    "    popq %rdx\n"
+    "    popq %rcx\n"
+    "    popq %rax\n"
+    "    addq $16, %rsp\n"
+    "    iretq\n"
+);
+
+/*******************************************************************************
+Default Exception Handler Function
+An unhandled exception leaves the processor in an unknown state, stop it.
+*******************************************************************************/
+static void Default_Exception_Handler (interrupt_frame* frame) {
+
+    (void)frame;
+
+    disable_interrupts();
+    while (true) {
+        __asm__ __volatile__ ("hlt");
+    }
+}
+
+/*******************************************************************************
+Default Interrupt Handler Function
+Unhandled interrupts are ignored.
+*******************************************************************************/
+static void Default_Interrupt_Handler (interrupt_frame* frame) {
+    (void)frame;
+}
+
+/*******************************************************************************
+Record Interrupt Latency Function
+*******************************************************************************/
+static void Record_Interrupt_Latency (uint64_t vector, uint64_t cycles) {
+
+    interrupt_latency_statistics* statistics = &idt_latency_statistics[vector];
+
+    __atomic_add_fetch(&statistics->count,        1,      __ATOMIC_RELAXED);
+    __atomic_add_fetch(&statistics->total_cycles, cycles, __ATOMIC_RELAXED);
+
+    uint64_t min_cycles = __atomic_load_n(&statistics->min_cycles, __ATOMIC_RELAXED);
+    while ((cycles < min_cycles) &&
+           (!__atomic_compare_exchange_n(&statistics->min_cycles, &min_cycles, cycles, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
+
+    uint64_t max_cycles = __atomic_load_n(&statistics->max_cycles, __ATOMIC_RELAXED);
+    while ((cycles > max_cycles) &&
+           (!__atomic_compare_exchange_n(&statistics->max_cycles, &max_cycles, cycles, true, __ATOMIC_RELAXED, __ATOMIC_RELAXED)));
+
+}
+
+/*******************************************************************************
+Interrupt Dispatch Function
+Called by the common entry stub. Records the entry latency and calls the
+vector's handler straight from the handler table, then the exit hook. Used,
+since link time optimization does not see the call from assembly.
+*******************************************************************************/
+extern "C" __attribute__((used)) void interrupt_dispatch (interrupt_frame* frame) {
+
+    uint64_t handler_tsc = read_tsc();
+
+    interrupt_handler handler = __atomic_load_n(&idt_handler_table[frame->vector], __ATOMIC_ACQUIRE);
+
+    Record_Interrupt_Latency(frame->vector, handler_tsc - frame->entry_tsc);
+
+    handler(frame);
+
+    interrupt_handler exit_hook = __atomic_load_n(&idt_exit_hook, __ATOMIC_ACQUIRE);
+    if (exit_hook != nullptr) {
+        exit_hook(frame);
+    }
+
+}
+
+/*******************************************************************************
+Initialize Interrupt Descriptor Table Function (Constructor)
+Point every vector at its stub, give #DF, NMI and #MC their own interrupt stack
+table stacks and install the default handlers.
+*******************************************************************************/
+Interrupt_Descriptor_Table::Interrupt_Descriptor_Table () {
+
+    for (uint64_t vector = 0; vector < IDT_NUM_OF_VECTORS; vector++) {
+
+        uint8_t ist = 0;
+        if (vector == IDT_VECTOR_DOUBLE_FAULT) {
+            ist = GDT_IST_DOUBLE_FAULT;
+        } else if (vector == IDT_VECTOR_NMI) {
+            ist = GDT_IST_NMI;
+        } else if (vector == IDT_VECTOR_MACHINE_CHECK) {
+            ist = GDT_IST_MACHINE_CHECK;
+        }
+
+        set_gate((uint8_t)vector, (uint64_t)&interrupt_stubs[vector * IDT_STUB_SIZE], ist);
+
+        idt_handler_table[vector] = (vector < IDT_NUM_OF_EXCEPTION_VECTORS) ? Default_Exception_Handler : Default_Interrupt_Handler;
+
+        idt_latency_statistics[vector].count        = 0;
+        idt_latency_statistics[vector].total_cycles = 0;
+        idt_latency_statistics[vector].min_cycles   = UINT64_MAX;
+        idt_latency_statistics[vector].max_cycles   = 0;
+
+    }
+
+    idt_exit_hook = nullptr;
+
+}
+
+/*******************************************************************************
+Load Function
+Load the IDT into the executing processor's IDT register.
+*******************************************************************************/
+void Interrupt_Descriptor_Table::load () {
+
+    descriptor_table_register idtr;
+    idtr.limit = sizeof(m_gates) - 1;
+    idtr.base  = (uint64_t)m_gates;
+
+    __asm__ __volatile__ (
+        "lidt %0"
+        : /* No output. */
+        : "m"(idtr)
+        : "memory"
+    );
+
+}
+
+/*******************************************************************************
+Register Handler Function
+Install the handler of a vector. Returns false if the vector already has a
+handler other than the default one.
+*******************************************************************************/
+bool Interrupt_Descriptor_Table::register_handler (uint8_t vector, interrupt_handler handler) {
+
+    interrupt_handler current = __atomic_load_n(&idt_handler_table[vector], __ATOMIC_ACQUIRE);
+
+    if ((current != Default_Exception_Handler) && (current != Default_Interrupt_Handler)) {
+        return false;
+    }
+
+    return __atomic_compare_exchange_n(&idt_handler_table[vector], &current, handler, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED);
+
+}
+
+/*******************************************************************************
+Unregister Handler Function
+Restore the default handler of a vector.
+*******************************************************************************/
+void Interrupt_Descriptor_Table::unregister_handler (uint8_t vector) {
+
+    interrupt_handler handler = (vector < IDT_NUM_OF_EXCEPTION_VECTORS) ? Default_Exception_Handler : Default_Interrupt_Handler;
+
+    __atomic_store_n(&idt_handler_table[vector], handler, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Set Exit Hook Function
+
+Install a function called on the way out of every interrupt and exception,
+after the vector's handler, with interrupts still disabled. Interrupt gates
+keep external interrupts from nesting, but exceptions and NMIs can still arrive
+inside a handler or any region with interrupts disabled, and NMI, #DF and #MC
+run on IST stacks. The hook has to check the frame's vector and saved RFLAGS
+before doing anything like switching threads.
+*******************************************************************************/
+void Interrupt_Descriptor_Table::set_exit_hook (interrupt_handler hook) {
+    __atomic_store_n(&idt_exit_hook, hook, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+Get Latency Statistics Function
+*******************************************************************************/
+void Interrupt_Descriptor_Table::get_latency_statistics (uint8_t vector, interrupt_latency_statistics* statistics) {
+
+    statistics->count        = __atomic_load_n(&idt_latency_statistics[vector].count,        __ATOMIC_RELAXED);
+    statistics->total_cycles = __atomic_load_n(&idt_latency_statistics[vector].total_cycles, __ATOMIC_RELAXED);
+    statistics->min_cycles   = __atomic_load_n(&idt_latency_statistics[vector].min_cycles,   __ATOMIC_RELAXED);
+    statistics->max_cycles   = __atomic_load_n(&idt_latency_statistics[vector].max_cycles,   __ATOMIC_RELAXED);
+
+}
+
+/*******************************************************************************
+Set Gate Function
+*******************************************************************************/
+void Interrupt_Descriptor_Table::set_gate (uint8_t vector, uint64_t handler_address, uint8_t ist) {
+
+    interrupt_descriptor_table_gate* gate = &m_gates[vector];
+
+    gate->offset_low       = (uint16_t)(handler_address & 0xFFFF);
+    gate->segment_selector = GDT_KERNEL_CODE_SELECTOR;
+    gate->ist              = ist;
+    gate->type_attributes  = IDT_INTERRUPT_GATE_TYPE;
+    gate->offset_middle    = (uint16_t)((handler_address >> 16) & 0xFFFF);
+    gate->offset_high      = (uint32_t)(handler_address >> 32);
+    gate->reserved         = 0;
+
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <stdint.h>
+
+#define IDT_NUM_OF_VECTORS              256
+#define IDT_NUM_OF_EXCEPTION_VECTORS    32
+#define IDT_STUB_SIZE                   16
+
+#define IDT_VECTOR_DIVIDE_ERROR         0
+#define IDT_VECTOR_NMI                  2
+#define IDT_VECTOR_DEVICE_NOT_AVAILABLE 7
+#define IDT_VECTOR_DOUBLE_FAULT         8
+#define IDT_VECTOR_GENERAL_PROTECTION   13
+#define IDT_VECTOR_PAGE_FAULT           14
+#define IDT_VECTOR_MACHINE_CHECK        18
+
+/* Register state saved on interrupt entry, lowest address first. The stubs save
+only the registers a C handler may clobber (callee-saved registers other than
+rbp are preserved by the handler itself) plus rbp for frame pointer walks. */
+typedef struct {
+    uint64_t entry_tsc;
+    uint64_t rbp;
+    uint64_t r11;
+    uint64_t r10;
+    uint64_t r9;
+    uint64_t r8;
+    uint64_t rdi;
+    uint64_t rsi;
+    uint64_t rdx;
+    uint64_t rcx;
+    uint64_t rax;
+    uint64_t vector;
+    uint64_t error_code;
+    uint64_t rip;
+    uint64_t cs;
+    uint64_t rflags;
+    uint64_t rsp;
+    uint64_t ss;
+} interrupt_frame;
+
+/* Handlers run with interrupts disabled. Vector registers are not saved by the
+stubs, so handlers must not touch them. */
+typedef void (*interrupt_handler) (interrupt_frame* frame);
+
+/* Cycles from the stub taking the entry timestamp to the handler being called,
+per vector. */
+typedef struct {
+    uint64_t count;
+    uint64_t total_cycles;
+    uint64_t min_cycles;
+    uint64_t max_cycles;
+} interrupt_latency_statistics;
+
+typedef struct {
+    uint16_t offset_low;
+    uint16_t segment_selector;
+    uint8_t  ist;
+    uint8_t  type_attributes;
+    uint16_t offset_middle;
+    uint32_t offset_high;
+    uint32_t reserved;
+} __attribute__((packed)) interrupt_descriptor_table_gate;
+
+class Interrupt_Descriptor_Table {
+
+    public:
+
+        Interrupt_Descriptor_Table ();
+        void load                   ();
+        bool register_handler       (uint8_t vector, interrupt_handler handler);
+        void unregister_handler     (uint8_t vector);
+        void set_exit_hook          (interrupt_handler hook);
+        void get_latency_statistics (uint8_t vector, interrupt_latency_statistics* statistics);
+
+    private:
+
+        interrupt_descriptor_table_gate m_gates[IDT_NUM_OF_VECTORS] __attribute__((aligned(16)));
+
+        void set_gate (uint8_t vector, uint64_t handler_address, uint8_t ist);
+
+};
@@ -0,0 +1,174 @@
+#include "io_apic.h"
+#include "../acpi/acpi.h"
+#include "../../shared/memory/paging.h"
+
+#define IO_APIC_VERSION_MAX_ENTRY_SHIFT 16
+#define IO_APIC_VERSION_MAX_ENTRY_MASK  0xFF
+
+// MADT interrupt source override flags (MPS INTI flags).
+#define ACPI_INTI_POLARITY_MASK         0x3
+#define ACPI_INTI_POLARITY_ACTIVE_LOW   0x3
+#define ACPI_INTI_TRIGGER_MASK          0xC
+#define ACPI_INTI_TRIGGER_LEVEL         0xC
+
+static io_apic  io_apics[ACPI_MAX_NUM_OF_IO_APICS];
+static uint64_t io_apic_count;
+
+/*******************************************************************************
+IO APIC Read Function
+*******************************************************************************/
+static uint32_t IO_APIC_Read (io_apic* apic, uint32_t reg) {
+    apic->mmio_base[IO_APIC_REGISTER_SELECT / 4] = reg;
+    return apic->mmio_base[IO_APIC_REGISTER_WINDOW / 4];
+}
+
+/*******************************************************************************
+IO APIC Write Function
+*******************************************************************************/
+static void IO_APIC_Write (io_apic* apic, uint32_t reg, uint32_t value) {
+    apic->mmio_base[IO_APIC_REGISTER_SELECT / 4] = reg;
+    apic->mmio_base[IO_APIC_REGISTER_WINDOW / 4] = value;
+}
+
+/*******************************************************************************
+Write Redirection Entry Function
+Masked while the high half changes, so it never fires with a stale destination.
+*******************************************************************************/
+static void Write_Redirection_Entry (io_apic* apic, uint32_t entry, uint64_t value) {
+    IO_APIC_Write(apic, IO_APIC_REDIRECTION_TABLE_REGISTER + (entry * 2),     (uint32_t)IO_APIC_REDIRECTION_MASKED);
+    IO_APIC_Write(apic, IO_APIC_REDIRECTION_TABLE_REGISTER + (entry * 2) + 1, (uint32_t)(value >> 32));
+    IO_APIC_Write(apic, IO_APIC_REDIRECTION_TABLE_REGISTER + (entry * 2),     (uint32_t)value);
+}
+
+/*******************************************************************************
+Legacy IRQ To Global System Interrupt Function
+
+Apply the MADT's interrupt source overrides. ISA interrupts default to the same
+numbered global system interrupt, edge triggered and active high.
+*******************************************************************************/
+static uint32_t Legacy_IRQ_To_Global_System_Interrupt (uint8_t irq, uint64_t* flags) {
+
+    const acpi_tables* acpi = get_acpi_tables();
+
+    *flags = 0;
+
+    for (uint64_t idx = 0; idx < acpi->num_of_interrupt_overrides; idx++) {
+
+        const acpi_interrupt_override* override = &acpi->interrupt_overrides[idx];
+        if ((override->bus != 0) || (override->source_irq != irq)) {
+            continue;
+        }
+
+        if ((override->flags & ACPI_INTI_POLARITY_MASK) == ACPI_INTI_POLARITY_ACTIVE_LOW) {
+            *flags |= IO_APIC_REDIRECTION_ACTIVE_LOW;
+        }
+        if ((override->flags & ACPI_INTI_TRIGGER_MASK) == ACPI_INTI_TRIGGER_LEVEL) {
+            *flags |= IO_APIC_REDIRECTION_LEVEL_TRIGGERED;
+        }
+
+        return override->global_system_interrupt;
+
+    }
+
+    return irq;
+
+}
+
+/*******************************************************************************
+Find IO APIC Function
+The IO APIC serving a global system interrupt, nullptr if none does.
+*******************************************************************************/
+static io_apic* Find_IO_APIC (uint32_t global_system_interrupt) {
+
+    for (uint64_t idx = 0; idx < io_apic_count; idx++) {
+        io_apic* apic = &io_apics[idx];
+        if ((global_system_interrupt >= apic->global_system_interrupt_base) &&
+            (global_system_interrupt < (apic->global_system_interrupt_base + apic->num_of_redirection_entries))) {
+            return apic;
+        }
+    }
+
+    return nullptr;
+
+}
+
+/*******************************************************************************
+Initialize IO APICs Function
+
+Map every IO APIC in the MADT uncached through the VMM and mask all of its
+redirection entries, firmware may have left some enabled. Devices then route
+their interrupt explicitly. Returns false if there is no IO APIC or one could
+not be mapped.
+*******************************************************************************/
+bool Initialize_IO_APICs (Virtual_Memory_Manager* vmm) {
+
+    const acpi_tables* acpi = get_acpi_tables();
+
+    io_apic_count = 0;
+
+    for (uint64_t idx = 0; idx < acpi->num_of_io_apics; idx++) {
+
+        uint64_t address = acpi->io_apics[idx].address;
+
+        if (!vmm->map_page(address, address, PAGE_TABLES_ENTRY_READ_WRITE |
+                                             PAGE_TABLES_ENTRY_PAGE_LEVEL_WRITE_THROUGH |
+                                             PAGE_TABLES_ENTRY_PAGE_LEVEL_CACHE_DISABLE)) {
+            return false;
+        }
+
+        io_apic* apic                      = &io_apics[io_apic_count++];
+        apic->mmio_base                    = (volatile uint32_t*)address;
+        apic->id                           = acpi->io_apics[idx].id;
+        apic->global_system_interrupt_base = acpi->io_apics[idx].global_system_interrupt_base;
+        apic->num_of_redirection_entries   = ((IO_APIC_Read(apic, IO_APIC_VERSION_REGISTER) >> IO_APIC_VERSION_MAX_ENTRY_SHIFT) & IO_APIC_VERSION_MAX_ENTRY_MASK) + 1;
+
+        for (uint32_t entry = 0; entry < apic->num_of_redirection_entries; entry++) {
+            Write_Redirection_Entry(apic, entry, IO_APIC_REDIRECTION_MASKED);
+        }
+
+    }
+
+    return (io_apic_count != 0);
+
+}
+
+/*******************************************************************************
+IO APIC Route Legacy IRQ Function
+Deliver an ISA IRQ as a fixed interrupt on the given vector to one processor,
+honouring the MADT's overrides. Returns false if no IO APIC serves it.
+*******************************************************************************/
+bool io_apic_route_legacy_irq (uint8_t irq, uint8_t vector, uint32_t destination_apic_id) {
+
+    uint64_t flags;
+    uint32_t global_system_interrupt = Legacy_IRQ_To_Global_System_Interrupt(irq, &flags);
+
+    io_apic* apic = Find_IO_APIC(global_system_interrupt);
+    if (apic == nullptr) {
+        return false;
+    }
+
+    uint64_t entry = ((uint64_t)destination_apic_id << IO_APIC_REDIRECTION_DESTINATION_SHIFT) | flags | vector;
+    Write_Redirection_Entry(apic, global_system_interrupt - apic->global_system_interrupt_base, entry);
+
+    return true;
+
+}
+
+/*******************************************************************************
+IO APIC Mask Legacy IRQ Function
+*******************************************************************************/
+bool io_apic_mask_legacy_irq (uint8_t irq) {
+
+    uint64_t flags;
+    uint32_t global_system_interrupt = Legacy_IRQ_To_Global_System_Interrupt(irq, &flags);
+
+    io_apic* apic = Find_IO_APIC(global_system_interrupt);
+    if (apic == nullptr) {
+        return false;
+    }
+
+    Write_Redirection_Entry(apic, global_system_interrupt - apic->global_system_interrupt_base, IO_APIC_REDIRECTION_MASKED);
+
+    return true;
+
+}
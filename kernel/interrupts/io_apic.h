@@ -0,0 +1,31 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/virtual_memory_manager.h"
+
+#define IO_APIC_LEGACY_VECTOR_BASE  0x40 // ISA IRQ n arrives on vector base + n.
+#define IO_APIC_NUM_OF_LEGACY_IRQS  16
+
+// Register select and data window offsets in the MMIO page.
+#define IO_APIC_REGISTER_SELECT     0x00
+#define IO_APIC_REGISTER_WINDOW     0x10
+
+#define IO_APIC_ID_REGISTER                 0x00
+#define IO_APIC_VERSION_REGISTER            0x01
+#define IO_APIC_REDIRECTION_TABLE_REGISTER  0x10 // Two registers per entry.
+
+// Redirection entry fields.
+#define IO_APIC_REDIRECTION_ACTIVE_LOW        (1ULL << 13)
+#define IO_APIC_REDIRECTION_LEVEL_TRIGGERED   (1ULL << 15)
+#define IO_APIC_REDIRECTION_MASKED            (1ULL << 16)
+#define IO_APIC_REDIRECTION_DESTINATION_SHIFT 56
+
+typedef struct {
+    volatile uint32_t* mmio_base;
+    uint32_t           id;
+    uint32_t           global_system_interrupt_base;
+    uint32_t           num_of_redirection_entries;
+} io_apic;
+
+bool Initialize_IO_APICs      (Virtual_Memory_Manager* vmm);
+bool io_apic_route_legacy_irq (uint8_t irq, uint8_t vector, uint32_t destination_apic_id);
+bool io_apic_mask_legacy_irq  (uint8_t irq);
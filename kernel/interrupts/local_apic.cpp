@@ -0,0 +1,373 @@
+#include "local_apic.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+#include "../../shared/assembly_wrappers/port_io.h"
+#include "../../shared/memory/paging.h"
+#include "../../shared/math/uint128.h"
+
+#define CPUID_FEATURES_LEAF               0x00000001
+#define CPUID_FEATURES_EDX_APIC           (1U << 9)
+#define CPUID_FEATURES_ECX_X2APIC         (1U << 21)
+#define CPUID_FEATURES_ECX_TSC_DEADLINE   (1U << 24)
+#define CPUID_TOPOLOGY_LEAF               0x0000000B
+
+#define IA32_APIC_BASE_MSR                0x1B
+#define IA32_APIC_BASE_X2APIC_ENABLE      (1ULL << 10)
+#define IA32_APIC_BASE_GLOBAL_ENABLE      (1ULL << 11)
+#define IA32_APIC_BASE_ADDRESS_MASK       0x000FFFFFFFFFF000ULL
+#define IA32_TSC_DEADLINE_MSR             0x6E0
+#define X2APIC_MSR_BASE                   0x800
+#define X2APIC_ICR_MSR                    0x830
+
+#define LOCAL_APIC_SPURIOUS_ENABLE        (1U << 8)
+#define LOCAL_APIC_LVT_MASKED             (1U << 16)
+#define LOCAL_APIC_LVT_TIMER_PERIODIC     (1U << 17)
+#define LOCAL_APIC_LVT_TIMER_TSC_DEADLINE (2U << 17)
+#define LOCAL_APIC_TIMER_DIVIDE_BY_1      0xB
+#define LOCAL_APIC_TIMER_MAX_COUNT        0xFFFFFFFFULL
+
+// Legacy 8259 programmable interrupt controllers.
+#define PIC_MASTER_COMMAND_PORT          0x20
+#define PIC_MASTER_DATA_PORT             0x21
+#define PIC_SLAVE_COMMAND_PORT           0xA0
+#define PIC_SLAVE_DATA_PORT              0xA1
+#define PIC_ICW1_INIT_WITH_ICW4          0x11
+#define PIC_ICW4_8086_MODE               0x01
+#define PIC_MASK_ALL                     0xFF
+
+/*******************************************************************************
+Disable Legacy PIC Function
+
+Move the 8259 PICs off the exception vectors and mask every line. A masked PIC
+can still raise spurious IRQ 7/15, which now land on ignored vectors.
+*******************************************************************************/
+static void Disable_Legacy_PIC () {
+
+    outb(PIC_MASTER_COMMAND_PORT, PIC_ICW1_INIT_WITH_ICW4); io_wait();
+    outb(PIC_SLAVE_COMMAND_PORT,  PIC_ICW1_INIT_WITH_ICW4); io_wait();
+    outb(PIC_MASTER_DATA_PORT,    LEGACY_PIC_VECTOR_BASE);     io_wait();
+    outb(PIC_SLAVE_DATA_PORT,     LEGACY_PIC_VECTOR_BASE + 8); io_wait();
+    outb(PIC_MASTER_DATA_PORT,    4); io_wait(); // Slave on IRQ 2.
+    outb(PIC_SLAVE_DATA_PORT,     2); io_wait(); // Slave cascade identity.
+    outb(PIC_MASTER_DATA_PORT,    PIC_ICW4_8086_MODE); io_wait();
+    outb(PIC_SLAVE_DATA_PORT,     PIC_ICW4_8086_MODE); io_wait();
+
+    outb(PIC_MASTER_DATA_PORT, PIC_MASK_ALL);
+    outb(PIC_SLAVE_DATA_PORT,  PIC_MASK_ALL);
+
+}
+
+/*******************************************************************************
+Calibrate Local APIC Timer Function
+Count timer ticks at divide by 1 over a TSC measured period.
+*******************************************************************************/
+static void Calibrate_Local_APIC_Timer (local_apic* apic, const tsc_calibration* tsc) {
+
+    local_apic_write(apic, LOCAL_APIC_LVT_TIMER_REGISTER,    LOCAL_APIC_LVT_MASKED | LOCAL_APIC_TIMER_VECTOR);
+    local_apic_write(apic, LOCAL_APIC_TIMER_DIVIDE_REGISTER, LOCAL_APIC_TIMER_DIVIDE_BY_1);
+
+    const uint64_t PERIOD_CYCLES = (tsc->frequency_hz * LOCAL_APIC_TIMER_CALIBRATION_PERIOD_MS) / 1000;
+
+    local_apic_write(apic, LOCAL_APIC_TIMER_INITIAL_COUNT_REGISTER, (uint32_t)LOCAL_APIC_TIMER_MAX_COUNT);
+    uint64_t start_tsc = read_tsc();
+
+    uint64_t end_tsc = start_tsc;
+    while ((end_tsc - start_tsc) < PERIOD_CYCLES) {
+        end_tsc = read_tsc();
+    }
+
+    uint64_t ticks = LOCAL_APIC_TIMER_MAX_COUNT - local_apic_read(apic, LOCAL_APIC_TIMER_CURRENT_COUNT_REGISTER);
+    local_apic_write(apic, LOCAL_APIC_TIMER_INITIAL_COUNT_REGISTER, 0);
+
+    apic->timer_frequency_hz    = (ticks * tsc->frequency_hz) / (end_tsc - start_tsc);
+    apic->timer_ticks_per_ns_fp = ((apic->timer_frequency_hz / TSC_NANOSECONDS_PER_SECOND) << 32) +
+                                  (((apic->timer_frequency_hz % TSC_NANOSECONDS_PER_SECOND) << 32) / TSC_NANOSECONDS_PER_SECOND);
+
+}
+
+/*******************************************************************************
+Initialize Local APIC Function
+
+Enable the executing processor's local APIC, preferring x2APIC MSR access and
+falling back to the xAPIC MMIO page (mapped uncached through the VMM). The
+legacy PICs are masked and the timer is calibrated against the TSC and left
+stopped. Returns false if the processor has no local APIC or the MMIO page
+could not be mapped.
+*******************************************************************************/
+bool Initialize_Local_APIC (local_apic* apic, Virtual_Memory_Manager* vmm, const tsc_calibration* tsc) {
+
+    uint32_t eax, ebx, ecx, edx;
+    cpuid(CPUID_FEATURES_LEAF, 0, &eax, &ebx, &ecx, &edx);
+
+    if (!(edx & CPUID_FEATURES_EDX_APIC)) {
+        return false;
+    }
+
+    apic->x2apic                  = ((ecx & CPUID_FEATURES_ECX_X2APIC) != 0);
+    apic->tsc_deadline            = ((ecx & CPUID_FEATURES_ECX_TSC_DEADLINE) != 0);
+    apic->mmio_base               = nullptr;
+    apic->timer_mode              = local_apic_timer_stopped;
+    apic->num_of_timer_interrupts = 0;
+    apic->timer_callback          = nullptr;
+
+    Disable_Legacy_PIC();
+
+    uint64_t apic_base = read_msr(IA32_APIC_BASE_MSR);
+
+    if (apic->x2apic) {
+
+        write_msr(IA32_APIC_BASE_MSR, apic_base | IA32_APIC_BASE_GLOBAL_ENABLE | IA32_APIC_BASE_X2APIC_ENABLE);
+
+    } else {
+
+        uint64_t mmio_address = apic_base & IA32_APIC_BASE_ADDRESS_MASK;
+
+        if (!vmm->map_page(mmio_address, mmio_address, PAGE_TABLES_ENTRY_READ_WRITE |
+                                                       PAGE_TABLES_ENTRY_PAGE_LEVEL_WRITE_THROUGH |
+                                                       PAGE_TABLES_ENTRY_PAGE_LEVEL_CACHE_DISABLE)) {
+            return false;
+        }
+
+        write_msr(IA32_APIC_BASE_MSR, apic_base | IA32_APIC_BASE_GLOBAL_ENABLE);
+        apic->mmio_base = (volatile uint32_t*)mmio_address;
+
+    }
+
+    // Accept every priority and software enable the APIC.
+    local_apic_write(apic, LOCAL_APIC_TASK_PRIORITY_REGISTER,   0);
+    local_apic_write(apic, LOCAL_APIC_SPURIOUS_VECTOR_REGISTER, LOCAL_APIC_SPURIOUS_ENABLE | LOCAL_APIC_SPURIOUS_VECTOR);
+
+    Calibrate_Local_APIC_Timer(apic, tsc);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Local APIC Read Function
+*******************************************************************************/
+uint32_t local_apic_read (local_apic* apic, uint32_t reg) {
+
+    if (apic->x2apic) {
+        return (uint32_t)read_msr(X2APIC_MSR_BASE + (reg >> 4));
+    }
+
+    return apic->mmio_base[reg / sizeof(uint32_t)];
+
+}
+
+/*******************************************************************************
+Local APIC Write Function
+*******************************************************************************/
+void local_apic_write (local_apic* apic, uint32_t reg, uint32_t value) {
+
+    if (apic->x2apic) {
+        write_msr(X2APIC_MSR_BASE + (reg >> 4), value);
+        return;
+    }
+
+    apic->mmio_base[reg / sizeof(uint32_t)] = value;
+
+}
+
+/*******************************************************************************
+Local APIC Get ID Function
+*******************************************************************************/
+uint32_t local_apic_get_id (local_apic* apic) {
+
+    uint32_t id = local_apic_read(apic, LOCAL_APIC_ID_REGISTER);
+
+    // The xAPIC ID lives in the top byte, the x2APIC ID is the whole register.
+    return apic->x2apic ? id : (id >> 24);
+
+}
+
+/*******************************************************************************
+Local APIC Get Initial ID Function
+The executing processor's APIC ID as reported by CPUID, usable before its local
+APIC is initialized. Matches local_apic_get_id unless software changed the ID.
+*******************************************************************************/
+uint32_t local_apic_get_initial_id () {
+
+    uint32_t eax, ebx, ecx, edx;
+
+    // The topology leaf has the full 32-bit x2APIC ID, leaf 1 only 8 bits.
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= CPUID_TOPOLOGY_LEAF) {
+        cpuid(CPUID_TOPOLOGY_LEAF, 0, &eax, &ebx, &ecx, &edx);
+        if (ebx != 0) {
+            return edx;
+        }
+    }
+
+    cpuid(CPUID_FEATURES_LEAF, 0, &eax, &ebx, &ecx, &edx);
+
+    return (ebx >> 24);
+
+}
+
+/*******************************************************************************
+Local APIC End Of Interrupt Function
+*******************************************************************************/
+void local_apic_end_of_interrupt (local_apic* apic) {
+    local_apic_write(apic, LOCAL_APIC_EOI_REGISTER, 0);
+}
+
+/*******************************************************************************
+Local APIC Send IPI Function
+
+Send an inter-processor interrupt. The command holds the vector, delivery mode,
+level and destination shorthand; the destination APIC ID is ignored when a
+shorthand is used. In xAPIC mode waits for a previous IPI to be accepted first.
+*******************************************************************************/
+void local_apic_send_ipi (local_apic* apic, uint32_t destination_apic_id, uint32_t command) {
+
+    if (apic->x2apic) {
+        write_msr(X2APIC_ICR_MSR, (((uint64_t)destination_apic_id) << 32) | command);
+        return;
+    }
+
+    while (local_apic_read(apic, LOCAL_APIC_INTERRUPT_COMMAND_REGISTER) & LOCAL_APIC_ICR_DELIVERY_PENDING) {
+        __asm__ __volatile__ ("pause");
+    }
+
+    // Writing the low half sends the IPI, so the destination goes first.
+    local_apic_write(apic, LOCAL_APIC_INTERRUPT_COMMAND_HIGH_REGISTER, destination_apic_id << 24);
+    local_apic_write(apic, LOCAL_APIC_INTERRUPT_COMMAND_REGISTER,      command);
+
+}
+
+/*******************************************************************************
+Set Timer Mode Function
+Reprogram the LVT timer entry only when the mode changes.
+*******************************************************************************/
+static void Set_Timer_Mode (local_apic* apic, local_apic_timer_mode mode) {
+
+    if (apic->timer_mode == mode) {
+        return;
+    }
+
+    uint32_t lvt = LOCAL_APIC_TIMER_VECTOR;
+    if (mode == local_apic_timer_periodic) {
+        lvt |= LOCAL_APIC_LVT_TIMER_PERIODIC;
+    } else if (mode == local_apic_timer_tsc_deadline) {
+        lvt |= LOCAL_APIC_LVT_TIMER_TSC_DEADLINE;
+    } else if (mode == local_apic_timer_stopped) {
+        lvt |= LOCAL_APIC_LVT_MASKED;
+    }
+
+    local_apic_write(apic, LOCAL_APIC_LVT_TIMER_REGISTER, lvt);
+    apic->timer_mode = mode;
+
+    /* The LVT write must be seen before the first IA32_TSC_DEADLINE write,
+    otherwise the deadline may be dropped. */
+    if (mode == local_apic_timer_tsc_deadline) {
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    }
+
+}
+
+/*******************************************************************************
+Nanoseconds To Timer Ticks Function
+Clamped to the 32-bit count register; a delay that does not fit fires early and
+is expected to be re-armed by the caller.
+*******************************************************************************/
+static uint32_t Nanoseconds_To_Timer_Ticks (local_apic* apic, uint64_t ns) {
+
+    uint64_t ticks = (uint64_t)(((uint128_t)ns * apic->timer_ticks_per_ns_fp) >> 32);
+
+    if (ticks == 0) {
+        return 1;
+    }
+
+    if (ticks > LOCAL_APIC_TIMER_MAX_COUNT) {
+        return (uint32_t)LOCAL_APIC_TIMER_MAX_COUNT;
+    }
+
+    return (uint32_t)ticks;
+
+}
+
+/*******************************************************************************
+Local APIC Timer Start Periodic Function
+*******************************************************************************/
+void local_apic_timer_start_periodic (local_apic* apic, uint64_t period_ns) {
+
+    Set_Timer_Mode(apic, local_apic_timer_periodic);
+    local_apic_write(apic, LOCAL_APIC_TIMER_INITIAL_COUNT_REGISTER, Nanoseconds_To_Timer_Ticks(apic, period_ns));
+
+}
+
+/*******************************************************************************
+Local APIC Timer Arm One-Shot Function
+*******************************************************************************/
+void local_apic_timer_arm_one_shot (local_apic* apic, uint64_t delay_ns) {
+
+    Set_Timer_Mode(apic, local_apic_timer_one_shot);
+    local_apic_write(apic, LOCAL_APIC_TIMER_INITIAL_COUNT_REGISTER, Nanoseconds_To_Timer_Ticks(apic, delay_ns));
+
+}
+
+/*******************************************************************************
+Local APIC Timer Arm TSC Deadline Function
+Fire once the TSC reaches the given value. Requires TSC-deadline support.
+*******************************************************************************/
+void local_apic_timer_arm_tsc_deadline (local_apic* apic, uint64_t tsc_deadline) {
+
+    Set_Timer_Mode(apic, local_apic_timer_tsc_deadline);
+
+    // Writing zero disarms the timer, a deadline already passed fires at once.
+    write_msr(IA32_TSC_DEADLINE_MSR, (tsc_deadline == 0) ? 1 : tsc_deadline);
+
+}
+
+/*******************************************************************************
+Local APIC Timer Set Deadline Function
+
+Fire once at the given monotonic time, used to program the next expiry of a
+timer queue instead of taking fixed-rate ticks. Uses TSC-deadline mode when
+available and falls back to a one-shot countdown.
+*******************************************************************************/
+void local_apic_timer_set_deadline (local_apic* apic, const tsc_calibration* tsc, uint64_t deadline_ns) {
+
+    if (apic->tsc_deadline) {
+        local_apic_timer_arm_tsc_deadline(apic, tsc_monotonic_ns_to_tsc(tsc, deadline_ns));
+        return;
+    }
+
+    uint64_t now_ns = tsc_cycles_to_ns(tsc, read_tsc() - tsc->base_tsc);
+    local_apic_timer_arm_one_shot(apic, (deadline_ns > now_ns) ? (deadline_ns - now_ns) : 0);
+
+}
+
+/*******************************************************************************
+Local APIC Timer Stop Function
+*******************************************************************************/
+void local_apic_timer_stop (local_apic* apic) {
+
+    if (apic->timer_mode == local_apic_timer_tsc_deadline) {
+        write_msr(IA32_TSC_DEADLINE_MSR, 0);
+    }
+
+    local_apic_write(apic, LOCAL_APIC_TIMER_INITIAL_COUNT_REGISTER, 0);
+    Set_Timer_Mode(apic, local_apic_timer_stopped);
+
+}
+
+/*******************************************************************************
+Local APIC Timer Handler Function
+Acknowledge the interrupt before running the callback, which may re-arm the
+timer or switch away from the interrupted context.
+*******************************************************************************/
+void Local_APIC_Timer_Handler (interrupt_frame* frame) {
+
+    local_apic* apic = &get_per_cpu_data()->apic;
+
+    apic->num_of_timer_interrupts++;
+    local_apic_end_of_interrupt(apic);
+
+    if (apic->timer_callback != nullptr) {
+        apic->timer_callback(frame);
+    }
+
+}
@@ -0,0 +1,72 @@
+#pragma once
+#include <stdint.h>
+#include "interrupt_descriptor_table.h"
+#include "../time/time_stamp_counter.h"
+#include "../memory/virtual_memory_manager.h"
+
+#define LOCAL_APIC_TIMER_VECTOR     0x30
+#define LOCAL_APIC_SPURIOUS_VECTOR  0xFF
+#define LEGACY_PIC_VECTOR_BASE      0xE0 // Masked, only spurious IRQs 7/15 can land here.
+
+// Register offsets in the xAPIC MMIO page. x2APIC MSRs are 0x800 + (offset >> 4).
+#define LOCAL_APIC_ID_REGISTER                      0x020
+#define LOCAL_APIC_VERSION_REGISTER                 0x030
+#define LOCAL_APIC_TASK_PRIORITY_REGISTER           0x080
+#define LOCAL_APIC_EOI_REGISTER                     0x0B0
+#define LOCAL_APIC_SPURIOUS_VECTOR_REGISTER         0x0F0
+#define LOCAL_APIC_INTERRUPT_COMMAND_REGISTER       0x300
+#define LOCAL_APIC_INTERRUPT_COMMAND_HIGH_REGISTER  0x310
+#define LOCAL_APIC_LVT_TIMER_REGISTER               0x320
+#define LOCAL_APIC_TIMER_INITIAL_COUNT_REGISTER     0x380
+#define LOCAL_APIC_TIMER_CURRENT_COUNT_REGISTER     0x390
+#define LOCAL_APIC_TIMER_DIVIDE_REGISTER            0x3E0
+
+#define LOCAL_APIC_TIMER_CALIBRATION_PERIOD_MS 10
+
+// Interrupt command register fields.
+#define LOCAL_APIC_ICR_DELIVERY_FIXED              (0U << 8)
+#define LOCAL_APIC_ICR_DELIVERY_NMI                (4U << 8)
+#define LOCAL_APIC_ICR_DELIVERY_INIT               (5U << 8)
+#define LOCAL_APIC_ICR_DELIVERY_STARTUP            (6U << 8)
+#define LOCAL_APIC_ICR_DELIVERY_PENDING            (1U << 12)
+#define LOCAL_APIC_ICR_LEVEL_ASSERT                (1U << 14)
+#define LOCAL_APIC_ICR_DESTINATION_SELF            (1U << 18)
+#define LOCAL_APIC_ICR_DESTINATION_ALL             (2U << 18)
+#define LOCAL_APIC_ICR_DESTINATION_ALL_BUT_SELF    (3U << 18)
+
+typedef enum {
+    local_apic_timer_stopped,
+    local_apic_timer_periodic,
+    local_apic_timer_one_shot,
+    local_apic_timer_tsc_deadline
+} local_apic_timer_mode;
+
+typedef void (*local_apic_timer_callback) (interrupt_frame* frame);
+
+// State of one processor's local APIC, kept in its per-CPU data.
+typedef struct {
+    volatile uint32_t*        mmio_base;             // Unused in x2APIC mode.
+    bool                      x2apic;
+    bool                      tsc_deadline;          // TSC-deadline timer mode supported.
+    uint64_t                  timer_frequency_hz;    // Timer ticks per second at divide by 1.
+    uint64_t                  timer_ticks_per_ns_fp; // 32.32 fixed point.
+    local_apic_timer_mode     timer_mode;
+    uint64_t                  num_of_timer_interrupts;
+    local_apic_timer_callback timer_callback;        // Called on every timer interrupt, may be nullptr.
+} local_apic;
+
+bool     Initialize_Local_APIC       (local_apic* apic, Virtual_Memory_Manager* vmm, const tsc_calibration* tsc);
+uint32_t local_apic_read             (local_apic* apic, uint32_t reg);
+void     local_apic_write            (local_apic* apic, uint32_t reg, uint32_t value);
+uint32_t local_apic_get_id           (local_apic* apic);
+uint32_t local_apic_get_initial_id   ();
+void     local_apic_end_of_interrupt (local_apic* apic);
+void     local_apic_send_ipi         (local_apic* apic, uint32_t destination_apic_id, uint32_t command);
+
+void local_apic_timer_start_periodic   (local_apic* apic, uint64_t period_ns);
+void local_apic_timer_arm_one_shot     (local_apic* apic, uint64_t delay_ns);
+void local_apic_timer_arm_tsc_deadline (local_apic* apic, uint64_t tsc_deadline);
+void local_apic_timer_set_deadline     (local_apic* apic, const tsc_calibration* tsc, uint64_t deadline_ns);
+void local_apic_timer_stop             (local_apic* apic);
+
+void Local_APIC_Timer_Handler (interrupt_frame* frame);
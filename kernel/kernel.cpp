@@ -2,20 +2,215 @@
 #include "../shared/uefi/uefi_memory_map.h"
 #include "../shared/kernel_handover.h"
 #include "memory/physical_memory_manager.h"
+#include "memory/virtual_memory_manager.h"
+#include "memory/tlb_shootdown.h"
+#include "memory/kernel_relocation.h"
+#include "acpi/acpi.h"
+#include "cpu/per_cpu.h"
+#include "cpu/smp.h"
+#include "cpu/global_descriptor_table.h"
+#include "cpu/fpu.h"
+#include "interrupts/interrupt_descriptor_table.h"
+#include "time/time_stamp_counter.h"
+#include "interrupts/local_apic.h"
+#include "interrupts/io_apic.h"
+#include "drivers/serial_port.h"
+#include "log/kernel_log.h"
+#include "trace/kernel_trace.h"
+#include "profiler/sampling_profiler.h"
+#include "profiler/edge_profile.h"
+#include "benchmark/benchmark.h"
+#include "benchmark/kernel_benchmarks.h"
+#include "time/timer_wheel.h"
+#include "scheduler/scheduler.h"
+#include "executor/executor.h"
+#include "synchronization/rcu.h"
 #include "../shared/graphics/fonts/pc_screen_font_v1_renderer.h"
+#include "../shared/graphics/framebuffer.h"
 #include "../shared/assembly_wrappers/registers.h"
 
+// COM1, nullptr if there is none. The kernel log drains to it.
+static serial_port* kernel_serial_port;
+
+#ifdef KERNEL_BENCHMARKS
+/*******************************************************************************
+Unsigned To String Function
+Write the decimal digits of value and a terminating zero, buffer needs 21 bytes.
+*******************************************************************************/
+static char* Unsigned_To_String (uint64_t value, char* buffer) {
+
+    char digits[20];
+    uint64_t num_of_digits = 0;
+
+    do {
+        digits[num_of_digits++] = (char)('0' + (value % 10));
+        value /= 10;
+    } while (value != 0);
+
+    for (uint64_t idx = 0; idx < num_of_digits; idx++) {
+        buffer[idx] = digits[num_of_digits - 1 - idx];
+    }
+    buffer[num_of_digits] = '\0';
+
+    return buffer;
+
+}
+
+/*******************************************************************************
+Print Benchmark Function
+Print a label with two figures on the line below it, and log them.
+*******************************************************************************/
+static void Print_Benchmark (PC_Screen_Font_v1_Renderer* font_renderer, const char* label, uint64_t first, uint64_t second, uint64_t y) {
+
+    char number[21];
+
+    font_renderer->print_string(0x00000000, (char*)label, 10, y);
+    font_renderer->print_string(0x00000000, Unsigned_To_String(first, number), 10, y + 20);
+    font_renderer->print_string(0x00000000, Unsigned_To_String(second, number), 200, y + 20);
+
+    kernel_log("%s %u %u", label, first, second);
+
+}
+
+/*******************************************************************************
+Report Benchmark Results Function
+Print and log the figures the multi-phase benchmarks measured themselves.
+*******************************************************************************/
+static void Report_Benchmark_Results (PC_Screen_Font_v1_Renderer* font_renderer, const kernel_benchmark_results* results) {
+
+    char number[21];
+
+    // Context switch cost, min and average cycles per switch.
+    if (results->context_switch_ran) {
+        Print_Benchmark(font_renderer, "Context switch cycles min/avg:", results->context_switch.min_switch_cycles, results->context_switch.average_switch_cycles, 30);
+    }
+
+    // Serial against work-stealing parallel cycles.
+    if (results->parallel_fill_ran) {
+        Print_Benchmark(font_renderer, "Framebuffer fill cycles serial/parallel:", results->parallel_fill.serial_cycles, results->parallel_fill.parallel_cycles, 70);
+    }
+    if (results->frame_scrub_ran) {
+        Print_Benchmark(font_renderer, "Frame scrub cycles serial/parallel:", results->frame_scrub.serial_cycles, results->frame_scrub.parallel_cycles, 110);
+    }
+
+    // Fastest copy variant and its aligned cycles per size, where the crossovers are.
+    if (results->memory_operations_ran) {
+        const memory_operations_benchmark_result* memory_benchmark = &results->memory_operations;
+        font_renderer->print_string(0x00000000, (char*)"memcpy fastest variant per size:", 10, 150);
+        kernel_log("memcpy fastest variant per size:");
+        for (uint64_t size_idx = 0; size_idx < MEMORY_BENCHMARK_NUM_OF_SIZES; size_idx++) {
+            uint64_t y = 170 + (size_idx * 20);
+            memory_variant fastest = memory_benchmark->fastest_copy[size_idx];
+            font_renderer->print_string(0x00000000, Unsigned_To_String(memory_benchmark->sizes[size_idx], number), 10, y);
+            font_renderer->print_string(0x00000000, (char*)memory_variant_name(fastest), 120, y);
+            font_renderer->print_string(0x00000000, Unsigned_To_String(memory_benchmark->copy_cycles[fastest][size_idx][0], number), 250, y);
+            kernel_log("%u %s %u", memory_benchmark->sizes[size_idx], memory_variant_name(fastest), memory_benchmark->copy_cycles[fastest][size_idx][0]);
+        }
+    }
+
+    // Cycles per acquisition with every processor contending, average and slowest thread.
+    if (results->lock_contention_ran) {
+        const lock_contention_benchmark_result* lock_benchmark = &results->lock_contention;
+        font_renderer->print_string(0x00000000, (char*)"Lock cycles avg/slowest, threads:", 10, 340);
+        font_renderer->print_string(0x00000000, Unsigned_To_String(lock_benchmark->num_of_threads, number), 300, 340);
+        kernel_log("Lock cycles avg/slowest, %u threads, %u acquisitions each:", lock_benchmark->num_of_threads, lock_benchmark->num_of_acquisitions);
+        for (uint64_t kind = 0; kind < LOCK_BENCHMARK_NUM_OF_KINDS; kind++) {
+            uint64_t y = 360 + (kind * 20);
+            font_renderer->print_string(0x00000000, (char*)lock_benchmark_kind_name((lock_benchmark_kind)kind), 10, y);
+            font_renderer->print_string(0x00000000, Unsigned_To_String(lock_benchmark->average_cycles[kind], number), 120, y);
+            font_renderer->print_string(0x00000000, Unsigned_To_String(lock_benchmark->slowest_thread_cycles[kind], number), 250, y);
+            kernel_log("%s %u %u%s", lock_benchmark_kind_name((lock_benchmark_kind)kind), lock_benchmark->average_cycles[kind], lock_benchmark->slowest_thread_cycles[kind],
+                       lock_benchmark->mutual_exclusion_held[kind] ? "" : " BROKEN");
+            if (!lock_benchmark->mutual_exclusion_held[kind]) {
+                font_renderer->print_string(0x00000000, (char*)"BROKEN", 380, y);
+            }
+        }
+    }
+}
+#endif
+
+/*******************************************************************************
+Log Boot Timing Function
+Log when each boot phase first started after uefi_main and how long its runs
+took in total, in microseconds, then the time taken to reach the idle loop.
+*******************************************************************************/
+static void Log_Boot_Timing (const boot_timing* timing, const tsc_calibration* tsc) {
+
+    kernel_log("Boot phase, start us, duration us, runs:");
+
+    for (uint64_t idx = 0; idx < BOOT_NUM_OF_PHASES; idx++) {
+
+        const boot_phase_timing* phase = &timing->phases[idx];
+        if (phase->num_of_runs == 0) {
+            continue;
+        }
+
+        kernel_log("%s %u %u %u", boot_phase_name((boot_phase)idx),
+                   tsc_cycles_to_ns(tsc, phase->first_start_tsc - timing->uefi_main_tsc) / 1000,
+                   tsc_cycles_to_ns(tsc, phase->total_cycles) / 1000,
+                   phase->num_of_runs);
+
+    }
+
+    kernel_log("uefi_main to idle us: %u", tsc_cycles_to_ns(tsc, timing->idle_tsc - timing->uefi_main_tsc) / 1000);
+
+}
+
+/*******************************************************************************
+Halt With Error Function
+Show the error on screen and COM1, then stop the bootstrap processor for good.
+*******************************************************************************/
+static void Halt_With_Error (PC_Screen_Font_v1_Renderer* font_renderer, const char* message) {
+
+    font_renderer->print_string(0x00FF0000, (char*)message, 10, 10);
+
+    kernel_log("%s", message);
+    kernel_log_drain(UINT64_MAX);
+    if (kernel_serial_port != nullptr) {
+        serial_port_flush(kernel_serial_port);
+    }
+
+    disable_interrupts();
+    while (true) {
+        __asm__ __volatile__ ("hlt");
+    }
+
+}
+
 /*******************************************************************************
 KERNEL ENTRY POINT FUNCTION
 *******************************************************************************/
 extern "C" { // Avoids name mangling of the kernel's entry point.
 __attribute__((section(".kernel"))) int UEFI_API kernel_main (Kernel_Handover* k) {
 
+    // Nothing can take an interrupt until the kernel's own IDT is loaded.
+    disable_interrupts();
+
+    // Point the image's stored pointers at where it was loaded, before any is used.
+    Relocate_Kernel_Image();
+
+    // Continue the bootloader's trace buffer, so the PMM constructor is traced.
+    trace_set_default_buffer(k->boot_trace_buffer);
+    boot_timing* boot_timings = k->boot_timings;
+    boot_timing_begin(boot_timings, boot_phase_kernel_init);
+
     // Retrieve the instantiated font renderer from the kernel handover.
     PC_Screen_Font_v1_Renderer* font_renderer = k->font_renderer;
 
-    // PMM initialization.
+    /* Point GS at the bootstrap processor's per-CPU data before anything reads
+    it, the PMM looks up the calling processor's NUMA node there. */
+    per_cpu_data* cpu = get_bootstrap_per_cpu_data();
+    Install_Per_CPU_Data(cpu, 0);
+
+    /* Cache the firmware's MADT, HPET and SRAT. Processor start up, timer
+    calibration and NUMA placement all read the cache. */
+    Initialize_ACPI(k->acpi_rsdp);
+
+    // PMM initialization, one pool per NUMA node in the SRAT.
+    boot_timing_begin(boot_timings, boot_phase_pmm);
     Physical_Memory_Manager pmm (&k->memory_map, k->os_reserved_page_sets[0]);
+    boot_timing_end(boot_timings, boot_phase_pmm);
+    cpu->numa_node = pmm.get_node_of_processor(local_apic_get_initial_id());
 
     // Quick test of PMM.
     void* mem_one = pmm.allocate_physical_frames(100 * 4096);
@@ -23,6 +218,84 @@ __attribute__((section(".kernel"))) int UEFI_API kernel_main (Kernel_Handover* k
     pmm.free_physical_frames(mem_two);
     pmm.free_physical_frames(mem_one);
 
+    /* Per-CPU log rings, formatted only when the idle loop drains them to
+    COM1. The UART is polled until the IO APIC routes its interrupt. */
+    Setup_Kernel_Log(&pmm);
+    serial_port com1;
+    if (Initialize_Serial_Port(&com1, SERIAL_COM1_PORT, SERIAL_DEFAULT_BAUD_RATE, &pmm)) {
+        kernel_serial_port = &com1;
+        kernel_log_add_sink(serial_port_log_sink, kernel_serial_port);
+    }
+    kernel_log("Kernel started, %u NUMA nodes", pmm.get_num_of_nodes());
+
+    // Per-CPU trace buffers, dumped to COM1 once the benchmarks are done.
+    Setup_Kernel_Trace(k->boot_trace_buffer);
+
+    // VMM initialization, adopting the bootloader's identity mapped tables.
+    Virtual_Memory_Manager vmm (&pmm);
+
+    // Replace the firmware's GDT and IDT with the kernel's own.
+    Setup_Global_Descriptor_Table(&cpu->descriptor_tables, &pmm);
+    Interrupt_Descriptor_Table idt;
+    idt.load();
+
+    /* Enable SSE, AVX and XSAVE. Kernel code is built without vector registers,
+    code using them explicitly gets its state switched lazily on #NM. */
+    Setup_FPU(&idt);
+
+    // Pick memcpy/memset implementations now that the vector state is set up.
+    Initialize_Memory_Operations();
+
+    /* Calibrate the TSC for monotonic nanosecond time, against the HPET when
+    there is one and it can be mapped uncached, else against the PIT. */
+    volatile uint64_t* hpet_registers = nullptr;
+    const acpi_tables* acpi = get_acpi_tables();
+    if (acpi->hpet.present &&
+        vmm.map_page(acpi->hpet.address, acpi->hpet.address, PAGE_TABLES_ENTRY_READ_WRITE |
+                                                             PAGE_TABLES_ENTRY_PAGE_LEVEL_WRITE_THROUGH |
+                                                             PAGE_TABLES_ENTRY_PAGE_LEVEL_CACHE_DISABLE)) {
+        hpet_registers = (volatile uint64_t*)acpi->hpet.address;
+    }
+    if (!Calibrate_Time_Stamp_Counter(&cpu->tsc, hpet_registers)) {
+        Halt_With_Error(font_renderer, "Could not calibrate the TSC against the HPET or PIT");
+    }
+
+    /* Bring up the local APIC with its timer stopped. The kernel runs tickless,
+    the timer wheel only arms the APIC for its earliest pending timeout. */
+    Initialize_Local_APIC(&cpu->apic, &vmm, &cpu->tsc);
+    cpu->apic_id = local_apic_get_id(&cpu->apic);
+    Initialize_Timer_Wheel(&cpu->timers, &cpu->apic, &cpu->tsc);
+    cpu->apic.timer_callback = Timer_Wheel_Interrupt_Callback;
+    idt.register_handler(LOCAL_APIC_TIMER_VECTOR, Local_APIC_Timer_Handler);
+
+    /* Mask everything the firmware left routed, then let COM1 drain its ring
+    from the transmitter empty interrupt on this processor. */
+    if (Initialize_IO_APICs(&vmm) && (kernel_serial_port != nullptr)) {
+        serial_port_enable_interrupts(kernel_serial_port, &idt, SERIAL_COM1_IRQ, cpu->apic_id);
+    }
+
+    /* Kernel threads, switched on the way out of interrupts. From here on this
+    code is the bootstrap processor's idle thread. */
+    Setup_Scheduler(&pmm, &idt);
+    Initialize_Run_Queue(&cpu->run_queue, &cpu->timers, cpu->cpu_index);
+
+    // Lock-free lookups for read-mostly structures, grace periods end in idle loops.
+    Setup_RCU(&pmm);
+    Initialize_RCU_State(&cpu->rcu);
+
+    // Sample rings and the control vector, before the processors it samples start.
+    Setup_Profiler(&pmm, &idt);
+
+    /* Paging structures the VMM unlinks are only freed once every processor
+    has flushed its TLB, each one joins as its local APIC comes up. */
+    Setup_TLB_Shootdown(&idt);
+
+    // Start the application processors, they idle until handed work.
+    Start_Application_Processors(&pmm, &vmm, &idt);
+
+    // One work-stealing worker thread per processor for parallel jobs.
+    Initialize_Executor(&pmm);
+
     // Pointer to framebuffer in memory.
     uint32_t* framebuffer = (uint32_t*) k->gop.FrameBufferBase; 
 
@@ -30,15 +303,104 @@ __attribute__((section(".kernel"))) int UEFI_API kernel_main (Kernel_Handover* k
     uint32_t x_resolution = k->gop.Info->PixelsPerScanLine;
     uint32_t y_resolution = k->gop.Info->VerticalResolution;
 
-    // Color entire framebuffer.
-    for (uint32_t y = 0; y < y_resolution; y++)
-        for (uint32_t x = 0; x < x_resolution; x++)
-            framebuffer[((y * x_resolution) + x)] = 0xFFDDDDDD;
+    boot_timing_end(boot_timings, boot_phase_kernel_init);
+
+    // Color entire framebuffer, padding included, in one vectorized span.
+    boot_timing_begin(boot_timings, boot_phase_framebuffer_clear);
+    framebuffer_surface screen;
+    Initialize_Framebuffer_Surface(&screen, framebuffer, k->gop.Info->HorizontalResolution, y_resolution, x_resolution);
+    framebuffer_clear(&screen, 0xFFDDDDDD);
+    boot_timing_end(boot_timings, boot_phase_framebuffer_clear);
 
+#ifdef KERNEL_BENCHMARKS
+    /* Benchmark build (make bench): the registered benchmarks, as BENCH lines
+    on COM1, then the figures the multi-phase ones report themselves. The
+    profile build samples them on every processor, the samples stream to COM1
+    from the idle loop for Profile_Report.py. */
+    boot_timing_begin(boot_timings, boot_phase_benchmarks);
+#ifdef KERNEL_SAMPLING_PROFILER
+    profiler_start(PROFILER_DEFAULT_FREQUENCY_HZ, true);
+#endif
+    if (Setup_Benchmarks(&pmm) && (Register_Kernel_Benchmarks(&pmm, &vmm, font_renderer, &k->gop) != 0)) {
+        benchmark_run_all(cpu->tsc.frequency_hz);
+        Report_Benchmark_Results(font_renderer, get_kernel_benchmark_results());
+    }
+#ifdef KERNEL_SAMPLING_PROFILER
+    profiler_stop();
+#endif
+    boot_timing_end(boot_timings, boot_phase_benchmarks);
+#endif
+
+    // After the benchmarks, the framebuffer ones repaint the whole screen.
     font_renderer->print_string(0x00000000, "Hello World", 10, 10);
 
-    // Never return to UEFI.
-    while(1);
+    // Every phase up to here is counted as boot time.
+    boot_timings->idle_tsc = read_tsc();
+    Log_Boot_Timing(boot_timings, &cpu->tsc);
+
+    /* Dump the boot and benchmark trace after the log lines so far, for
+    Trace_To_Chrome.py to pick out of the serial output. The instrument build
+    follows it with its edge counters for Merge_Edge_Profile.py. */
+    if (kernel_serial_port != nullptr) {
+        kernel_log_drain(KERNEL_LOG_RING_SIZE);
+        kernel_trace_dump(kernel_serial_port, cpu->tsc.frequency_hz);
+        edge_profile_dump(kernel_serial_port);
+    }
+
+#ifdef KERNEL_BENCHMARKS
+    // Headless benchmark runs end here, once everything logged has left COM1.
+    kernel_log_drain(KERNEL_LOG_RING_SIZE);
+    if (kernel_serial_port != nullptr) {
+        serial_port_flush(kernel_serial_port);
+    }
+    benchmark_exit_emulator(0);
+#endif
+
+    /* Never return to UEFI. While idle, run any runnable threads and RCU
+    callbacks whose grace period ended, then promote runs of 4KB pages to 2MB
+    pages a few regions at a time. When a pass finds nothing to promote, halt
+    until a wake-up timer that backs off exponentially, so an idle core wakes up
+    less and less often instead of spinning. */
+    const uint64_t MIN_IDLE_BACKOFF_NS = 1000000;    // 1ms
+    const uint64_t MAX_IDLE_BACKOFF_NS = 1000000000; // 1s
+    uint64_t idle_backoff_ns = MIN_IDLE_BACKOFF_NS;
+    kernel_timer idle_wake_up_timer;
+    kernel_timer_initialize(&idle_wake_up_timer, nullptr, nullptr);
+    while(1) {
+
+        // Threads handed to this processor run before any idle work.
+        scheduler_yield();
+        rcu_process_callbacks();
+
+        /* Format pending log records. Without its interrupt COM1 is drained here
+        too; either keeps the wake-ups short while output is pending. */
+        kernel_log_drain(KERNEL_LOG_RING_SIZE);
+        if (kernel_log_is_pending() || ((kernel_serial_port != nullptr) && serial_port_poll(kernel_serial_port))) {
+            idle_backoff_ns = MIN_IDLE_BACKOFF_NS;
+        }
+
+        // Profile samples follow as the port has room for them.
+        if ((kernel_serial_port != nullptr) && profiler_is_pending()) {
+            profiler_stream(kernel_serial_port, PROFILER_RING_SIZE);
+            idle_backoff_ns = MIN_IDLE_BACKOFF_NS;
+        }
+
+        if (vmm.promote_huge_pages(16) != 0) {
+            idle_backoff_ns = MIN_IDLE_BACKOFF_NS;
+            continue;
+        }
+
+        timer_wheel_arm(&cpu->timers, &idle_wake_up_timer, get_monotonic_time_ns() + idle_backoff_ns);
+        rcu_enter_idle();
+        enable_interrupts_and_halt();
+        disable_interrupts();
+        rcu_exit_idle();
+
+        if (idle_backoff_ns < MAX_IDLE_BACKOFF_NS) {
+            idle_backoff_ns *= 2;
+        }
+
+    }
 
     return 0;
 
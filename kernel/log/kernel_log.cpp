@@ -0,0 +1,305 @@
+#include "kernel_log.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+/* Rings by processor index, each allocated by its processor as it comes up.
+Indices up to the number of rings may still be without one. */
+static kernel_log_ring* kernel_log_rings[PER_CPU_MAX_NUM_OF_CPUS];
+static uint64_t         kernel_log_num_of_rings;
+static kernel_log_sink  kernel_log_sinks[KERNEL_LOG_MAX_NUM_OF_SINKS];
+static void*            kernel_log_sink_contexts[KERNEL_LOG_MAX_NUM_OF_SINKS];
+static uint64_t         kernel_log_num_of_sinks;
+static uint32_t         kernel_log_consumer_busy;
+
+/*******************************************************************************
+Append Character Function
+*******************************************************************************/
+static void Append_Character (char* buffer, uint64_t capacity, uint64_t* length, char character) {
+    if (*length < capacity) {
+        buffer[(*length)++] = character;
+    }
+}
+
+/*******************************************************************************
+Append Number Function
+Digits of a number in base 10 or 16, hex with a 0x prefix like uefi_printf.
+*******************************************************************************/
+static void Append_Number (char* buffer, uint64_t capacity, uint64_t* length, uint64_t number, uint64_t base, bool is_signed) {
+
+    const char* DIGITS = "0123456789ABCDEF";
+
+    if (is_signed && ((int64_t)number < 0)) {
+        Append_Character(buffer, capacity, length, '-');
+        number = (uint64_t)(-(int64_t)number);
+    }
+
+    if (base == 16) {
+        Append_Character(buffer, capacity, length, '0');
+        Append_Character(buffer, capacity, length, 'x');
+    }
+
+    char     digits[20];
+    uint64_t num_of_digits = 0;
+    do {
+        digits[num_of_digits++] = DIGITS[number % base];
+        number /= base;
+    } while (number != 0);
+
+    while (num_of_digits != 0) {
+        Append_Character(buffer, capacity, length, digits[--num_of_digits]);
+    }
+
+}
+
+/*******************************************************************************
+Setup Kernel Log Function
+Once, on the bootstrap processor once its NUMA node is known. Allocates its
+ring, every other processor allocates its own with Initialize_Kernel_Log_Ring.
+Returns false if the ring could not be allocated.
+*******************************************************************************/
+bool Setup_Kernel_Log (Physical_Memory_Manager* pmm) {
+    return Initialize_Kernel_Log_Ring(pmm);
+}
+
+/*******************************************************************************
+Initialize Kernel Log Ring Function
+Allocate the executing processor's ring on its NUMA node, which is only known
+for certain on the processor itself: processor indices follow the order the
+processors came up in, not the MADT's. A processor without a ring drops its
+records. Returns false if the ring could not be allocated.
+*******************************************************************************/
+bool Initialize_Kernel_Log_Ring (Physical_Memory_Manager* pmm) {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    if (cpu->cpu_index >= PER_CPU_MAX_NUM_OF_CPUS) {
+        return false;
+    }
+
+    const uint64_t ALIGNMENT = 64;
+
+    uint8_t* memory = (uint8_t*)pmm->allocate_physical_frames_on_node(sizeof(kernel_log_ring) + ALIGNMENT, cpu->numa_node, true);
+    if (memory == nullptr) {
+        return false;
+    }
+
+    kernel_log_ring* ring = (kernel_log_ring*)((((uint64_t)memory) + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+    ring->head            = 0;
+    ring->num_of_dropped  = 0;
+    ring->tail            = 0;
+
+    __atomic_store_n(&kernel_log_rings[cpu->cpu_index], ring, __ATOMIC_RELEASE);
+
+    // Processors come up in any order, the count only grows.
+    uint64_t num_of_rings = __atomic_load_n(&kernel_log_num_of_rings, __ATOMIC_RELAXED);
+    while ((num_of_rings <= cpu->cpu_index) &&
+           !__atomic_compare_exchange_n(&kernel_log_num_of_rings, &num_of_rings, cpu->cpu_index + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Kernel Log Add Sink Function
+Lines drained from then on also go to the sink. Returns false when full.
+*******************************************************************************/
+bool kernel_log_add_sink (kernel_log_sink sink, void* context) {
+
+    if (kernel_log_num_of_sinks >= KERNEL_LOG_MAX_NUM_OF_SINKS) {
+        return false;
+    }
+
+    kernel_log_sinks[kernel_log_num_of_sinks]         = sink;
+    kernel_log_sink_contexts[kernel_log_num_of_sinks] = context;
+    __atomic_add_fetch(&kernel_log_num_of_sinks, 1, __ATOMIC_RELEASE);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Kernel Log Record Function
+Append a record to the executing processor's ring. Never blocks; a full ring
+drops the record and counts it. Use kernel_log rather than calling this.
+*******************************************************************************/
+void kernel_log_record (const char* format, const uint64_t* arguments, uint64_t num_of_arguments) {
+
+    uint64_t tsc    = read_tsc();
+    uint64_t rflags = save_and_disable_interrupts();
+
+    uint64_t         cpu_index = get_per_cpu_data()->cpu_index;
+    kernel_log_ring* ring      = (cpu_index < PER_CPU_MAX_NUM_OF_CPUS) ? __atomic_load_n(&kernel_log_rings[cpu_index], __ATOMIC_ACQUIRE) : nullptr;
+
+    if (ring == nullptr) {
+        restore_interrupts(rflags);
+        return;
+    }
+
+    uint64_t head = ring->head;
+    if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= KERNEL_LOG_RING_SIZE) {
+        ring->num_of_dropped++;
+        restore_interrupts(rflags);
+        return;
+    }
+
+    kernel_log_entry* entry = &ring->entries[head & (KERNEL_LOG_RING_SIZE - 1)];
+    entry->tsc              = tsc;
+    entry->format           = format;
+    entry->num_of_arguments = num_of_arguments;
+    for (uint64_t idx = 0; idx < num_of_arguments; idx++) {
+        entry->arguments[idx] = arguments[idx];
+    }
+
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    restore_interrupts(rflags);
+
+}
+
+/*******************************************************************************
+Kernel Log Format Function
+Format a record into the buffer, truncating at the capacity. Returns the length.
+*******************************************************************************/
+uint64_t kernel_log_format (char* buffer, uint64_t capacity, const char* format, const uint64_t* arguments, uint64_t num_of_arguments) {
+
+    uint64_t length        = 0;
+    uint64_t next_argument = 0;
+
+    for (uint64_t idx = 0; format[idx] != '\0'; idx++) {
+
+        if ((format[idx] != '%') || (format[idx + 1] == '\0')) {
+            Append_Character(buffer, capacity, &length, format[idx]);
+            continue;
+        }
+
+        idx++;
+
+        if (format[idx] == '%') {
+            Append_Character(buffer, capacity, &length, '%');
+            continue;
+        }
+
+        // A specifier past the recorded arguments prints as written.
+        if (next_argument >= num_of_arguments) {
+            Append_Character(buffer, capacity, &length, '%');
+            Append_Character(buffer, capacity, &length, format[idx]);
+            continue;
+        }
+
+        uint64_t argument = arguments[next_argument++];
+
+        switch (format[idx]) {
+
+            case 's': {
+                const char* string = (const char*)argument;
+                if (string == nullptr) {
+                    string = "(null)";
+                }
+                while (*string != '\0') {
+                    Append_Character(buffer, capacity, &length, *string++);
+                }
+            } break;
+
+            case 'i': Append_Number(buffer, capacity, &length, argument, 10, true);  break;
+            case 'u': Append_Number(buffer, capacity, &length, argument, 10, false); break;
+            case 'h': Append_Number(buffer, capacity, &length, argument, 16, false); break;
+            case 'c': Append_Character(buffer, capacity, &length, (char)argument);   break;
+
+            default: {
+                Append_Character(buffer, capacity, &length, '%');
+                Append_Character(buffer, capacity, &length, format[idx]);
+            }
+
+        }
+    }
+
+    return length;
+
+}
+
+/*******************************************************************************
+Kernel Log Drain Function
+
+Format up to the given number of records and hand the lines to every sink.
+Records of all processors are merged oldest first by TSC, which the kernel
+keeps synchronized across processors. One consumer at a time; a second caller
+returns straight away. Returns the number of records drained.
+*******************************************************************************/
+uint64_t kernel_log_drain (uint64_t max_num_of_entries) {
+
+    if (__atomic_exchange_n(&kernel_log_consumer_busy, 1, __ATOMIC_ACQUIRE) != 0) {
+        return 0;
+    }
+
+    const tsc_calibration* tsc = &get_bootstrap_per_cpu_data()->tsc;
+
+    uint64_t num_of_drained = 0;
+    char     line[KERNEL_LOG_MAX_LINE_LENGTH];
+
+    while (num_of_drained < max_num_of_entries) {
+
+        // Oldest pending record over all processors.
+        kernel_log_ring* oldest_ring  = nullptr;
+        uint64_t         oldest_cpu   = 0;
+        uint64_t         num_of_rings = __atomic_load_n(&kernel_log_num_of_rings, __ATOMIC_ACQUIRE);
+        for (uint64_t idx = 0; idx < num_of_rings; idx++) {
+            kernel_log_ring* ring = __atomic_load_n(&kernel_log_rings[idx], __ATOMIC_ACQUIRE);
+            if ((ring == nullptr) || (ring->tail == __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))) {
+                continue;
+            }
+            if ((oldest_ring == nullptr) || (ring->entries[ring->tail & (KERNEL_LOG_RING_SIZE - 1)].tsc < oldest_ring->entries[oldest_ring->tail & (KERNEL_LOG_RING_SIZE - 1)].tsc)) {
+                oldest_ring = ring;
+                oldest_cpu  = idx;
+            }
+        }
+
+        if (oldest_ring == nullptr) {
+            break;
+        }
+
+        kernel_log_entry* entry = &oldest_ring->entries[oldest_ring->tail & (KERNEL_LOG_RING_SIZE - 1)];
+
+        // "[<ns since boot> <cpu>] message"
+        uint64_t length = 0;
+        uint64_t ns     = (entry->tsc > tsc->base_tsc) ? tsc_cycles_to_ns(tsc, entry->tsc - tsc->base_tsc) : 0;
+        Append_Character(line, sizeof(line), &length, '[');
+        Append_Number(line, sizeof(line), &length, ns, 10, false);
+        Append_Character(line, sizeof(line), &length, ' ');
+        Append_Number(line, sizeof(line), &length, oldest_cpu, 10, false);
+        Append_Character(line, sizeof(line), &length, ']');
+        Append_Character(line, sizeof(line), &length, ' ');
+        length += kernel_log_format(&line[length], sizeof(line) - length, entry->format, entry->arguments, entry->num_of_arguments);
+
+        __atomic_store_n(&oldest_ring->tail, oldest_ring->tail + 1, __ATOMIC_RELEASE);
+        num_of_drained++;
+
+        uint64_t num_of_sinks = __atomic_load_n(&kernel_log_num_of_sinks, __ATOMIC_ACQUIRE);
+        for (uint64_t sink = 0; sink < num_of_sinks; sink++) {
+            kernel_log_sinks[sink](line, length, kernel_log_sink_contexts[sink]);
+        }
+
+    }
+
+    __atomic_store_n(&kernel_log_consumer_busy, 0, __ATOMIC_RELEASE);
+
+    return num_of_drained;
+
+}
+
+/*******************************************************************************
+Kernel Log Is Pending Function
+*******************************************************************************/
+bool kernel_log_is_pending () {
+
+    uint64_t num_of_rings = __atomic_load_n(&kernel_log_num_of_rings, __ATOMIC_ACQUIRE);
+    for (uint64_t idx = 0; idx < num_of_rings; idx++) {
+        kernel_log_ring* ring = __atomic_load_n(&kernel_log_rings[idx], __ATOMIC_ACQUIRE);
+        if ((ring != nullptr) && (__atomic_load_n(&ring->tail, __ATOMIC_RELAXED) != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))) {
+            return true;
+        }
+    }
+
+    return false;
+
+}
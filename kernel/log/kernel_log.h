@@ -0,0 +1,51 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+
+#define KERNEL_LOG_MAX_NUM_OF_ARGUMENTS 5
+#define KERNEL_LOG_RING_SIZE            256 // Entries per processor, power of two.
+#define KERNEL_LOG_MAX_NUM_OF_SINKS     4
+#define KERNEL_LOG_MAX_LINE_LENGTH      256
+
+/* One record, a cache line. Only the format pointer and raw arguments are kept,
+formatting waits for the consumer. The format and any %s argument must outlive
+the record, e.g. string literals. */
+typedef struct {
+    uint64_t    tsc;
+    const char* format;
+    uint64_t    num_of_arguments;
+    uint64_t    arguments[KERNEL_LOG_MAX_NUM_OF_ARGUMENTS];
+} __attribute__((aligned(64))) kernel_log_entry;
+
+/* Single producer, single consumer ring of one processor. The owner writes with
+interrupts disabled, so its interrupt handlers cannot interleave records. */
+typedef struct {
+    uint64_t         head;                                // Written by the owner.
+    uint64_t         num_of_dropped;                      // Records lost to a full ring.
+    uint64_t         tail __attribute__((aligned(64)));   // Written by the consumer.
+    kernel_log_entry entries[KERNEL_LOG_RING_SIZE];
+} kernel_log_ring;
+
+// Receives each formatted line, without a line terminator.
+typedef void (*kernel_log_sink) (const char* line, uint64_t length, void* context);
+
+bool     Setup_Kernel_Log           (Physical_Memory_Manager* pmm);
+bool     Initialize_Kernel_Log_Ring (Physical_Memory_Manager* pmm);
+bool     kernel_log_add_sink        (kernel_log_sink sink, void* context);
+void     kernel_log_record          (const char* format, const uint64_t* arguments, uint64_t num_of_arguments);
+uint64_t kernel_log_drain           (uint64_t max_num_of_entries);
+bool     kernel_log_is_pending      ();
+uint64_t kernel_log_format          (char* buffer, uint64_t capacity, const char* format, const uint64_t* arguments, uint64_t num_of_arguments);
+
+/* Log a line from anywhere, interrupt handlers included, in a few tens of
+cycles. Formats like uefi_printf: %s string, %i signed, %u unsigned, %h hex,
+%c character and %%. Arguments are widened to 64 bits, signed ones extended. */
+template <typename... Arguments> inline void kernel_log (const char* format, Arguments... arguments) {
+
+    static_assert(sizeof...(arguments) <= KERNEL_LOG_MAX_NUM_OF_ARGUMENTS, "Too many kernel log arguments.");
+
+    // The leading zero keeps the array non-empty without arguments.
+    const uint64_t values[] = { 0, ((uint64_t)arguments)... };
+    kernel_log_record(format, &values[1], sizeof...(arguments));
+
+}
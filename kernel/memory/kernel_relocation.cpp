@@ -0,0 +1,39 @@
+#include "kernel_relocation.h"
+
+/* From kernel.ld. Hidden so they are addressed relative to RIP, not through a
+GOT entry that would itself need relocating. */
+extern "C" {
+extern const uint8_t    kernel_image_start[]       __attribute__((visibility("hidden")));
+extern const elf64_rela kernel_relocations_start[] __attribute__((visibility("hidden")));
+extern const elf64_rela kernel_relocations_end[]   __attribute__((visibility("hidden")));
+}
+
+/*******************************************************************************
+Relocate Kernel Image Function
+The kernel is linked at 0 as a position independent executable and loaded
+wherever the bootloader's pool allocation landed. Code reaches everything
+relative to RIP, but a pointer stored in data, such as a jump or string table
+an optimized build emits, or the gcov_info of an instrumented one, holds its
+link time address. Add the load address to each of them. The image only has
+R_X86_64_RELATIVE entries, other types are skipped and counted. Must run before
+any such pointer is followed; applying it twice is harmless.
+*******************************************************************************/
+uint64_t Relocate_Kernel_Image () {
+
+    uint64_t base = (uint64_t)kernel_image_start;
+    uint64_t num_of_skipped = 0;
+
+    for (const elf64_rela* rela = kernel_relocations_start; rela < kernel_relocations_end; rela++) {
+
+        if ((rela->info & 0xFFFFFFFF) != ELF64_R_X86_64_RELATIVE) {
+            num_of_skipped++;
+            continue;
+        }
+
+        *(uint64_t*)(base + rela->offset) = base + (uint64_t)rela->addend;
+
+    }
+
+    return num_of_skipped;
+
+}
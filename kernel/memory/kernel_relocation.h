@@ -0,0 +1,13 @@
+#pragma once
+#include <stdint.h>
+
+#define ELF64_R_X86_64_RELATIVE 8 // Image base plus addend.
+
+// Elf64_Rela, one entry of the image's .rela.dyn.
+typedef struct {
+    uint64_t offset; // Link time address of the 8 byte slot to patch.
+    uint64_t info;   // Symbol index in the high half, type in the low half.
+    int64_t  addend;
+} elf64_rela;
+
+uint64_t Relocate_Kernel_Image ();
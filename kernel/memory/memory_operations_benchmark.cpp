@@ -0,0 +1,154 @@
+#include "memory_operations_benchmark.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+/*******************************************************************************
+Time Copy Function
+Minimum cycles per call over the samples, each sample repeating small copies so
+the timestamp overhead does not dominate.
+*******************************************************************************/
+static uint64_t Time_Copy (memory_variant variant, uint8_t* destination, const uint8_t* source, uint64_t size) {
+
+    uint64_t num_of_repetitions = (size < MEMORY_BENCHMARK_BYTES_PER_SAMPLE) ? (MEMORY_BENCHMARK_BYTES_PER_SAMPLE / size) : 1;
+    uint64_t min_cycles         = UINT64_MAX;
+
+    // One untimed call to warm the caches and TLB.
+    memory_copy_with_variant(variant, destination, source, size);
+
+    for (uint64_t sample = 0; sample < MEMORY_BENCHMARK_NUM_OF_SAMPLES; sample++) {
+
+        uint64_t start_tsc = read_tsc();
+        for (uint64_t idx = 0; idx < num_of_repetitions; idx++) {
+            memory_copy_with_variant(variant, destination, source, size);
+        }
+        uint64_t cycles = (read_tsc() - start_tsc) / num_of_repetitions;
+
+        if (cycles < min_cycles) {
+            min_cycles = cycles;
+        }
+
+    }
+
+    return min_cycles;
+
+}
+
+/*******************************************************************************
+Time Set Function
+*******************************************************************************/
+static uint64_t Time_Set (memory_variant variant, uint8_t* destination, uint64_t size) {
+
+    uint64_t num_of_repetitions = (size < MEMORY_BENCHMARK_BYTES_PER_SAMPLE) ? (MEMORY_BENCHMARK_BYTES_PER_SAMPLE / size) : 1;
+    uint64_t min_cycles         = UINT64_MAX;
+
+    memory_set_with_variant(variant, destination, 0, size);
+
+    for (uint64_t sample = 0; sample < MEMORY_BENCHMARK_NUM_OF_SAMPLES; sample++) {
+
+        uint64_t start_tsc = read_tsc();
+        for (uint64_t idx = 0; idx < num_of_repetitions; idx++) {
+            memory_set_with_variant(variant, destination, (uint8_t)idx, size);
+        }
+        uint64_t cycles = (read_tsc() - start_tsc) / num_of_repetitions;
+
+        if (cycles < min_cycles) {
+            min_cycles = cycles;
+        }
+
+    }
+
+    return min_cycles;
+
+}
+
+/*******************************************************************************
+Benchmark Memory Operations Function
+
+Time every copy and fill variant from 16 bytes to 4MB, with the source aligned,
+off by one byte and off by half a cache line, to find where rep strings, SIMD
+and non-temporal stores cross over. Destinations are cache line aligned. Uses
+vector registers, so run it from a thread. Returns false if the buffers cannot
+be allocated.
+*******************************************************************************/
+bool Benchmark_Memory_Operations (Physical_Memory_Manager* pmm, memory_operations_benchmark_result* result) {
+
+    const uint64_t BUFFER_SIZE = MEMORY_BENCHMARK_MAX_SIZE + 4096;
+
+    uint8_t* source_memory      = (uint8_t*)pmm->allocate_physical_frames(BUFFER_SIZE);
+    uint8_t* destination_memory = (uint8_t*)pmm->allocate_physical_frames(BUFFER_SIZE);
+
+    if ((source_memory == nullptr) || (destination_memory == nullptr)) {
+        if (source_memory != nullptr) {
+            pmm->free_physical_frames(source_memory);
+        }
+        if (destination_memory != nullptr) {
+            pmm->free_physical_frames(destination_memory);
+        }
+        return false;
+    }
+
+    uint8_t* source      = (uint8_t*)((((uint64_t)source_memory)      + 4095) & ~4095ULL);
+    uint8_t* destination = (uint8_t*)((((uint64_t)destination_memory) + 4095) & ~4095ULL);
+
+    for (uint64_t idx = 0; idx < MEMORY_BENCHMARK_MAX_SIZE; idx++) {
+        source[idx] = (uint8_t)idx;
+    }
+
+    uint64_t size = 16;
+    for (uint64_t size_idx = 0; size_idx < MEMORY_BENCHMARK_NUM_OF_SIZES; size_idx++) {
+        result->sizes[size_idx] = size;
+        size = (size < 4096) ? (size * 4) : (size * 16);
+    }
+    result->sizes[MEMORY_BENCHMARK_NUM_OF_SIZES - 1] = MEMORY_BENCHMARK_MAX_SIZE;
+
+    result->source_offsets[0] = 0;
+    result->source_offsets[1] = 1;
+    result->source_offsets[2] = 32;
+
+    for (uint64_t size_idx = 0; size_idx < MEMORY_BENCHMARK_NUM_OF_SIZES; size_idx++) {
+
+        uint64_t best_copy_cycles = UINT64_MAX;
+        uint64_t best_set_cycles  = UINT64_MAX;
+        result->fastest_copy[size_idx] = memory_variant_rep_qword;
+        result->fastest_set[size_idx]  = memory_variant_rep_qword;
+
+        for (uint32_t variant = 0; variant < MEMORY_NUM_OF_VARIANTS; variant++) {
+
+            bool     supported         = memory_variant_is_supported((memory_variant)variant);
+            uint64_t total_copy_cycles = 0;
+            uint64_t total_set_cycles  = 0;
+
+            for (uint64_t alignment_idx = 0; alignment_idx < MEMORY_BENCHMARK_NUM_OF_ALIGNMENTS; alignment_idx++) {
+
+                uint64_t copy_cycles = UINT64_MAX;
+                uint64_t set_cycles  = UINT64_MAX;
+
+                if (supported) {
+                    copy_cycles = Time_Copy((memory_variant)variant, destination, source + result->source_offsets[alignment_idx], result->sizes[size_idx]);
+                    set_cycles  = Time_Set((memory_variant)variant, destination + result->source_offsets[alignment_idx], result->sizes[size_idx]);
+                    total_copy_cycles += copy_cycles;
+                    total_set_cycles  += set_cycles;
+                }
+
+                result->copy_cycles[variant][size_idx][alignment_idx] = copy_cycles;
+                result->set_cycles[variant][size_idx][alignment_idx]  = set_cycles;
+
+            }
+
+            if (supported && (total_copy_cycles < best_copy_cycles)) {
+                best_copy_cycles               = total_copy_cycles;
+                result->fastest_copy[size_idx] = (memory_variant)variant;
+            }
+            if (supported && (total_set_cycles < best_set_cycles)) {
+                best_set_cycles               = total_set_cycles;
+                result->fastest_set[size_idx] = (memory_variant)variant;
+            }
+
+        }
+    }
+
+    pmm->free_physical_frames(destination_memory);
+    pmm->free_physical_frames(source_memory);
+
+    return true;
+
+}
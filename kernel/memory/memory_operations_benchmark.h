@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+#include "physical_memory_manager.h"
+#include "../../shared/memory/memory_operations.h"
+
+#define MEMORY_BENCHMARK_NUM_OF_SIZES      8
+#define MEMORY_BENCHMARK_NUM_OF_ALIGNMENTS 3
+#define MEMORY_BENCHMARK_MAX_SIZE          (4 * 1024 * 1024)
+#define MEMORY_BENCHMARK_NUM_OF_SAMPLES    3
+#define MEMORY_BENCHMARK_BYTES_PER_SAMPLE  (64 * 1024) // Small sizes repeat to about this much per sample.
+
+/* Minimum cycles per call of every variant at every size and source
+misalignment, UINT64_MAX where the variant is not supported. */
+typedef struct {
+    uint64_t       sizes[MEMORY_BENCHMARK_NUM_OF_SIZES];
+    uint64_t       source_offsets[MEMORY_BENCHMARK_NUM_OF_ALIGNMENTS];
+    uint64_t       copy_cycles[MEMORY_NUM_OF_VARIANTS][MEMORY_BENCHMARK_NUM_OF_SIZES][MEMORY_BENCHMARK_NUM_OF_ALIGNMENTS];
+    uint64_t       set_cycles[MEMORY_NUM_OF_VARIANTS][MEMORY_BENCHMARK_NUM_OF_SIZES][MEMORY_BENCHMARK_NUM_OF_ALIGNMENTS];
+    memory_variant fastest_copy[MEMORY_BENCHMARK_NUM_OF_SIZES]; // Summed over the alignments.
+    memory_variant fastest_set[MEMORY_BENCHMARK_NUM_OF_SIZES];
+} memory_operations_benchmark_result;
+
+bool Benchmark_Memory_Operations (Physical_Memory_Manager* pmm, memory_operations_benchmark_result* result);
@@ -1,4 +1,7 @@
 #include "physical_memory_manager.h"
+#include "../acpi/acpi.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/trace/trace.h"
 
 // Input p is a void*.
 #define PMM_PHYSICAL_ADDRESS_BYTE_ALIGNMENT_BITS  3
@@ -23,7 +26,7 @@ Red-black Tree Rotate Left Function
 Rotates a node x and it's right subtree y left. Node y becomes the parent of x 
 and x becomes y's left subtree.
 *******************************************************************************/
-void Physical_Memory_Manager::pmm_red_black_tree_rotate_left (void* x) {
+void Physical_Memory_Manager::pmm_red_black_tree_rotate_left (pmm_node_pool* pool, void* x) {
 
     // y is the right subtree of x.
     void* y = PMM_RED_BLACK_TREE_RIGHT_CHILD(x);
@@ -41,7 +44,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_rotate_left (void* x) {
 
     // If x was the root of the tree, y is now the root.
     if (PMM_RED_BLACK_TREE_PARENT(x) == pmm_red_black_tree_null) {
-        pmm_red_black_tree_root = y;
+        pool->red_black_tree_root = y;
     
     // If x was it's parent's left child then y is now the left child.
     } else if (x == PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(x))) {
@@ -66,7 +69,7 @@ Red-black Tree Rotate Right Function
 Rotates a node y and it's left subtree x right. Node x becomes the parent of y 
 and y becomes x's right subtree.
 *******************************************************************************/
-void Physical_Memory_Manager::pmm_red_black_tree_rotate_right (void* y) { 
+void Physical_Memory_Manager::pmm_red_black_tree_rotate_right (pmm_node_pool* pool, void* y) { 
 
     // x is the left subtree of y.
     void* x = PMM_RED_BLACK_TREE_LEFT_CHILD(y);
@@ -84,7 +87,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_rotate_right (void* y) {
 
     // If y was the root of the tree, x is now the root.
     if (PMM_RED_BLACK_TREE_PARENT(y) == pmm_red_black_tree_null) {
-        pmm_red_black_tree_root = x;
+        pool->red_black_tree_root = x;
     
     // If y was it's parent's left child then x is now the left child.
     } else if (y == PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(y))) {
@@ -106,10 +109,10 @@ void Physical_Memory_Manager::pmm_red_black_tree_rotate_right (void* y) {
 /*******************************************************************************
 Red-black Tree Find Parent of Inserted Node Function
 *******************************************************************************/
-void* Physical_Memory_Manager::pmm_red_black_tree_find_parent_of_inserted_node (uint64_t value) {
+void* Physical_Memory_Manager::pmm_red_black_tree_find_parent_of_inserted_node (pmm_node_pool* pool, uint64_t value) {
 
     // Initialize x to the root to descend down the tree.
-    void* x = pmm_red_black_tree_root;
+    void* x = pool->red_black_tree_root;
 
     // Initialize y which will be the parent of x.
     void* y = pmm_red_black_tree_null;
@@ -138,10 +141,10 @@ void* Physical_Memory_Manager::pmm_red_black_tree_find_parent_of_inserted_node (
 /*******************************************************************************
 Red-black Tree Find Best Fit Function
 *******************************************************************************/
-void* Physical_Memory_Manager::pmm_red_black_tree_find_best_fit (uint64_t value) {
+void* Physical_Memory_Manager::pmm_red_black_tree_find_best_fit (pmm_node_pool* pool, uint64_t value) {
 
     // Initialize x to the root to descend down the tree.
-    void* x = pmm_red_black_tree_root;
+    void* x = pool->red_black_tree_root;
 
     /* Initialize best fit which will be the node with the smallest value 
     greater than the given one. */
@@ -171,13 +174,57 @@ void* Physical_Memory_Manager::pmm_red_black_tree_find_best_fit (uint64_t value)
 
 }
 
+/*******************************************************************************
+Red-black Tree Find Best Fit Below Function
+
+Finds the smallest node in the subtree rooted at x of at least the given value
+whose first value bytes end at or below the address limit. Allocations are 
+carved from the start of a node so only its address and size matter.
+*******************************************************************************/
+void* Physical_Memory_Manager::pmm_red_black_tree_find_best_fit_below (void* x, uint64_t value, uint64_t address_limit) {
+
+    if (x == pmm_red_black_tree_null) {
+        return pmm_red_black_tree_null;
+    }
+
+    void* best_fit = pmm_red_black_tree_null;
+
+    if ((value <= PMM_RED_BLACK_TREE_KEY_VALUE(x)) && ((((uint64_t)x) + value) <= address_limit)) {
+        best_fit = x;
+    }
+
+    /* Nodes of the left subtree are smaller than x, only worth visiting if the
+    value is smaller than x as well. Nodes of the right subtree are at least as 
+    large as x, only worth visiting while x itself is not a fit. */
+    void* candidates[2] = {pmm_red_black_tree_null, pmm_red_black_tree_null};
+    if (value < PMM_RED_BLACK_TREE_KEY_VALUE(x)) {
+        candidates[0] = PMM_RED_BLACK_TREE_LEFT_CHILD(x);
+    }
+    if (best_fit == pmm_red_black_tree_null) {
+        candidates[1] = PMM_RED_BLACK_TREE_RIGHT_CHILD(x);
+    }
+
+    for (uint64_t idx = 0; idx < 2; idx++) {
+
+        void* candidate = pmm_red_black_tree_find_best_fit_below(candidates[idx], value, address_limit);
+
+        if ((candidate != pmm_red_black_tree_null) &&
+            ((best_fit == pmm_red_black_tree_null) || (PMM_RED_BLACK_TREE_KEY_VALUE(candidate) < PMM_RED_BLACK_TREE_KEY_VALUE(best_fit)))) {
+            best_fit = candidate;
+        }
+    }
+
+    return best_fit;
+
+}
+
 /*******************************************************************************
 Red-black Tree Insert Function
 *******************************************************************************/
-void Physical_Memory_Manager::pmm_red_black_tree_insert (void* z) {
+void Physical_Memory_Manager::pmm_red_black_tree_insert (pmm_node_pool* pool, void* z) {
 
     // y will be the parent of z.
-    void* y = pmm_red_black_tree_find_parent_of_inserted_node (PMM_RED_BLACK_TREE_KEY_VALUE(z));
+    void* y = pmm_red_black_tree_find_parent_of_inserted_node (pool, PMM_RED_BLACK_TREE_KEY_VALUE(z));
 
     // Set z's parent to be y after the descent.
     PMM_RED_BLACK_TREE_PARENT(z) = y;
@@ -185,7 +232,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_insert (void* z) {
     /* If y is the null node, z is the root of the tree otherwise, compare z's 
     key to it's parent's key and place z as the left or right child.*/
     if (y == pmm_red_black_tree_null) {
-        pmm_red_black_tree_root = z;
+        pool->red_black_tree_root = z;
     } else if (PMM_RED_BLACK_TREE_KEY_VALUE(z) < PMM_RED_BLACK_TREE_KEY_VALUE(y)) {
         PMM_RED_BLACK_TREE_LEFT_CHILD(y) = z;
     } else {
@@ -201,14 +248,14 @@ void Physical_Memory_Manager::pmm_red_black_tree_insert (void* z) {
     PMM_RED_BLACK_TREE_COLOR(z)       = pmm_red_black_tree_color::red;
 
     // Handle any red black tree property violations after insertion.
-    pmm_red_black_tree_insert_fixup(z);
+    pmm_red_black_tree_insert_fixup(pool, z);
 
 }
 
 /*******************************************************************************
 Red-black Tree Insert Fix-Up Function
 *******************************************************************************/
-void Physical_Memory_Manager::pmm_red_black_tree_insert_fixup (void* z) {
+void Physical_Memory_Manager::pmm_red_black_tree_insert_fixup (pmm_node_pool* pool, void* z) {
 
     /* Only execute loop if z's parent is also red which violates that a red 
     node should have black children. (z is a red node being inserted). */
@@ -245,7 +292,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_insert_fixup (void* z) {
                     /* Perform a left rotation on z's parent. z's parent is now
                     z. */
                     z = PMM_RED_BLACK_TREE_PARENT(z);
-                    pmm_red_black_tree_rotate_left(z);
+                    pmm_red_black_tree_rotate_left(pool, z);
 
                 }
 
@@ -253,7 +300,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_insert_fixup (void* z) {
                 the violation. */
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(z))      = pmm_red_black_tree_color::black;
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_GRANDPARENT(z)) = pmm_red_black_tree_color::red;
-                pmm_red_black_tree_rotate_right(PMM_RED_BLACK_TREE_GRANDPARENT(z));
+                pmm_red_black_tree_rotate_right(pool, PMM_RED_BLACK_TREE_GRANDPARENT(z));
 
             }
 
@@ -279,13 +326,13 @@ void Physical_Memory_Manager::pmm_red_black_tree_insert_fixup (void* z) {
                 if (z == PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(z))) {
 
                     z = PMM_RED_BLACK_TREE_PARENT(z);
-                    pmm_red_black_tree_rotate_right(z);
+                    pmm_red_black_tree_rotate_right(pool, z);
 
                 }
 
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(z))      = pmm_red_black_tree_color::black;
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_GRANDPARENT(z)) = pmm_red_black_tree_color::red;
-                pmm_red_black_tree_rotate_left(PMM_RED_BLACK_TREE_GRANDPARENT(z));
+                pmm_red_black_tree_rotate_left(pool, PMM_RED_BLACK_TREE_GRANDPARENT(z));
 
             }
         }
@@ -293,19 +340,19 @@ void Physical_Memory_Manager::pmm_red_black_tree_insert_fixup (void* z) {
 
     /* Always color the root of the red-black tree black - in the case z becomes
     the root. */
-    PMM_RED_BLACK_TREE_COLOR(pmm_red_black_tree_root) = pmm_red_black_tree_color::black;
+    PMM_RED_BLACK_TREE_COLOR(pool->red_black_tree_root) = pmm_red_black_tree_color::black;
 
 }
 
 /*******************************************************************************
 Red-black Tree Transplant Function
 *******************************************************************************/
-void Physical_Memory_Manager::pmm_red_black_tree_transplant (void* u, void* v) {
+void Physical_Memory_Manager::pmm_red_black_tree_transplant (pmm_node_pool* pool, void* u, void* v) {
 
     /* Replace v as the left or right subtree of u's parent instead of u if u 
     has a parent. If u was the root, v is now the root. */
     if (PMM_RED_BLACK_TREE_PARENT(u) == pmm_red_black_tree_null) {
-        pmm_red_black_tree_root = v;
+        pool->red_black_tree_root = v;
     } else if (u == PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(u))) {
         PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(u)) = v;
     } else {
@@ -333,7 +380,7 @@ void* Physical_Memory_Manager::pmm_red_black_tree_minimum (void* x) {
 /*******************************************************************************
 Red-black Tree Delete Function
 *******************************************************************************/
-void Physical_Memory_Manager::pmm_red_black_tree_delete (void* z) {
+void Physical_Memory_Manager::pmm_red_black_tree_delete (pmm_node_pool* pool, void* z) {
 
     /* y is the node either being moved within the tree or removed from the tree
     either z's replacement or successor thus, we must track it's color.*/
@@ -349,13 +396,13 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete (void* z) {
         // z only has a right child or no children thus z is replaced by it's 
         // right child or null respectively.
         x = PMM_RED_BLACK_TREE_RIGHT_CHILD(z);
-        pmm_red_black_tree_transplant(z, x);
+        pmm_red_black_tree_transplant(pool, z, x);
 
     } else if (PMM_RED_BLACK_TREE_RIGHT_CHILD(z) == pmm_red_black_tree_null) {
 
         // z only has a left child thus z is replaced by it's left child.
         x = PMM_RED_BLACK_TREE_LEFT_CHILD(z);
-        pmm_red_black_tree_transplant(z, x);
+        pmm_red_black_tree_transplant(pool, z, x);
 
     } else { // z has a left and right child.
 
@@ -374,7 +421,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete (void* z) {
         if (y != PMM_RED_BLACK_TREE_RIGHT_CHILD(z)) {
             
             // The right child of y replaces y's position.
-            pmm_red_black_tree_transplant (y, x);
+            pmm_red_black_tree_transplant (pool, y, x);
             
             // z's successor's right child is z's right child.
             PMM_RED_BLACK_TREE_RIGHT_CHILD(y) = PMM_RED_BLACK_TREE_RIGHT_CHILD(z);
@@ -389,7 +436,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete (void* z) {
         }
 
         // Replace z with it's in order successor.
-        pmm_red_black_tree_transplant (z, y);
+        pmm_red_black_tree_transplant (pool, z, y);
 
         // z's successor's left child is z's left child.
         PMM_RED_BLACK_TREE_LEFT_CHILD(y) = PMM_RED_BLACK_TREE_LEFT_CHILD(z);
@@ -404,18 +451,18 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete (void* z) {
     fixup is not needed as a path on the tree's black height has not changed
     and y's children must be black, no red nodes are adajacent. */
     if (y_original_color == pmm_red_black_tree_color::black) {
-        pmm_red_black_tree_delete_fixup(x);
+        pmm_red_black_tree_delete_fixup(pool, x);
     }
 }
 
 /*******************************************************************************
 Red-black Tree Delete Fix-Up Function
 *******************************************************************************/
-void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (void* x) {
+void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (pmm_node_pool* pool, void* x) {
 
     /* Iterate until doubly black node x propagates up to the root or x is no
     no longer doubly black. */
-    while ((x != pmm_red_black_tree_root) && (PMM_RED_BLACK_TREE_COLOR(x) == pmm_red_black_tree_color::black)) {
+    while ((x != pool->red_black_tree_root) && (PMM_RED_BLACK_TREE_COLOR(x) == pmm_red_black_tree_color::black)) {
 
         // Is x a left child?
         if (x == PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(x))) {
@@ -429,7 +476,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (void* x) {
                 // Transform this case into a case where w is a black sibling.
                 PMM_RED_BLACK_TREE_COLOR(w)                            = pmm_red_black_tree_color::black;
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(x)) = pmm_red_black_tree_color::red;
-                pmm_red_black_tree_rotate_left(PMM_RED_BLACK_TREE_PARENT(x));
+                pmm_red_black_tree_rotate_left(pool, PMM_RED_BLACK_TREE_PARENT(x));
                 w = PMM_RED_BLACK_TREE_RIGHT_CHILD(PMM_RED_BLACK_TREE_PARENT(x));
 
             }
@@ -451,7 +498,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (void* x) {
                     // If so, create the case where w's right child is red.
                     PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_LEFT_CHILD(w)) = pmm_red_black_tree_color::black;
                     PMM_RED_BLACK_TREE_COLOR(w)                                = pmm_red_black_tree_color::red;
-                    pmm_red_black_tree_rotate_right(w);
+                    pmm_red_black_tree_rotate_right(pool, w);
                     w = PMM_RED_BLACK_TREE_RIGHT_CHILD(PMM_RED_BLACK_TREE_PARENT(x));
 
                 }
@@ -462,8 +509,8 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (void* x) {
                 PMM_RED_BLACK_TREE_COLOR(w)                                 = PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(x));
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(x))      = pmm_red_black_tree_color::black;
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_RIGHT_CHILD(w)) = pmm_red_black_tree_color::black;
-                pmm_red_black_tree_rotate_left(PMM_RED_BLACK_TREE_PARENT(x));
-                x = pmm_red_black_tree_root;
+                pmm_red_black_tree_rotate_left(pool, PMM_RED_BLACK_TREE_PARENT(x));
+                x = pool->red_black_tree_root;
 
             }
 
@@ -477,7 +524,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (void* x) {
                 // Transform this case into a case where w is a black sibling.
                 PMM_RED_BLACK_TREE_COLOR(w)                            = pmm_red_black_tree_color::black;
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(x)) = pmm_red_black_tree_color::red;
-                pmm_red_black_tree_rotate_right(PMM_RED_BLACK_TREE_PARENT(x));
+                pmm_red_black_tree_rotate_right(pool, PMM_RED_BLACK_TREE_PARENT(x));
                 w = PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(x));
 
             }
@@ -494,7 +541,7 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (void* x) {
 
                     PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_RIGHT_CHILD(w)) = pmm_red_black_tree_color::black;
                     PMM_RED_BLACK_TREE_COLOR(w)                                 = pmm_red_black_tree_color::red;
-                    pmm_red_black_tree_rotate_left(w);
+                    pmm_red_black_tree_rotate_left(pool, w);
                     w = PMM_RED_BLACK_TREE_LEFT_CHILD(PMM_RED_BLACK_TREE_PARENT(x));
 
                 }
@@ -502,8 +549,8 @@ void Physical_Memory_Manager::pmm_red_black_tree_delete_fixup (void* x) {
                 PMM_RED_BLACK_TREE_COLOR(w)                                = PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(x));
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_PARENT(x))     = pmm_red_black_tree_color::black;
                 PMM_RED_BLACK_TREE_COLOR(PMM_RED_BLACK_TREE_LEFT_CHILD(w)) = pmm_red_black_tree_color::black;
-                pmm_red_black_tree_rotate_right(PMM_RED_BLACK_TREE_PARENT(x));
-                x = pmm_red_black_tree_root;
+                pmm_red_black_tree_rotate_right(pool, PMM_RED_BLACK_TREE_PARENT(x));
+                x = pool->red_black_tree_root;
 
             }
         }    
@@ -545,7 +592,10 @@ bool Physical_Memory_Manager::Is_Physical_Memory_Region_Usable (void* addr) {
 
         if ((((uint64_t)addr) >= mem_desc->PhysicalStart) && (((uint64_t)addr) < (mem_desc->PhysicalStart + (mem_desc->NumberOfPages * PMM_FRAME_SIZE)))) {
 
-            if (mem_desc->PhysicalStart == 0) {
+            /* Never hand out the first frame, address zero is the null pointer
+            (and holds the real mode interrupt vector table). The rest of low 
+            memory is usable, application processors start up from it. */
+            if (((uint64_t)addr) < PMM_FRAME_SIZE) {
                 return false;
             }
 
@@ -649,14 +699,62 @@ uint64_t Physical_Memory_Manager::Get_Size_of_Memory_Region (void* addr) {
     return 0;
 }
 
+/*******************************************************************************
+Get Next NUMA Node Boundary
+
+Gets the first address after the given one, and before the end address, at which
+a SRAT memory affinity range starts or ends, rounded down to a frame. Returns
+the end address if there is no such address.
+*******************************************************************************/
+uint64_t Physical_Memory_Manager::Get_Next_NUMA_Node_Boundary (uint64_t address, uint64_t end_address) {
+
+    uint64_t boundary = end_address;
+
+    if (m_num_of_nodes <= 1) {
+        return boundary;
+    }
+
+    const acpi_tables* acpi = get_acpi_tables();
+
+    for (uint64_t idx = 0; idx < acpi->num_of_memory_affinities; idx++) {
+
+        const acpi_memory_affinity* affinity = &acpi->memory_affinities[idx];
+
+        uint64_t edges[2] = {affinity->base_address, affinity->base_address + affinity->length};
+        for (uint64_t edge = 0; edge < 2; edge++) {
+
+            uint64_t frame_aligned_edge = edges[edge] & ~((uint64_t)PMM_FRAME_SIZE - 1);
+            if ((frame_aligned_edge > address) && (frame_aligned_edge < boundary)) {
+                boundary = frame_aligned_edge;
+            }
+        }
+    }
+
+    return boundary;
+
+}
+
 /******************************************************************************* 
 Initialize Physical Memory Manager Function (Constructor)
-Read memory map passed from UEFI bootloader and insert free regions into red-
-black tree.
+Read memory map passed from UEFI bootloader and insert free regions into the 
+red-black tree of the NUMA node the SRAT places them in. Must run after the ACPI
+tables are cached; without a SRAT all memory belongs to node 0.
 *******************************************************************************/
 Physical_Memory_Manager::Physical_Memory_Manager (Memory_Map_Info* mmap_info, void* pmm_null_memory) {
 
+    TRACE_BEGIN(TRACE_CATEGORY_MEMORY, "Physical_Memory_Manager");
+
     m_mmap_info = mmap_info;
+    ticket_lock_initialize(&m_lock);
+
+    /* Proximity domains index the pools directly, firmware numbers them densely
+    from zero. Domains past the last pool are folded into node 0. */
+    m_num_of_nodes = get_acpi_tables()->num_of_proximity_domains;
+    if (m_num_of_nodes == 0) {
+        m_num_of_nodes = 1;
+    } else if (m_num_of_nodes > PMM_MAX_NUM_OF_NODES) {
+        m_num_of_nodes = PMM_MAX_NUM_OF_NODES;
+    }
 
     /* Initialize pmm_red_black_tree_null as having the color black and it's
     parent and children are pmm_red_black_tree_null as well. */
@@ -666,15 +764,33 @@ Physical_Memory_Manager::Physical_Memory_Manager (Memory_Map_Info* mmap_info, vo
     PMM_RED_BLACK_TREE_LEFT_CHILD(pmm_red_black_tree_null)  = pmm_red_black_tree_null;
     PMM_RED_BLACK_TREE_RIGHT_CHILD(pmm_red_black_tree_null) = pmm_red_black_tree_null;
 
-    // Initialize the root of the tree as being the null construct.
-    pmm_red_black_tree_root = pmm_red_black_tree_null;
-    PMM_RED_BLACK_TREE_COLOR(pmm_red_black_tree_root)       = pmm_red_black_tree_color::black;
-    PMM_RED_BLACK_TREE_PARENT(pmm_red_black_tree_root)      = pmm_red_black_tree_null;
-    PMM_RED_BLACK_TREE_LEFT_CHILD(pmm_red_black_tree_root)  = pmm_red_black_tree_null;
-    PMM_RED_BLACK_TREE_RIGHT_CHILD(pmm_red_black_tree_root) = pmm_red_black_tree_null;
+    /* Initialize the root of every node's tree as being the null construct, 
+    zero the statistics and by default fall back to the other nodes in order of 
+    increasing node number after the node itself. */
+    for (uint64_t node = 0; node < PMM_MAX_NUM_OF_NODES; node++) {
+
+        pmm_node_pool* pool = &m_pools[node];
+
+        pool->red_black_tree_root = pmm_red_black_tree_null;
+
+        pool->statistics.total_bytes                 = 0;
+        pool->statistics.free_bytes                  = 0;
+        pool->statistics.num_of_allocations          = 0;
+        pool->statistics.num_of_local_allocations    = 0;
+        pool->statistics.num_of_fallback_allocations = 0;
+        pool->statistics.num_of_frees                = 0;
+        pool->statistics.num_of_failed_allocations   = 0;
 
-    // Initialize the current memory being addressed to the start of memory.
-    void* current_memory = (void*)0;
+        pool->num_of_fallback_nodes = 0;
+        for (uint64_t offset = 1; offset < m_num_of_nodes; offset++) {
+            pool->fallback_order[pool->num_of_fallback_nodes++] = (uint32_t)((node + offset) % m_num_of_nodes);
+        }
+
+    }
+
+    /* Initialize the current memory being addressed to the start of memory, 
+    skipping the first frame which is never usable. */
+    void* current_memory = (void*)PMM_FRAME_SIZE;
 
     // Loop thru the entirety of memory.
     while (true) {
@@ -692,8 +808,9 @@ Physical_Memory_Manager::Physical_Memory_Manager (Memory_Map_Info* mmap_info, vo
             uint64_t accumulated_memory_size = 0;
             while (Is_Physical_Memory_Region_Usable(current_memory)) {
 
-                // Accumulate the sizes of the usable memory regions.
-                accumulated_memory_size += Get_Size_of_Memory_Region (current_memory);
+                /* Accumulate the sizes of the usable memory regions, from the
+                current address as the first region may be entered part way. */
+                accumulated_memory_size += Get_Expected_First_Address_in_Next_Memory_Region (current_memory) - ((uint64_t)current_memory);
 
                 /* If the calculated first address of the next memory region 
                 does not match the first address of the next memory region there
@@ -716,24 +833,40 @@ Physical_Memory_Manager::Physical_Memory_Manager (Memory_Map_Info* mmap_info, vo
 
             }
 
-            /* Coalesce memory by declaring the size of the first usable region
-            as the accumulated memory size. The division by 8 is because the 
-            aligned size is only the upper 61 bits. It is guaranteed to be a 
-            multiple of 8 because the sizes are a multiple of the frame size 
-            which is 4096 which is a multiple of 8. */
-            physical_memory_size_and_flags size_and_flags;
-            size_and_flags.aligned_size = accumulated_memory_size / 8;
-            size_and_flags.is_allocated = 0;
-            size_and_flags.reserved     = 0;
-            *((physical_memory_size_and_flags*)first_usable_memory_addr) = size_and_flags;
-
-            // Copy the size and flags to the boundary tag as well.
-            physical_memory_boundary_tag boundary_tag;
-            boundary_tag.size_and_flags = size_and_flags;
-            *((physical_memory_boundary_tag*)(((uint8_t*)first_usable_memory_addr) + accumulated_memory_size - sizeof(physical_memory_boundary_tag))) = boundary_tag;
-
-            // Insert the coalesced memory region into the red-black tree.
-            pmm_red_black_tree_insert(first_usable_memory_addr);
+            /* Coalesce memory by declaring the size of each usable region as the
+            accumulated memory size, split where the region crosses from one NUMA
+            node into another so every region belongs to exactly one node. The 
+            division by 8 is because the aligned size is only the upper 61 bits.
+            It is guaranteed to be a multiple of 8 because the sizes are a 
+            multiple of the frame size which is 4096 which is a multiple of 8. */
+            uint64_t region_address     = (uint64_t)first_usable_memory_addr;
+            uint64_t region_end_address = region_address + accumulated_memory_size;
+
+            while (region_address < region_end_address) {
+
+                uint64_t region_size = Get_Next_NUMA_Node_Boundary(region_address, region_end_address) - region_address;
+                uint32_t node        = get_node_of_address((void*)region_address);
+
+                physical_memory_size_and_flags size_and_flags;
+                size_and_flags.aligned_size = region_size / 8;
+                size_and_flags.is_allocated = 0;
+                size_and_flags.reserved     = 0;
+                *((physical_memory_size_and_flags*)region_address) = size_and_flags;
+
+                // Copy the size and flags to the boundary tag as well.
+                physical_memory_boundary_tag boundary_tag;
+                boundary_tag.size_and_flags = size_and_flags;
+                *((physical_memory_boundary_tag*)(region_address + region_size - sizeof(physical_memory_boundary_tag))) = boundary_tag;
+
+                // Insert the coalesced memory region into its node's red-black tree.
+                pmm_red_black_tree_insert(&m_pools[node], (void*)region_address);
+
+                m_pools[node].statistics.total_bytes += region_size;
+                m_pools[node].statistics.free_bytes  += region_size;
+
+                region_address += region_size;
+
+            }
 
         /* The current memory address is not in a region of memory that is 
         usable to the operating system. */
@@ -751,70 +884,74 @@ Physical_Memory_Manager::Physical_Memory_Manager (Memory_Map_Info* mmap_info, vo
         }
 
     }
+
+    TRACE_END(TRACE_CATEGORY_MEMORY, "Physical_Memory_Manager");
 }
 
-/******************************************************************************* 
-Allocate Frame(s) of Physical Memory Function
-Given a size of memory to allocate, find the smallest free memory region capable 
-of fitting the frame-aligned size (best fit allocator), split the memory region 
-to the frame-aligned size if necessary, remove the entry from red-black tree, 
-and return a pointer to the address space which is the first address after the 
-header for allocated memory.
+/*******************************************************************************
+Frame Aligned Allocation Size Function
+Add the size of the allocated header and boundary tag onto the desired size and
+round it up to a multiple of the frame size.
 *******************************************************************************/
-void* Physical_Memory_Manager::allocate_physical_frames (uint64_t desired_size) {
+static uint64_t Frame_Aligned_Allocation_Size (uint64_t desired_size) {
 
     /* Add onto the size, the number of bytes the header for allocated memory
     and the boundary tag take. */
     uint64_t desired_size_modified = desired_size + sizeof(physical_memory_allocated_header) + sizeof(physical_memory_boundary_tag);
 
     // Round the desired size up to the nearest multiple of the size of a frame.
-    desired_size_modified = (((uint64_t)(desired_size_modified / PMM_FRAME_SIZE)) * PMM_FRAME_SIZE) + PMM_FRAME_SIZE;
+    return (((uint64_t)(desired_size_modified / PMM_FRAME_SIZE)) * PMM_FRAME_SIZE) + PMM_FRAME_SIZE;
 
-    // Find the free memory region that best fits the size of memory requested.
-    void* best_fit_node = pmm_red_black_tree_find_best_fit(desired_size_modified);
+}
 
-    /* If a best fit does not exist i.e. insufficient memory, return the null 
-    pointer. */
-    if (best_fit_node == pmm_red_black_tree_null) {
-        return nullptr;
-    }
+/*******************************************************************************
+Allocate Free Region Function
+Remove a free region from its node's red-black tree, mark the first allocation 
+size bytes of it allocated and return any remainder to the tree. Returns a 
+pointer to the address after the allocated header.
+*******************************************************************************/
+void* Physical_Memory_Manager::allocate_free_region (pmm_node_pool* pool, void* best_fit_node, uint64_t allocation_size) {
 
     /* Remove the best fit node form the red black tree because the memory it
     represents is now allocated. */
-    pmm_red_black_tree_delete(best_fit_node);
+    pmm_red_black_tree_delete(pool, best_fit_node);
+
+    /* Remember the size of the whole free region, the header is rewritten 
+    below with the allocated size. */
+    uint64_t size_of_free_region = PMM_RED_BLACK_TREE_KEY_VALUE(best_fit_node);
 
     // Update header and boundary tag to say this region is now allocated.
     physical_memory_size_and_flags size_and_flags;
-    size_and_flags.aligned_size = PMM_RED_BLACK_TREE_KEY_VALUE(best_fit_node) / 8;
+    size_and_flags.aligned_size = size_of_free_region / 8;
     size_and_flags.is_allocated = 1;
     size_and_flags.reserved     = 0;
     *((physical_memory_size_and_flags*)best_fit_node) = size_and_flags;
 
     physical_memory_boundary_tag boundary_tag;
     boundary_tag.size_and_flags = size_and_flags;
-    *((physical_memory_boundary_tag*)(((uint8_t*)best_fit_node) + PMM_RED_BLACK_TREE_KEY_VALUE(best_fit_node) - sizeof(physical_memory_boundary_tag))) = boundary_tag;
+    *((physical_memory_boundary_tag*)(((uint8_t*)best_fit_node) + size_of_free_region - sizeof(physical_memory_boundary_tag))) = boundary_tag;
 
     /* If the best fit memory region is bigger than desired, split the region
     into a region of the desired size and a region of size of the remaining 
     memory. */
-    if (PMM_RED_BLACK_TREE_KEY_VALUE(best_fit_node) > desired_size_modified) {
+    if (size_of_free_region > allocation_size) {
 
         /* Change the best fit node's size in the header and create a new 
         boundary tag. */
         physical_memory_size_and_flags size_and_flags;
-        size_and_flags.aligned_size = desired_size_modified / 8;
+        size_and_flags.aligned_size = allocation_size / 8;
         size_and_flags.is_allocated = 1;
         size_and_flags.reserved     = 0;
         *((physical_memory_size_and_flags*)best_fit_node) = size_and_flags;
 
         physical_memory_boundary_tag boundary_tag;
         boundary_tag.size_and_flags = size_and_flags;
-        *((physical_memory_boundary_tag*)(((uint8_t*)best_fit_node) + desired_size_modified - sizeof(physical_memory_boundary_tag))) = boundary_tag;
+        *((physical_memory_boundary_tag*)(((uint8_t*)best_fit_node) + allocation_size - sizeof(physical_memory_boundary_tag))) = boundary_tag;
 
         /* Create the new memory region of size of the remaining memory with a 
         header and boundary tag. */
-        uint64_t size_of_new_node = PMM_RED_BLACK_TREE_KEY_VALUE(best_fit_node) - desired_size_modified;
-        void* new_memory_region = (void*)(((uint8_t*)best_fit_node) + desired_size_modified);
+        uint64_t size_of_new_node = size_of_free_region - allocation_size;
+        void* new_memory_region = (void*)(((uint8_t*)best_fit_node) + allocation_size);
 
         size_and_flags.aligned_size = size_of_new_node / 8;
         size_and_flags.is_allocated = 0;
@@ -825,34 +962,153 @@ void* Physical_Memory_Manager::allocate_physical_frames (uint64_t desired_size)
         *((physical_memory_boundary_tag*)(((uint8_t*)new_memory_region) + size_of_new_node - sizeof(physical_memory_boundary_tag))) = boundary_tag;
 
         // Add the new node to the red black tree.
-        pmm_red_black_tree_insert(new_memory_region);
+        pmm_red_black_tree_insert(pool, new_memory_region);
 
     }
 
+    pool->statistics.free_bytes -= PMM_RED_BLACK_TREE_KEY_VALUE(best_fit_node);
+    pool->statistics.num_of_allocations++;
+
     /* Return a pointer to the address after the header of the best fit memory 
     region. */ 
     return ((void *)(((uint8_t*)best_fit_node) + sizeof(physical_memory_allocated_header)));
 
 }
 
+/*******************************************************************************
+Allocate From Nodes Function
+
+Try the preferred node, then its fallback nodes in order unless fallback is not
+allowed. A node is searched with an address limit when one is given (zero means
+no limit). Updates the local, fallback and failed allocation counts.
+*******************************************************************************/
+void* Physical_Memory_Manager::allocate_from_nodes (uint64_t allocation_size, uint32_t preferred_node, bool allow_fallback, uint64_t address_limit) {
+
+    TRACE_BEGIN(TRACE_CATEGORY_MEMORY, "pmm_allocate");
+
+    if (preferred_node >= m_num_of_nodes) {
+        preferred_node = 0;
+    }
+
+    pmm_node_pool* preferred_pool = &m_pools[preferred_node];
+    uint64_t num_of_candidates    = allow_fallback ? (preferred_pool->num_of_fallback_nodes + 1) : 1;
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&m_lock);
+
+    for (uint64_t idx = 0; idx < num_of_candidates; idx++) {
+
+        uint32_t       node = (idx == 0) ? preferred_node : preferred_pool->fallback_order[idx - 1];
+        pmm_node_pool* pool = &m_pools[node];
+
+        // Find the free memory region that best fits the size of memory requested.
+        void* best_fit_node;
+        if (address_limit == 0) {
+            best_fit_node = pmm_red_black_tree_find_best_fit(pool, allocation_size);
+        } else {
+            best_fit_node = pmm_red_black_tree_find_best_fit_below(pool->red_black_tree_root, allocation_size, address_limit);
+        }
+
+        if (best_fit_node != pmm_red_black_tree_null) {
+
+            if (idx == 0) {
+                pool->statistics.num_of_local_allocations++;
+            } else {
+                pool->statistics.num_of_fallback_allocations++;
+            }
+
+            void* memory = allocate_free_region(pool, best_fit_node, allocation_size);
+            ticket_lock_release_irq_restore(&m_lock, rflags);
+
+            TRACE_END(TRACE_CATEGORY_MEMORY, "pmm_allocate");
+
+            return memory;
+
+        }
+    }
+
+    /* If a best fit does not exist on any allowed node i.e. insufficient 
+    memory, return the null pointer. */
+    preferred_pool->statistics.num_of_failed_allocations++;
+    ticket_lock_release_irq_restore(&m_lock, rflags);
+
+    TRACE_INSTANT(TRACE_CATEGORY_MEMORY, "pmm_allocation_failed");
+    TRACE_END(TRACE_CATEGORY_MEMORY, "pmm_allocate");
+
+    return nullptr;
+
+}
+
+/******************************************************************************* 
+Allocate Frame(s) of Physical Memory Function
+Given a size of memory to allocate, find the smallest free memory region capable 
+of fitting the frame-aligned size (best fit allocator) on the calling 
+processor's NUMA node or, failing that, on its fallback nodes. Split the memory
+region to the frame-aligned size if necessary, remove the entry from red-black 
+tree, and return a pointer to the address space which is the first address 
+after the header for allocated memory.
+*******************************************************************************/
+void* Physical_Memory_Manager::allocate_physical_frames (uint64_t desired_size) {
+
+    uint32_t node = (m_num_of_nodes > 1) ? get_per_cpu_data()->numa_node : 0;
+
+    return allocate_from_nodes(Frame_Aligned_Allocation_Size(desired_size), node, true, 0);
+
+}
+
+/******************************************************************************* 
+Allocate Frame(s) of Physical Memory on a Node Function
+Like allocate_physical_frames but preferring the given NUMA node. Without 
+fallback the allocation fails rather than use another node's memory.
+*******************************************************************************/
+void* Physical_Memory_Manager::allocate_physical_frames_on_node (uint64_t desired_size, uint32_t node, bool allow_fallback) {
+    return allocate_from_nodes(Frame_Aligned_Allocation_Size(desired_size), node, allow_fallback, 0);
+}
+
+/******************************************************************************* 
+Allocate Frame(s) of Physical Memory Below an Address Function
+Like allocate_physical_frames but the whole allocation must lie below the given
+physical address, for memory devices or processor modes can only address (e.g.
+the real mode start up code of application processors below 1MB). The trees are
+keyed by size, so every node is visited; only meant for rare allocations.
+*******************************************************************************/
+void* Physical_Memory_Manager::allocate_physical_frames_below (uint64_t desired_size, uint64_t address_limit) {
+
+    uint32_t node = (m_num_of_nodes > 1) ? get_per_cpu_data()->numa_node : 0;
+
+    return allocate_from_nodes(Frame_Aligned_Allocation_Size(desired_size), node, true, address_limit);
+
+}
+
 /*******************************************************************************
 Free Frame(s) of Physical Memory Function
 Given a pointer to the address space free the memory allocated by updating the 
-header and boundary tag, add the region into the red-black tree after coalescing
-the freed space with other contigious free memory.
+header and boundary tag, add the region into its node's red-black tree after 
+coalescing the freed space with other contigious free memory of the same node.
 *******************************************************************************/
 void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
 
+    TRACE_BEGIN(TRACE_CATEGORY_MEMORY, "pmm_free");
+
     /* The given void pointer is the pointer to the start of allocated memory,
     go back to a pointer to the header. */
     void* memory_to_free_modified = (void*)(((uint8_t*)(memory_to_free)) - sizeof(physical_memory_allocated_header));
 
+    // Regions never span nodes, so the header's node is the whole region's node.
+    uint32_t       node = get_node_of_address(memory_to_free_modified);
+    pmm_node_pool* pool = &m_pools[node];
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&m_lock);
+
+    pool->statistics.free_bytes += PMM_RED_BLACK_TREE_KEY_VALUE(memory_to_free_modified);
+    pool->statistics.num_of_frees++;
+
     // Jump to the region on left.
     void* left_memory_address = (void*)(((uint8_t*)(memory_to_free_modified)) - sizeof(physical_memory_boundary_tag));
     bool left_is_free_and_usable = false;
 
-    // Check if we can coalesce to the left. Check if memory region is usable.
-    if (Is_Physical_Memory_Region_Usable(left_memory_address)) {
+    /* Check if we can coalesce to the left. Check if memory region is usable 
+    and on the same node, regions of other nodes are in other trees. */
+    if (Is_Physical_Memory_Region_Usable(left_memory_address) && (get_node_of_address(left_memory_address) == node)) {
 
         // Is the memory region free?
         if (PMM_IS_ALLOCATED_MEMORY_FLAG(left_memory_address) == 0) {
@@ -867,8 +1123,9 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
     void* right_memory_address = (void*)(((uint8_t*)(memory_to_free_modified)) + PMM_RED_BLACK_TREE_KEY_VALUE(memory_to_free_modified));
     bool right_is_free_and_usable = false;
 
-    // Check if we can coalesce to the right. Check if memory region is usable.
-    if (Is_Physical_Memory_Region_Usable(right_memory_address)) {
+    /* Check if we can coalesce to the right. Check if memory region is usable
+    and on the same node. */
+    if (Is_Physical_Memory_Region_Usable(right_memory_address) && (get_node_of_address(right_memory_address) == node)) {
 
         // Is the memory region free?
         if (PMM_IS_ALLOCATED_MEMORY_FLAG(right_memory_address) == 0) {
@@ -882,6 +1139,11 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
         // Calculate size of the coalesced region.
         uint64_t coalesced_size = PMM_RED_BLACK_TREE_KEY_VALUE(memory_to_free_modified) + PMM_RED_BLACK_TREE_KEY_VALUE(left_memory_address) + PMM_RED_BLACK_TREE_KEY_VALUE(right_memory_address);
 
+        /* The tree is keyed by size, remove the left and right regions before
+        the left region's size changes and reinsert the coalesced region. */
+        pmm_red_black_tree_delete(pool, right_memory_address);
+        pmm_red_black_tree_delete(pool, left_memory_address);
+
         // Start from the left region and form the newly coalesced region.
         physical_memory_size_and_flags size_and_flags;
         size_and_flags.aligned_size = coalesced_size / 8;
@@ -893,11 +1155,7 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
         boundary_tag.size_and_flags = size_and_flags;
         *((physical_memory_boundary_tag*)(((uint8_t*)left_memory_address) + coalesced_size - sizeof(physical_memory_boundary_tag))) = boundary_tag;
 
-        /* Don't need to add the recently freed memory node to the red black 
-        tree because it was coalesced into the left memory region. However, we 
-        must remove the right region that was coalesced from the tree. The left
-        memory region should already be in tree as it was free and usable. */ 
-        pmm_red_black_tree_delete(right_memory_address);
+        pmm_red_black_tree_insert(pool, left_memory_address);
 
     // Coalesce with the right memory region.
     } else if ((!left_is_free_and_usable) && right_is_free_and_usable) {
@@ -905,6 +1163,9 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
         // Calculate size of the coalesced region.
         uint64_t coalesced_size = PMM_RED_BLACK_TREE_KEY_VALUE(memory_to_free_modified) + PMM_RED_BLACK_TREE_KEY_VALUE(right_memory_address);
 
+        // Remove the right region from the tree that will be coalesced.
+        pmm_red_black_tree_delete(pool, right_memory_address);
+
         /* Start from the recently freed memory region and form the newly 
         coalesced region. */
         physical_memory_size_and_flags size_and_flags;
@@ -918,10 +1179,8 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
         *((physical_memory_boundary_tag*)(((uint8_t*)memory_to_free_modified) + coalesced_size - sizeof(physical_memory_boundary_tag))) = boundary_tag;
 
         /* Insert the newly coalesced region into the tree that starts from the
-        recently freed memory region. Remove the right region from the tree that 
-        was coalesced.*/
-        pmm_red_black_tree_insert(memory_to_free_modified);
-        pmm_red_black_tree_delete(right_memory_address);
+        recently freed memory region. */
+        pmm_red_black_tree_insert(pool, memory_to_free_modified);
 
     // Coalesce with the left memory region.
     } else if (left_is_free_and_usable && (!right_is_free_and_usable)) {
@@ -929,6 +1188,11 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
         // Calculate size of the coalesced region.
         uint64_t coalesced_size = PMM_RED_BLACK_TREE_KEY_VALUE(memory_to_free_modified) + PMM_RED_BLACK_TREE_KEY_VALUE(left_memory_address);
 
+        /* The tree is keyed by size, remove the left region before its size
+        changes. The right region is not free and usable thus it does not 
+        belong in the tree. */
+        pmm_red_black_tree_delete(pool, left_memory_address);
+
         // Start from the left region and form the newly coalesced region.
         physical_memory_size_and_flags size_and_flags;
         size_and_flags.aligned_size = coalesced_size / 8;
@@ -940,11 +1204,7 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
         boundary_tag.size_and_flags = size_and_flags;
         *((physical_memory_boundary_tag*)(((uint8_t*)left_memory_address) + coalesced_size - sizeof(physical_memory_boundary_tag))) = boundary_tag;
 
-        /* Don't need to add the recently freed memory node to the red black 
-        tree because it was coalesced into the left memory region. The left
-        memory region should already be in tree as it was free and usable. The 
-        right regon is not free and usable thus it does not belong in the tree. 
-        */ 
+        pmm_red_black_tree_insert(pool, left_memory_address);
 
     // No coalescing.
     } else {
@@ -962,7 +1222,103 @@ void Physical_Memory_Manager::free_physical_frames (void* memory_to_free) {
 
         /* Insert the recently freed memory region into the tree. The left and 
         right regions are not free and usable thus don't belong in the tree. */
-        pmm_red_black_tree_insert(memory_to_free_modified);
+        pmm_red_black_tree_insert(pool, memory_to_free_modified);
 
     }
+
+    ticket_lock_release_irq_restore(&m_lock, rflags);
+
+    TRACE_END(TRACE_CATEGORY_MEMORY, "pmm_free");
+
+}
+
+/*******************************************************************************
+Get Number of NUMA Nodes Function
+*******************************************************************************/
+uint32_t Physical_Memory_Manager::get_num_of_nodes () {
+    return m_num_of_nodes;
+}
+
+/*******************************************************************************
+Get Node of Address Function
+The NUMA node whose SRAT memory affinity range holds the physical address. 
+Memory the SRAT does not describe belongs to node 0.
+*******************************************************************************/
+uint32_t Physical_Memory_Manager::get_node_of_address (void* addr) {
+
+    if (m_num_of_nodes <= 1) {
+        return 0;
+    }
+
+    const acpi_tables* acpi = get_acpi_tables();
+
+    for (uint64_t idx = 0; idx < acpi->num_of_memory_affinities; idx++) {
+
+        const acpi_memory_affinity* affinity = &acpi->memory_affinities[idx];
+
+        if ((((uint64_t)addr) >= affinity->base_address) && (((uint64_t)addr) < (affinity->base_address + affinity->length))) {
+            return (affinity->proximity_domain < m_num_of_nodes) ? affinity->proximity_domain : 0;
+        }
+    }
+
+    return 0;
+
+}
+
+/*******************************************************************************
+Get Node of Processor Function
+The NUMA node of the processor with the given APIC ID, node 0 if the SRAT does
+not place it.
+*******************************************************************************/
+uint32_t Physical_Memory_Manager::get_node_of_processor (uint32_t apic_id) {
+
+    uint32_t proximity_domain = acpi_get_proximity_domain(apic_id);
+
+    return (proximity_domain < m_num_of_nodes) ? proximity_domain : 0;
+
+}
+
+/*******************************************************************************
+Set Fallback Order Function
+Set the nodes tried, in order, when the given node is out of memory. Nodes left
+out are never used for allocations preferring the node. Returns false if a node
+number is invalid.
+*******************************************************************************/
+bool Physical_Memory_Manager::set_fallback_order (uint32_t node, const uint32_t* fallback_nodes, uint64_t num_of_fallback_nodes) {
+
+    if ((node >= m_num_of_nodes) || (num_of_fallback_nodes >= PMM_MAX_NUM_OF_NODES)) {
+        return false;
+    }
+
+    for (uint64_t idx = 0; idx < num_of_fallback_nodes; idx++) {
+        if ((fallback_nodes[idx] >= m_num_of_nodes) || (fallback_nodes[idx] == node)) {
+            return false;
+        }
+    }
+
+    pmm_node_pool* pool = &m_pools[node];
+
+    for (uint64_t idx = 0; idx < num_of_fallback_nodes; idx++) {
+        pool->fallback_order[idx] = fallback_nodes[idx];
+    }
+    pool->num_of_fallback_nodes = num_of_fallback_nodes;
+
+    return true;
+
+}
+
+/*******************************************************************************
+Get Node Statistics Function
+Returns false if there is no such node.
+*******************************************************************************/
+bool Physical_Memory_Manager::get_node_statistics (uint32_t node, pmm_node_statistics* statistics) {
+
+    if (node >= m_num_of_nodes) {
+        return false;
+    }
+
+    *statistics = m_pools[node].statistics;
+
+    return true;
+
 }
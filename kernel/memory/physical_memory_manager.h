@@ -2,6 +2,9 @@
 #include <stdint.h>
 #include "../../shared/uefi/uefi_memory_map.h"
 #include "../../shared/graphics/fonts/pc_screen_font_v1_renderer.h"
+#include "../../shared/synchronization/ticket_lock.h"
+
+#define PMM_MAX_NUM_OF_NODES 8
 
 enum pmm_red_black_tree_color {
     black = 0,
@@ -30,36 +33,69 @@ typedef struct {
     physical_memory_size_and_flags size_and_flags;
 } physical_memory_boundary_tag;
 
+typedef struct {
+    uint64_t total_bytes;
+    uint64_t free_bytes;
+    uint64_t num_of_allocations;          // Served from this node.
+    uint64_t num_of_local_allocations;    // Served from this node, preferring it.
+    uint64_t num_of_fallback_allocations; // Served from this node, preferring another.
+    uint64_t num_of_frees;
+    uint64_t num_of_failed_allocations;   // Preferring this node, served by none.
+} pmm_node_statistics;
+
+/* The free memory of one NUMA node. Free regions never cross a node boundary so
+each region lives in exactly one node's tree. */
+typedef struct {
+    void*               red_black_tree_root;
+    uint32_t            fallback_order[PMM_MAX_NUM_OF_NODES - 1];
+    uint64_t            num_of_fallback_nodes;
+    pmm_node_statistics statistics;
+} pmm_node_pool;
+
 class Physical_Memory_Manager {
 
     public:
 
         Physical_Memory_Manager (Memory_Map_Info* mmap_info, void* pmm_null_memory);
-        void* allocate_physical_frames (uint64_t desired_size);
-        void  free_physical_frames (void* memory_to_free);
+        void*    allocate_physical_frames         (uint64_t desired_size);
+        void*    allocate_physical_frames_on_node (uint64_t desired_size, uint32_t node, bool allow_fallback);
+        void*    allocate_physical_frames_below   (uint64_t desired_size, uint64_t address_limit);
+        void     free_physical_frames             (void* memory_to_free);
+        uint32_t get_num_of_nodes                 ();
+        uint32_t get_node_of_address              (void* addr);
+        uint32_t get_node_of_processor            (uint32_t apic_id);
+        bool     set_fallback_order               (uint32_t node, const uint32_t* fallback_nodes, uint64_t num_of_fallback_nodes);
+        bool     get_node_statistics              (uint32_t node, pmm_node_statistics* statistics);
     
     private:
     
-        void* pmm_red_black_tree_root;
-        void* pmm_red_black_tree_null;
+        pmm_node_pool m_pools[PMM_MAX_NUM_OF_NODES];
+        uint32_t      m_num_of_nodes;
+        void*         pmm_red_black_tree_null;
+        ticket_lock   m_lock; // Held by allocations and frees, any processor may call them.
 
         Memory_Map_Info* m_mmap_info = nullptr;
 
-        void  pmm_red_black_tree_rotate_left                  (void* x);
-        void  pmm_red_black_tree_rotate_right                 (void* y);
-        void* pmm_red_black_tree_find_parent_of_inserted_node (uint64_t value);
-        void* pmm_red_black_tree_find_best_fit                (uint64_t value);
-        void  pmm_red_black_tree_insert                       (void* z);
-        void  pmm_red_black_tree_insert_fixup                 (void* z);
-        void  pmm_red_black_tree_transplant                   (void* u, void* v);
+        void  pmm_red_black_tree_rotate_left                  (pmm_node_pool* pool, void* x);
+        void  pmm_red_black_tree_rotate_right                 (pmm_node_pool* pool, void* y);
+        void* pmm_red_black_tree_find_parent_of_inserted_node (pmm_node_pool* pool, uint64_t value);
+        void* pmm_red_black_tree_find_best_fit                (pmm_node_pool* pool, uint64_t value);
+        void* pmm_red_black_tree_find_best_fit_below          (void* x, uint64_t value, uint64_t address_limit);
+        void  pmm_red_black_tree_insert                       (pmm_node_pool* pool, void* z);
+        void  pmm_red_black_tree_insert_fixup                 (pmm_node_pool* pool, void* z);
+        void  pmm_red_black_tree_transplant                   (pmm_node_pool* pool, void* u, void* v);
         void* pmm_red_black_tree_minimum                      (void* x);
-        void  pmm_red_black_tree_delete                       (void* z);
-        void  pmm_red_black_tree_delete_fixup                 (void* x);
+        void  pmm_red_black_tree_delete                       (pmm_node_pool* pool, void* z);
+        void  pmm_red_black_tree_delete_fixup                 (pmm_node_pool* pool, void* x);
+
+        void* allocate_free_region (pmm_node_pool* pool, void* best_fit_node, uint64_t allocation_size);
+        void* allocate_from_nodes  (uint64_t allocation_size, uint32_t preferred_node, bool allow_fallback, uint64_t address_limit);
 
         bool Is_Physical_Memory_Region_Type_Usable (UEFI_MEMORY_TYPE mem_type);
         bool Is_Physical_Memory_Region_Usable (void* addr);
         uint64_t Get_Expected_First_Address_in_Next_Memory_Region (void* addr);
         uint64_t Get_Size_of_Memory_Region (void* addr);
         uint64_t Get_Next_Memory_Region (void* addr);
+        uint64_t Get_Next_NUMA_Node_Boundary (uint64_t address, uint64_t end_address);
 
 };
@@ -0,0 +1,116 @@
+#include "tlb_shootdown.h"
+#include "../cpu/per_cpu.h"
+#include "../cpu/smp.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+// Bumped by every shootdown, a flush covers every generation up to the one read before it.
+static uint64_t tlb_shootdown_generation;
+
+/*******************************************************************************
+Flush Local TLB Function
+Reload CR3, dropping every TLB and paging-structure cache entry of the executing
+processor (the kernel maps nothing global), and record the newest shootdown the
+flush covers. The generation is read before the flush so it is never ahead of
+what the TLB has seen.
+*******************************************************************************/
+static void Flush_Local_TLB () {
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    tlb_shootdown_cpu_state* state      = &get_per_cpu_data()->tlb_shootdown;
+    uint64_t                 generation = __atomic_load_n(&tlb_shootdown_generation, __ATOMIC_SEQ_CST);
+
+    write_cr3(read_cr3());
+
+    if (generation > state->flushed_generation) {
+        __atomic_store_n(&state->flushed_generation, generation, __ATOMIC_RELEASE);
+    }
+
+    restore_interrupts(rflags);
+
+}
+
+/*******************************************************************************
+TLB Shootdown IPI Handler Function
+*******************************************************************************/
+static void TLB_Shootdown_IPI_Handler (interrupt_frame* frame) {
+
+    (void)frame;
+    Flush_Local_TLB();
+    local_apic_end_of_interrupt(&get_per_cpu_data()->apic);
+
+}
+
+/*******************************************************************************
+Setup TLB Shootdown Function
+Register the shootdown vector and join the bootstrap processor. Called once its
+local APIC is up and before the application processors start.
+*******************************************************************************/
+bool Setup_TLB_Shootdown (Interrupt_Descriptor_Table* idt) {
+
+    if (!idt->register_handler(TLB_SHOOTDOWN_VECTOR, TLB_Shootdown_IPI_Handler)) {
+        return false;
+    }
+
+    tlb_shootdown_join();
+
+    return true;
+
+}
+
+/*******************************************************************************
+TLB Shootdown Join Function
+Start taking part in shootdowns, on a processor whose local APIC is up. The
+flush follows the join so a shootdown that did not wait for this processor
+still finds its TLB clean.
+*******************************************************************************/
+void tlb_shootdown_join () {
+
+    __atomic_store_n(&get_per_cpu_data()->tlb_shootdown.joined, true, __ATOMIC_SEQ_CST);
+    Flush_Local_TLB();
+
+}
+
+/*******************************************************************************
+TLB Shootdown Function
+
+Flush the TLB of every joined processor and wait until each has done so, after
+which paging structures unlinked before the call may be freed. Shootdowns of
+other processors are serviced while waiting, so concurrent callers with
+interrupts disabled make progress, but the caller must not hold a lock that
+processors spin for with interrupts disabled. Before the caller joins no other
+processor runs, and the caller's own invalidations are all that is needed.
+*******************************************************************************/
+void tlb_shootdown () {
+
+    per_cpu_data* self = get_per_cpu_data();
+
+    if (!__atomic_load_n(&self->tlb_shootdown.joined, __ATOMIC_ACQUIRE) || (get_num_of_cpus() < 2)) {
+        return;
+    }
+
+    uint64_t generation = __atomic_add_fetch(&tlb_shootdown_generation, 1, __ATOMIC_SEQ_CST);
+
+    smp_send_ipi_to_all_others(TLB_SHOOTDOWN_VECTOR);
+    Flush_Local_TLB();
+
+    for (uint64_t idx = 0; idx < PER_CPU_MAX_NUM_OF_CPUS; idx++) {
+
+        per_cpu_data* cpu = get_per_cpu_data_of(idx);
+        if ((cpu == nullptr) || (cpu == self)) {
+            continue;
+        }
+
+        while (__atomic_load_n(&cpu->tlb_shootdown.joined, __ATOMIC_SEQ_CST) &&
+               (__atomic_load_n(&cpu->tlb_shootdown.flushed_generation, __ATOMIC_ACQUIRE) < generation)) {
+
+            if (__atomic_load_n(&self->tlb_shootdown.flushed_generation, __ATOMIC_RELAXED) <
+                __atomic_load_n(&tlb_shootdown_generation, __ATOMIC_RELAXED)) {
+                Flush_Local_TLB();
+            }
+
+            __asm__ __volatile__ ("pause");
+
+        }
+    }
+}
@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+#include "../interrupts/interrupt_descriptor_table.h"
+
+#define TLB_SHOOTDOWN_VECTOR 0xF2
+
+/* One processor's part of TLB shootdowns. The flushed generation is polled by
+processors waiting for a shootdown to complete, the rest is only written by the
+owner. */
+typedef struct {
+    bool     joined;             // Its local APIC is up and it receives the IPI.
+    uint64_t flushed_generation; // Newest shootdown its TLB has been flushed for.
+} __attribute__((aligned(64))) tlb_shootdown_cpu_state;
+
+bool Setup_TLB_Shootdown (Interrupt_Descriptor_Table* idt);
+void tlb_shootdown_join  ();
+void tlb_shootdown       ();
@@ -0,0 +1,678 @@
+#include "virtual_memory_manager.h"
+#include "tlb_shootdown.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+// Input va is a uint64_t virtual address, e is a uint64_t paging entry.
+#define VMM_PAGE_TABLES_INDEX_BITS      9
+#define VMM_PAGE_TABLES_INDEX_MASK      0x1FF
+#define VMM_PAGE_OFFSET_BITS            12
+#define VMM_PML4_SHIFT                  39
+#define VMM_ENTRY_TABLE(e)              ((uint64_t*)((e) & PAGE_TABLES_ENTRY_ADDRESS_MASK))
+#define VMM_IS_ENTRY_PRESENT(e)         (((e) & PAGE_TABLES_ENTRY_PRESENT) != 0)
+#define VMM_IS_ENTRY_HUGE_PAGE(e)       (((e) & PAGE_TABLES_ENTRY_PAGE_SIZE) != 0)
+#define VMM_TRANSLATION_CACHE_INDEX(va) (((va) >> VMM_PAGE_OFFSET_BITS) % VMM_TRANSLATION_CACHE_NUM_OF_LINES)
+#define VMM_LEVEL_PAGE_SIZE(level)      (1ULL << (VMM_PAGE_OFFSET_BITS + (((level) - 1) * VMM_PAGE_TABLES_INDEX_BITS)))
+#define VMM_ENTRY_PAT_4KB               (1ULL << 7)  // PAT bit of an entry mapping a 4KB page.
+#define VMM_ENTRY_PAT_HUGE              (1ULL << 12) // PAT bit of an entry mapping a 2MB or 1GB page.
+#define VMM_LOWER_HALF_END              (1ULL << 47)
+
+/*******************************************************************************
+Initialize Virtual Memory Manager Function (Constructor)
+Adopt the page tables currently loaded in CR3, which are the identity mapped
+tables built by the bootloader.
+*******************************************************************************/
+Virtual_Memory_Manager::Virtual_Memory_Manager (Physical_Memory_Manager* pmm) {
+
+    m_pmm                    = pmm;
+    m_pml4                   = (uint64_t*)(read_cr3() & PAGE_TABLES_ENTRY_ADDRESS_MASK);
+    m_free_page_table_frames           = nullptr;
+    m_num_of_retired_page_table_frames = 0;
+    m_shootdown_pending                = false;
+    m_promotion_cursor                 = 0;
+
+    ticket_lock_initialize(&m_lock);
+
+    /* Generation zero is never current so zeroed translation cache lines are
+    never mistaken for valid translations. */
+    m_generation = 1;
+
+}
+
+/*******************************************************************************
+Find Page Table Entries Function
+Descend the four levels of paging structures for a virtual address, recording a
+pointer to the entry used at each level in entries (indexed by level, entries
+below the level the walk stopped at are set to nullptr). Returns the level of
+the leaf entry mapping the address or 0 if the address is not mapped.
+*******************************************************************************/
+uint64_t Virtual_Memory_Manager::find_page_table_entries (uint64_t virtual_address, uint64_t** entries) {
+
+    for (uint64_t level = page_table_level; level <= page_map_level_4_level; level++) {
+        entries[level] = nullptr;
+    }
+
+    uint64_t* table = m_pml4;
+    uint64_t  shift = VMM_PML4_SHIFT;
+
+    for (uint64_t level = page_map_level_4_level; level >= page_table_level; level--) {
+
+        uint64_t* entry = &table[(virtual_address >> shift) & VMM_PAGE_TABLES_INDEX_MASK];
+        entries[level]  = entry;
+
+        if (!VMM_IS_ENTRY_PRESENT(*entry)) {
+            return 0;
+        }
+
+        /* The entry is a leaf if it is in a page table or it maps a 1GB or 2MB
+        page in a page directory pointer table or page directory. */
+        if ((level == page_table_level) ||
+            ((level != page_map_level_4_level) && VMM_IS_ENTRY_HUGE_PAGE(*entry))) {
+            return level;
+        }
+
+        table  = VMM_ENTRY_TABLE(*entry);
+        shift -= VMM_PAGE_TABLES_INDEX_BITS;
+
+    }
+
+    return 0;
+
+}
+
+/*******************************************************************************
+Walk Page Tables Function
+Return the leaf entry mapping a virtual address, the level it was found at, the
+size of the page it maps and the translated physical address. Returns false if
+the address is not mapped.
+*******************************************************************************/
+bool Virtual_Memory_Manager::walk_page_tables (uint64_t virtual_address, vmm_page_table_walk_result* result) {
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&m_lock);
+
+    uint64_t* entries[page_map_level_4_level + 1];
+    uint64_t  level = find_page_table_entries(virtual_address, entries);
+
+    if (level == 0) {
+        ticket_lock_release_irq_restore(&m_lock, rflags);
+        return false;
+    }
+
+    uint64_t page_size = VMM_LEVEL_PAGE_SIZE(level);
+
+    result->entry            = entries[level];
+    result->level            = (vmm_page_table_level)level;
+    result->page_size        = page_size;
+    result->physical_address = (*entries[level] & PAGE_TABLES_ENTRY_ADDRESS_MASK & ~(page_size - 1)) |
+                               (virtual_address & (page_size - 1));
+
+    ticket_lock_release_irq_restore(&m_lock, rflags);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Virtual to Physical Function
+Translate a virtual address to a physical address through the executing
+processor's translation cache, walking the page tables only on a miss. Returns
+VMM_INVALID_PHYSICAL_ADDRESS if the address is not mapped. Interrupts stay
+disabled throughout, so neither an interrupt handler nor a thread switched to
+on this processor sees a line half-written, and the cache stays the one of the
+processor the lookup started on.
+*******************************************************************************/
+uint64_t Virtual_Memory_Manager::virtual_to_physical (uint64_t virtual_address) {
+
+    uint64_t               rflags = save_and_disable_interrupts();
+    vmm_translation_cache* cache  = &get_per_cpu_data()->translation_cache;
+
+    /* Read the generation before walking so a translation removed while this
+    walk is in progress is cached under an already stale generation. */
+    uint64_t generation = __atomic_load_n(&m_generation, __ATOMIC_ACQUIRE);
+
+    // The cache is owned by another address space, invalidate all lines.
+    if (cache->owner != this) {
+        for (uint64_t idx = 0; idx < VMM_TRANSLATION_CACHE_NUM_OF_LINES; idx++) {
+            cache->lines[idx].generation = 0;
+        }
+        cache->owner = this;
+    }
+
+    uint64_t                    virtual_page = virtual_address & ~(VMM_PAGE_SIZE_4KB - 1);
+    vmm_translation_cache_line* line         = &cache->lines[VMM_TRANSLATION_CACHE_INDEX(virtual_address)];
+
+    // Cache hit.
+    if ((line->generation == generation) && (line->virtual_page == virtual_page)) {
+        uint64_t physical_address = line->physical_page | (virtual_address & (VMM_PAGE_SIZE_4KB - 1));
+        restore_interrupts(rflags);
+        return physical_address;
+    }
+
+    // Cache miss, walk the page tables and fill the line.
+    vmm_page_table_walk_result result;
+    if (!walk_page_tables(virtual_address, &result)) {
+        restore_interrupts(rflags);
+        return VMM_INVALID_PHYSICAL_ADDRESS;
+    }
+
+    line->virtual_page  = virtual_page;
+    line->physical_page = result.physical_address & ~(VMM_PAGE_SIZE_4KB - 1);
+    line->generation    = generation;
+
+    restore_interrupts(rflags);
+
+    return result.physical_address;
+
+}
+
+/*******************************************************************************
+Map Page Function
+Map a 4KB virtual page to a physical frame with the given entry flags, creating
+any missing intermediate paging structures and demoting any huge page the page
+lies within. Returns false if a paging structure could not be allocated.
+Replacing a live mapping shoots it down on every processor before returning.
+*******************************************************************************/
+bool Virtual_Memory_Manager::map_page (uint64_t virtual_address, uint64_t physical_address, uint64_t flags) {
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&m_lock);
+    bool     result = map_page_locked(virtual_address, physical_address, flags);
+    unlock_and_shoot_down(rflags);
+
+    return result;
+
+}
+
+/*******************************************************************************
+Map Page Locked Function
+The body of map_page, called with the lock held.
+*******************************************************************************/
+bool Virtual_Memory_Manager::map_page_locked (uint64_t virtual_address, uint64_t physical_address, uint64_t flags) {
+
+    uint64_t* table = m_pml4;
+    uint64_t  shift = VMM_PML4_SHIFT;
+
+    // Descend to the page table, creating missing tables on the way.
+    for (uint64_t level = page_map_level_4_level; level > page_table_level; level--) {
+
+        uint64_t* entry = &table[(virtual_address >> shift) & VMM_PAGE_TABLES_INDEX_MASK];
+
+        if (!VMM_IS_ENTRY_PRESENT(*entry)) {
+
+            uint64_t* new_table = allocate_page_table_frame();
+            if (new_table == nullptr) {
+                return false;
+            }
+
+            *entry = ((uint64_t)new_table) | PAGE_TABLES_KERNEL_TABLE_ENTRY_TEMPLATE |
+                     (flags & PAGE_TABLES_ENTRY_USER_SUPERVISOR);
+
+        } else if (VMM_IS_ENTRY_HUGE_PAGE(*entry)) {
+
+            if (!demote_huge_page(entry, level, virtual_address)) {
+                return false;
+            }
+        }
+
+        table  = VMM_ENTRY_TABLE(*entry);
+        shift -= VMM_PAGE_TABLES_INDEX_BITS;
+
+    }
+
+    uint64_t* entry     = &table[(virtual_address >> shift) & VMM_PAGE_TABLES_INDEX_MASK];
+    uint64_t  old_entry = *entry;
+    uint64_t  new_entry = (physical_address & PAGE_TABLES_ENTRY_ADDRESS_MASK) | flags | PAGE_TABLES_ENTRY_PRESENT;
+
+    *entry = new_entry;
+
+    /* Replacing a live mapping invalidates any cached translation of it. Mapping
+    a page again the same way, as each processor does with its local APIC before
+    it can take part in shootdowns, leaves cached translations valid. */
+    const uint64_t MERGED_BITS = PAGE_TABLES_ENTRY_ACCESSED | PAGE_TABLES_ENTRY_DIRTY;
+    if (VMM_IS_ENTRY_PRESENT(old_entry) && (((old_entry ^ new_entry) & ~MERGED_BITS) != 0)) {
+        invalidate_page(virtual_address);
+        advance_generation();
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Unmap Page Function
+Remove the mapping of a 4KB virtual page, demoting the huge page it lies within
+if necessary, and reclaim any paging structures left empty. Returns false if the
+page is not mapped or a huge page could not be demoted.
+The mapping is shot down on every processor before returning.
+*******************************************************************************/
+bool Virtual_Memory_Manager::unmap_page (uint64_t virtual_address) {
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&m_lock);
+    bool     result = unmap_page_locked(virtual_address);
+    unlock_and_shoot_down(rflags);
+
+    return result;
+
+}
+
+/*******************************************************************************
+Unmap Page Locked Function
+The body of unmap_page, called with the lock held.
+*******************************************************************************/
+bool Virtual_Memory_Manager::unmap_page_locked (uint64_t virtual_address) {
+
+    uint64_t* entries[page_map_level_4_level + 1];
+    uint64_t  level = find_page_table_entries(virtual_address, entries);
+
+    if (level == 0) {
+        return false;
+    }
+
+    // Partially unmapping a huge page, split it until a page table maps it.
+    while (level != page_table_level) {
+
+        if (!demote_huge_page(entries[level], level, virtual_address)) {
+            return false;
+        }
+
+        level = find_page_table_entries(virtual_address, entries);
+
+    }
+
+    *entries[page_table_level] = 0;
+
+    reclaim_empty_page_tables(entries, page_table_level);
+
+    invalidate_page(virtual_address);
+    advance_generation();
+
+    return true;
+
+}
+
+/*******************************************************************************
+Protect Page Function
+Replace the entry flags of a mapped 4KB virtual page keeping its frame and its
+accessed and dirty state, demoting the huge page it lies within if necessary.
+Returns false if the page is not mapped or a huge page could not be demoted.
+The old entry is shot down on every processor before returning.
+*******************************************************************************/
+bool Virtual_Memory_Manager::protect_page (uint64_t virtual_address, uint64_t flags) {
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&m_lock);
+    bool     result = protect_page_locked(virtual_address, flags);
+    unlock_and_shoot_down(rflags);
+
+    return result;
+
+}
+
+/*******************************************************************************
+Protect Page Locked Function
+The body of protect_page, called with the lock held.
+*******************************************************************************/
+bool Virtual_Memory_Manager::protect_page_locked (uint64_t virtual_address, uint64_t flags) {
+
+    uint64_t* entries[page_map_level_4_level + 1];
+    uint64_t  level = find_page_table_entries(virtual_address, entries);
+
+    if (level == 0) {
+        return false;
+    }
+
+    // Partially protecting a huge page, split it until a page table maps it.
+    while (level != page_table_level) {
+
+        if (!demote_huge_page(entries[level], level, virtual_address)) {
+            return false;
+        }
+
+        level = find_page_table_entries(virtual_address, entries);
+
+    }
+
+    const uint64_t KEPT_BITS = PAGE_TABLES_ENTRY_ADDRESS_MASK | PAGE_TABLES_ENTRY_ACCESSED | PAGE_TABLES_ENTRY_DIRTY;
+
+    uint64_t* entry = entries[page_table_level];
+    *entry = (*entry & KEPT_BITS) | flags | PAGE_TABLES_ENTRY_PRESENT;
+
+    invalidate_page(virtual_address);
+    advance_generation();
+
+    return true;
+
+}
+
+/*******************************************************************************
+Promote Huge Pages Function
+Background pass over the lower half of the address space. Each call examines at
+most the given number of regions, resuming where the previous call stopped, and
+replaces every page table that maps a physically contiguous, 2MB aligned run of
+uniformly protected 4KB pages with a single 2MB page. Returns the number of page
+tables promoted.
+Page tables replaced are freed once no processor's TLB can reference them.
+*******************************************************************************/
+uint64_t Virtual_Memory_Manager::promote_huge_pages (uint64_t max_num_of_regions) {
+
+    uint64_t rflags = ticket_lock_acquire_irq_save(&m_lock);
+    uint64_t result = promote_huge_pages_locked(max_num_of_regions);
+    unlock_and_shoot_down(rflags);
+
+    return result;
+
+}
+
+/*******************************************************************************
+Promote Huge Pages Locked Function
+The body of promote_huge_pages, called with the lock held.
+*******************************************************************************/
+uint64_t Virtual_Memory_Manager::promote_huge_pages_locked (uint64_t max_num_of_regions) {
+
+    uint64_t num_of_promoted = 0;
+
+    for (uint64_t region = 0; region < max_num_of_regions; region++) {
+
+        // Each promotion retires a page table, stop while there is room for one.
+        if (m_num_of_retired_page_table_frames == VMM_MAX_NUM_OF_RETIRED_FRAMES) {
+            break;
+        }
+
+        uint64_t virtual_address = m_promotion_cursor;
+
+        uint64_t* entries[page_map_level_4_level + 1];
+        find_page_table_entries(virtual_address, entries);
+
+        /* Skip the whole range of an absent PML4 or page directory pointer 
+        table entry rather than visiting each of its 2MB regions. */
+        uint64_t region_size = VMM_PAGE_SIZE_2MB;
+        if (!VMM_IS_ENTRY_PRESENT(*entries[page_map_level_4_level])) {
+            region_size = VMM_LEVEL_PAGE_SIZE(page_map_level_4_level);
+        } else if ((!VMM_IS_ENTRY_PRESENT(*entries[page_directory_pointer_table_level])) ||
+                   VMM_IS_ENTRY_HUGE_PAGE(*entries[page_directory_pointer_table_level])) {
+            region_size = VMM_LEVEL_PAGE_SIZE(page_directory_pointer_table_level);
+        } else {
+
+            uint64_t* page_directory_entry = entries[page_directory_level];
+
+            if (VMM_IS_ENTRY_PRESENT(*page_directory_entry) &&
+                (!VMM_IS_ENTRY_HUGE_PAGE(*page_directory_entry)) &&
+                try_promote_page_table(page_directory_entry, virtual_address)) {
+                num_of_promoted++;
+            }
+        }
+
+        m_promotion_cursor = (virtual_address & ~(region_size - 1)) + region_size;
+        if (m_promotion_cursor >= VMM_LOWER_HALF_END) {
+            m_promotion_cursor = 0;
+        }
+    }
+
+    return num_of_promoted;
+
+}
+
+/*******************************************************************************
+Try Promote Page Table Function
+Replace the page table referenced by a page directory entry with a 2MB page if
+all 512 entries map consecutive frames of a 2MB aligned physical region with the
+same flags, and the page directory entry grants at least those permissions. The
+translations do not change, so translation caches stay valid.
+*******************************************************************************/
+bool Virtual_Memory_Manager::try_promote_page_table (uint64_t* page_directory_entry, uint64_t virtual_address) {
+
+    uint64_t* table = VMM_ENTRY_TABLE(*page_directory_entry);
+
+    // Accessed and dirty state may differ between pages and is merged.
+    const uint64_t MERGED_BITS = PAGE_TABLES_ENTRY_ACCESSED | PAGE_TABLES_ENTRY_DIRTY;
+
+    uint64_t base_address = table[0] & PAGE_TABLES_ENTRY_ADDRESS_MASK;
+    uint64_t flags        = table[0] & ~(PAGE_TABLES_ENTRY_ADDRESS_MASK | MERGED_BITS);
+
+    if ((!VMM_IS_ENTRY_PRESENT(table[0])) || ((base_address & (VMM_PAGE_SIZE_2MB - 1)) != 0)) {
+        return false;
+    }
+
+    /* The page directory entry must not be more restrictive than the pages,
+    otherwise promotion would widen the effective permissions. */
+    const uint64_t PERMISSION_BITS = PAGE_TABLES_ENTRY_READ_WRITE | PAGE_TABLES_ENTRY_USER_SUPERVISOR;
+    if (((flags & PERMISSION_BITS) & ~(*page_directory_entry & PERMISSION_BITS)) != 0) {
+        return false;
+    }
+    if (((*page_directory_entry & PAGE_TABLES_ENTRY_EXECUTE_DISABLE) != 0) &&
+        ((flags & PAGE_TABLES_ENTRY_EXECUTE_DISABLE) == 0)) {
+        return false;
+    }
+
+    uint64_t merged = 0;
+    for (uint64_t idx = 0; idx < PAGE_TABLES_NUM_OF_ENTRIES; idx++) {
+
+        uint64_t entry = table[idx];
+
+        if (((entry & PAGE_TABLES_ENTRY_ADDRESS_MASK) != (base_address + (idx * VMM_PAGE_SIZE_4KB))) ||
+            ((entry & ~(PAGE_TABLES_ENTRY_ADDRESS_MASK | MERGED_BITS)) != flags)) {
+            return false;
+        }
+
+        merged |= (entry & MERGED_BITS);
+
+    }
+
+    // The PAT bit moves from bit 7 in a 4KB entry to bit 12 in a 2MB entry.
+    uint64_t huge_flags = (flags & ~VMM_ENTRY_PAT_4KB) | merged | PAGE_TABLES_ENTRY_PAGE_SIZE;
+    if ((flags & VMM_ENTRY_PAT_4KB) != 0) {
+        huge_flags |= VMM_ENTRY_PAT_HUGE;
+    }
+
+    *page_directory_entry = base_address | huge_flags;
+
+    invalidate_page(virtual_address);
+    retire_page_table_frame(table);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Demote Huge Page Function
+Split the 1GB or 2MB page mapped by an entry at the given level into a table of
+512 entries of the next smaller page size with the same frames and flags. The
+translations do not change, so translation caches stay valid.
+*******************************************************************************/
+bool Virtual_Memory_Manager::demote_huge_page (uint64_t* entry, uint64_t level, uint64_t virtual_address) {
+
+    uint64_t* table = allocate_page_table_frame();
+    if (table == nullptr) {
+        return false;
+    }
+
+    uint64_t huge_entry   = *entry;
+    uint64_t page_size    = VMM_LEVEL_PAGE_SIZE(level);
+    uint64_t child_size   = VMM_LEVEL_PAGE_SIZE(level - 1);
+    uint64_t base_address = huge_entry & PAGE_TABLES_ENTRY_ADDRESS_MASK & ~(page_size - 1);
+    uint64_t child_flags  = huge_entry & ~(PAGE_TABLES_ENTRY_ADDRESS_MASK | VMM_ENTRY_PAT_HUGE);
+
+    // 4KB entries have no page size bit, bit 7 is their PAT bit instead.
+    if ((level - 1) == page_table_level) {
+        child_flags &= ~PAGE_TABLES_ENTRY_PAGE_SIZE;
+        if ((huge_entry & VMM_ENTRY_PAT_HUGE) != 0) {
+            child_flags |= VMM_ENTRY_PAT_4KB;
+        }
+    } else {
+        child_flags |= (huge_entry & VMM_ENTRY_PAT_HUGE);
+    }
+
+    for (uint64_t idx = 0; idx < PAGE_TABLES_NUM_OF_ENTRIES; idx++) {
+        table[idx] = (base_address + (idx * child_size)) | child_flags;
+    }
+
+    *entry = ((uint64_t)table) | PAGE_TABLES_KERNEL_TABLE_ENTRY_TEMPLATE |
+             (huge_entry & PAGE_TABLES_ENTRY_USER_SUPERVISOR);
+
+    // Drop the TLB's huge page entry so entries of two page sizes never mix.
+    invalidate_page(virtual_address);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Is Page Table Empty Function
+*******************************************************************************/
+bool Virtual_Memory_Manager::is_page_table_empty (uint64_t* table) {
+
+    for (uint64_t idx = 0; idx < PAGE_TABLES_NUM_OF_ENTRIES; idx++) {
+        if (table[idx] != 0) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Reclaim Empty Page Tables Function
+After an entry at the given level is cleared, retire each paging structure that
+is left with no entries and clear the entry referencing it, moving up the levels
+until a structure still in use is found. The PML4 is never freed.
+*******************************************************************************/
+void Virtual_Memory_Manager::reclaim_empty_page_tables (uint64_t** entries, uint64_t leaf_level) {
+
+    for (uint64_t level = leaf_level; level < page_map_level_4_level; level++) {
+
+        uint64_t* table = (uint64_t*)(((uint64_t)entries[level]) & ~((uint64_t)(PAGE_TABLES_SIZE - 1)));
+
+        if (!is_page_table_empty(table)) {
+            break;
+        }
+
+        *entries[level + 1] = 0;
+        retire_page_table_frame(table);
+
+    }
+}
+
+/*******************************************************************************
+Get Generation Function
+*******************************************************************************/
+uint64_t Virtual_Memory_Manager::get_generation () {
+    return __atomic_load_n(&m_generation, __ATOMIC_ACQUIRE);
+}
+
+/*******************************************************************************
+Advance Generation Function
+Invalidates every translation cache line filled before this call.
+*******************************************************************************/
+void Virtual_Memory_Manager::advance_generation () {
+    __atomic_add_fetch(&m_generation, 1, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+Allocate Page Table Frame Function
+Return a zeroed, 4KB aligned frame for a paging structure. Frames are carved
+from batches allocated from the PMM since PMM allocations are not frame aligned.
+*******************************************************************************/
+uint64_t* Virtual_Memory_Manager::allocate_page_table_frame () {
+
+    if (m_free_page_table_frames == nullptr) {
+
+        /* One frame more than the batch is requested, the PMM header puts the
+        first aligned frame one frame into the allocation. */
+        uint8_t* batch = (uint8_t*)m_pmm->allocate_physical_frames((VMM_PAGE_TABLE_FRAME_BATCH_SIZE + 1) * PAGE_TABLES_SIZE);
+        if (batch == nullptr) {
+            return nullptr;
+        }
+
+        uint64_t first_frame = (((uint64_t)batch) + PAGE_TABLES_SIZE - 1) & ~((uint64_t)(PAGE_TABLES_SIZE - 1));
+        for (uint64_t idx = 0; idx < VMM_PAGE_TABLE_FRAME_BATCH_SIZE; idx++) {
+            free_page_table_frame((uint64_t*)(first_frame + (idx * PAGE_TABLES_SIZE)));
+        }
+    }
+
+    uint64_t* frame = (uint64_t*)m_free_page_table_frames;
+    m_free_page_table_frames = *((void**)frame);
+
+    for (uint64_t idx = 0; idx < PAGE_TABLES_NUM_OF_ENTRIES; idx++) {
+        frame[idx] = 0;
+    }
+
+    return frame;
+
+}
+
+/*******************************************************************************
+Free Page Table Frame Function
+Return a paging structure frame to the free list, linked through its first
+entry.
+*******************************************************************************/
+void Virtual_Memory_Manager::free_page_table_frame (uint64_t* frame) {
+
+    *((void**)frame) = m_free_page_table_frames;
+    m_free_page_table_frames = (void*)frame;
+
+}
+
+/*******************************************************************************
+Invalidate Page Function
+Drop the executing processor's translation of a page and note that the other
+processors must drop theirs before the lock holder returns.
+*******************************************************************************/
+void Virtual_Memory_Manager::invalidate_page (uint64_t virtual_address) {
+
+    invlpg(virtual_address);
+    m_shootdown_pending = true;
+
+}
+
+/*******************************************************************************
+Retire Page Table Frame Function
+Hold back a paging structure that was unlinked from the tables. Other processors
+may still walk it through their paging-structure caches until they are shot
+down, so it is kept intact, rather than linked through its first entry, and
+only freed after that.
+*******************************************************************************/
+void Virtual_Memory_Manager::retire_page_table_frame (uint64_t* frame) {
+    m_retired_page_table_frames[m_num_of_retired_page_table_frames++] = frame;
+}
+
+/*******************************************************************************
+Unlock and Shoot Down Function
+
+Release the lock taken by an update and, if it invalidated anything, shoot down
+every processor's TLB and only then free the paging structures it retired. The
+shootdown waits for processors that may be spinning for the lock with
+interrupts disabled, so it runs after the lock is released.
+*******************************************************************************/
+void Virtual_Memory_Manager::unlock_and_shoot_down (uint64_t rflags) {
+
+    bool      shootdown_pending = m_shootdown_pending;
+    uint64_t  num_of_retired    = m_num_of_retired_page_table_frames;
+    uint64_t* retired_frames[VMM_MAX_NUM_OF_RETIRED_FRAMES];
+
+    for (uint64_t idx = 0; idx < num_of_retired; idx++) {
+        retired_frames[idx] = m_retired_page_table_frames[idx];
+    }
+
+    m_shootdown_pending                = false;
+    m_num_of_retired_page_table_frames = 0;
+
+    ticket_lock_release_irq_restore(&m_lock, rflags);
+
+    if (!shootdown_pending) {
+        return;
+    }
+
+    tlb_shootdown();
+
+    if (num_of_retired == 0) {
+        return;
+    }
+
+    rflags = ticket_lock_acquire_irq_save(&m_lock);
+
+    for (uint64_t idx = 0; idx < num_of_retired; idx++) {
+        free_page_table_frame(retired_frames[idx]);
+    }
+
+    ticket_lock_release_irq_restore(&m_lock, rflags);
+
+}
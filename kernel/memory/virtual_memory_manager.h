@@ -0,0 +1,87 @@
+#pragma once
+#include <stdint.h>
+#include "../../shared/memory/paging.h"
+#include "physical_memory_manager.h"
+
+#define VMM_PAGE_SIZE_4KB                  0x1000ULL
+#define VMM_PAGE_SIZE_2MB                  0x200000ULL
+#define VMM_PAGE_SIZE_1GB                  0x40000000ULL
+#define VMM_INVALID_PHYSICAL_ADDRESS       0xFFFFFFFFFFFFFFFFULL
+#define VMM_TRANSLATION_CACHE_NUM_OF_LINES 64
+#define VMM_PAGE_TABLE_FRAME_BATCH_SIZE    16
+#define VMM_MAX_NUM_OF_RETIRED_FRAMES      16 // Page tables one update may unlink, at least one per level.
+
+// Paging structure levels, numbered from the leaf page table upwards.
+enum vmm_page_table_level {
+    page_table_level                   = 1,
+    page_directory_level               = 2,
+    page_directory_pointer_table_level = 3,
+    page_map_level_4_level             = 4
+};
+
+typedef struct {
+    uint64_t*            entry;
+    vmm_page_table_level level;
+    uint64_t             page_size;
+    uint64_t             physical_address;
+} vmm_page_table_walk_result;
+
+typedef struct {
+    uint64_t virtual_page;
+    uint64_t physical_page;
+    uint64_t generation;
+} vmm_translation_cache_line;
+
+/* Direct-mapped cache of virtual to physical page translations. A line is only
+valid while its generation matches the generation of the owning virtual memory
+manager, which changes whenever a mapping is removed or its protection is
+changed. */
+typedef struct {
+    void*                      owner;
+    vmm_translation_cache_line lines[VMM_TRANSLATION_CACHE_NUM_OF_LINES];
+} vmm_translation_cache;
+
+class Virtual_Memory_Manager {
+
+    public:
+
+        Virtual_Memory_Manager (Physical_Memory_Manager* pmm);
+        bool     walk_page_tables    (uint64_t virtual_address, vmm_page_table_walk_result* result);
+        uint64_t virtual_to_physical (uint64_t virtual_address);
+        bool     map_page            (uint64_t virtual_address, uint64_t physical_address, uint64_t flags);
+        bool     unmap_page          (uint64_t virtual_address);
+        bool     protect_page        (uint64_t virtual_address, uint64_t flags);
+        uint64_t get_generation      ();
+        uint64_t promote_huge_pages  (uint64_t max_num_of_regions);
+
+    private:
+
+        uint64_t*                m_pml4;
+        Physical_Memory_Manager* m_pmm;
+        uint64_t                 m_generation;
+        void*                    m_free_page_table_frames;
+        uint64_t                 m_promotion_cursor;
+        ticket_lock              m_lock;              // Held by walks and updates, any processor may call them.
+        bool                     m_shootdown_pending; // Invalidated locally, other processors still to follow.
+
+        // Page tables unlinked by the update in progress, freed after its shootdown.
+        uint64_t*                m_retired_page_table_frames[VMM_MAX_NUM_OF_RETIRED_FRAMES];
+        uint64_t                 m_num_of_retired_page_table_frames;
+
+        bool      map_page_locked           (uint64_t virtual_address, uint64_t physical_address, uint64_t flags);
+        bool      unmap_page_locked         (uint64_t virtual_address);
+        bool      protect_page_locked       (uint64_t virtual_address, uint64_t flags);
+        uint64_t  promote_huge_pages_locked (uint64_t max_num_of_regions);
+        uint64_t  find_page_table_entries   (uint64_t virtual_address, uint64_t** entries);
+        bool      demote_huge_page          (uint64_t* entry, uint64_t level, uint64_t virtual_address);
+        bool      try_promote_page_table    (uint64_t* page_directory_entry, uint64_t virtual_address);
+        bool      is_page_table_empty       (uint64_t* table);
+        void      reclaim_empty_page_tables (uint64_t** entries, uint64_t leaf_level);
+        uint64_t* allocate_page_table_frame ();
+        void      free_page_table_frame     (uint64_t* frame);
+        void      retire_page_table_frame   (uint64_t* frame);
+        void      invalidate_page           (uint64_t virtual_address);
+        void      unlock_and_shoot_down     (uint64_t rflags);
+        void      advance_generation        ();
+
+};
@@ -0,0 +1,218 @@
+#include "edge_profile.h"
+#include "../log/kernel_log.h"
+
+/* Only the instrument build (make CONFIG=instrument) has counters to dump, and
+only it links libgcov. */
+#ifdef KERNEL_EDGE_PROFILE
+
+// libgcov's freestanding interface, as declared by GCC's gcov.h (GCC 12 on).
+struct gcov_info;
+extern "C" {
+void __gcov_info_to_gcda (const gcov_info* info,
+                          void (*filename_fn) (const char* filename, void* arg),
+                          void (*dump_fn) (const void* data, unsigned length, void* arg),
+                          void* (*allocate_fn) (unsigned length, void* arg),
+                          void* arg);
+
+// From kernel.ld, relocated by Relocate_Kernel_Image.
+extern const gcov_info* const kernel_gcov_info_start[] __attribute__((visibility("hidden")));
+extern const gcov_info* const kernel_gcov_info_end[]   __attribute__((visibility("hidden")));
+}
+
+// Where the gcda stream goes while dumping.
+typedef struct {
+    serial_port* port;
+    uint64_t     num_of_bytes;
+    uint64_t     line_length;
+    uint8_t      line[EDGE_PROFILE_BYTES_PER_LINE];
+    uint64_t     scratch_used;
+} edge_profile_stream;
+
+static uint8_t edge_profile_scratch[EDGE_PROFILE_SCRATCH_SIZE] __attribute__((aligned(16)));
+
+/*******************************************************************************
+libgcov Support Functions
+
+The counters' merge function, referenced from every gcov_info. libgcov's own
+pulls in its whole file based driver, and merging is done on the host, so the
+kernel's never runs. abort and mmap are referenced by libgcov's encoder on
+paths edge counters never take; weak, so a libgcov built without them still
+links.
+*******************************************************************************/
+extern "C" void __gcov_merge_add (int64_t* counters, unsigned num_of_counters) {
+    (void)counters;
+    (void)num_of_counters;
+}
+
+extern "C" __attribute__((weak, noreturn)) void abort () {
+    while (1) {
+        __asm__ __volatile__ ("cli; hlt");
+    }
+}
+
+extern "C" __attribute__((weak)) void* mmap (void* address, uint64_t length, int protection, int flags, int fd, int64_t offset) {
+    (void)address;
+    (void)length;
+    (void)protection;
+    (void)flags;
+    (void)fd;
+    (void)offset;
+    return (void*)-1; // MAP_FAILED
+}
+
+/*******************************************************************************
+Write Function
+Queue text, waiting for room in the transmit ring instead of dropping it.
+*******************************************************************************/
+static void Write (serial_port* port, const char* data, uint64_t length) {
+
+    while ((length != 0) && (serial_port_write(port, data, length) == 0)) {
+        serial_port_flush(port);
+    }
+
+}
+
+/*******************************************************************************
+Flush Line Function
+*******************************************************************************/
+static void Flush_Line (edge_profile_stream* stream) {
+
+    const char HEX_DIGITS[] = "0123456789abcdef";
+
+    if (stream->line_length == 0) {
+        return;
+    }
+
+    char     text[5 + (2 * EDGE_PROFILE_BYTES_PER_LINE) + 2] = { 'G', 'C', 'O', 'V', ' ' };
+    uint64_t length = 5;
+    for (uint64_t idx = 0; idx < stream->line_length; idx++) {
+        text[length++] = HEX_DIGITS[stream->line[idx] >> 4];
+        text[length++] = HEX_DIGITS[stream->line[idx] & 0xF];
+    }
+    text[length++] = '\r';
+    text[length++] = '\n';
+
+    Write(stream->port, text, length);
+    stream->line_length = 0;
+
+}
+
+/*******************************************************************************
+Dump Callback Function
+Append bytes of the gcda stream, a line at a time.
+*******************************************************************************/
+static void Dump_Callback (const void* data, unsigned length, void* arg) {
+
+    edge_profile_stream* stream = (edge_profile_stream*)arg;
+    const uint8_t*       bytes  = (const uint8_t*)data;
+
+    for (unsigned idx = 0; idx < length; idx++) {
+        stream->line[stream->line_length++] = bytes[idx];
+        if (stream->line_length == EDGE_PROFILE_BYTES_PER_LINE) {
+            Flush_Line(stream);
+        }
+    }
+    stream->num_of_bytes += length;
+
+}
+
+/*******************************************************************************
+Filename Callback Function
+Start an object's gcda data with the path it belongs at.
+*******************************************************************************/
+static void Filename_Callback (const char* filename, void* arg) {
+
+    edge_profile_stream* stream = (edge_profile_stream*)arg;
+
+    Flush_Line(stream);
+
+    uint64_t length = 0;
+    while ((filename != nullptr) && (filename[length] != '\0')) {
+        length++;
+    }
+
+    Write(stream->port, "GCOV FILE ", 10);
+    Write(stream->port, filename, length);
+    Write(stream->port, "\r\n", 2);
+
+}
+
+/*******************************************************************************
+Allocate Callback Function
+Scratch memory for one object's counters, released after the object is done.
+*******************************************************************************/
+static void* Allocate_Callback (unsigned length, void* arg) {
+
+    edge_profile_stream* stream = (edge_profile_stream*)arg;
+    uint64_t             size   = ((uint64_t)length + 15) & ~15ULL;
+
+    if (stream->scratch_used + size > EDGE_PROFILE_SCRATCH_SIZE) {
+        return nullptr;
+    }
+
+    void* memory = &edge_profile_scratch[stream->scratch_used];
+    stream->scratch_used += size;
+    return memory;
+
+}
+
+#endif
+
+/*******************************************************************************
+Edge Profile Dump Function
+
+Write the edge counters of every instrumented object to the serial port as
+its .gcda file contents, hex encoded, for Merge_Edge_Profile.py:
+
+    GCOV BEGIN
+    GCOV FILE <path of the .gcda>
+    GCOV <hex bytes>
+    ...
+    GCOV END <objects> <bytes>
+
+Counters keep counting on other processors while dumping, so their totals can
+be slightly inconsistent, which is fine for feedback. Returns the objects
+dumped, 0 in builds without edge counters.
+*******************************************************************************/
+uint64_t edge_profile_dump (serial_port* port) {
+
+#ifdef KERNEL_EDGE_PROFILE
+
+    edge_profile_stream stream;
+    stream.port         = port;
+    stream.num_of_bytes = 0;
+    stream.line_length  = 0;
+    stream.scratch_used = 0;
+
+    Write(port, "GCOV BEGIN\r\n", 12);
+
+    // The compiler may not assume two distinct symbols bound one array.
+    const gcov_info* const* info = kernel_gcov_info_start;
+    __asm__ ("" : "+r"(info));
+
+    uint64_t num_of_objects = 0;
+    for (; info != kernel_gcov_info_end; info++) {
+        stream.scratch_used = 0;
+        __gcov_info_to_gcda(*info, Filename_Callback, Dump_Callback, Allocate_Callback, &stream);
+        num_of_objects++;
+    }
+    Flush_Line(&stream);
+
+    char     footer[KERNEL_LOG_MAX_LINE_LENGTH + 2];
+    uint64_t values[] = { num_of_objects, stream.num_of_bytes };
+    uint64_t length   = kernel_log_format(footer, KERNEL_LOG_MAX_LINE_LENGTH, "GCOV END %u %u", values, 2);
+    footer[length++]  = '\r';
+    footer[length++]  = '\n';
+    Write(port, footer, length);
+    serial_port_flush(port);
+
+    return num_of_objects;
+
+#else
+
+    (void)port;
+    return 0;
+
+#endif
+
+}
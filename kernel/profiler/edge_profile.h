@@ -0,0 +1,8 @@
+#pragma once
+#include <stdint.h>
+#include "../drivers/serial_port.h"
+
+#define EDGE_PROFILE_BYTES_PER_LINE 48          // Hex encoded, 96 characters.
+#define EDGE_PROFILE_SCRATCH_SIZE   (64 * 1024) // For libgcov while encoding one object.
+
+uint64_t edge_profile_dump (serial_port* port);
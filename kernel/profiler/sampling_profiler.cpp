@@ -0,0 +1,386 @@
+#include "sampling_profiler.h"
+#include "../cpu/per_cpu.h"
+#include "../cpu/smp.h"
+#include "../log/kernel_log.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+// Rings by processor index, each allocated by its processor as it comes up.
+static profiler_ring* profiler_rings[PER_CPU_MAX_NUM_OF_CPUS];
+static uint64_t       profiler_num_of_rings;
+
+// Set by start and stop, every processor follows them on the control IPI.
+static bool           profiler_enabled;
+static bool           profiler_call_chains;
+static uint64_t       profiler_period_ns;
+static uint64_t       profiler_frequency_hz;
+
+// Consumer side.
+static uint32_t       profiler_consumer_busy;
+static bool           profiler_header_pending;
+static bool           profiler_footer_pending;
+static uint64_t       profiler_num_of_streamed;
+static uint64_t       profiler_num_of_dropped_at_start;
+
+/*******************************************************************************
+Samples Pending Function
+*******************************************************************************/
+static bool Samples_Pending () {
+
+    uint64_t num_of_rings = __atomic_load_n(&profiler_num_of_rings, __ATOMIC_ACQUIRE);
+    for (uint64_t ring_idx = 0; ring_idx < num_of_rings; ring_idx++) {
+        profiler_ring* ring = __atomic_load_n(&profiler_rings[ring_idx], __ATOMIC_ACQUIRE);
+        if ((ring != nullptr) && (__atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE) != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))) {
+            return true;
+        }
+    }
+
+    return false;
+
+}
+
+/*******************************************************************************
+Number of Dropped Samples Function
+*******************************************************************************/
+static uint64_t Num_Of_Dropped_Samples () {
+
+    uint64_t num_of_dropped = 0;
+    uint64_t num_of_rings   = __atomic_load_n(&profiler_num_of_rings, __ATOMIC_ACQUIRE);
+    for (uint64_t ring_idx = 0; ring_idx < num_of_rings; ring_idx++) {
+        profiler_ring* ring = __atomic_load_n(&profiler_rings[ring_idx], __ATOMIC_ACQUIRE);
+        if (ring != nullptr) {
+            num_of_dropped += __atomic_load_n(&ring->num_of_dropped, __ATOMIC_RELAXED);
+        }
+    }
+
+    return num_of_dropped;
+
+}
+
+/*******************************************************************************
+Walk Call Chain Function
+Follow the saved frame pointers up the interrupted stack. Each frame must lie
+above the previous one and not far from it, which stops the walk at the stack's
+end or at code without a frame pointer instead of wandering off the stack.
+*******************************************************************************/
+static uint64_t Walk_Call_Chain (const interrupt_frame* frame, uint64_t* callers) {
+
+    uint64_t num_of_callers = 0;
+    uint64_t lower_bound    = frame->rsp;
+    uint64_t frame_pointer  = frame->rbp;
+
+    while ((num_of_callers < PROFILER_MAX_CALL_CHAIN_DEPTH) &&
+           (frame_pointer >= lower_bound) &&
+           ((frame_pointer - lower_bound) < PROFILER_MAX_FRAME_SIZE) &&
+           ((frame_pointer & 7) == 0)) {
+
+        const uint64_t* saved = (const uint64_t*)frame_pointer;
+        if (saved[1] == 0) {
+            break;
+        }
+
+        callers[num_of_callers++] = saved[1];
+        lower_bound               = frame_pointer + 16;
+        frame_pointer             = saved[0];
+
+    }
+
+    return num_of_callers;
+
+}
+
+/*******************************************************************************
+Sample Timer Callback Function
+Runs from the timer interrupt of the sampled processor. Records where the
+interrupt came in and re-arms for the next period while enabled. Code running
+with interrupts disabled is never sampled, its time is charged to where it
+enabled them again.
+*******************************************************************************/
+static void Sample_Timer_Callback (kernel_timer* timer, void* context) {
+
+    profiler_cpu_state* state = (profiler_cpu_state*)context;
+    per_cpu_data*       cpu   = get_per_cpu_data();
+
+    if (!__atomic_load_n(&profiler_enabled, __ATOMIC_ACQUIRE)) {
+        state->sampling = false;
+        return;
+    }
+
+    // The wheel can also be processed outside the timer interrupt, then there is nothing to sample.
+    const interrupt_frame* frame = cpu->timers.interrupted_frame;
+    profiler_ring*         ring  = state->ring;
+
+    if ((frame != nullptr) && (ring != nullptr)) {
+
+        uint64_t head = ring->head;
+        if ((head - __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE)) >= PROFILER_RING_SIZE) {
+            ring->num_of_dropped++;
+        } else {
+            profiler_sample* sample = &ring->samples[head & (PROFILER_RING_SIZE - 1)];
+            sample->rip             = frame->rip;
+            sample->num_of_callers  = __atomic_load_n(&profiler_call_chains, __ATOMIC_RELAXED) ? Walk_Call_Chain(frame, sample->callers) : 0;
+            __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+        }
+
+    }
+
+    timer_wheel_arm(&cpu->timers, timer, get_monotonic_time_ns() + __atomic_load_n(&profiler_period_ns, __ATOMIC_RELAXED));
+
+}
+
+/*******************************************************************************
+Synchronize Processor Function
+Arm or stop the executing processor's sample timer to match the global state.
+Interrupts must be disabled, the timer wheel is the processor's own.
+*******************************************************************************/
+static void Synchronize_Processor () {
+
+    per_cpu_data*       cpu   = get_per_cpu_data();
+    profiler_cpu_state* state = &cpu->profiler;
+
+    bool enabled = __atomic_load_n(&profiler_enabled, __ATOMIC_ACQUIRE);
+
+    if (enabled && !state->sampling) {
+        kernel_timer_initialize(&state->sample_timer, Sample_Timer_Callback, state);
+        timer_wheel_arm(&cpu->timers, &state->sample_timer, get_monotonic_time_ns() + profiler_period_ns);
+        state->sampling = true;
+    } else if (!enabled && state->sampling) {
+        timer_wheel_cancel(&cpu->timers, &state->sample_timer);
+        state->sampling = false;
+    }
+
+}
+
+/*******************************************************************************
+Control IPI Handler Function
+*******************************************************************************/
+static void Control_IPI_Handler (interrupt_frame* frame) {
+
+    (void)frame;
+
+    Synchronize_Processor();
+    local_apic_end_of_interrupt(&get_per_cpu_data()->apic);
+
+}
+
+/*******************************************************************************
+Setup Profiler Function
+Once, on the bootstrap processor before the others start. Allocates its sample
+ring and takes the control vector, every other processor allocates its own ring
+with Initialize_Profiler_Ring.
+*******************************************************************************/
+bool Setup_Profiler (Physical_Memory_Manager* pmm, Interrupt_Descriptor_Table* idt) {
+
+    if (!Initialize_Profiler_Ring(pmm)) {
+        return false;
+    }
+
+    return idt->register_handler(PROFILER_CONTROL_VECTOR, Control_IPI_Handler);
+
+}
+
+/*******************************************************************************
+Initialize Profiler Ring Function
+Allocate the executing processor's sample ring on its NUMA node, before it
+enables interrupts. Processor indices follow the order the processors came up
+in, not the MADT's, so only the processor itself knows its node. A processor
+without a ring is not sampled.
+*******************************************************************************/
+bool Initialize_Profiler_Ring (Physical_Memory_Manager* pmm) {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    if (cpu->cpu_index >= PER_CPU_MAX_NUM_OF_CPUS) {
+        return false;
+    }
+
+    const uint64_t ALIGNMENT = 64;
+
+    uint8_t* memory = (uint8_t*)pmm->allocate_physical_frames_on_node(sizeof(profiler_ring) + ALIGNMENT, cpu->numa_node, true);
+    if (memory == nullptr) {
+        return false;
+    }
+
+    profiler_ring* ring  = (profiler_ring*)((((uint64_t)memory) + ALIGNMENT - 1) & ~(ALIGNMENT - 1));
+    ring->head           = 0;
+    ring->num_of_dropped = 0;
+    ring->tail           = 0;
+
+    cpu->profiler.ring = ring;
+    __atomic_store_n(&profiler_rings[cpu->cpu_index], ring, __ATOMIC_RELEASE);
+
+    // Processors come up in any order, the count only grows.
+    uint64_t num_of_rings = __atomic_load_n(&profiler_num_of_rings, __ATOMIC_RELAXED);
+    while ((num_of_rings <= cpu->cpu_index) &&
+           !__atomic_compare_exchange_n(&profiler_num_of_rings, &num_of_rings, cpu->cpu_index + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Profiler Start Function
+Sample every processor frequency_hz times a second, with frame pointer call
+chains if asked for. Returns false if already running or not set up.
+*******************************************************************************/
+bool profiler_start (uint64_t frequency_hz, bool call_chains) {
+
+    if ((profiler_num_of_rings == 0) || (frequency_hz == 0) || __atomic_load_n(&profiler_enabled, __ATOMIC_ACQUIRE)) {
+        return false;
+    }
+
+    // Rings only drop while sampling, so nothing changes the counts here.
+    profiler_num_of_dropped_at_start = Num_Of_Dropped_Samples();
+
+    profiler_frequency_hz = frequency_hz;
+    profiler_period_ns    = 1000000000 / frequency_hz;
+    if (profiler_period_ns == 0) {
+        profiler_period_ns = 1;
+    }
+    __atomic_store_n(&profiler_call_chains, call_chains, __ATOMIC_RELAXED);
+    __atomic_store_n(&profiler_header_pending, true, __ATOMIC_RELAXED);
+    __atomic_store_n(&profiler_enabled, true, __ATOMIC_RELEASE);
+
+    uint64_t rflags = save_and_disable_interrupts();
+    Synchronize_Processor();
+    restore_interrupts(rflags);
+
+    smp_send_ipi_to_all_others(PROFILER_CONTROL_VECTOR);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Profiler Stop Function
+Sample timers stop on their next expiry, samples taken stay to be streamed.
+*******************************************************************************/
+void profiler_stop () {
+
+    if (!__atomic_exchange_n(&profiler_enabled, false, __ATOMIC_ACQ_REL)) {
+        return;
+    }
+
+    __atomic_store_n(&profiler_footer_pending, true, __ATOMIC_RELEASE);
+
+    uint64_t rflags = save_and_disable_interrupts();
+    Synchronize_Processor();
+    restore_interrupts(rflags);
+
+    smp_send_ipi_to_all_others(PROFILER_CONTROL_VECTOR);
+
+}
+
+/*******************************************************************************
+Write Line Function
+Queue a line only if it fits, so a busy port delays samples rather than
+dropping them. Returns false if it did not fit.
+*******************************************************************************/
+static bool Write_Line (serial_port* port, char* line, uint64_t length) {
+
+    line[length++] = '\r';
+    line[length++] = '\n';
+
+    if (serial_port_get_free_space(port) < length) {
+        return false;
+    }
+
+    return (serial_port_write(port, line, length) != 0);
+
+}
+
+/*******************************************************************************
+Profiler Stream Function
+
+Write up to the given number of samples to the serial port as text lines, for
+Profile_Report.py to symbolize against kernel.elf:
+
+    PROFILE START <frequency hz> <anchor address>
+    PROFILE <cpu> <rip> [<return address> ...]
+    PROFILE STOP <samples> <dropped>
+
+The anchor is the address profiler_stream runs at, which locates the loaded
+image. One consumer at a time; a second caller returns straight away. Stops
+early when the port's ring is full. Returns the number of samples written.
+*******************************************************************************/
+uint64_t profiler_stream (serial_port* port, uint64_t max_num_of_samples) {
+
+    if (__atomic_exchange_n(&profiler_consumer_busy, 1, __ATOMIC_ACQUIRE) != 0) {
+        return 0;
+    }
+
+    char     line[KERNEL_LOG_MAX_LINE_LENGTH + 2];
+    uint64_t num_of_written = 0;
+    bool     port_full      = false;
+
+    if (__atomic_load_n(&profiler_header_pending, __ATOMIC_ACQUIRE)) {
+        uint64_t arguments[] = { profiler_frequency_hz, (uint64_t)profiler_stream };
+        if (Write_Line(port, line, kernel_log_format(line, KERNEL_LOG_MAX_LINE_LENGTH, "PROFILE START %u %h", arguments, 2))) {
+            __atomic_store_n(&profiler_header_pending, false, __ATOMIC_RELAXED);
+            profiler_num_of_streamed = 0;
+        } else {
+            port_full = true;
+        }
+    }
+
+    uint64_t num_of_rings = __atomic_load_n(&profiler_num_of_rings, __ATOMIC_ACQUIRE);
+    for (uint64_t ring_idx = 0; (ring_idx < num_of_rings) && !port_full; ring_idx++) {
+
+        profiler_ring* ring = __atomic_load_n(&profiler_rings[ring_idx], __ATOMIC_ACQUIRE);
+        if (ring == nullptr) {
+            continue;
+        }
+
+        uint64_t tail = ring->tail;
+
+        while ((num_of_written < max_num_of_samples) && (tail != __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE))) {
+
+            const profiler_sample* sample = &ring->samples[tail & (PROFILER_RING_SIZE - 1)];
+
+            uint64_t arguments[] = { ring_idx, sample->rip };
+            uint64_t length      = kernel_log_format(line, KERNEL_LOG_MAX_LINE_LENGTH, "PROFILE %u %h", arguments, 2);
+            for (uint64_t idx = 0; idx < sample->num_of_callers; idx++) {
+                length += kernel_log_format(line + length, KERNEL_LOG_MAX_LINE_LENGTH - length, " %h", &sample->callers[idx], 1);
+            }
+
+            if (!Write_Line(port, line, length)) {
+                port_full = true;
+                break;
+            }
+
+            tail++;
+            num_of_written++;
+            __atomic_store_n(&ring->tail, tail, __ATOMIC_RELEASE);
+
+        }
+    }
+
+    profiler_num_of_streamed += num_of_written;
+
+    // The footer follows the last sample taken before the stop.
+    if (!port_full && __atomic_load_n(&profiler_footer_pending, __ATOMIC_ACQUIRE) && !Samples_Pending()) {
+
+        uint64_t arguments[] = { profiler_num_of_streamed, Num_Of_Dropped_Samples() - profiler_num_of_dropped_at_start };
+        if (Write_Line(port, line, kernel_log_format(line, KERNEL_LOG_MAX_LINE_LENGTH, "PROFILE STOP %u %u", arguments, 2))) {
+            __atomic_store_n(&profiler_footer_pending, false, __ATOMIC_RELAXED);
+        }
+
+    }
+
+    __atomic_store_n(&profiler_consumer_busy, 0, __ATOMIC_RELEASE);
+
+    return num_of_written;
+
+}
+
+/*******************************************************************************
+Profiler Is Pending Function
+True while samples, or the start or stop line, wait to be streamed.
+*******************************************************************************/
+bool profiler_is_pending () {
+
+    return __atomic_load_n(&profiler_header_pending, __ATOMIC_ACQUIRE) ||
+           __atomic_load_n(&profiler_footer_pending, __ATOMIC_ACQUIRE) ||
+           Samples_Pending();
+
+}
@@ -0,0 +1,42 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+#include "../interrupts/interrupt_descriptor_table.h"
+#include "../time/timer_wheel.h"
+#include "../drivers/serial_port.h"
+
+#define PROFILER_RING_SIZE             1024        // Samples per processor, power of two.
+#define PROFILER_MAX_CALL_CHAIN_DEPTH  8
+#define PROFILER_MAX_FRAME_SIZE        (64 * 1024) // A larger step between frame pointers ends the chain.
+#define PROFILER_DEFAULT_FREQUENCY_HZ  100         // Per processor, about what COM1 keeps up with.
+#define PROFILER_CONTROL_VECTOR        0xF1
+
+// Where one timer interrupt found its processor.
+typedef struct {
+    uint64_t rip;
+    uint64_t num_of_callers;
+    uint64_t callers[PROFILER_MAX_CALL_CHAIN_DEPTH]; // Return addresses, innermost first.
+} profiler_sample;
+
+/* Single producer, single consumer ring of one processor. The producer is its
+timer interrupt, the consumer whoever streams the samples out. */
+typedef struct {
+    uint64_t        head;                                // Written by the owner.
+    uint64_t        num_of_dropped;                      // Samples lost to a full ring.
+    uint64_t        tail __attribute__((aligned(64)));   // Written by the consumer.
+    profiler_sample samples[PROFILER_RING_SIZE];
+} profiler_ring;
+
+// One processor's part of the profiler, only touched by that processor.
+typedef struct {
+    kernel_timer   sample_timer;
+    profiler_ring* ring;
+    bool           sampling;     // The sample timer is armed.
+} profiler_cpu_state;
+
+bool     Setup_Profiler           (Physical_Memory_Manager* pmm, Interrupt_Descriptor_Table* idt);
+bool     Initialize_Profiler_Ring (Physical_Memory_Manager* pmm);
+bool     profiler_start           (uint64_t frequency_hz, bool call_chains);
+void     profiler_stop            ();
+uint64_t profiler_stream          (serial_port* port, uint64_t max_num_of_samples);
+bool     profiler_is_pending      ();
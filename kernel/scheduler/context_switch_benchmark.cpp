@@ -0,0 +1,111 @@
+#include "context_switch_benchmark.h"
+#include "scheduler.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+// Shared by the two benchmark threads, lives on the caller's stack.
+typedef struct {
+    uint64_t num_of_round_trips;
+    uint64_t min_cycles;
+    uint64_t total_cycles;
+    bool     done;
+    uint64_t num_of_finished_threads;
+} context_switch_benchmark_state;
+
+/*******************************************************************************
+Measuring Thread Function
+Time each yield, which only returns once the partner thread has yielded back.
+*******************************************************************************/
+static void Measuring_Thread (void* argument) {
+
+    context_switch_benchmark_state* state = (context_switch_benchmark_state*)argument;
+
+    // Let the partner get going so the first round trip is not an outlier.
+    scheduler_yield();
+
+    for (uint64_t idx = 0; idx < state->num_of_round_trips; idx++) {
+
+        uint64_t start_tsc = read_tsc();
+        scheduler_yield();
+        uint64_t cycles = read_tsc() - start_tsc;
+
+        state->total_cycles += cycles;
+        if (cycles < state->min_cycles) {
+            state->min_cycles = cycles;
+        }
+
+    }
+
+    state->done = true;
+    __atomic_add_fetch(&state->num_of_finished_threads, 1, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Partner Thread Function
+*******************************************************************************/
+static void Partner_Thread (void* argument) {
+
+    context_switch_benchmark_state* state = (context_switch_benchmark_state*)argument;
+
+    while (!state->done) {
+        scheduler_yield();
+    }
+
+    __atomic_add_fetch(&state->num_of_finished_threads, 1, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Benchmark Context Switch Function
+
+Ping-pong two threads on the executing processor through scheduler_yield and
+time the round trips with the TSC. The figures include the scheduler's pick and
+accounting, not only the register switch. Must be called from the processor's
+idle thread, which does not take part in the ping-pong. Returns false if the
+threads could not be created.
+*******************************************************************************/
+bool Benchmark_Context_Switch (uint64_t num_of_round_trips, context_switch_benchmark_result* result) {
+
+    if (num_of_round_trips == 0) {
+        return false;
+    }
+
+    context_switch_benchmark_state state;
+    state.num_of_round_trips      = num_of_round_trips;
+    state.min_cycles              = UINT64_MAX;
+    state.total_cycles            = 0;
+    state.done                    = false;
+    state.num_of_finished_threads = 0;
+
+    uint64_t cpu_index = get_per_cpu_data()->cpu_index;
+
+    kernel_thread* measuring = Create_Kernel_Thread(Measuring_Thread, &state, 0, cpu_index);
+    if (measuring == nullptr) {
+        return false;
+    }
+
+    uint64_t expected_num_of_finished_threads = 2;
+    if (Create_Kernel_Thread(Partner_Thread, &state, 0, cpu_index) == nullptr) {
+        state.done                       = true;
+        expected_num_of_finished_threads = 1;
+    }
+
+    // The idle thread only runs again once both threads have stopped.
+    while (__atomic_load_n(&state.num_of_finished_threads, __ATOMIC_ACQUIRE) < expected_num_of_finished_threads) {
+        scheduler_yield();
+    }
+
+    if (expected_num_of_finished_threads != 2) {
+        return false;
+    }
+
+    result->num_of_round_trips        = num_of_round_trips;
+    result->min_round_trip_cycles     = state.min_cycles;
+    result->average_round_trip_cycles = state.total_cycles / num_of_round_trips;
+    result->min_switch_cycles         = result->min_round_trip_cycles / 2;
+    result->average_switch_cycles     = result->average_round_trip_cycles / 2;
+
+    return true;
+
+}
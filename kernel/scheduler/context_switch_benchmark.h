@@ -0,0 +1,12 @@
+#pragma once
+#include <stdint.h>
+
+typedef struct {
+    uint64_t num_of_round_trips;
+    uint64_t min_round_trip_cycles;     // A round trip is two switches.
+    uint64_t average_round_trip_cycles;
+    uint64_t min_switch_cycles;
+    uint64_t average_switch_cycles;
+} context_switch_benchmark_result;
+
+bool Benchmark_Context_Switch (uint64_t num_of_round_trips, context_switch_benchmark_result* result);
@@ -0,0 +1,751 @@
+#include "scheduler.h"
+#include "../cpu/per_cpu.h"
+#include "../cpu/smp.h"
+#include "../cpu/fpu.h"
+#include "../synchronization/rcu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+// Weight of each nice level, -20 first. Every level is about 1.25x the next.
+static const uint32_t scheduler_nice_to_weight[] = {
+    88761, 71755, 56483, 46273, 36291,
+    29154, 23254, 18705, 14949, 11916,
+     9548,  7620,  6100,  4904,  3906,
+     3121,  2501,  1991,  1586,  1277,
+     1024,   820,   655,   526,   423,
+      335,   272,   215,   172,   137,
+      110,    87,    70,    56,    45,
+       36,    29,    23,    18,    15
+};
+
+static_assert((sizeof(scheduler_nice_to_weight) / sizeof(scheduler_nice_to_weight[0])) == (SCHEDULER_NICE_MAX - SCHEDULER_NICE_MIN + 1),
+              "One weight per nice level.");
+
+// Thread stacks are allocated from and freed to this PMM.
+static Physical_Memory_Manager* scheduler_pmm;
+static uint64_t                 scheduler_next_thread_id;
+
+/*******************************************************************************
+Context Switch
+
+scheduler_switch_context (uint64_t* saved_rsp, uint64_t new_rsp) saves the
+callee-saved registers on the current stack, stores the stack pointer through
+saved_rsp, loads new_rsp and restores the registers saved there. Everything a
+caller may clobber is already saved by the caller, so nothing else is needed.
+A new thread's stack is built to look like it was switched away from inside
+scheduler_thread_trampoline, with the thread pointer in r12.
+*******************************************************************************/
+extern "C" void scheduler_switch_context    (uint64_t* saved_rsp, uint64_t new_rsp);
+extern "C" void scheduler_thread_trampoline ();
+extern "C" void Kernel_Thread_Start         (kernel_thread* thread);
+
+__asm__ (
+    ".text\n"
+    ".global scheduler_switch_context\n"
+    "scheduler_switch_context:\n"
+    "    pushq %rbp\n"
+    "    pushq %rbx\n"
+    "    pushq %r12\n"
+    "    pushq %r13\n"
+    "    pushq %r14\n"
+    "    pushq %r15\n"
+    "    movq %rsp, (%rdi)\n"
+    "    movq %rsi, %rsp\n"
+    "    popq %r15\n"
+    "    popq %r14\n"
+    "    popq %r13\n"
+    "    popq %r12\n"
+    "    popq %rbx\n"
+    "    popq %rbp\n"
+    "    ret\n"
+    "\n"
+    ".global scheduler_thread_trampoline\n"
+    "scheduler_thread_trampoline:\n"
+    "    movq %r12, %rdi\n"
+    "    call Kernel_Thread_Start\n"
+    "    ud2\n"
+);
+
+// Registers popped by the context switch, lowest address first.
+typedef struct {
+    uint64_t r15;
+    uint64_t r14;
+    uint64_t r13;
+    uint64_t r12;
+    uint64_t rbx;
+    uint64_t rbp;
+    uint64_t return_address;
+} scheduler_switch_frame;
+
+/*******************************************************************************
+FPU Save Area Footprint Function
+Bytes to allocate for a vector register save area, with room to align it.
+*******************************************************************************/
+static uint64_t FPU_Save_Area_Footprint () {
+
+    uint64_t size = get_fpu_configuration()->save_area_size;
+
+    return ((size + FPU_SAVE_AREA_ALIGNMENT - 1) & ~((uint64_t)FPU_SAVE_AREA_ALIGNMENT - 1)) + FPU_SAVE_AREA_ALIGNMENT;
+
+}
+
+/*******************************************************************************
+Align FPU Save Area Function
+*******************************************************************************/
+static uint8_t* Align_FPU_Save_Area (uint8_t* memory) {
+    return (uint8_t*)((((uint64_t)memory) + FPU_SAVE_AREA_ALIGNMENT - 1) & ~((uint64_t)FPU_SAVE_AREA_ALIGNMENT - 1));
+}
+
+/*******************************************************************************
+Insert Runnable Function
+Insert the thread behind every thread with the same or a smaller vruntime.
+*******************************************************************************/
+static void Insert_Runnable (scheduler_run_queue* run_queue, kernel_thread* thread) {
+
+    kernel_thread* prev = nullptr;
+    kernel_thread* next = run_queue->head;
+
+    while ((next != nullptr) && (next->vruntime <= thread->vruntime)) {
+        prev = next;
+        next = next->next;
+    }
+
+    thread->prev = prev;
+    thread->next = next;
+
+    if (prev == nullptr) {
+        run_queue->head = thread;
+    } else {
+        prev->next = thread;
+    }
+
+    if (next != nullptr) {
+        next->prev = thread;
+    }
+
+    run_queue->num_of_runnable++;
+
+}
+
+/*******************************************************************************
+Pop Runnable Function
+Remove the thread with the smallest vruntime, nullptr if there is none.
+*******************************************************************************/
+static kernel_thread* Pop_Runnable (scheduler_run_queue* run_queue) {
+
+    kernel_thread* thread = run_queue->head;
+    if (thread == nullptr) {
+        return nullptr;
+    }
+
+    run_queue->head = thread->next;
+    if (run_queue->head != nullptr) {
+        run_queue->head->prev = nullptr;
+    }
+
+    thread->next = nullptr;
+    thread->prev = nullptr;
+
+    run_queue->num_of_runnable--;
+
+    return thread;
+
+}
+
+/*******************************************************************************
+Update Current Function
+Charge the running thread for the time since it was last accounted and move
+the queue's minimum vruntime forward.
+*******************************************************************************/
+static void Update_Current (scheduler_run_queue* run_queue, uint64_t now_ns) {
+
+    kernel_thread* current = run_queue->current;
+
+    uint64_t delta_ns = now_ns - current->exec_start_ns;
+    current->exec_start_ns     = now_ns;
+    current->total_runtime_ns += delta_ns;
+
+    if (current == &run_queue->idle_thread) {
+        if (run_queue->head != nullptr) {
+            run_queue->min_vruntime = (run_queue->head->vruntime > run_queue->min_vruntime) ? run_queue->head->vruntime : run_queue->min_vruntime;
+        }
+        return;
+    }
+
+    current->vruntime += (delta_ns * SCHEDULER_NICE_0_WEIGHT) / current->weight;
+
+    // The minimum only ever grows, so woken threads cannot be placed in the past.
+    uint64_t min_vruntime = current->vruntime;
+    if ((run_queue->head != nullptr) && (run_queue->head->vruntime < min_vruntime)) {
+        min_vruntime = run_queue->head->vruntime;
+    }
+    if (min_vruntime > run_queue->min_vruntime) {
+        run_queue->min_vruntime = min_vruntime;
+    }
+
+}
+
+/*******************************************************************************
+Arm Preempt Timer Function
+
+Time slices shrink as threads are added so each runs once per target latency,
+down to the minimum granularity. The preempt timer is left alone while it will
+fire no later than the new slice end; its callback re-arms it for the current
+slice end if it fires early, so a switch rarely touches the APIC. Nothing is
+armed while the running thread has no competition.
+*******************************************************************************/
+static void Arm_Preempt_Timer (scheduler_run_queue* run_queue, uint64_t now_ns) {
+
+    if (run_queue->num_of_runnable == 0) {
+        return;
+    }
+
+    uint64_t slice_ns = SCHEDULER_TARGET_LATENCY_NS / (run_queue->num_of_runnable + 1);
+    if (slice_ns < SCHEDULER_MIN_GRANULARITY_NS) {
+        slice_ns = SCHEDULER_MIN_GRANULARITY_NS;
+    }
+
+    run_queue->slice_end_ns = now_ns + slice_ns;
+
+    kernel_timer* timer = &run_queue->preempt_timer;
+    if ((!timer->pending) || ((timer->expires_tick << TIMER_WHEEL_TICK_SHIFT) > run_queue->slice_end_ns)) {
+        timer_wheel_arm(run_queue->timers, timer, run_queue->slice_end_ns);
+    }
+
+}
+
+/*******************************************************************************
+Preempt Timer Callback Function
+*******************************************************************************/
+static void Preempt_Timer_Callback (kernel_timer* timer, void* context) {
+
+    scheduler_run_queue* run_queue = (scheduler_run_queue*)context;
+
+    if (run_queue->num_of_runnable == 0) {
+        return;
+    }
+
+    if (get_monotonic_time_ns() >= run_queue->slice_end_ns) {
+        run_queue->need_resched = true;
+    } else {
+        timer_wheel_arm(run_queue->timers, timer, run_queue->slice_end_ns);
+    }
+
+}
+
+/*******************************************************************************
+Enqueue Woken Thread Function
+
+Place a thread that became runnable on the executing processor's run queue. A
+thread that slept is credited at most half a latency period of vruntime so it
+runs soon without starving others; a new thread starts at the minimum. Asks for
+a reschedule if the thread should preempt the running one.
+*******************************************************************************/
+static void Enqueue_Woken_Thread (scheduler_run_queue* run_queue, kernel_thread* thread) {
+
+    const uint64_t SLEEPER_CREDIT_NS = SCHEDULER_TARGET_LATENCY_NS / 2;
+
+    if (thread->is_new) {
+        thread->vruntime = run_queue->min_vruntime;
+        thread->is_new   = false;
+    } else {
+        uint64_t floor = (run_queue->min_vruntime > SLEEPER_CREDIT_NS) ? (run_queue->min_vruntime - SLEEPER_CREDIT_NS) : 0;
+        if (thread->vruntime < floor) {
+            thread->vruntime = floor;
+        }
+    }
+
+    thread->state = thread_state_runnable;
+    Insert_Runnable(run_queue, thread);
+
+    kernel_thread* current = run_queue->current;
+    if ((current == &run_queue->idle_thread) || ((thread->vruntime + SCHEDULER_WAKE_UP_GRANULARITY_NS) < current->vruntime)) {
+        run_queue->need_resched = true;
+    }
+
+    Arm_Preempt_Timer(run_queue, get_monotonic_time_ns());
+
+}
+
+/*******************************************************************************
+Drain Incoming Function
+Move threads handed over by other processors onto the run queue.
+*******************************************************************************/
+static void Drain_Incoming (scheduler_run_queue* run_queue) {
+
+    kernel_thread* thread = __atomic_exchange_n(&run_queue->incoming, nullptr, __ATOMIC_ACQUIRE);
+
+    while (thread != nullptr) {
+        kernel_thread* next = thread->next;
+        Enqueue_Woken_Thread(run_queue, thread);
+        thread = next;
+    }
+
+}
+
+/*******************************************************************************
+Enqueue Thread Function
+
+Make a runnable thread known to its processor. On the executing processor it
+goes straight onto the run queue; for another processor it is pushed onto that
+processor's incoming list and the processor is interrupted to pick it up.
+*******************************************************************************/
+static void Enqueue_Thread (kernel_thread* thread) {
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    if (thread->cpu_index == cpu->cpu_index) {
+
+        Enqueue_Woken_Thread(&cpu->run_queue, thread);
+
+    } else {
+
+        scheduler_run_queue* run_queue = &get_per_cpu_data_of(thread->cpu_index)->run_queue;
+
+        kernel_thread* head = __atomic_load_n(&run_queue->incoming, __ATOMIC_RELAXED);
+        do {
+            thread->next = head;
+        } while (!__atomic_compare_exchange_n(&run_queue->incoming, &head, thread, true, __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+
+        smp_send_ipi(thread->cpu_index, SMP_WAKE_UP_VECTOR);
+
+    }
+
+    restore_interrupts(rflags);
+
+}
+
+/*******************************************************************************
+Finish Switch Function
+Runs on the thread switched to. Frees the threads that exited, now that no
+processor is running on their stacks.
+*******************************************************************************/
+static void Finish_Switch (scheduler_run_queue* run_queue) {
+
+    kernel_thread* thread = run_queue->exited;
+    if (thread == nullptr) {
+        return;
+    }
+
+    run_queue->exited = nullptr;
+
+    while (thread != nullptr) {
+        kernel_thread* next = thread->next;
+        scheduler_pmm->free_physical_frames(thread);
+        thread = next;
+    }
+
+}
+
+/*******************************************************************************
+Schedule Function
+
+Pick the thread with the smallest vruntime and switch to it. A running thread
+goes back on the queue; a yielding thread goes back only after the next thread
+has been picked so it cannot pick itself while others are runnable. The idle
+thread never sits on the queue, it runs when the queue is empty. Called with
+interrupts disabled.
+*******************************************************************************/
+static void Schedule (scheduler_run_queue* run_queue, bool yield) {
+
+    uint64_t       now_ns = get_monotonic_time_ns();
+    kernel_thread* prev   = run_queue->current;
+
+    Update_Current(run_queue, now_ns);
+    run_queue->need_resched = false;
+
+    // Read-side critical sections never span a switch.
+    rcu_quiescent_state();
+
+    Drain_Incoming(run_queue);
+
+    /* A thread that is not running anymore either blocked, exited or was woken
+    by another processor between blocking and getting here, in which case it is
+    already back on the queue. */
+    bool requeue_prev = (prev != &run_queue->idle_thread) && (prev->state == thread_state_running);
+    if (requeue_prev) {
+        prev->state = thread_state_runnable;
+        if (!yield) {
+            Insert_Runnable(run_queue, prev);
+        }
+    }
+
+    kernel_thread* next = Pop_Runnable(run_queue);
+
+    if (requeue_prev && yield) {
+        if (next == nullptr) {
+            next = prev;
+        } else {
+            Insert_Runnable(run_queue, prev);
+        }
+    }
+
+    if (next == nullptr) {
+        next = &run_queue->idle_thread;
+    }
+
+    next->state          = thread_state_running;
+    next->exec_start_ns  = now_ns;
+    run_queue->current   = next;
+
+    Arm_Preempt_Timer(run_queue, now_ns);
+
+    if (next != prev) {
+
+        run_queue->num_of_switches++;
+        fpu_switch_to(next);
+        scheduler_switch_context(&prev->saved_rsp, next->saved_rsp);
+
+        // Back on prev, possibly much later.
+        Finish_Switch(&get_per_cpu_data()->run_queue);
+
+    }
+}
+
+/*******************************************************************************
+Scheduler Interrupt Exit Function
+Interrupt exit hook. Switches threads if an interrupt asked for it or another
+processor handed threads over. Only external interrupts and IPIs that arrived
+with interrupts enabled switch: exceptions can hit code with interrupts
+disabled, such as a lock holder or a switch in progress, and NMI, #DF and #MC
+run on IST stacks that are no thread's.
+*******************************************************************************/
+static void Scheduler_Interrupt_Exit (interrupt_frame* frame) {
+
+    if ((frame->vector < IDT_NUM_OF_EXCEPTION_VECTORS) || ((frame->rflags & RFLAGS_INTERRUPT_FLAG) == 0)) {
+        return;
+    }
+
+    scheduler_run_queue* run_queue = &get_per_cpu_data()->run_queue;
+
+    // Processors still starting up have no run queue yet.
+    if (run_queue->current == nullptr) {
+        return;
+    }
+
+    // The switch waits for scheduler_enable_preemption.
+    if (run_queue->preempt_disable_count != 0) {
+        return;
+    }
+
+    // Nothing interrupted can be in a read-side critical section.
+    rcu_quiescent_state();
+
+    if (run_queue->need_resched || (__atomic_load_n(&run_queue->incoming, __ATOMIC_RELAXED) != nullptr)) {
+        Schedule(run_queue, false);
+    }
+
+}
+
+/*******************************************************************************
+Sleep Timer Callback Function
+*******************************************************************************/
+static void Sleep_Timer_Callback (kernel_timer* timer, void* context) {
+    (void)timer;
+    scheduler_wake((kernel_thread*)context);
+}
+
+/*******************************************************************************
+Kernel Thread Start Function
+First code run by every new thread, entered from the trampoline with interrupts
+disabled as left by the switch. Used, since link time optimization does not see
+the call from assembly.
+*******************************************************************************/
+extern "C" __attribute__((used)) void Kernel_Thread_Start (kernel_thread* thread) {
+
+    Finish_Switch(&get_per_cpu_data()->run_queue);
+    enable_interrupts();
+
+    thread->entry(thread->argument);
+
+    scheduler_exit();
+
+}
+
+/*******************************************************************************
+Setup Scheduler Function
+Once, before any run queue is initialized. Threads are allocated from the given
+PMM and scheduling decisions are made on the way out of interrupts.
+*******************************************************************************/
+void Setup_Scheduler (Physical_Memory_Manager* pmm, Interrupt_Descriptor_Table* idt) {
+
+    scheduler_pmm            = pmm;
+    scheduler_next_thread_id = 1; // 0 is every idle thread.
+
+    idt->set_exit_hook(Scheduler_Interrupt_Exit);
+
+}
+
+/*******************************************************************************
+Initialize Run Queue Function
+Run on each processor after its timer wheel and FPU are up. The code calling
+this becomes the processor's idle thread and owns the vector registers.
+*******************************************************************************/
+void Initialize_Run_Queue (scheduler_run_queue* run_queue, timer_wheel* timers, uint64_t cpu_index) {
+
+    kernel_thread* idle = &run_queue->idle_thread;
+
+    idle->saved_rsp        = 0;
+    idle->next             = nullptr;
+    idle->prev             = nullptr;
+    idle->id               = 0;
+    idle->state            = thread_state_running;
+    idle->nice             = SCHEDULER_NICE_MAX;
+    idle->weight           = scheduler_nice_to_weight[SCHEDULER_NICE_MAX - SCHEDULER_NICE_MIN];
+    idle->vruntime         = 0;
+    idle->exec_start_ns    = get_monotonic_time_ns();
+    idle->total_runtime_ns = 0;
+    idle->cpu_index        = cpu_index;
+    idle->is_new           = false;
+    idle->wake_pending     = false;
+    idle->stack            = nullptr;
+    idle->entry            = nullptr;
+    idle->argument         = nullptr;
+    kernel_timer_initialize(&idle->sleep_timer, nullptr, nullptr);
+
+    uint8_t* fpu_memory = (uint8_t*)scheduler_pmm->allocate_physical_frames(FPU_Save_Area_Footprint());
+
+    idle->fpu_state = (fpu_memory != nullptr) ? Align_FPU_Save_Area(fpu_memory) : nullptr;
+    if (idle->fpu_state != nullptr) {
+        fpu_initialize_save_area(idle->fpu_state);
+    }
+    fpu_take_ownership(idle);
+
+    run_queue->head                  = nullptr;
+    run_queue->num_of_runnable       = 0;
+    run_queue->min_vruntime          = 0;
+    run_queue->incoming              = nullptr;
+    run_queue->exited                = nullptr;
+    run_queue->need_resched          = false;
+    run_queue->preempt_disable_count = 0;
+    run_queue->slice_end_ns          = 0;
+    run_queue->timers                = timers;
+    run_queue->num_of_switches       = 0;
+    kernel_timer_initialize(&run_queue->preempt_timer, Preempt_Timer_Callback, run_queue);
+
+    // Publish last, the interrupt exit hook treats a null current as not set up.
+    __atomic_store_n(&run_queue->current, idle, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Create Kernel Thread Function
+
+Allocate a thread and its stack from the NUMA node of the processor it will run
+on and make it runnable there. The thread runs entry(argument) with interrupts
+enabled and exits when entry returns. Returns nullptr if the processor does not
+exist or memory ran out.
+*******************************************************************************/
+kernel_thread* Create_Kernel_Thread (kernel_thread_entry entry, void* argument, int32_t nice, uint64_t cpu_index) {
+
+    per_cpu_data* cpu = get_per_cpu_data_of(cpu_index);
+    if ((cpu == nullptr) || (__atomic_load_n(&cpu->run_queue.current, __ATOMIC_ACQUIRE) == nullptr)) {
+        return nullptr;
+    }
+
+    if (nice < SCHEDULER_NICE_MIN) {
+        nice = SCHEDULER_NICE_MIN;
+    } else if (nice > SCHEDULER_NICE_MAX) {
+        nice = SCHEDULER_NICE_MAX;
+    }
+
+    /* The thread sits at the bottom of its allocation followed by its vector
+    register save area, the stack grows down from the top. */
+    kernel_thread* thread = (kernel_thread*)scheduler_pmm->allocate_physical_frames_on_node(sizeof(kernel_thread) + FPU_Save_Area_Footprint() + SCHEDULER_THREAD_STACK_SIZE, cpu->numa_node, true);
+    uint64_t id = __atomic_fetch_add(&scheduler_next_thread_id, 1, __ATOMIC_RELAXED);
+
+    if (thread == nullptr) {
+        return nullptr;
+    }
+
+    thread->next             = nullptr;
+    thread->prev             = nullptr;
+    thread->id               = id;
+    thread->state            = thread_state_blocked;
+    thread->nice             = nice;
+    thread->weight           = scheduler_nice_to_weight[nice - SCHEDULER_NICE_MIN];
+    thread->vruntime         = 0;
+    thread->exec_start_ns    = 0;
+    thread->total_runtime_ns = 0;
+    thread->cpu_index        = cpu_index;
+    thread->is_new           = true;
+    thread->wake_pending     = false;
+    thread->fpu_state        = Align_FPU_Save_Area(((uint8_t*)thread) + sizeof(kernel_thread));
+    thread->stack            = thread->fpu_state + FPU_Save_Area_Footprint() - FPU_SAVE_AREA_ALIGNMENT;
+    thread->entry            = entry;
+    thread->argument         = argument;
+    kernel_timer_initialize(&thread->sleep_timer, Sleep_Timer_Callback, thread);
+    fpu_initialize_save_area(thread->fpu_state);
+
+    /* Build the frame the context switch pops, returning into the trampoline
+    with a 16 byte aligned stack. rbp is zero to end frame pointer walks. */
+    uint64_t stack_top = ((uint64_t)(thread->stack + SCHEDULER_THREAD_STACK_SIZE)) & ~0xFULL;
+    scheduler_switch_frame* frame = (scheduler_switch_frame*)(stack_top - sizeof(scheduler_switch_frame));
+    frame->r15            = 0;
+    frame->r14            = 0;
+    frame->r13            = 0;
+    frame->r12            = (uint64_t)thread;
+    frame->rbx            = 0;
+    frame->rbp            = 0;
+    frame->return_address = (uint64_t)scheduler_thread_trampoline;
+    thread->saved_rsp     = (uint64_t)frame;
+
+    scheduler_wake(thread);
+
+    return thread;
+
+}
+
+/*******************************************************************************
+Scheduler Current Thread Function
+*******************************************************************************/
+kernel_thread* scheduler_current_thread () {
+    return get_per_cpu_data()->run_queue.current;
+}
+
+/*******************************************************************************
+Scheduler Yield Function
+Let every other runnable thread of this processor with a smaller vruntime run
+first. Returns straight away if nothing else is runnable.
+*******************************************************************************/
+void scheduler_yield () {
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    Schedule(&get_per_cpu_data()->run_queue, true);
+
+    restore_interrupts(rflags);
+
+}
+
+/*******************************************************************************
+Scheduler Block Function
+
+Stop running the current thread until scheduler_wake is called on it. A wake
+that arrives while the thread is still running makes the next block return at
+once, so no wake is lost; in exchange block may return early and callers should
+re-check whatever they waited for. Not for the idle thread.
+*******************************************************************************/
+void scheduler_block () {
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    scheduler_run_queue* run_queue = &get_per_cpu_data()->run_queue;
+    kernel_thread*       thread    = run_queue->current;
+
+    __atomic_store_n(&thread->state, thread_state_blocked, __ATOMIC_SEQ_CST);
+
+    // A wake that raced with getting here leaves the thread running.
+    if (__atomic_exchange_n(&thread->wake_pending, false, __ATOMIC_SEQ_CST)) {
+        kernel_thread_state expected = thread_state_blocked;
+        if (__atomic_compare_exchange_n(&thread->state, &expected, thread_state_running, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+            restore_interrupts(rflags);
+            return;
+        }
+    }
+
+    Schedule(run_queue, false);
+
+    restore_interrupts(rflags);
+
+}
+
+/*******************************************************************************
+Scheduler Wake Function
+Make a blocked thread runnable on its processor. Safe from any processor and
+from interrupt handlers.
+*******************************************************************************/
+void scheduler_wake (kernel_thread* thread) {
+
+    // Set first so a thread about to block sees it and does not sleep.
+    __atomic_store_n(&thread->wake_pending, true, __ATOMIC_SEQ_CST);
+
+    kernel_thread_state expected = thread_state_blocked;
+    if (__atomic_compare_exchange_n(&thread->state, &expected, thread_state_runnable, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST)) {
+        __atomic_store_n(&thread->wake_pending, false, __ATOMIC_RELAXED);
+        Enqueue_Thread(thread);
+    }
+
+}
+
+/*******************************************************************************
+Scheduler Sleep Function
+Block the current thread for at least the given number of nanoseconds.
+*******************************************************************************/
+void scheduler_sleep_ns (uint64_t ns) {
+
+    kernel_thread* thread      = scheduler_current_thread();
+    uint64_t       deadline_ns = get_monotonic_time_ns() + ns;
+
+    while (get_monotonic_time_ns() < deadline_ns) {
+
+        uint64_t rflags = save_and_disable_interrupts();
+        timer_wheel_arm(&get_per_cpu_data()->timers, &thread->sleep_timer, deadline_ns);
+        restore_interrupts(rflags);
+
+        scheduler_block();
+
+    }
+
+    uint64_t rflags = save_and_disable_interrupts();
+    timer_wheel_cancel(&get_per_cpu_data()->timers, &thread->sleep_timer);
+    restore_interrupts(rflags);
+
+}
+
+/*******************************************************************************
+Scheduler Exit Function
+End the current thread. Its memory is freed by the next thread to run.
+*******************************************************************************/
+void scheduler_exit () {
+
+    disable_interrupts();
+
+    scheduler_run_queue* run_queue = &get_per_cpu_data()->run_queue;
+    kernel_thread*       thread    = run_queue->current;
+
+    fpu_release(thread);
+
+    thread->state     = thread_state_exited;
+    thread->next      = run_queue->exited;
+    run_queue->exited = thread;
+
+    Schedule(run_queue, false);
+
+    // Never switched back to.
+    while (true) {
+        __asm__ __volatile__ ("hlt");
+    }
+
+}
+
+/*******************************************************************************
+Scheduler Disable Preemption Function
+Keep the current thread on the processor until the matching enable, interrupts
+still run. Nests. The thread must not yield, block or sleep meanwhile.
+*******************************************************************************/
+void scheduler_disable_preemption () {
+    get_per_cpu_data()->run_queue.preempt_disable_count++;
+}
+
+/*******************************************************************************
+Scheduler Enable Preemption Function
+Undo one disable. A switch asked for in between happens now, unless interrupts
+are disabled, in which case the next interrupt exit makes it.
+*******************************************************************************/
+void scheduler_enable_preemption () {
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    scheduler_run_queue* run_queue = &get_per_cpu_data()->run_queue;
+    run_queue->preempt_disable_count--;
+
+    if ((run_queue->preempt_disable_count == 0) && ((rflags & RFLAGS_INTERRUPT_FLAG) != 0) &&
+        (run_queue->need_resched || (__atomic_load_n(&run_queue->incoming, __ATOMIC_RELAXED) != nullptr))) {
+        Schedule(run_queue, false);
+    }
+
+    restore_interrupts(rflags);
+
+}
@@ -0,0 +1,75 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+#include "../interrupts/interrupt_descriptor_table.h"
+#include "../time/timer_wheel.h"
+
+#define SCHEDULER_THREAD_STACK_SIZE       (4 * 4096)
+#define SCHEDULER_NICE_MIN                (-20)
+#define SCHEDULER_NICE_MAX                19
+#define SCHEDULER_NICE_0_WEIGHT           1024
+#define SCHEDULER_TARGET_LATENCY_NS       6000000 // Every runnable thread runs once per period...
+#define SCHEDULER_MIN_GRANULARITY_NS      750000  // ...unless that makes slices shorter than this.
+#define SCHEDULER_WAKE_UP_GRANULARITY_NS  1000000 // Vruntime lead a woken thread needs to preempt.
+
+enum kernel_thread_state {
+    thread_state_runnable = 0,
+    thread_state_running  = 1,
+    thread_state_blocked  = 2,
+    thread_state_exited   = 3
+};
+
+typedef void (*kernel_thread_entry) (void* argument);
+
+/* A kernel thread. Threads stay on the processor they were created for, so only
+that processor ever switches to or from one. */
+typedef struct kernel_thread {
+    uint64_t              saved_rsp; // Must stay first, written by the context switch.
+    struct kernel_thread* next;      // Run queue, incoming or exited list link.
+    struct kernel_thread* prev;
+    uint64_t              id;
+    kernel_thread_state   state;
+    int32_t               nice;
+    uint64_t              weight;
+    uint64_t              vruntime;  // Processor time received, ns scaled by nice 0 weight / weight.
+    uint64_t              exec_start_ns;
+    uint64_t              total_runtime_ns;
+    uint64_t              cpu_index;
+    bool                  is_new;
+    bool                  wake_pending; // Woken while still running, the next block returns.
+    uint8_t*              stack;     // nullptr for a processor's idle thread.
+    uint8_t*              fpu_state; // Vector register save area, loaded lazily.
+    kernel_thread_entry   entry;
+    void*                 argument;
+    kernel_timer          sleep_timer;
+} kernel_thread;
+
+/* Run queue of one processor, only touched by that processor with interrupts
+disabled. Other processors hand threads over through the incoming list. */
+typedef struct {
+    kernel_thread*  current;
+    kernel_thread   idle_thread;     // The processor's boot context, runs when nothing else can.
+    kernel_thread*  head;            // Runnable threads, ascending vruntime.
+    uint64_t        num_of_runnable; // Not counting the current thread.
+    uint64_t        min_vruntime;
+    kernel_thread*  incoming;        // Pushed by any processor, drained by the owner.
+    kernel_thread*  exited;          // Freed once switched away from.
+    bool            need_resched;
+    uint32_t        preempt_disable_count; // Interrupts do not switch threads while non-zero.
+    uint64_t        slice_end_ns;
+    kernel_timer    preempt_timer;
+    timer_wheel*    timers;
+    uint64_t        num_of_switches;
+} scheduler_run_queue;
+
+void           Setup_Scheduler              (Physical_Memory_Manager* pmm, Interrupt_Descriptor_Table* idt);
+void           Initialize_Run_Queue         (scheduler_run_queue* run_queue, timer_wheel* timers, uint64_t cpu_index);
+kernel_thread* Create_Kernel_Thread         (kernel_thread_entry entry, void* argument, int32_t nice, uint64_t cpu_index);
+kernel_thread* scheduler_current_thread     ();
+void           scheduler_yield              ();
+void           scheduler_sleep_ns           (uint64_t ns);
+void           scheduler_block              ();
+void           scheduler_wake               (kernel_thread* thread);
+void           scheduler_exit               ();
+void           scheduler_disable_preemption ();
+void           scheduler_enable_preemption  ();
@@ -0,0 +1,245 @@
+#include "lock_contention_benchmark.h"
+#include "../scheduler/scheduler.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/synchronization/ticket_lock.h"
+#include "../../shared/synchronization/mcs_lock.h"
+#include "../../shared/synchronization/reader_writer_lock.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+typedef struct lock_benchmark_state lock_benchmark_state;
+
+// One thread's part, a line of its own so threads only share the lock's lines.
+typedef struct {
+    mcs_lock_node         node;
+    lock_benchmark_state* state;
+    uint64_t              cycles;
+} __attribute__((aligned(64))) lock_benchmark_thread;
+
+// Shared by the benchmark threads, lives on the caller's stack.
+struct lock_benchmark_state {
+    lock_benchmark_kind   kind;
+    uint64_t              num_of_threads;
+    uint64_t              num_of_acquisitions;
+    uint64_t              num_of_ready_threads;
+    uint64_t              num_of_finished_threads;
+    uint64_t              num_of_torn_reads;
+    uint32_t              test_and_set_lock __attribute__((aligned(64)));
+    ticket_lock           ticket            __attribute__((aligned(64)));
+    mcs_lock              mcs               __attribute__((aligned(64)));
+    reader_writer_lock    reader_writer     __attribute__((aligned(64)));
+    /* Written in pairs inside the lock, so a count off from the number of
+    writes or a reader seeing the two differ means the lock let two in. */
+    volatile uint64_t     first_counter     __attribute__((aligned(64)));
+    volatile uint64_t     second_counter;
+    lock_benchmark_thread threads[LOCK_BENCHMARK_MAX_NUM_OF_THREADS];
+};
+
+/*******************************************************************************
+Write Critical Section Function
+*******************************************************************************/
+static void Write_Critical_Section (lock_benchmark_state* state) {
+    state->first_counter  = state->first_counter + 1;
+    state->second_counter = state->second_counter + 1;
+}
+
+/*******************************************************************************
+Read Critical Section Function
+*******************************************************************************/
+static void Read_Critical_Section (lock_benchmark_state* state) {
+    if (state->first_counter != state->second_counter) {
+        __atomic_add_fetch(&state->num_of_torn_reads, 1, __ATOMIC_RELAXED);
+    }
+}
+
+/*******************************************************************************
+Contending Thread Function
+Wait until every thread is in place, then take and release the lock in a loop
+with interrupts disabled, so the figures are lock hand-offs and not a holder
+being preempted.
+*******************************************************************************/
+static void Contending_Thread (void* argument) {
+
+    lock_benchmark_thread* thread = (lock_benchmark_thread*)argument;
+    lock_benchmark_state*  state  = thread->state;
+
+    __atomic_add_fetch(&state->num_of_ready_threads, 1, __ATOMIC_ACQ_REL);
+    while (__atomic_load_n(&state->num_of_ready_threads, __ATOMIC_ACQUIRE) < state->num_of_threads) {
+        __asm__ __volatile__ ("pause");
+    }
+
+    uint64_t rflags    = save_and_disable_interrupts();
+    uint64_t start_tsc = read_tsc();
+
+    for (uint64_t idx = 0; idx < state->num_of_acquisitions; idx++) {
+
+        switch (state->kind) {
+
+            case lock_benchmark_test_and_set:
+                while (__atomic_exchange_n(&state->test_and_set_lock, 1, __ATOMIC_ACQUIRE) != 0) {
+                    while (__atomic_load_n(&state->test_and_set_lock, __ATOMIC_RELAXED) != 0) {
+                        __asm__ __volatile__ ("pause");
+                    }
+                }
+                Write_Critical_Section(state);
+                __atomic_store_n(&state->test_and_set_lock, 0, __ATOMIC_RELEASE);
+                break;
+
+            case lock_benchmark_ticket:
+                ticket_lock_acquire(&state->ticket);
+                Write_Critical_Section(state);
+                ticket_lock_release(&state->ticket);
+                break;
+
+            case lock_benchmark_mcs:
+                mcs_lock_acquire(&state->mcs, &thread->node);
+                Write_Critical_Section(state);
+                mcs_lock_release(&state->mcs, &thread->node);
+                break;
+
+            case lock_benchmark_reader_writer_writes:
+                reader_writer_lock_acquire_write(&state->reader_writer);
+                Write_Critical_Section(state);
+                reader_writer_lock_release_write(&state->reader_writer);
+                break;
+
+            case lock_benchmark_reader_writer_mixed:
+                if ((idx % LOCK_BENCHMARK_WRITE_INTERVAL) == 0) {
+                    reader_writer_lock_acquire_write(&state->reader_writer);
+                    Write_Critical_Section(state);
+                    reader_writer_lock_release_write(&state->reader_writer);
+                } else {
+                    reader_writer_lock_acquire_read(&state->reader_writer);
+                    Read_Critical_Section(state);
+                    reader_writer_lock_release_read(&state->reader_writer);
+                }
+                break;
+
+        }
+
+    }
+
+    thread->cycles = read_tsc() - start_tsc;
+    restore_interrupts(rflags);
+
+    __atomic_add_fetch(&state->num_of_finished_threads, 1, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Run Kind Function
+One thread per processor contending for the kind's lock. Returns false if the
+threads could not all be created.
+*******************************************************************************/
+static bool Run_Kind (lock_benchmark_state* state, lock_benchmark_kind kind, lock_contention_benchmark_result* result) {
+
+    state->kind                    = kind;
+    state->num_of_ready_threads    = 0;
+    state->num_of_finished_threads = 0;
+    state->num_of_torn_reads       = 0;
+    state->test_and_set_lock       = 0;
+    state->first_counter           = 0;
+    state->second_counter          = 0;
+    ticket_lock_initialize(&state->ticket);
+    mcs_lock_initialize(&state->mcs);
+    reader_writer_lock_initialize(&state->reader_writer);
+
+    uint64_t num_of_created_threads = 0;
+    for (uint64_t idx = 0; idx < state->num_of_threads; idx++) {
+        state->threads[idx].state  = state;
+        state->threads[idx].cycles = 0;
+        if (Create_Kernel_Thread(Contending_Thread, &state->threads[idx], 0, idx) == nullptr) {
+            break;
+        }
+        num_of_created_threads++;
+    }
+
+    // Threads that did start wait for the missing ones, release them to finish.
+    if (num_of_created_threads != state->num_of_threads) {
+        __atomic_add_fetch(&state->num_of_ready_threads, state->num_of_threads - num_of_created_threads, __ATOMIC_RELEASE);
+    }
+
+    // The idle thread only runs again once the processor's thread has stopped.
+    while (__atomic_load_n(&state->num_of_finished_threads, __ATOMIC_ACQUIRE) < num_of_created_threads) {
+        scheduler_yield();
+    }
+
+    if (num_of_created_threads != state->num_of_threads) {
+        return false;
+    }
+
+    uint64_t total_cycles   = 0;
+    uint64_t slowest_cycles = 0;
+    for (uint64_t idx = 0; idx < state->num_of_threads; idx++) {
+        total_cycles += state->threads[idx].cycles;
+        if (state->threads[idx].cycles > slowest_cycles) {
+            slowest_cycles = state->threads[idx].cycles;
+        }
+    }
+
+    uint64_t num_of_writes_per_thread = state->num_of_acquisitions;
+    if (kind == lock_benchmark_reader_writer_mixed) {
+        num_of_writes_per_thread = (state->num_of_acquisitions + LOCK_BENCHMARK_WRITE_INTERVAL - 1) / LOCK_BENCHMARK_WRITE_INTERVAL;
+    }
+    uint64_t expected_count = num_of_writes_per_thread * state->num_of_threads;
+
+    result->average_cycles[kind]        = total_cycles / (state->num_of_acquisitions * state->num_of_threads);
+    result->slowest_thread_cycles[kind] = slowest_cycles / state->num_of_acquisitions;
+    result->mutual_exclusion_held[kind] = (state->first_counter  == expected_count) &&
+                                          (state->second_counter == expected_count) &&
+                                          (state->num_of_torn_reads == 0);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Benchmark Lock Contention Function
+
+Run every lock kind with one thread per processor, up to MAX_NUM_OF_THREADS,
+each taking the lock num_of_acquisitions times around a two line critical
+section. Reports cycles per acquisition and whether the critical section was
+ever entered twice at once. Must be called from the bootstrap processor's idle
+thread. Returns false if the threads could not be created.
+*******************************************************************************/
+bool Benchmark_Lock_Contention (uint64_t num_of_acquisitions, lock_contention_benchmark_result* result) {
+
+    if (num_of_acquisitions == 0) {
+        return false;
+    }
+
+    lock_benchmark_state state;
+    state.num_of_threads      = get_num_of_cpus();
+    state.num_of_acquisitions = num_of_acquisitions;
+    if (state.num_of_threads > LOCK_BENCHMARK_MAX_NUM_OF_THREADS) {
+        state.num_of_threads = LOCK_BENCHMARK_MAX_NUM_OF_THREADS;
+    }
+
+    result->num_of_threads      = state.num_of_threads;
+    result->num_of_acquisitions = num_of_acquisitions;
+
+    for (uint64_t kind = 0; kind < LOCK_BENCHMARK_NUM_OF_KINDS; kind++) {
+        if (!Run_Kind(&state, (lock_benchmark_kind)kind, result)) {
+            return false;
+        }
+    }
+
+    return true;
+
+}
+
+/*******************************************************************************
+Lock Benchmark Kind Name Function
+*******************************************************************************/
+const char* lock_benchmark_kind_name (lock_benchmark_kind kind) {
+
+    switch (kind) {
+        case lock_benchmark_test_and_set:         return "test-and-set";
+        case lock_benchmark_ticket:               return "ticket";
+        case lock_benchmark_mcs:                  return "mcs";
+        case lock_benchmark_reader_writer_writes: return "rw write";
+        case lock_benchmark_reader_writer_mixed:  return "rw mixed";
+    }
+
+    return "unknown";
+
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+
+#define LOCK_BENCHMARK_NUM_OF_KINDS       5
+#define LOCK_BENCHMARK_MAX_NUM_OF_THREADS 64
+#define LOCK_BENCHMARK_WRITE_INTERVAL     8  // One write per this many acquisitions in the mixed run.
+
+enum lock_benchmark_kind {
+    lock_benchmark_test_and_set         = 0, // Baseline, the exchange loop the kernel used before.
+    lock_benchmark_ticket               = 1,
+    lock_benchmark_mcs                  = 2,
+    lock_benchmark_reader_writer_writes = 3, // Reader-writer lock taken for writing only.
+    lock_benchmark_reader_writer_mixed  = 4  // Reads with a write every WRITE_INTERVAL.
+};
+
+typedef struct {
+    uint64_t num_of_threads;
+    uint64_t num_of_acquisitions;                                  // Per thread.
+    uint64_t average_cycles[LOCK_BENCHMARK_NUM_OF_KINDS];          // Per acquisition over all threads.
+    uint64_t slowest_thread_cycles[LOCK_BENCHMARK_NUM_OF_KINDS];   // Per acquisition of the slowest thread.
+    bool     mutual_exclusion_held[LOCK_BENCHMARK_NUM_OF_KINDS];
+} lock_contention_benchmark_result;
+
+bool        Benchmark_Lock_Contention  (uint64_t num_of_acquisitions, lock_contention_benchmark_result* result);
+const char* lock_benchmark_kind_name   (lock_benchmark_kind kind);
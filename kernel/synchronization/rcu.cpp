@@ -0,0 +1,303 @@
+#include "rcu.h"
+#include "../cpu/per_cpu.h"
+#include "../cpu/smp.h"
+#include "../scheduler/scheduler.h"
+#include "../../shared/assembly_wrappers/registers.h"
+
+/* Quiescent-state based RCU. Readers only disable preemption, touching nothing
+but their own processor's data, so lookups scale with the number of processors.
+
+Every processor records the global epoch whenever it passes a quiescent state:
+a context switch, an interrupt taken outside a read-side critical section or a
+pass of the idle loop. Halted processors are marked idle and not waited for.
+Once every processor has recorded the current epoch the epoch advances. An
+object retired in epoch E is unreachable to every reader by epoch E + 2, the
+quiescent states of E + 1 were all passed after the retirement. */
+static uint64_t                 rcu_global_epoch;
+static Physical_Memory_Manager* rcu_pmm;
+
+/*******************************************************************************
+Advance Epoch Function
+Move the global epoch on if every processor passed a quiescent state in it.
+Kicks processors still lagging with an IPI, whose interrupt exit reports one.
+*******************************************************************************/
+static bool Advance_Epoch (bool kick_lagging) {
+
+    uint64_t epoch         = __atomic_load_n(&rcu_global_epoch, __ATOMIC_SEQ_CST);
+    uint64_t own_cpu_index = get_per_cpu_data()->cpu_index;
+    bool     all_quiescent = true;
+
+    for (uint64_t idx = 0; idx < get_num_of_cpus(); idx++) {
+
+        uint64_t quiescent_epoch = __atomic_load_n(&get_per_cpu_data_of(idx)->rcu.quiescent_epoch, __ATOMIC_SEQ_CST);
+        if ((quiescent_epoch == RCU_IDLE_EPOCH) || (quiescent_epoch == epoch)) {
+            continue;
+        }
+
+        all_quiescent = false;
+        if (!kick_lagging) {
+            break;
+        }
+        if (idx != own_cpu_index) {
+            smp_wake_up(idx);
+        }
+
+    }
+
+    if (!all_quiescent) {
+        return false;
+    }
+
+    // Losing the race means another processor advanced it, as good.
+    __atomic_compare_exchange_n(&rcu_global_epoch, &epoch, epoch + 1, false, __ATOMIC_SEQ_CST, __ATOMIC_RELAXED);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Free Frames Callback Function
+*******************************************************************************/
+static void Free_Frames_Callback (void* argument) {
+    rcu_pmm->free_physical_frames(argument);
+}
+
+/*******************************************************************************
+Setup RCU Function
+Once, before any processor's state is initialized. Deferred frees go back to
+the given PMM.
+*******************************************************************************/
+void Setup_RCU (Physical_Memory_Manager* pmm) {
+    rcu_pmm          = pmm;
+    rcu_global_epoch = 1;
+}
+
+/*******************************************************************************
+Initialize RCU State Function
+On the processor owning the state. It starts idle until its idle loop runs.
+*******************************************************************************/
+void Initialize_RCU_State (rcu_cpu_state* state) {
+
+    state->read_nesting     = 0;
+    state->reader_left_idle = false;
+    state->pending_head     = nullptr;
+    state->pending_tail     = nullptr;
+    state->num_of_pending   = 0;
+    kernel_timer_initialize(&state->poll_timer, nullptr, nullptr);
+
+    __atomic_store_n(&state->quiescent_epoch, RCU_IDLE_EPOCH, __ATOMIC_SEQ_CST);
+
+}
+
+/*******************************************************************************
+RCU Read Lock Function
+
+Enter a read-side critical section, nests. Objects read through RCU_DEREFERENCE
+stay valid until the matching unlock. The section must not yield, block or
+sleep. An interrupt handler of a halted processor leaves the idle state for the
+section so it is waited for.
+*******************************************************************************/
+void rcu_read_lock () {
+
+    scheduler_disable_preemption();
+
+    rcu_cpu_state* state = &get_per_cpu_data()->rcu;
+    state->read_nesting++;
+
+    if ((state->read_nesting == 1) && (__atomic_load_n(&state->quiescent_epoch, __ATOMIC_RELAXED) == RCU_IDLE_EPOCH)) {
+        __atomic_exchange_n(&state->quiescent_epoch, __atomic_load_n(&rcu_global_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+        state->reader_left_idle = true;
+    }
+
+}
+
+/*******************************************************************************
+RCU Read Unlock Function
+*******************************************************************************/
+void rcu_read_unlock () {
+
+    rcu_cpu_state* state = &get_per_cpu_data()->rcu;
+    state->read_nesting--;
+
+    if ((state->read_nesting == 0) && state->reader_left_idle) {
+        state->reader_left_idle = false;
+        __atomic_store_n(&state->quiescent_epoch, RCU_IDLE_EPOCH, __ATOMIC_RELEASE);
+    }
+
+    scheduler_enable_preemption();
+
+}
+
+/*******************************************************************************
+RCU Quiescent State Function
+
+Report that the executing processor is outside any read-side critical section.
+The report is a full barrier so later reads cannot be taken for earlier ones,
+it is only made once per epoch.
+*******************************************************************************/
+void rcu_quiescent_state () {
+
+    rcu_cpu_state* state = &get_per_cpu_data()->rcu;
+    uint64_t       epoch = __atomic_load_n(&rcu_global_epoch, __ATOMIC_ACQUIRE);
+
+    if (__atomic_load_n(&state->quiescent_epoch, __ATOMIC_RELAXED) != epoch) {
+        __atomic_exchange_n(&state->quiescent_epoch, epoch, __ATOMIC_SEQ_CST);
+    }
+
+}
+
+/*******************************************************************************
+RCU Enter Idle Function
+Called by the idle loop with interrupts disabled right before halting. With
+callbacks pending, a poll timer wakes the processor to check on them.
+*******************************************************************************/
+void rcu_enter_idle () {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    if (cpu->rcu.pending_head != nullptr) {
+        timer_wheel_arm(&cpu->timers, &cpu->rcu.poll_timer, get_monotonic_time_ns() + RCU_POLL_INTERVAL_NS);
+    }
+
+    __atomic_store_n(&cpu->rcu.quiescent_epoch, RCU_IDLE_EPOCH, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+RCU Exit Idle Function
+Called by the idle loop with interrupts disabled after halting.
+*******************************************************************************/
+void rcu_exit_idle () {
+
+    rcu_cpu_state* state = &get_per_cpu_data()->rcu;
+
+    __atomic_exchange_n(&state->quiescent_epoch, __atomic_load_n(&rcu_global_epoch, __ATOMIC_SEQ_CST), __ATOMIC_SEQ_CST);
+
+}
+
+/*******************************************************************************
+RCU Call Function
+Run the callback once every reader that could have seen the retired object is
+done with it. The object must already be unreachable for new readers. Runs on
+the calling processor from its idle loop.
+*******************************************************************************/
+void rcu_call (rcu_head* head, rcu_callback callback, void* argument) {
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    rcu_cpu_state* state = &get_per_cpu_data()->rcu;
+
+    // The unlinking stores come before the epoch is read.
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    head->next     = nullptr;
+    head->epoch    = __atomic_load_n(&rcu_global_epoch, __ATOMIC_SEQ_CST);
+    head->callback = callback;
+    head->argument = argument;
+
+    if (state->pending_tail == nullptr) {
+        state->pending_head = head;
+    } else {
+        state->pending_tail->next = head;
+    }
+    state->pending_tail = head;
+    state->num_of_pending++;
+
+    restore_interrupts(rflags);
+
+}
+
+/*******************************************************************************
+RCU Free Frames Function
+Give frames from the PMM back after a grace period. The head may live inside
+the frames.
+*******************************************************************************/
+void rcu_free_frames (rcu_head* head, void* frames) {
+    rcu_call(head, Free_Frames_Callback, frames);
+}
+
+/*******************************************************************************
+RCU Process Callbacks Function
+
+Run the executing processor's callbacks whose grace period is over, advancing
+the epoch as far as it can go. Called from the idle loop, which is a quiescent
+state. Returns true while callbacks remain pending.
+*******************************************************************************/
+bool rcu_process_callbacks () {
+
+    rcu_cpu_state* state = &get_per_cpu_data()->rcu;
+
+    if (__atomic_load_n(&state->pending_head, __ATOMIC_RELAXED) == nullptr) {
+        return false;
+    }
+
+    // A grace period is two epochs, both can pass here when nothing lags.
+    rcu_quiescent_state();
+    for (uint64_t idx = 0; idx < 2; idx++) {
+        if (!Advance_Epoch(true)) {
+            break;
+        }
+        rcu_quiescent_state();
+    }
+
+    uint64_t rflags = save_and_disable_interrupts();
+
+    uint64_t  epoch      = __atomic_load_n(&rcu_global_epoch, __ATOMIC_ACQUIRE);
+    rcu_head* ready_head = state->pending_head;
+    rcu_head* ready_tail = nullptr;
+
+    while ((state->pending_head != nullptr) && ((state->pending_head->epoch + 2) <= epoch)) {
+        ready_tail          = state->pending_head;
+        state->pending_head = state->pending_head->next;
+        state->num_of_pending--;
+    }
+
+    if (state->pending_head == nullptr) {
+        state->pending_tail = nullptr;
+    }
+
+    bool pending = (state->pending_head != nullptr);
+
+    restore_interrupts(rflags);
+
+    if (ready_tail == nullptr) {
+        return pending;
+    }
+
+    ready_tail->next = nullptr;
+    while (ready_head != nullptr) {
+        rcu_head* next = ready_head->next;
+        ready_head->callback(ready_head->argument);
+        ready_head = next;
+    }
+
+    return pending;
+
+}
+
+/*******************************************************************************
+RCU Synchronize Function
+Wait for a full grace period, sleeping between checks. Not from a read-side
+critical section, an interrupt handler or an idle thread, which use rcu_call.
+*******************************************************************************/
+void rcu_synchronize () {
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+
+    uint64_t target_epoch = __atomic_load_n(&rcu_global_epoch, __ATOMIC_SEQ_CST) + 2;
+
+    while (__atomic_load_n(&rcu_global_epoch, __ATOMIC_SEQ_CST) < target_epoch) {
+        rcu_quiescent_state();
+        if (!Advance_Epoch(true)) {
+            scheduler_sleep_ns(RCU_POLL_INTERVAL_NS);
+        }
+    }
+
+}
+
+/*******************************************************************************
+RCU Get Epoch Function
+*******************************************************************************/
+uint64_t rcu_get_epoch () {
+    return __atomic_load_n(&rcu_global_epoch, __ATOMIC_ACQUIRE);
+}
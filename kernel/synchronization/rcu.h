@@ -0,0 +1,47 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/physical_memory_manager.h"
+#include "../time/timer_wheel.h"
+
+#define RCU_IDLE_EPOCH        UINT64_MAX // Quiescent epoch of a halted processor.
+#define RCU_POLL_INTERVAL_NS  1000000    // 1ms, how often waiting grace periods are checked.
+
+// Publish a pointer for readers, and read one inside a read-side critical section.
+#define RCU_ASSIGN_POINTER(pointer, value) __atomic_store_n(&(pointer), (value), __ATOMIC_RELEASE)
+#define RCU_DEREFERENCE(pointer)           __atomic_load_n(&(pointer), __ATOMIC_ACQUIRE)
+
+typedef void (*rcu_callback) (void* argument);
+
+/* Deferred work, usually embedded in the retired object in a field readers do
+not look at. Must stay untouched until the callback runs. */
+typedef struct rcu_head {
+    struct rcu_head* next;
+    uint64_t         epoch;    // Global epoch when retired, runs two epochs later.
+    rcu_callback     callback;
+    void*            argument;
+} rcu_head;
+
+/* One processor's part of RCU. The quiescent epoch is read by every processor
+looking for the end of a grace period, the rest only by the owner. */
+typedef struct {
+    uint64_t     quiescent_epoch;  // Global epoch of the last quiescent state or RCU_IDLE_EPOCH.
+    uint32_t     read_nesting;
+    bool         reader_left_idle; // A reader in an interrupt handler while halted.
+    rcu_head*    pending_head;     // Retired on this processor, in epoch order.
+    rcu_head*    pending_tail;
+    uint64_t     num_of_pending;
+    kernel_timer poll_timer;       // Wakes the halted processor to check pending callbacks.
+} __attribute__((aligned(64))) rcu_cpu_state;
+
+void     Setup_RCU             (Physical_Memory_Manager* pmm);
+void     Initialize_RCU_State  (rcu_cpu_state* state);
+void     rcu_read_lock         ();
+void     rcu_read_unlock       ();
+void     rcu_quiescent_state   ();
+void     rcu_enter_idle        ();
+void     rcu_exit_idle         ();
+void     rcu_call              (rcu_head* head, rcu_callback callback, void* argument);
+void     rcu_free_frames       (rcu_head* head, void* frames);
+bool     rcu_process_callbacks ();
+void     rcu_synchronize       ();
+uint64_t rcu_get_epoch         ();
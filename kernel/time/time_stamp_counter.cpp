@@ -0,0 +1,248 @@
+#include "time_stamp_counter.h"
+#include "../cpu/per_cpu.h"
+#include "../../shared/assembly_wrappers/registers.h"
+#include "../../shared/assembly_wrappers/port_io.h"
+#include "../../shared/math/uint128.h"
+
+#define CPUID_FEATURES_LEAF            0x00000001
+#define CPUID_FEATURES_EDX_TSC         (1U << 4)
+#define CPUID_EXTENDED_MAX_LEAF        0x80000000
+#define CPUID_ADVANCED_POWER_LEAF      0x80000007
+#define CPUID_ADVANCED_POWER_EDX_ITSC  (1U << 8)
+
+// Programmable interval timer channel 2, whose gate and output are wired to port 0x61.
+#define PIT_FREQUENCY_HZ               1193182ULL
+#define PIT_CHANNEL_2_DATA_PORT        0x42
+#define PIT_COMMAND_PORT               0x43
+#define PIT_CHANNEL_2_ONE_SHOT_COMMAND 0xB0 // Channel 2, low then high byte, mode 0, binary.
+#define PIT_CONTROL_PORT               0x61
+#define PIT_CONTROL_GATE_2             0x01
+#define PIT_CONTROL_SPEAKER            0x02
+#define PIT_CONTROL_OUTPUT_2           0x20
+#define PIT_MAX_POLLS                  (1ULL << 24)
+
+// High precision event timer registers, as 64-bit register indices.
+#define HPET_CAPABILITIES_REGISTER     (0x000 / 8)
+#define HPET_CONFIGURATION_REGISTER    (0x010 / 8)
+#define HPET_MAIN_COUNTER_REGISTER     (0x0F0 / 8)
+#define HPET_CAPABILITIES_64_BIT       (1ULL << 13)
+#define HPET_CONFIGURATION_ENABLE      (1ULL << 0)
+#define HPET_FEMTOSECONDS_PER_SECOND   1000000000000000ULL
+
+/*******************************************************************************
+Measure TSC Against PIT Function
+
+Count TSC cycles while PIT channel 2 counts down pit_ticks in one-shot mode.
+Returns 0 if the PIT output never went high.
+*******************************************************************************/
+static uint64_t Measure_TSC_Against_PIT (uint16_t pit_ticks) {
+
+    // Gate channel 2 on with the speaker disconnected.
+    outb(PIT_CONTROL_PORT, (inb(PIT_CONTROL_PORT) & ~PIT_CONTROL_SPEAKER) | PIT_CONTROL_GATE_2);
+
+    outb(PIT_COMMAND_PORT,        PIT_CHANNEL_2_ONE_SHOT_COMMAND);
+    outb(PIT_CHANNEL_2_DATA_PORT, (uint8_t)(pit_ticks & 0xFF));
+    outb(PIT_CHANNEL_2_DATA_PORT, (uint8_t)(pit_ticks >> 8));
+
+    // Counting starts once the high byte is written.
+    uint64_t start_tsc = read_tsc();
+
+    for (uint64_t poll = 0; poll < PIT_MAX_POLLS; poll++) {
+        if (inb(PIT_CONTROL_PORT) & PIT_CONTROL_OUTPUT_2) {
+            return read_tsc() - start_tsc;
+        }
+    }
+
+    return 0;
+
+}
+
+/*******************************************************************************
+Measure TSC Against HPET Function
+
+Count TSC cycles while the HPET main counter advances hpet_ticks. The counter
+is sampled right after each TSC read so both ends of the interval see the same
+delay. Returns the cycles, or 0 if the counter did not advance. A 32-bit
+counter wraps after minutes, so differences are taken modulo its width.
+*******************************************************************************/
+static uint64_t Measure_TSC_Against_HPET (volatile uint64_t* hpet_registers, uint64_t hpet_ticks, uint64_t* measured_hpet_ticks) {
+
+    uint64_t counter_mask = (hpet_registers[HPET_CAPABILITIES_REGISTER] & HPET_CAPABILITIES_64_BIT) ? UINT64_MAX : UINT32_MAX;
+
+    uint64_t start_tsc     = read_tsc();
+    uint64_t start_counter = hpet_registers[HPET_MAIN_COUNTER_REGISTER];
+
+    for (uint64_t poll = 0; poll < PIT_MAX_POLLS; poll++) {
+
+        uint64_t end_tsc     = read_tsc();
+        uint64_t end_counter = hpet_registers[HPET_MAIN_COUNTER_REGISTER];
+        uint64_t elapsed     = (end_counter - start_counter) & counter_mask;
+
+        if (elapsed >= hpet_ticks) {
+            *measured_hpet_ticks = elapsed;
+            return end_tsc - start_tsc;
+        }
+    }
+
+    return 0;
+
+}
+
+/*******************************************************************************
+Measure Frequency Against HPET Function
+TSC frequency from the run with the fewest cycles per HPET tick, the HPET is
+sampled at both ends. Returns 0 if the HPET is unusable or never advanced.
+*******************************************************************************/
+static uint64_t Measure_Frequency_Against_HPET (volatile uint64_t* hpet_registers) {
+
+    uint64_t period_fs = hpet_registers[HPET_CAPABILITIES_REGISTER] >> 32;
+    if (period_fs == 0) {
+        return 0;
+    }
+
+    hpet_registers[HPET_CONFIGURATION_REGISTER] |= HPET_CONFIGURATION_ENABLE;
+
+    const uint64_t HPET_FREQUENCY_HZ = HPET_FEMTOSECONDS_PER_SECOND / period_fs;
+    const uint64_t HPET_TICKS        = (HPET_FREQUENCY_HZ * TSC_CALIBRATION_PERIOD_MS) / 1000;
+
+    uint64_t best_cycles = 0;
+    uint64_t best_ticks  = 0;
+    for (uint64_t run = 0; run < TSC_CALIBRATION_NUM_OF_RUNS; run++) {
+
+        uint64_t ticks  = 0;
+        uint64_t cycles = Measure_TSC_Against_HPET(hpet_registers, HPET_TICKS, &ticks);
+        if (cycles == 0) {
+            return 0;
+        }
+
+        if ((best_ticks == 0) || (((uint128_t)cycles * best_ticks) < ((uint128_t)best_cycles * ticks))) {
+            best_cycles = cycles;
+            best_ticks  = ticks;
+        }
+
+    }
+
+    return (best_cycles * HPET_FREQUENCY_HZ) / best_ticks;
+
+}
+
+/*******************************************************************************
+Measure Frequency Against PIT Function
+TSC frequency from the shortest run. Returns 0 if the PIT never fired.
+*******************************************************************************/
+static uint64_t Measure_Frequency_Against_PIT () {
+
+    const uint16_t PIT_TICKS = (uint16_t)((PIT_FREQUENCY_HZ * TSC_CALIBRATION_PERIOD_MS) / 1000);
+
+    uint64_t min_cycles = UINT64_MAX;
+    for (uint64_t run = 0; run < TSC_CALIBRATION_NUM_OF_RUNS; run++) {
+
+        uint64_t cycles = Measure_TSC_Against_PIT(PIT_TICKS);
+        if (cycles == 0) {
+            return 0;
+        }
+
+        if (cycles < min_cycles) {
+            min_cycles = cycles;
+        }
+
+    }
+
+    return (min_cycles * PIT_FREQUENCY_HZ) / PIT_TICKS;
+
+}
+
+/*******************************************************************************
+Calibrate Time Stamp Counter Function
+
+Detect the TSC and whether it is invariant, then measure its frequency against
+the HPET when the ACPI tables describe one (hpet_registers is its mapped
+register block), else or if the HPET measurement fails against the PIT. The calibration is repeated and the
+shortest measurement kept, since an SMI or a slow port access can only make a
+run longer. Monotonic time starts at zero at the end of calibration. Returns
+false if there is no TSC or neither reference timer could be used.
+*******************************************************************************/
+bool Calibrate_Time_Stamp_Counter (tsc_calibration* calibration, volatile uint64_t* hpet_registers) {
+
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(CPUID_FEATURES_LEAF, 0, &eax, &ebx, &ecx, &edx);
+    if (!(edx & CPUID_FEATURES_EDX_TSC)) {
+        return false;
+    }
+
+    calibration->invariant = false;
+    cpuid(CPUID_EXTENDED_MAX_LEAF, 0, &eax, &ebx, &ecx, &edx);
+    if (eax >= CPUID_ADVANCED_POWER_LEAF) {
+        cpuid(CPUID_ADVANCED_POWER_LEAF, 0, &eax, &ebx, &ecx, &edx);
+        calibration->invariant = ((edx & CPUID_ADVANCED_POWER_EDX_ITSC) != 0);
+    }
+
+    calibration->frequency_hz = (hpet_registers != nullptr) ? Measure_Frequency_Against_HPET(hpet_registers) : 0;
+    if (calibration->frequency_hz == 0) {
+        calibration->frequency_hz = Measure_Frequency_Against_PIT();
+    }
+    if (calibration->frequency_hz == 0) {
+        return false;
+    }
+
+    calibration->ns_per_cycle_fp  = (TSC_NANOSECONDS_PER_SECOND << 32) / calibration->frequency_hz;
+    calibration->cycles_per_ns_fp = ((calibration->frequency_hz / TSC_NANOSECONDS_PER_SECOND) << 32) +
+                                    (((calibration->frequency_hz % TSC_NANOSECONDS_PER_SECOND) << 32) / TSC_NANOSECONDS_PER_SECOND);
+    calibration->base_tsc         = read_tsc();
+
+    return true;
+
+}
+
+/*******************************************************************************
+TSC Cycles To Nanoseconds Function
+*******************************************************************************/
+uint64_t tsc_cycles_to_ns (const tsc_calibration* calibration, uint64_t cycles) {
+    return (uint64_t)(((uint128_t)cycles * calibration->ns_per_cycle_fp) >> 32);
+}
+
+/*******************************************************************************
+TSC Nanoseconds To Cycles Function
+*******************************************************************************/
+uint64_t tsc_ns_to_cycles (const tsc_calibration* calibration, uint64_t ns) {
+    return (uint64_t)(((uint128_t)ns * calibration->cycles_per_ns_fp) >> 32);
+}
+
+/*******************************************************************************
+TSC Monotonic Nanoseconds To TSC Function
+The TSC value at which monotonic time reaches the given nanosecond count.
+*******************************************************************************/
+uint64_t tsc_monotonic_ns_to_tsc (const tsc_calibration* calibration, uint64_t monotonic_ns) {
+    return calibration->base_tsc + tsc_ns_to_cycles(calibration, monotonic_ns);
+}
+
+/*******************************************************************************
+Get Monotonic Time Function
+
+Nanoseconds since calibration, using the executing processor's calibration.
+Consistent across processors only when the TSC is invariant.
+*******************************************************************************/
+uint64_t get_monotonic_time_ns () {
+
+    const tsc_calibration* calibration = &get_per_cpu_data()->tsc;
+
+    return tsc_cycles_to_ns(calibration, read_tsc() - calibration->base_tsc);
+
+}
+
+/*******************************************************************************
+TSC Busy Wait Function
+Spin for at least the given number of nanoseconds, for hardware delays needed
+before timer interrupts are available.
+*******************************************************************************/
+void tsc_busy_wait_ns (const tsc_calibration* calibration, uint64_t ns) {
+
+    uint64_t start_tsc = read_tsc();
+    uint64_t cycles    = tsc_ns_to_cycles(calibration, ns);
+
+    while ((read_tsc() - start_tsc) < cycles) {
+        __asm__ __volatile__ ("pause");
+    }
+
+}
@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+#define TSC_NANOSECONDS_PER_SECOND  1000000000ULL
+#define TSC_CALIBRATION_PERIOD_MS   10
+#define TSC_CALIBRATION_NUM_OF_RUNS 5
+
+/* Conversion from time stamp counter cycles to nanoseconds. Kept per processor
+so the read path never touches shared cache lines. */
+typedef struct {
+    uint64_t frequency_hz;
+    uint64_t base_tsc;         // TSC value at which monotonic time is zero.
+    uint64_t ns_per_cycle_fp;  // Nanoseconds per cycle, 32.32 fixed point.
+    uint64_t cycles_per_ns_fp; // Cycles per nanosecond, 32.32 fixed point.
+    bool     invariant;        // TSC runs at a constant rate in every P/C-state.
+} tsc_calibration;
+
+bool     Calibrate_Time_Stamp_Counter (tsc_calibration* calibration, volatile uint64_t* hpet_registers);
+uint64_t tsc_cycles_to_ns             (const tsc_calibration* calibration, uint64_t cycles);
+uint64_t tsc_ns_to_cycles             (const tsc_calibration* calibration, uint64_t ns);
+uint64_t tsc_monotonic_ns_to_tsc      (const tsc_calibration* calibration, uint64_t monotonic_ns);
+uint64_t get_monotonic_time_ns        ();
+void     tsc_busy_wait_ns             (const tsc_calibration* calibration, uint64_t ns);
@@ -0,0 +1,320 @@
+#include "timer_wheel.h"
+#include "../cpu/per_cpu.h"
+
+#define TIMER_WHEEL_SLOT_MASK     (TIMER_WHEEL_NUM_OF_SLOTS - 1)
+#define TIMER_WHEEL_NO_TICK       UINT64_MAX
+
+// Mask of the tick bits below the given level.
+#define TIMER_WHEEL_LEVEL_MASK(level) ((1ULL << ((level) * TIMER_WHEEL_SLOT_BITS)) - 1)
+
+// Mask of every tick bit the wheel can represent.
+#define TIMER_WHEEL_RANGE_MASK    TIMER_WHEEL_LEVEL_MASK(TIMER_WHEEL_NUM_OF_LEVELS)
+
+/*******************************************************************************
+Insert Timer Function
+
+Link the timer into the slot of the level at which its expiry tick first differs
+from the current tick. Expiries already in the past are due at the current tick
+and expiries beyond the wheel's range are parked in the top level, they are
+placed again with their real expiry when that slot is cascaded.
+*******************************************************************************/
+static void Insert_Timer (timer_wheel* wheel, kernel_timer* timer) {
+
+    uint64_t tick = timer->expires_tick;
+
+    if (tick < wheel->current_tick) {
+        tick = wheel->current_tick;
+    }
+
+    if ((tick ^ wheel->current_tick) > TIMER_WHEEL_RANGE_MASK) {
+        tick = wheel->current_tick | TIMER_WHEEL_RANGE_MASK;
+    }
+
+    uint64_t differing_bits = tick ^ wheel->current_tick;
+    uint64_t level          = (differing_bits == 0) ? 0 : ((63 - __builtin_clzll(differing_bits)) / TIMER_WHEEL_SLOT_BITS);
+    uint64_t slot           = (tick >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK;
+
+    kernel_timer** head = &wheel->slots[level][slot];
+
+    timer->prev = nullptr;
+    timer->next = *head;
+    if (*head != nullptr) {
+        (*head)->prev = timer;
+    }
+    *head = timer;
+
+    timer->level   = (uint8_t)level;
+    timer->slot    = (uint8_t)slot;
+    timer->pending = true;
+
+    wheel->occupied[level] |= (1ULL << slot);
+    wheel->num_of_pending++;
+
+}
+
+/*******************************************************************************
+Remove Timer Function
+*******************************************************************************/
+static void Remove_Timer (timer_wheel* wheel, kernel_timer* timer) {
+
+    kernel_timer** head = &wheel->slots[timer->level][timer->slot];
+
+    if (timer->prev != nullptr) {
+        timer->prev->next = timer->next;
+    } else {
+        *head = timer->next;
+    }
+
+    if (timer->next != nullptr) {
+        timer->next->prev = timer->prev;
+    }
+
+    if (*head == nullptr) {
+        wheel->occupied[timer->level] &= ~(1ULL << timer->slot);
+    }
+
+    timer->pending = false;
+    wheel->num_of_pending--;
+
+}
+
+/*******************************************************************************
+Detach Slot Function
+Unlink a whole slot at once and return its list.
+*******************************************************************************/
+static kernel_timer* Detach_Slot (timer_wheel* wheel, uint64_t level, uint64_t slot) {
+
+    kernel_timer* list = wheel->slots[level][slot];
+
+    wheel->slots[level][slot] = nullptr;
+    wheel->occupied[level]   &= ~(1ULL << slot);
+
+    for (kernel_timer* timer = list; timer != nullptr; timer = timer->next) {
+        timer->pending = false;
+        wheel->num_of_pending--;
+    }
+
+    return list;
+
+}
+
+/*******************************************************************************
+Next Event Tick Function
+The tick at which the earliest occupied slot of any level comes due, either to
+expire (level 0) or to be cascaded into a lower level.
+*******************************************************************************/
+static uint64_t Next_Event_Tick (timer_wheel* wheel) {
+
+    uint64_t next_tick = TIMER_WHEEL_NO_TICK;
+
+    for (uint64_t level = 0; level < TIMER_WHEEL_NUM_OF_LEVELS; level++) {
+
+        if (wheel->occupied[level] == 0) {
+            continue;
+        }
+
+        uint64_t slot = __builtin_ctzll(wheel->occupied[level]);
+        uint64_t tick = (wheel->current_tick & ~TIMER_WHEEL_LEVEL_MASK(level + 1)) |
+                        (slot << (level * TIMER_WHEEL_SLOT_BITS));
+
+        if (tick < next_tick) {
+            next_tick = tick;
+        }
+
+    }
+
+    return next_tick;
+
+}
+
+/*******************************************************************************
+Reprogram Hardware Timer Function
+Program the local APIC for the earliest non-empty slot, or stop it if nothing
+is pending. Unless forced, the hardware is only touched when that deadline
+changes.
+*******************************************************************************/
+static void Reprogram_Hardware_Timer (timer_wheel* wheel, bool force) {
+
+    uint64_t next_tick   = Next_Event_Tick(wheel);
+    uint64_t deadline_ns = (next_tick == TIMER_WHEEL_NO_TICK) ? TIMER_WHEEL_NO_DEADLINE : (next_tick << TIMER_WHEEL_TICK_SHIFT);
+
+    if ((!force) && (deadline_ns == wheel->programmed_deadline_ns)) {
+        return;
+    }
+
+    wheel->programmed_deadline_ns = deadline_ns;
+
+    if (deadline_ns == TIMER_WHEEL_NO_DEADLINE) {
+        local_apic_timer_stop(wheel->apic);
+    } else {
+        local_apic_timer_set_deadline(wheel->apic, wheel->tsc, deadline_ns);
+    }
+
+}
+
+/*******************************************************************************
+Initialize Timer Wheel Function
+*******************************************************************************/
+void Initialize_Timer_Wheel (timer_wheel* wheel, local_apic* apic, const tsc_calibration* tsc) {
+
+    for (uint64_t level = 0; level < TIMER_WHEEL_NUM_OF_LEVELS; level++) {
+        for (uint64_t slot = 0; slot < TIMER_WHEEL_NUM_OF_SLOTS; slot++) {
+            wheel->slots[level][slot] = nullptr;
+        }
+        wheel->occupied[level] = 0;
+    }
+
+    wheel->apic                   = apic;
+    wheel->tsc                    = tsc;
+    wheel->current_tick           = get_monotonic_time_ns() >> TIMER_WHEEL_TICK_SHIFT;
+    wheel->num_of_pending         = 0;
+    wheel->programmed_deadline_ns = TIMER_WHEEL_NO_DEADLINE;
+    wheel->interrupted_frame      = nullptr;
+
+}
+
+/*******************************************************************************
+Kernel Timer Initialize Function
+*******************************************************************************/
+void kernel_timer_initialize (kernel_timer* timer, kernel_timer_callback callback, void* context) {
+
+    timer->next         = nullptr;
+    timer->prev         = nullptr;
+    timer->expires_tick = 0;
+    timer->callback     = callback;
+    timer->context      = context;
+    timer->pending      = false;
+    timer->level        = 0;
+    timer->slot         = 0;
+
+}
+
+/*******************************************************************************
+Timer Wheel Arm Function
+Arm (or re-arm) the timer to fire at the given monotonic time. The expiry is
+rounded up to the next tick so a timer never fires early. O(1).
+*******************************************************************************/
+void timer_wheel_arm (timer_wheel* wheel, kernel_timer* timer, uint64_t expires_ns) {
+
+    if (timer->pending) {
+        Remove_Timer(wheel, timer);
+    }
+
+    const uint64_t TICK_ROUNDING = (1ULL << TIMER_WHEEL_TICK_SHIFT) - 1;
+    timer->expires_tick = (expires_ns >= (UINT64_MAX - TICK_ROUNDING)) ? (UINT64_MAX >> TIMER_WHEEL_TICK_SHIFT)
+                                                                      : ((expires_ns + TICK_ROUNDING) >> TIMER_WHEEL_TICK_SHIFT);
+
+    Insert_Timer(wheel, timer);
+    Reprogram_Hardware_Timer(wheel, false);
+
+}
+
+/*******************************************************************************
+Timer Wheel Cancel Function
+Returns whether the timer was pending. O(1).
+*******************************************************************************/
+bool timer_wheel_cancel (timer_wheel* wheel, kernel_timer* timer) {
+
+    if (!timer->pending) {
+        return false;
+    }
+
+    Remove_Timer(wheel, timer);
+    Reprogram_Hardware_Timer(wheel, false);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Timer Wheel Process Function
+
+Advance the wheel to the given time, jumping straight from one occupied slot to
+the next. Slots of higher levels coming due are cascaded into lower levels and
+due level 0 slots are expired a timer at a time. Callbacks may cancel or re-arm
+any timer, a re-arm in the past fires again in the same pass.
+*******************************************************************************/
+void timer_wheel_process (timer_wheel* wheel, uint64_t now_ns) {
+
+    uint64_t now_tick = now_ns >> TIMER_WHEEL_TICK_SHIFT;
+
+    while (true) {
+
+        uint64_t next_tick = Next_Event_Tick(wheel);
+        if ((next_tick == TIMER_WHEEL_NO_TICK) || (next_tick > now_tick)) {
+            break;
+        }
+
+        wheel->current_tick = next_tick;
+
+        // Cascade from the top so a cascaded slot can cascade again below.
+        for (uint64_t level = TIMER_WHEEL_NUM_OF_LEVELS - 1; level > 0; level--) {
+
+            if ((next_tick & TIMER_WHEEL_LEVEL_MASK(level)) != 0) {
+                continue;
+            }
+
+            uint64_t slot = (next_tick >> (level * TIMER_WHEEL_SLOT_BITS)) & TIMER_WHEEL_SLOT_MASK;
+            if (!(wheel->occupied[level] & (1ULL << slot))) {
+                continue;
+            }
+
+            kernel_timer* timer = Detach_Slot(wheel, level, slot);
+            while (timer != nullptr) {
+                kernel_timer* next = timer->next;
+                Insert_Timer(wheel, timer);
+                timer = next;
+            }
+
+        }
+
+        /* Each timer leaves the slot before its callback runs, the rest stay
+        linked in the wheel where callbacks can cancel or re-arm them. */
+        uint64_t slot = next_tick & TIMER_WHEEL_SLOT_MASK;
+        while (wheel->slots[0][slot] != nullptr) {
+
+            kernel_timer* timer = wheel->slots[0][slot];
+            Remove_Timer(wheel, timer);
+
+            if (timer->callback != nullptr) {
+                timer->callback(timer, timer->context);
+            }
+
+        }
+    }
+
+    if (now_tick > wheel->current_tick) {
+        wheel->current_tick = now_tick;
+    }
+
+    // The interrupt that got us here disarmed the hardware, program it afresh.
+    Reprogram_Hardware_Timer(wheel, true);
+
+}
+
+/*******************************************************************************
+Timer Wheel Next Deadline Function
+Monotonic time of the next event, TIMER_WHEEL_NO_DEADLINE if none is pending.
+*******************************************************************************/
+uint64_t timer_wheel_next_deadline_ns (timer_wheel* wheel) {
+
+    uint64_t next_tick = Next_Event_Tick(wheel);
+
+    return (next_tick == TIMER_WHEEL_NO_TICK) ? TIMER_WHEEL_NO_DEADLINE : (next_tick << TIMER_WHEEL_TICK_SHIFT);
+
+}
+
+/*******************************************************************************
+Timer Wheel Interrupt Callback Function
+Hooked into the local APIC timer interrupt of every processor. Callbacks can
+see the interrupted state through the wheel, e.g. to sample where it was.
+*******************************************************************************/
+void Timer_Wheel_Interrupt_Callback (interrupt_frame* frame) {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    cpu->timers.interrupted_frame = frame;
+    timer_wheel_process(&cpu->timers, get_monotonic_time_ns());
+    cpu->timers.interrupted_frame = nullptr;
+
+}
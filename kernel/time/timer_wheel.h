@@ -0,0 +1,50 @@
+#pragma once
+#include <stdint.h>
+#include "time_stamp_counter.h"
+#include "../interrupts/local_apic.h"
+
+#define TIMER_WHEEL_TICK_SHIFT      10 // One tick is 2^10ns, about 1us.
+#define TIMER_WHEEL_SLOT_BITS       6
+#define TIMER_WHEEL_NUM_OF_SLOTS    (1ULL << TIMER_WHEEL_SLOT_BITS)
+#define TIMER_WHEEL_NUM_OF_LEVELS   6  // Covers 2^46ns (about 19.5 hours) before clamping.
+#define TIMER_WHEEL_NO_DEADLINE     UINT64_MAX
+
+typedef struct kernel_timer kernel_timer;
+typedef void (*kernel_timer_callback) (kernel_timer* timer, void* context);
+
+/* A pending timeout, linked into one slot of a timer wheel. Owned by the caller
+and must stay alive while armed. */
+struct kernel_timer {
+    kernel_timer*         next;
+    kernel_timer*         prev;
+    uint64_t              expires_tick;
+    kernel_timer_callback callback; // nullptr if the timer only has to wake the processor.
+    void*                 context;
+    bool                  pending;
+    uint8_t               level;
+    uint8_t               slot;
+};
+
+/* Hierarchical timing wheel of one processor. Level l holds timers that differ
+from the current tick first in slot bits l, so every slot in use is ahead of
+the current position and the earliest event is the lowest occupied slot. Only
+touched by its own processor with interrupts disabled. */
+typedef struct {
+    kernel_timer*          slots[TIMER_WHEEL_NUM_OF_LEVELS][TIMER_WHEEL_NUM_OF_SLOTS];
+    uint64_t               occupied[TIMER_WHEEL_NUM_OF_LEVELS]; // Bit per non-empty slot.
+    uint64_t               current_tick;                        // Last processed tick.
+    uint64_t               num_of_pending;
+    uint64_t               programmed_deadline_ns;
+    local_apic*            apic;
+    const tsc_calibration* tsc;
+    interrupt_frame*       interrupted_frame;                   // Of the timer interrupt running callbacks, else nullptr.
+} timer_wheel;
+
+void     Initialize_Timer_Wheel       (timer_wheel* wheel, local_apic* apic, const tsc_calibration* tsc);
+void     kernel_timer_initialize      (kernel_timer* timer, kernel_timer_callback callback, void* context);
+void     timer_wheel_arm              (timer_wheel* wheel, kernel_timer* timer, uint64_t expires_ns);
+bool     timer_wheel_cancel           (timer_wheel* wheel, kernel_timer* timer);
+void     timer_wheel_process          (timer_wheel* wheel, uint64_t now_ns);
+uint64_t timer_wheel_next_deadline_ns (timer_wheel* wheel);
+
+void Timer_Wheel_Interrupt_Callback (interrupt_frame* frame);
@@ -0,0 +1,162 @@
+#include "kernel_trace.h"
+#include "../cpu/per_cpu.h"
+#include "../log/kernel_log.h"
+
+// Buffer of each processor by index, the bootstrap processor's is the bootloader's.
+static trace_buffer* kernel_trace_buffers[PER_CPU_MAX_NUM_OF_CPUS];
+static uint64_t      kernel_trace_num_of_buffers;
+
+/*******************************************************************************
+Update Num Of Buffers Function
+Processors come up in any order, the count only grows.
+*******************************************************************************/
+static void Update_Num_Of_Buffers (uint64_t cpu_index) {
+
+    uint64_t num_of_buffers = __atomic_load_n(&kernel_trace_num_of_buffers, __ATOMIC_RELAXED);
+    while ((num_of_buffers <= cpu_index) &&
+           !__atomic_compare_exchange_n(&kernel_trace_num_of_buffers, &num_of_buffers, cpu_index + 1, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+    }
+
+}
+
+/*******************************************************************************
+Buffer of Executing Processor Function
+Buffer selector installed once per processor data exists.
+*******************************************************************************/
+static trace_buffer* Buffer_Of_Executing_Processor () {
+
+    uint64_t cpu_index = get_per_cpu_data()->cpu_index;
+
+    return (cpu_index < PER_CPU_MAX_NUM_OF_CPUS) ? __atomic_load_n(&kernel_trace_buffers[cpu_index], __ATOMIC_ACQUIRE) : nullptr;
+
+}
+
+/*******************************************************************************
+Setup Kernel Trace Function
+Start selecting buffers by processor. The bootstrap processor keeps recording
+into the bootloader's buffer, so boot and kernel events share one timeline,
+every other processor allocates its own with Initialize_Kernel_Trace_Buffer.
+Until this runs, tracepoints use the boot buffer set as the default on entry.
+*******************************************************************************/
+bool Setup_Kernel_Trace (trace_buffer* boot_buffer) {
+
+    uint64_t cpu_index = get_per_cpu_data()->cpu_index;
+
+    if ((boot_buffer == nullptr) || (cpu_index >= PER_CPU_MAX_NUM_OF_CPUS)) {
+        return false;
+    }
+
+    __atomic_store_n(&kernel_trace_buffers[cpu_index], boot_buffer, __ATOMIC_RELEASE);
+    Update_Num_Of_Buffers(cpu_index);
+
+    trace_set_buffer_selector(Buffer_Of_Executing_Processor);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Initialize Kernel Trace Buffer Function
+Allocate the executing processor's buffer on its NUMA node, which is only known
+for certain on the processor itself: processor indices follow the order the
+processors came up in, not the MADT's. Records of a processor without a buffer
+are dropped. Returns false if the buffer could not be allocated.
+*******************************************************************************/
+bool Initialize_Kernel_Trace_Buffer (Physical_Memory_Manager* pmm) {
+
+    per_cpu_data* cpu = get_per_cpu_data();
+
+    if (cpu->cpu_index >= PER_CPU_MAX_NUM_OF_CPUS) {
+        return false;
+    }
+
+    uint8_t* memory = (uint8_t*)pmm->allocate_physical_frames_on_node(sizeof(trace_buffer) + (KERNEL_TRACE_NUM_OF_RECORDS * sizeof(trace_record)), cpu->numa_node, true);
+    if (memory == nullptr) {
+        return false;
+    }
+
+    trace_buffer* buffer = (trace_buffer*)memory;
+    trace_buffer_initialize(buffer, (trace_record*)(memory + sizeof(trace_buffer)), KERNEL_TRACE_NUM_OF_RECORDS, (uint32_t)cpu->cpu_index);
+
+    __atomic_store_n(&kernel_trace_buffers[cpu->cpu_index], buffer, __ATOMIC_RELEASE);
+    Update_Num_Of_Buffers(cpu->cpu_index);
+
+    return true;
+
+}
+
+/*******************************************************************************
+Write Line Function
+Queue a dump line, waiting for room in the transmit ring instead of dropping it.
+*******************************************************************************/
+static void Write_Line (serial_port* port, const char* format, const uint64_t* arguments, uint64_t num_of_arguments) {
+
+    char     line[KERNEL_LOG_MAX_LINE_LENGTH + 2];
+    uint64_t length = kernel_log_format(line, KERNEL_LOG_MAX_LINE_LENGTH, format, arguments, num_of_arguments);
+    line[length++]  = '\r';
+    line[length++]  = '\n';
+
+    while (serial_port_write(port, line, length) == 0) {
+        serial_port_flush(port);
+    }
+
+}
+
+/*******************************************************************************
+Kernel Trace Dump Function
+
+Write every buffer to the serial port as text, for Trace_To_Chrome.py:
+
+    TRACE BEGIN <tsc frequency hz>
+    <cpu> <tsc> <B|E|I|C> <value> <name>
+    TRACE END <records> <dropped>
+
+Records are written buffer by buffer, not merged. Processors still tracing may
+add records while dumping; a record reserved but not yet filled can come out
+torn, so dump while the traced work is quiescent. Returns the records written.
+*******************************************************************************/
+uint64_t kernel_trace_dump (serial_port* port, uint64_t tsc_frequency_hz) {
+
+    const char TYPE_LETTERS[] = { 'B', 'E', 'I', 'C' };
+
+    uint64_t header[] = { tsc_frequency_hz };
+    Write_Line(port, "TRACE BEGIN %u", header, 1);
+
+    uint64_t num_of_records = 0;
+    uint64_t num_of_dropped = 0;
+
+    uint64_t num_of_buffers = __atomic_load_n(&kernel_trace_num_of_buffers, __ATOMIC_ACQUIRE);
+    for (uint64_t buffer_idx = 0; buffer_idx < num_of_buffers; buffer_idx++) {
+
+        trace_buffer* buffer = __atomic_load_n(&kernel_trace_buffers[buffer_idx], __ATOMIC_ACQUIRE);
+        if (buffer == nullptr) {
+            continue;
+        }
+
+        uint64_t num_of_buffer_records = trace_buffer_num_of_records(buffer);
+        for (uint64_t idx = 0; idx < num_of_buffer_records; idx++) {
+
+            const trace_record* record = &buffer->records[idx];
+            uint64_t arguments[] = {
+                record->cpu_index,
+                record->tsc,
+                (uint64_t)TYPE_LETTERS[record->type & 3],
+                record->value,
+                (uint64_t)record->name
+            };
+            Write_Line(port, "%u %u %c %u %s", arguments, 5);
+
+        }
+
+        num_of_records += num_of_buffer_records;
+        num_of_dropped += trace_buffer_num_of_dropped(buffer);
+
+    }
+
+    uint64_t footer[] = { num_of_records, num_of_dropped };
+    Write_Line(port, "TRACE END %u %u", footer, 2);
+    serial_port_flush(port);
+
+    return num_of_records;
+
+}
@@ -0,0 +1,11 @@
+#pragma once
+#include <stdint.h>
+#include "../../shared/trace/trace.h"
+#include "../memory/physical_memory_manager.h"
+#include "../drivers/serial_port.h"
+
+#define KERNEL_TRACE_NUM_OF_RECORDS 8192 // Per application processor.
+
+bool     Setup_Kernel_Trace             (trace_buffer* boot_buffer);
+bool     Initialize_Kernel_Trace_Buffer (Physical_Memory_Manager* pmm);
+uint64_t kernel_trace_dump              (serial_port* port, uint64_t tsc_frequency_hz);
@@ -0,0 +1,51 @@
+#include "port_io.h"
+
+// Port 0x80 is the POST code port, writes to it have no side effects.
+#define PORT_IO_WAIT_PORT 0x80
+
+/* Write a byte to an I/O port. */
+void outb (uint16_t port, uint8_t value) {
+    __asm__ __volatile__ ("outb %0, %1" : : "a"(value), "Nd"(port) : "memory");
+}
+
+/* Write a word to an I/O port. */
+void outw (uint16_t port, uint16_t value) {
+    __asm__ __volatile__ ("outw %0, %1" : : "a"(value), "Nd"(port) : "memory");
+}
+
+/* Write a double word to an I/O port. */
+void outl (uint16_t port, uint32_t value) {
+    __asm__ __volatile__ ("outl %0, %1" : : "a"(value), "Nd"(port) : "memory");
+}
+
+/* Read a byte from an I/O port. */
+uint8_t inb (uint16_t port) {
+
+    uint8_t value;
+    __asm__ __volatile__ ("inb %1, %0" : "=a"(value) : "Nd"(port) : "memory");
+    return value;
+
+}
+
+/* Read a word from an I/O port. */
+uint16_t inw (uint16_t port) {
+
+    uint16_t value;
+    __asm__ __volatile__ ("inw %1, %0" : "=a"(value) : "Nd"(port) : "memory");
+    return value;
+
+}
+
+/* Read a double word from an I/O port. */
+uint32_t inl (uint16_t port) {
+
+    uint32_t value;
+    __asm__ __volatile__ ("inl %1, %0" : "=a"(value) : "Nd"(port) : "memory");
+    return value;
+
+}
+
+/* Give slow legacy devices time to settle by writing to an unused port. */
+void io_wait () {
+    outb(PORT_IO_WAIT_PORT, 0);
+}
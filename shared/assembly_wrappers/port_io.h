@@ -0,0 +1,15 @@
+#pragma once
+#include <stdint.h>
+
+// Write a byte, word or double word to an I/O port.
+void outb (uint16_t port, uint8_t  value);
+void outw (uint16_t port, uint16_t value);
+void outl (uint16_t port, uint32_t value);
+
+// Read a byte, word or double word from an I/O port.
+uint8_t  inb (uint16_t port);
+uint16_t inw (uint16_t port);
+uint32_t inl (uint16_t port);
+
+// Give slow legacy devices time to settle by writing to an unused port.
+void io_wait ();
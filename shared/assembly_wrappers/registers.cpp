@@ -44,3 +44,181 @@ DEFINE_CONTROL_REGISTER_RW(4)
 // DEFINE_CONTROL_REGISTER_RW(6); Reserved.
 // DEFINE_CONTROL_REGISTER_RW(7); Reserved.
 DEFINE_CONTROL_REGISTER_RW(8)
+
+/* Read an extended control register, returned split across edx:eax. Needs
+CR4.OSXSAVE. */
+uint64_t xgetbv (uint32_t index) {
+
+    uint32_t low, high;
+
+    __asm__ __volatile__ (
+        "xgetbv"
+        : "=a"(low), "=d"(high)
+        : "c"(index)
+        : /* No clobbered. */
+    );
+
+    return ((((uint64_t)high) << 32) | low);
+
+}
+
+/* Write an extended control register, passed split across edx:eax. */
+void xsetbv (uint32_t index, uint64_t value) {
+
+    __asm__ __volatile__ (
+        "xsetbv"
+        : /* No output. */
+        : "c"(index), "a"((uint32_t)value), "d"((uint32_t)(value >> 32))
+        : "memory"
+    );
+
+}
+
+/* Invalidate the TLB entry of the page containing the given virtual address. */
+void invlpg (uint64_t virtual_address) {
+
+    __asm__ __volatile__ (
+        "invlpg (%0)"
+        : /* No output. */
+        : "r"(virtual_address)
+        : "memory"
+    );
+
+}
+
+/* Read the 64-bit time stamp counter, returned split across edx:eax. */
+uint64_t read_tsc () {
+
+    uint32_t low, high;
+
+    __asm__ __volatile__ (
+        "rdtsc"
+        : "=a"(low), "=d"(high)
+        : /* No input. */
+        : /* No clobbered. */
+    );
+
+    return ((((uint64_t)high) << 32) | low);
+
+}
+
+/* Read the time stamp counter once every earlier instruction has completed
+locally, and before any later instruction starts, for the start of a timed
+region. */
+uint64_t read_tsc_fenced () {
+
+    uint32_t low, high;
+
+    __asm__ __volatile__ (
+        "lfence\n\t"
+        "rdtsc\n\t"
+        "lfence"
+        : "=a"(low), "=d"(high)
+        : /* No input. */
+        : "memory"
+    );
+
+    return ((((uint64_t)high) << 32) | low);
+
+}
+
+/* Read the time stamp counter with rdtscp, which waits for every earlier
+instruction, then fence later ones, for the end of a timed region. Needs
+CPUID.80000001h:EDX.RDTSCP; IA32_TSC_AUX (ecx) is discarded. */
+uint64_t read_tscp_fenced () {
+
+    uint32_t low, high;
+
+    __asm__ __volatile__ (
+        "rdtscp\n\t"
+        "lfence"
+        : "=a"(low), "=d"(high)
+        : /* No input. */
+        : "rcx", "memory"
+    );
+
+    return ((((uint64_t)high) << 32) | low);
+
+}
+
+/* Execute CPUID for the given leaf and subleaf (ecx). */
+void cpuid (uint32_t leaf, uint32_t subleaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx) {
+
+    __asm__ __volatile__ (
+        "cpuid"
+        : "=a"(*eax), "=b"(*ebx), "=c"(*ecx), "=d"(*edx)
+        : "a"(leaf), "c"(subleaf)
+        : /* No clobbered. */
+    );
+
+}
+
+/* Read a model specific register, returned split across edx:eax. */
+uint64_t read_msr (uint32_t msr) {
+
+    uint32_t low, high;
+
+    __asm__ __volatile__ (
+        "rdmsr"
+        : "=a"(low), "=d"(high)
+        : "c"(msr)
+        : /* No clobbered. */
+    );
+
+    return ((((uint64_t)high) << 32) | low);
+
+}
+
+/* Write a model specific register, passed split across edx:eax. */
+void write_msr (uint32_t msr, uint64_t value) {
+
+    __asm__ __volatile__ (
+        "wrmsr"
+        : /* No output. */
+        : "c"(msr), "a"((uint32_t)value), "d"((uint32_t)(value >> 32))
+        : "memory"
+    );
+
+}
+
+/* Clear the interrupt flag of the executing processor. */
+void disable_interrupts () {
+    __asm__ __volatile__ ("cli" : : : "memory");
+}
+
+/* Set the interrupt flag of the executing processor. */
+void enable_interrupts () {
+    __asm__ __volatile__ ("sti" : : : "memory");
+}
+
+/* Set the interrupt flag and halt. Interrupts are only recognized after the
+instruction following sti, so none can slip in before the hlt. */
+void enable_interrupts_and_halt () {
+    __asm__ __volatile__ ("sti\n\thlt" : : : "memory");
+}
+
+/* Clear the interrupt flag and return RFLAGS from before, for
+restore_interrupts. */
+uint64_t save_and_disable_interrupts () {
+
+    uint64_t rflags;
+
+    __asm__ __volatile__ (
+        "pushfq\n\t"
+        "popq %0\n\t"
+        "cli"
+        : "=r"(rflags)
+        : /* No input. */
+        : "memory"
+    );
+
+    return rflags;
+
+}
+
+/* Set the interrupt flag again if it was set when the flags were saved. */
+void restore_interrupts (uint64_t rflags) {
+    if (rflags & (1ULL << 9)) {
+        __asm__ __volatile__ ("sti" : : : "memory");
+    }
+}
@@ -14,3 +14,40 @@ DEFINE_CONTROL_REGISTER_RW_PROTO(4);
 // DEFINE_CONTROL_REGISTER_RW_PROTO(6); Reserved.
 // DEFINE_CONTROL_REGISTER_RW_PROTO(7); Reserved.
 DEFINE_CONTROL_REGISTER_RW_PROTO(8);
+
+// Read and write an extended control register, XCR0 selects the XSAVE features.
+uint64_t xgetbv (uint32_t index);
+void     xsetbv (uint32_t index, uint64_t value);
+
+// Invalidate the TLB entry of the page containing the given virtual address.
+void invlpg (uint64_t virtual_address);
+
+// Read the 64-bit time stamp counter.
+uint64_t read_tsc ();
+
+// Read the time stamp counter ordered against the surrounding instructions, for
+// the start and end of a timed region. The rdtscp form needs CPUID support.
+uint64_t read_tsc_fenced  ();
+uint64_t read_tscp_fenced ();
+
+// Execute CPUID for the given leaf and subleaf.
+void cpuid (uint32_t leaf, uint32_t subleaf, uint32_t* eax, uint32_t* ebx, uint32_t* ecx, uint32_t* edx);
+
+// Read and write a model specific register.
+uint64_t read_msr  (uint32_t msr);
+void     write_msr (uint32_t msr, uint64_t value);
+
+// Clear and set the interrupt flag of the executing processor.
+void disable_interrupts ();
+void enable_interrupts ();
+
+// Enable interrupts and halt until the next one arrives, without a window for
+// an interrupt to be taken between the two.
+void enable_interrupts_and_halt ();
+
+#define RFLAGS_INTERRUPT_FLAG (1ULL << 9)
+
+// Disable interrupts, returning the previous RFLAGS, and restore the interrupt
+// flag from them.
+uint64_t save_and_disable_interrupts ();
+void     restore_interrupts          (uint64_t rflags);
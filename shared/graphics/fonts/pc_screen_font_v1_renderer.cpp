@@ -1,5 +1,6 @@
 #include "pc_screen_font_v1_renderer.h"
 #include "../../uefi/uefi_file_io.h"
+#include "../../trace/trace.h"
 
 PC_Screen_Font_v1_Renderer::PC_Screen_Font_v1_Renderer ( 
     UEFI_HANDLE                        ImageHandle,
@@ -63,6 +64,8 @@ void PC_Screen_Font_v1_Renderer::print_character (uint32_t color, char c, uint64
 
 void PC_Screen_Font_v1_Renderer::print_string (uint32_t color, char* s, uint64_t x, uint64_t y) {
 
+    TRACE_BEGIN(TRACE_CATEGORY_GRAPHICS, "print_string");
+
     uint64_t xPixel = x;
     char* str = s;
     
@@ -71,4 +74,6 @@ void PC_Screen_Font_v1_Renderer::print_string (uint32_t color, char* s, uint64_t
         xPixel += M_FONT_GLYPH_WIDTH;
         str++;
     }
+
+    TRACE_END(TRACE_CATEGORY_GRAPHICS, "print_string");
 }
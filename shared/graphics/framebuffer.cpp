@@ -0,0 +1,310 @@
+#include "framebuffer.h"
+
+/* The kernel is built without vector registers, so the compiler never keeps
+values in them and they need not be declared clobbered; where it may use them
+they must be. */
+#ifdef __SSE2__
+#define FRAMEBUFFER_VECTOR_CLOBBERS , "xmm0"
+#else
+#define FRAMEBUFFER_VECTOR_CLOBBERS
+#endif
+
+/*******************************************************************************
+Is Vector Variant Function
+*******************************************************************************/
+static bool Is_Vector_Variant (memory_variant variant) {
+    return (variant == memory_variant_sse2) || (variant == memory_variant_avx2) || (variant == memory_variant_non_temporal_sse2);
+}
+
+/*******************************************************************************
+Variant For Function
+The surface's variant, switched to non-temporal stores when an operation
+writes more than the threshold, which would only evict everything else from
+the caches. The framebuffer is hardly ever read back.
+*******************************************************************************/
+static memory_variant Variant_For (const framebuffer_surface* surface, uint64_t num_of_bytes) {
+
+    uint64_t threshold = get_memory_operations_features()->non_temporal_threshold;
+
+    if (Is_Vector_Variant(surface->variant) && (threshold != 0) && (num_of_bytes >= threshold)) {
+        return memory_variant_non_temporal_sse2;
+    }
+
+    return surface->variant;
+
+}
+
+/*******************************************************************************
+Rep Stosd Function
+*******************************************************************************/
+static void Rep_Stosd (uint32_t* destination, uint32_t color, uint64_t num_of_pixels) {
+
+    __asm__ __volatile__ (
+        "rep stosl"
+        : "+D"(destination), "+c"(num_of_pixels)
+        : "a"(color)
+        : "memory"
+    );
+
+}
+
+/*******************************************************************************
+Fill Vector Blocks Function
+Fill whole MEMORY_VECTOR_BLOCK_SIZE blocks at a 64 byte aligned destination
+with the color broadcast to every lane.
+*******************************************************************************/
+static void Fill_Vector_Blocks (memory_variant variant, uint32_t* destination, uint32_t color, uint64_t num_of_blocks) {
+
+    if (num_of_blocks == 0) {
+        return;
+    }
+
+    switch (variant) {
+
+        case memory_variant_avx2:
+            __asm__ __volatile__ (
+                "vmovd %2, %%xmm0\n\t"
+                "vpbroadcastd %%xmm0, %%ymm0\n\t"
+                "1:\n\t"
+                "vmovdqa %%ymm0,   (%0)\n\t"
+                "vmovdqa %%ymm0, 32(%0)\n\t"
+                "addq $64, %0\n\t"
+                "decq %1\n\t"
+                "jnz 1b\n\t"
+                "vzeroupper"
+                : "+r"(destination), "+r"(num_of_blocks)
+                : "r"(color)
+                : "memory", "cc" FRAMEBUFFER_VECTOR_CLOBBERS
+            );
+            break;
+
+        case memory_variant_non_temporal_sse2:
+            __asm__ __volatile__ (
+                "movd %2, %%xmm0\n\t"
+                "pshufd $0, %%xmm0, %%xmm0\n\t"
+                "1:\n\t"
+                "movntdq %%xmm0,   (%0)\n\t"
+                "movntdq %%xmm0, 16(%0)\n\t"
+                "movntdq %%xmm0, 32(%0)\n\t"
+                "movntdq %%xmm0, 48(%0)\n\t"
+                "addq $64, %0\n\t"
+                "decq %1\n\t"
+                "jnz 1b\n\t"
+                "sfence"
+                : "+r"(destination), "+r"(num_of_blocks)
+                : "r"(color)
+                : "memory", "cc" FRAMEBUFFER_VECTOR_CLOBBERS
+            );
+            break;
+
+        default:
+            __asm__ __volatile__ (
+                "movd %2, %%xmm0\n\t"
+                "pshufd $0, %%xmm0, %%xmm0\n\t"
+                "1:\n\t"
+                "movdqa %%xmm0,   (%0)\n\t"
+                "movdqa %%xmm0, 16(%0)\n\t"
+                "movdqa %%xmm0, 32(%0)\n\t"
+                "movdqa %%xmm0, 48(%0)\n\t"
+                "addq $64, %0\n\t"
+                "decq %1\n\t"
+                "jnz 1b"
+                : "+r"(destination), "+r"(num_of_blocks)
+                : "r"(color)
+                : "memory", "cc" FRAMEBUFFER_VECTOR_CLOBBERS
+            );
+            break;
+
+    }
+}
+
+/*******************************************************************************
+Fill Span Function
+Fill consecutive pixels. Vector variants store rep stosd up to a 64 byte
+boundary, whole blocks, then the rest with rep stosd again; every other variant
+is rep stosd throughout, which fast strings also run at full speed.
+*******************************************************************************/
+static void Fill_Span (memory_variant variant, uint32_t* destination, uint32_t color, uint64_t num_of_pixels) {
+
+    if (Is_Vector_Variant(variant)) {
+
+        uint64_t head = ((MEMORY_VECTOR_BLOCK_SIZE - (((uint64_t)destination) & (MEMORY_VECTOR_BLOCK_SIZE - 1))) & (MEMORY_VECTOR_BLOCK_SIZE - 1)) / FRAMEBUFFER_BYTES_PER_PIXEL;
+        if (head > num_of_pixels) {
+            head = num_of_pixels;
+        }
+        Rep_Stosd(destination, color, head);
+        destination   += head;
+        num_of_pixels -= head;
+
+        uint64_t num_of_blocks = num_of_pixels / FRAMEBUFFER_PIXELS_PER_BLOCK;
+        Fill_Vector_Blocks(variant, destination, color, num_of_blocks);
+        destination   += num_of_blocks * FRAMEBUFFER_PIXELS_PER_BLOCK;
+        num_of_pixels -= num_of_blocks * FRAMEBUFFER_PIXELS_PER_BLOCK;
+
+    }
+
+    Rep_Stosd(destination, color, num_of_pixels);
+
+}
+
+/*******************************************************************************
+Initialize Framebuffer Surface Function
+Describe a framebuffer and pick the memory operations' vector variant for it,
+rep stosd and rep movs until Initialize_Memory_Operations ran. Set variant to
+a general purpose one to draw from an interrupt handler.
+*******************************************************************************/
+void Initialize_Framebuffer_Surface (framebuffer_surface* surface, uint32_t* base, uint32_t width, uint32_t height, uint32_t pixels_per_scan_line) {
+
+    surface->base                 = base;
+    surface->width                = (width < pixels_per_scan_line) ? width : pixels_per_scan_line;
+    surface->height               = height;
+    surface->pixels_per_scan_line = pixels_per_scan_line;
+    surface->variant              = get_memory_operations_features()->vector_variant;
+
+}
+
+/*******************************************************************************
+Framebuffer Clear Function
+Every scan line, padding included, as one span.
+*******************************************************************************/
+void framebuffer_clear (framebuffer_surface* surface, uint32_t color) {
+
+    uint64_t num_of_pixels = (uint64_t)surface->pixels_per_scan_line * surface->height;
+
+    Fill_Span(Variant_For(surface, num_of_pixels * FRAMEBUFFER_BYTES_PER_PIXEL), surface->base, color, num_of_pixels);
+
+}
+
+/*******************************************************************************
+Framebuffer Fill Rect Function
+Fill a rectangle, clipped to the surface. Rectangles as wide as the surface
+also fill the padding between their scan lines, so they are one span.
+*******************************************************************************/
+void framebuffer_fill_rect (framebuffer_surface* surface, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t color) {
+
+    if ((x >= surface->width) || (y >= surface->height)) {
+        return;
+    }
+    if (width > surface->width - x) {
+        width = surface->width - x;
+    }
+    if (height > surface->height - y) {
+        height = surface->height - y;
+    }
+    if ((width == 0) || (height == 0)) {
+        return;
+    }
+
+    uint64_t       pitch   = surface->pixels_per_scan_line;
+    uint32_t*      row     = surface->base + (y * pitch) + x;
+    memory_variant variant = Variant_For(surface, (uint64_t)width * height * FRAMEBUFFER_BYTES_PER_PIXEL);
+
+    if (width == surface->width) {
+        Fill_Span(variant, row, color, ((height - 1) * pitch) + width);
+        return;
+    }
+
+    for (uint32_t line = 0; line < height; line++) {
+        Fill_Span(variant, row, color, width);
+        row += pitch;
+    }
+
+}
+
+/*******************************************************************************
+Framebuffer Copy Rect Function
+
+Copy a rectangle within the surface, clipped so both the source and the
+destination fit. They may overlap: scan lines are copied away from the
+direction of the move, and a move along a scan line goes through memmove.
+Moving rectangles as wide as the surface up is a single forward copy, which
+is safe since each 64 byte block is loaded before the stores that could reach
+it, the source being at least a scan line ahead.
+*******************************************************************************/
+void framebuffer_copy_rect (framebuffer_surface* surface, uint32_t source_x, uint32_t source_y, uint32_t destination_x, uint32_t destination_y, uint32_t width, uint32_t height) {
+
+    uint32_t right  = (source_x > destination_x) ? source_x : destination_x;
+    uint32_t bottom = (source_y > destination_y) ? source_y : destination_y;
+
+    if ((right >= surface->width) || (bottom >= surface->height)) {
+        return;
+    }
+    if (width > surface->width - right) {
+        width = surface->width - right;
+    }
+    if (height > surface->height - bottom) {
+        height = surface->height - bottom;
+    }
+    if ((width == 0) || (height == 0) || ((source_x == destination_x) && (source_y == destination_y))) {
+        return;
+    }
+
+    uint64_t       pitch       = surface->pixels_per_scan_line;
+    uint64_t       row_bytes   = (uint64_t)width * FRAMEBUFFER_BYTES_PER_PIXEL;
+    uint32_t*      source      = surface->base + (source_y * pitch) + source_x;
+    uint32_t*      destination = surface->base + (destination_y * pitch) + destination_x;
+    memory_variant variant     = Variant_For(surface, row_bytes * height);
+
+    if (source_y == destination_y) {
+        for (uint32_t line = 0; line < height; line++) {
+            memmove(destination, source, row_bytes);
+            source      += pitch;
+            destination += pitch;
+        }
+        return;
+    }
+
+    if ((width == surface->width) && (destination_y < source_y) && (pitch >= FRAMEBUFFER_PIXELS_PER_BLOCK)) {
+        memory_copy_with_variant(variant, destination, source, (((height - 1) * pitch) + width) * FRAMEBUFFER_BYTES_PER_PIXEL);
+        return;
+    }
+
+    // Moving down, start from the bottom scan line so no source line is overwritten first.
+    int64_t step = (int64_t)pitch;
+    if (destination_y > source_y) {
+        source      += (height - 1) * pitch;
+        destination += (height - 1) * pitch;
+        step         = -step;
+    }
+
+    for (uint32_t line = 0; line < height; line++) {
+        memory_copy_with_variant(variant, destination, source, row_bytes);
+        source      += step;
+        destination += step;
+    }
+
+}
+
+/*******************************************************************************
+Framebuffer Scroll Region Function
+Move the contents of a rectangle up by num_of_lines scan lines, down when it
+is negative, and fill the lines uncovered with fill_color, the way a terminal
+scrolls.
+*******************************************************************************/
+void framebuffer_scroll_region (framebuffer_surface* surface, uint32_t x, uint32_t y, uint32_t width, uint32_t height, int32_t num_of_lines, uint32_t fill_color) {
+
+    if ((x >= surface->width) || (y >= surface->height) || (num_of_lines == 0)) {
+        return;
+    }
+    if (width > surface->width - x) {
+        width = surface->width - x;
+    }
+    if (height > surface->height - y) {
+        height = surface->height - y;
+    }
+
+    uint32_t distance = (num_of_lines > 0) ? (uint32_t)num_of_lines : (uint32_t)(-(int64_t)num_of_lines);
+    if (distance >= height) {
+        framebuffer_fill_rect(surface, x, y, width, height, fill_color);
+        return;
+    }
+
+    if (num_of_lines > 0) {
+        framebuffer_copy_rect(surface, x, y + distance, x, y, width, height - distance);
+        framebuffer_fill_rect(surface, x, y + height - distance, width, distance, fill_color);
+    } else {
+        framebuffer_copy_rect(surface, x, y, x, y + distance, width, height - distance);
+        framebuffer_fill_rect(surface, x, y, width, distance, fill_color);
+    }
+
+}
@@ -0,0 +1,22 @@
+#pragma once
+#include <stdint.h>
+#include "../memory/memory_operations.h"
+
+#define FRAMEBUFFER_BYTES_PER_PIXEL   4
+#define FRAMEBUFFER_PIXELS_PER_BLOCK  (MEMORY_VECTOR_BLOCK_SIZE / FRAMEBUFFER_BYTES_PER_PIXEL)
+
+/* A linear framebuffer of 32 bit pixels, as GOP describes it. Scan lines are
+pixels_per_scan_line apart, which can be more than the visible width. */
+typedef struct {
+    uint32_t*      base;
+    uint32_t       width;                // Visible pixels per scan line.
+    uint32_t       height;
+    uint32_t       pixels_per_scan_line;
+    memory_variant variant;              // Vector variants need thread context.
+} framebuffer_surface;
+
+void Initialize_Framebuffer_Surface (framebuffer_surface* surface, uint32_t* base, uint32_t width, uint32_t height, uint32_t pixels_per_scan_line);
+void framebuffer_clear              (framebuffer_surface* surface, uint32_t color);
+void framebuffer_fill_rect          (framebuffer_surface* surface, uint32_t x, uint32_t y, uint32_t width, uint32_t height, uint32_t color);
+void framebuffer_copy_rect          (framebuffer_surface* surface, uint32_t source_x, uint32_t source_y, uint32_t destination_x, uint32_t destination_y, uint32_t width, uint32_t height);
+void framebuffer_scroll_region      (framebuffer_surface* surface, uint32_t x, uint32_t y, uint32_t width, uint32_t height, int32_t num_of_lines, uint32_t fill_color);
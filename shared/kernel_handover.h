@@ -3,11 +3,16 @@
 #include "uefi/uefi_memory_map.h"
 #include "uefi/uefi.h"
 #include "graphics/fonts/pc_screen_font_v1_renderer.h"
+#include "trace/trace.h"
+#include "trace/boot_timing.h"
 
 typedef struct {
     Memory_Map_Info                    memory_map; 
     UEFI_GRAPHICS_OUTPUT_PROTOCOL_MODE gop;
     PC_Screen_Font_v1_Renderer*        font_renderer;
     void*                              os_reserved_page_sets[1];
+    void*                              acpi_rsdp; // nullptr if the firmware has no ACPI tables.
+    trace_buffer*                      boot_trace_buffer; // Bootloader events, continued by the bootstrap processor.
+    boot_timing*                       boot_timings;      // Bootloader phases, the kernel adds its own.
 } Kernel_Handover;
 
@@ -0,0 +1,5 @@
+#pragma once
+
+/* 128-bit unsigned integer for full 64x64 bit products, e.g. fixed point
+scaling. A GCC extension, __extension__ keeps -Wpedantic quiet about it. */
+__extension__ typedef unsigned __int128 uint128_t;
@@ -0,0 +1,723 @@
+#include "memory_operations.h"
+#include "../assembly_wrappers/registers.h"
+
+/* The kernel is built without vector registers, so the compiler never keeps
+values in them and they need not be declared clobbered; where it may use them
+they must be. */
+#ifdef __SSE2__
+#define MEMORY_VECTOR_CLOBBERS , "xmm0", "xmm1", "xmm2", "xmm3"
+#else
+#define MEMORY_VECTOR_CLOBBERS
+#endif
+
+// Loads and stores of any alignment.
+typedef struct { uint16_t value; } __attribute__((packed, may_alias)) unaligned_uint16;
+typedef struct { uint32_t value; } __attribute__((packed, may_alias)) unaligned_uint32;
+typedef struct { uint64_t value; } __attribute__((packed, may_alias)) unaligned_uint64;
+
+/* Zero until Initialize_Memory_Operations ran, which selects rep movsq/stosq and
+no non-temporal stores, so early copies work on any processor. */
+static memory_operations_features memory_features;
+
+/*******************************************************************************
+Copy Small Function
+
+Copy at most MEMORY_SMALL_SIZE bytes with a head and a tail move that overlap
+as needed. Everything is loaded before anything is stored, so the blocks may
+overlap. No loop, which the compiler could turn back into a memcpy call.
+*******************************************************************************/
+static void Copy_Small (uint8_t* destination, const uint8_t* source, size_t size) {
+
+    if (size >= 16) {
+        uint64_t head_0 = ((const unaligned_uint64*)source)->value;
+        uint64_t head_1 = ((const unaligned_uint64*)(source + 8))->value;
+        uint64_t tail_0 = ((const unaligned_uint64*)(source + size - 16))->value;
+        uint64_t tail_1 = ((const unaligned_uint64*)(source + size - 8))->value;
+        ((unaligned_uint64*)destination)->value               = head_0;
+        ((unaligned_uint64*)(destination + 8))->value         = head_1;
+        ((unaligned_uint64*)(destination + size - 16))->value = tail_0;
+        ((unaligned_uint64*)(destination + size - 8))->value  = tail_1;
+    } else if (size >= 8) {
+        uint64_t head = ((const unaligned_uint64*)source)->value;
+        uint64_t tail = ((const unaligned_uint64*)(source + size - 8))->value;
+        ((unaligned_uint64*)destination)->value              = head;
+        ((unaligned_uint64*)(destination + size - 8))->value = tail;
+    } else if (size >= 4) {
+        uint32_t head = ((const unaligned_uint32*)source)->value;
+        uint32_t tail = ((const unaligned_uint32*)(source + size - 4))->value;
+        ((unaligned_uint32*)destination)->value              = head;
+        ((unaligned_uint32*)(destination + size - 4))->value = tail;
+    } else if (size >= 2) {
+        uint16_t head = ((const unaligned_uint16*)source)->value;
+        uint16_t tail = ((const unaligned_uint16*)(source + size - 2))->value;
+        ((unaligned_uint16*)destination)->value              = head;
+        ((unaligned_uint16*)(destination + size - 2))->value = tail;
+    } else if (size == 1) {
+        *destination = *source;
+    }
+
+}
+
+/*******************************************************************************
+Set Small Function
+Fill at most MEMORY_SMALL_SIZE bytes the same way, pattern holds the value in
+every byte.
+*******************************************************************************/
+static void Set_Small (uint8_t* destination, uint64_t pattern, size_t size) {
+
+    if (size >= 16) {
+        ((unaligned_uint64*)destination)->value               = pattern;
+        ((unaligned_uint64*)(destination + 8))->value         = pattern;
+        ((unaligned_uint64*)(destination + size - 16))->value = pattern;
+        ((unaligned_uint64*)(destination + size - 8))->value  = pattern;
+    } else if (size >= 8) {
+        ((unaligned_uint64*)destination)->value              = pattern;
+        ((unaligned_uint64*)(destination + size - 8))->value = pattern;
+    } else if (size >= 4) {
+        ((unaligned_uint32*)destination)->value              = (uint32_t)pattern;
+        ((unaligned_uint32*)(destination + size - 4))->value = (uint32_t)pattern;
+    } else if (size >= 2) {
+        ((unaligned_uint16*)destination)->value              = (uint16_t)pattern;
+        ((unaligned_uint16*)(destination + size - 2))->value = (uint16_t)pattern;
+    } else if (size == 1) {
+        *destination = (uint8_t)pattern;
+    }
+
+}
+
+/*******************************************************************************
+Rep Movsb Function
+*******************************************************************************/
+static void Rep_Movsb (uint8_t* destination, const uint8_t* source, size_t size) {
+
+    __asm__ __volatile__ (
+        "rep movsb"
+        : "+D"(destination), "+S"(source), "+c"(size)
+        : /* No input. */
+        : "memory"
+    );
+
+}
+
+/*******************************************************************************
+Rep Movsq Function
+Whole quadwords, then the remaining bytes.
+*******************************************************************************/
+static void Rep_Movsq (uint8_t* destination, const uint8_t* source, size_t size) {
+
+    size_t num_of_quadwords = size >> 3;
+    size_t num_of_bytes     = size & 7;
+
+    __asm__ __volatile__ (
+        "rep movsq\n\t"
+        "movq %3, %%rcx\n\t"
+        "rep movsb"
+        : "+D"(destination), "+S"(source), "+c"(num_of_quadwords)
+        : "r"(num_of_bytes)
+        : "memory"
+    );
+
+}
+
+/*******************************************************************************
+Rep Stosb Function
+*******************************************************************************/
+static void Rep_Stosb (uint8_t* destination, uint64_t pattern, size_t size) {
+
+    __asm__ __volatile__ (
+        "rep stosb"
+        : "+D"(destination), "+c"(size)
+        : "a"(pattern)
+        : "memory"
+    );
+
+}
+
+/*******************************************************************************
+Rep Stosq Function
+*******************************************************************************/
+static void Rep_Stosq (uint8_t* destination, uint64_t pattern, size_t size) {
+
+    size_t num_of_quadwords = size >> 3;
+    size_t num_of_bytes     = size & 7;
+
+    __asm__ __volatile__ (
+        "rep stosq\n\t"
+        "movq %2, %%rcx\n\t"
+        "rep stosb"
+        : "+D"(destination), "+c"(num_of_quadwords)
+        : "r"(num_of_bytes), "a"(pattern)
+        : "memory"
+    );
+
+}
+
+/*******************************************************************************
+Bytes To Alignment Function
+Bytes from address to the next multiple of alignment, a power of two.
+*******************************************************************************/
+static size_t Bytes_To_Alignment (const void* address, size_t alignment) {
+    return (alignment - (((uint64_t)address) & (alignment - 1))) & (alignment - 1);
+}
+
+/*******************************************************************************
+Copy Non-Temporal Function
+
+movnti stores whole quadwords around the caches with general purpose registers
+only. The destination is quadword aligned first; the fence orders the weakly
+ordered stores before anything after the copy.
+*******************************************************************************/
+static void Copy_Non_Temporal (uint8_t* destination, const uint8_t* source, size_t size) {
+
+    size_t head = Bytes_To_Alignment(destination, 8);
+    Rep_Movsb(destination, source, head);
+    destination += head;
+    source      += head;
+    size        -= head;
+
+    size_t num_of_quadwords = size >> 3;
+    if (num_of_quadwords != 0) {
+        uint64_t scratch;
+        __asm__ __volatile__ (
+            "1:\n\t"
+            "movq (%1), %3\n\t"
+            "movnti %3, (%0)\n\t"
+            "addq $8, %1\n\t"
+            "addq $8, %0\n\t"
+            "decq %2\n\t"
+            "jnz 1b\n\t"
+            "sfence"
+            : "+r"(destination), "+r"(source), "+r"(num_of_quadwords), "=&r"(scratch)
+            : /* No input. */
+            : "memory", "cc"
+        );
+    }
+
+    Rep_Movsb(destination, source, size & 7);
+
+}
+
+/*******************************************************************************
+Set Non-Temporal Function
+*******************************************************************************/
+static void Set_Non_Temporal (uint8_t* destination, uint64_t pattern, size_t size) {
+
+    size_t head = Bytes_To_Alignment(destination, 8);
+    Rep_Stosb(destination, pattern, head);
+    destination += head;
+    size        -= head;
+
+    size_t num_of_quadwords = size >> 3;
+    if (num_of_quadwords != 0) {
+        __asm__ __volatile__ (
+            "1:\n\t"
+            "movnti %2, (%0)\n\t"
+            "addq $8, %0\n\t"
+            "decq %1\n\t"
+            "jnz 1b\n\t"
+            "sfence"
+            : "+r"(destination), "+r"(num_of_quadwords)
+            : "r"(pattern)
+            : "memory", "cc"
+        );
+    }
+
+    Rep_Stosb(destination, pattern, size & 7);
+
+}
+
+/*******************************************************************************
+Copy Vector Blocks Function
+
+Copy whole MEMORY_VECTOR_BLOCK_SIZE blocks with unaligned loads and stores to a
+64 byte aligned destination. AVX2 moves two 32 byte registers per block and
+clears the upper halves afterwards to avoid SSE transition stalls. The
+non-temporal SSE2 form needs the aligned destination for movntdq.
+*******************************************************************************/
+static void Copy_Vector_Blocks (memory_variant variant, uint8_t* destination, const uint8_t* source, size_t num_of_blocks) {
+
+    if (num_of_blocks == 0) {
+        return;
+    }
+
+    switch (variant) {
+
+        case memory_variant_avx2:
+            __asm__ __volatile__ (
+                "1:\n\t"
+                "vmovdqu   (%1), %%ymm0\n\t"
+                "vmovdqu 32(%1), %%ymm1\n\t"
+                "vmovdqa %%ymm0,   (%0)\n\t"
+                "vmovdqa %%ymm1, 32(%0)\n\t"
+                "addq $64, %1\n\t"
+                "addq $64, %0\n\t"
+                "decq %2\n\t"
+                "jnz 1b\n\t"
+                "vzeroupper"
+                : "+r"(destination), "+r"(source), "+r"(num_of_blocks)
+                : /* No input. */
+                : "memory", "cc" MEMORY_VECTOR_CLOBBERS
+            );
+            break;
+
+        case memory_variant_non_temporal_sse2:
+            __asm__ __volatile__ (
+                "1:\n\t"
+                "movdqu   (%1), %%xmm0\n\t"
+                "movdqu 16(%1), %%xmm1\n\t"
+                "movdqu 32(%1), %%xmm2\n\t"
+                "movdqu 48(%1), %%xmm3\n\t"
+                "movntdq %%xmm0,   (%0)\n\t"
+                "movntdq %%xmm1, 16(%0)\n\t"
+                "movntdq %%xmm2, 32(%0)\n\t"
+                "movntdq %%xmm3, 48(%0)\n\t"
+                "addq $64, %1\n\t"
+                "addq $64, %0\n\t"
+                "decq %2\n\t"
+                "jnz 1b\n\t"
+                "sfence"
+                : "+r"(destination), "+r"(source), "+r"(num_of_blocks)
+                : /* No input. */
+                : "memory", "cc" MEMORY_VECTOR_CLOBBERS
+            );
+            break;
+
+        default:
+            __asm__ __volatile__ (
+                "1:\n\t"
+                "movdqu   (%1), %%xmm0\n\t"
+                "movdqu 16(%1), %%xmm1\n\t"
+                "movdqu 32(%1), %%xmm2\n\t"
+                "movdqu 48(%1), %%xmm3\n\t"
+                "movdqa %%xmm0,   (%0)\n\t"
+                "movdqa %%xmm1, 16(%0)\n\t"
+                "movdqa %%xmm2, 32(%0)\n\t"
+                "movdqa %%xmm3, 48(%0)\n\t"
+                "addq $64, %1\n\t"
+                "addq $64, %0\n\t"
+                "decq %2\n\t"
+                "jnz 1b"
+                : "+r"(destination), "+r"(source), "+r"(num_of_blocks)
+                : /* No input. */
+                : "memory", "cc" MEMORY_VECTOR_CLOBBERS
+            );
+            break;
+
+    }
+}
+
+/*******************************************************************************
+Set Vector Blocks Function
+*******************************************************************************/
+static void Set_Vector_Blocks (memory_variant variant, uint8_t* destination, uint64_t pattern, size_t num_of_blocks) {
+
+    if (num_of_blocks == 0) {
+        return;
+    }
+
+    switch (variant) {
+
+        case memory_variant_avx2:
+            __asm__ __volatile__ (
+                "vmovq %2, %%xmm0\n\t"
+                "vpbroadcastq %%xmm0, %%ymm0\n\t"
+                "1:\n\t"
+                "vmovdqa %%ymm0,   (%0)\n\t"
+                "vmovdqa %%ymm0, 32(%0)\n\t"
+                "addq $64, %0\n\t"
+                "decq %1\n\t"
+                "jnz 1b\n\t"
+                "vzeroupper"
+                : "+r"(destination), "+r"(num_of_blocks)
+                : "r"(pattern)
+                : "memory", "cc" MEMORY_VECTOR_CLOBBERS
+            );
+            break;
+
+        case memory_variant_non_temporal_sse2:
+            __asm__ __volatile__ (
+                "movq %2, %%xmm0\n\t"
+                "punpcklqdq %%xmm0, %%xmm0\n\t"
+                "1:\n\t"
+                "movntdq %%xmm0,   (%0)\n\t"
+                "movntdq %%xmm0, 16(%0)\n\t"
+                "movntdq %%xmm0, 32(%0)\n\t"
+                "movntdq %%xmm0, 48(%0)\n\t"
+                "addq $64, %0\n\t"
+                "decq %1\n\t"
+                "jnz 1b\n\t"
+                "sfence"
+                : "+r"(destination), "+r"(num_of_blocks)
+                : "r"(pattern)
+                : "memory", "cc" MEMORY_VECTOR_CLOBBERS
+            );
+            break;
+
+        default:
+            __asm__ __volatile__ (
+                "movq %2, %%xmm0\n\t"
+                "punpcklqdq %%xmm0, %%xmm0\n\t"
+                "1:\n\t"
+                "movdqa %%xmm0,   (%0)\n\t"
+                "movdqa %%xmm0, 16(%0)\n\t"
+                "movdqa %%xmm0, 32(%0)\n\t"
+                "movdqa %%xmm0, 48(%0)\n\t"
+                "addq $64, %0\n\t"
+                "decq %1\n\t"
+                "jnz 1b"
+                : "+r"(destination), "+r"(num_of_blocks)
+                : "r"(pattern)
+                : "memory", "cc" MEMORY_VECTOR_CLOBBERS
+            );
+            break;
+
+    }
+}
+
+/*******************************************************************************
+Copy Forward Function
+Copy with the given variant, blocks larger than MEMORY_SMALL_SIZE only.
+*******************************************************************************/
+static void Copy_Forward (memory_variant variant, uint8_t* destination, const uint8_t* source, size_t size) {
+
+    switch (variant) {
+
+        case memory_variant_rep_byte:
+            Rep_Movsb(destination, source, size);
+            break;
+
+        case memory_variant_non_temporal:
+            Copy_Non_Temporal(destination, source, size);
+            break;
+
+        case memory_variant_sse2:
+        case memory_variant_avx2:
+        case memory_variant_non_temporal_sse2: {
+            size_t head = Bytes_To_Alignment(destination, MEMORY_VECTOR_BLOCK_SIZE);
+            if (head > size) {
+                head = size;
+            }
+            Rep_Movsb(destination, source, head);
+            size_t num_of_blocks = (size - head) / MEMORY_VECTOR_BLOCK_SIZE;
+            size_t block_bytes   = num_of_blocks * MEMORY_VECTOR_BLOCK_SIZE;
+            Copy_Vector_Blocks(variant, destination + head, source + head, num_of_blocks);
+            Rep_Movsb(destination + head + block_bytes, source + head + block_bytes, size - head - block_bytes);
+            break;
+        }
+
+        default:
+            Rep_Movsq(destination, source, size);
+            break;
+
+    }
+}
+
+/*******************************************************************************
+Set Forward Function
+*******************************************************************************/
+static void Set_Forward (memory_variant variant, uint8_t* destination, uint64_t pattern, size_t size) {
+
+    switch (variant) {
+
+        case memory_variant_rep_byte:
+            Rep_Stosb(destination, pattern, size);
+            break;
+
+        case memory_variant_non_temporal:
+            Set_Non_Temporal(destination, pattern, size);
+            break;
+
+        case memory_variant_sse2:
+        case memory_variant_avx2:
+        case memory_variant_non_temporal_sse2: {
+            size_t head = Bytes_To_Alignment(destination, MEMORY_VECTOR_BLOCK_SIZE);
+            if (head > size) {
+                head = size;
+            }
+            Rep_Stosb(destination, pattern, head);
+            size_t num_of_blocks = (size - head) / MEMORY_VECTOR_BLOCK_SIZE;
+            size_t block_bytes   = num_of_blocks * MEMORY_VECTOR_BLOCK_SIZE;
+            Set_Vector_Blocks(variant, destination + head, pattern, num_of_blocks);
+            Rep_Stosb(destination + head + block_bytes, pattern, size - head - block_bytes);
+            break;
+        }
+
+        default:
+            Rep_Stosq(destination, pattern, size);
+            break;
+
+    }
+}
+
+/*******************************************************************************
+String Variant For Function
+What memcpy and memset use for a block of the given size.
+*******************************************************************************/
+static memory_variant String_Variant_For (size_t size) {
+
+    if ((memory_features.non_temporal_threshold != 0) && (size >= memory_features.non_temporal_threshold)) {
+        return memory_variant_non_temporal;
+    }
+
+    return memory_features.string_variant;
+
+}
+
+/*******************************************************************************
+Memory Copy Function
+*******************************************************************************/
+extern "C" void* memcpy (void* destination, const void* source, size_t size) {
+
+    if (size <= MEMORY_SMALL_SIZE) {
+        Copy_Small((uint8_t*)destination, (const uint8_t*)source, size);
+    } else {
+        Copy_Forward(String_Variant_For(size), (uint8_t*)destination, (const uint8_t*)source, size);
+    }
+
+    return destination;
+
+}
+
+/*******************************************************************************
+Memory Move Function
+
+Blocks that do not overlap, or where the destination is below the source, are
+safe to copy forwards. Otherwise the copy runs backwards, quadwords then the
+remaining head bytes, since backward rep movsb has no fast string support.
+*******************************************************************************/
+extern "C" void* memmove (void* destination, const void* source, size_t size) {
+
+    uint8_t*       to   = (uint8_t*)destination;
+    const uint8_t* from = (const uint8_t*)source;
+
+    if (size <= MEMORY_SMALL_SIZE) {
+        Copy_Small(to, from, size);
+    } else if ((to <= from) || (to >= (from + size))) {
+        Copy_Forward((to >= (from + size)) ? String_Variant_For(size) : memory_variant_rep_qword, to, from, size);
+    } else {
+        size_t num_of_quadwords = size >> 3;
+        size_t num_of_bytes     = size & 7;
+        to   += size - 8;
+        from += size - 8;
+        __asm__ __volatile__ (
+            "std\n\t"
+            "rep movsq\n\t"
+            "addq $7, %%rdi\n\t"
+            "addq $7, %%rsi\n\t"
+            "movq %3, %%rcx\n\t"
+            "rep movsb\n\t"
+            "cld"
+            : "+D"(to), "+S"(from), "+c"(num_of_quadwords)
+            : "r"(num_of_bytes)
+            : "memory"
+        );
+    }
+
+    return destination;
+
+}
+
+/*******************************************************************************
+Memory Set Function
+*******************************************************************************/
+extern "C" void* memset (void* destination, int value, size_t size) {
+
+    uint64_t pattern = ((uint64_t)(uint8_t)value) * 0x0101010101010101ULL;
+
+    if (size <= MEMORY_SMALL_SIZE) {
+        Set_Small((uint8_t*)destination, pattern, size);
+    } else {
+        Set_Forward(String_Variant_For(size), (uint8_t*)destination, pattern, size);
+    }
+
+    return destination;
+
+}
+
+/*******************************************************************************
+Memory Compare Function
+*******************************************************************************/
+extern "C" int memcmp (const void* first, const void* second, size_t size) {
+
+    const uint8_t* a = (const uint8_t*)first;
+    const uint8_t* b = (const uint8_t*)second;
+
+    for (size_t idx = 0; idx < size; idx++) {
+        if (a[idx] != b[idx]) {
+            return (int)a[idx] - (int)b[idx];
+        }
+    }
+
+    return 0;
+
+}
+
+/*******************************************************************************
+Last Level Cache Size Function
+Largest cache described by CPUID leaf 4, 0 if the leaf does not exist.
+*******************************************************************************/
+static uint64_t Last_Level_Cache_Size () {
+
+    uint32_t eax, ebx, ecx, edx;
+
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    if (eax < 4) {
+        return 0;
+    }
+
+    uint64_t largest = 0;
+    for (uint32_t subleaf = 0; subleaf < 16; subleaf++) {
+
+        cpuid(4, subleaf, &eax, &ebx, &ecx, &edx);
+
+        uint32_t cache_type = eax & 0x1F;
+        if (cache_type == 0) {
+            break;
+        }
+
+        uint64_t ways       = ((ebx >> 22) & 0x3FF) + 1;
+        uint64_t partitions = ((ebx >> 12) & 0x3FF) + 1;
+        uint64_t line_size  = (ebx & 0xFFF) + 1;
+        uint64_t sets       = ((uint64_t)ecx) + 1;
+        uint64_t size       = ways * partitions * line_size * sets;
+
+        if (size > largest) {
+            largest = size;
+        }
+
+    }
+
+    return largest;
+
+}
+
+/*******************************************************************************
+Initialize Memory Operations Function
+
+Pick the implementations once from CPUID. memcpy/memset use rep movsb/stosb
+with ERMS or FSRM, else rep movsq/stosq, and switch to non-temporal stores for
+blocks over half the last level cache which would only evict everything else.
+The vector functions use AVX2 when the processor has it and XCR0 enables it,
+else SSE2. On the kernel, call after Setup_FPU.
+*******************************************************************************/
+void Initialize_Memory_Operations () {
+
+    uint32_t eax, ebx, ecx, edx;
+
+    memory_features.has_erms = false;
+    memory_features.has_fsrm = false;
+    memory_features.has_avx2 = false;
+
+    cpuid(0, 0, &eax, &ebx, &ecx, &edx);
+    uint32_t max_leaf = eax;
+
+    cpuid(1, 0, &eax, &ebx, &ecx, &edx);
+    const uint32_t CPUID_1_ECX_OSXSAVE = (1U << 27);
+    bool avx_state_enabled = (ecx & CPUID_1_ECX_OSXSAVE) && ((xgetbv(0) & 0x6) == 0x6);
+
+    if (max_leaf >= 7) {
+        cpuid(7, 0, &eax, &ebx, &ecx, &edx);
+        memory_features.has_erms = (ebx & (1U << 9)) != 0;
+        memory_features.has_fsrm = (edx & (1U << 4)) != 0;
+        memory_features.has_avx2 = ((ebx & (1U << 5)) != 0) && avx_state_enabled;
+    }
+
+    memory_features.string_variant = (memory_features.has_erms || memory_features.has_fsrm) ? memory_variant_rep_byte : memory_variant_rep_qword;
+    memory_features.vector_variant = memory_features.has_avx2 ? memory_variant_avx2 : memory_variant_sse2;
+
+    uint64_t last_level_cache_size = Last_Level_Cache_Size();
+    memory_features.non_temporal_threshold = (last_level_cache_size != 0) ? (last_level_cache_size / 2) : MEMORY_DEFAULT_NON_TEMPORAL_SIZE;
+
+}
+
+/*******************************************************************************
+Get Memory Operations Features Function
+*******************************************************************************/
+const memory_operations_features* get_memory_operations_features () {
+    return &memory_features;
+}
+
+/*******************************************************************************
+Memory Variant Is Supported Function
+*******************************************************************************/
+bool memory_variant_is_supported (memory_variant variant) {
+
+    if (variant == memory_variant_avx2) {
+        return memory_features.has_avx2;
+    }
+
+    return ((uint32_t)variant) < MEMORY_NUM_OF_VARIANTS;
+
+}
+
+/*******************************************************************************
+Memory Variant Name Function
+*******************************************************************************/
+const char* memory_variant_name (memory_variant variant) {
+
+    switch (variant) {
+        case memory_variant_rep_qword:         return "rep qword";
+        case memory_variant_rep_byte:          return "rep byte";
+        case memory_variant_sse2:              return "sse2";
+        case memory_variant_avx2:              return "avx2";
+        case memory_variant_non_temporal:      return "movnti";
+        case memory_variant_non_temporal_sse2: return "movntdq";
+    }
+
+    return "unknown";
+
+}
+
+/*******************************************************************************
+Memory Copy With Variant Function
+Copy with one particular variant, for benchmarks. Blocks may not overlap and
+vector variants need thread context.
+*******************************************************************************/
+void memory_copy_with_variant (memory_variant variant, void* destination, const void* source, size_t size) {
+
+    if (size <= MEMORY_SMALL_SIZE) {
+        Copy_Small((uint8_t*)destination, (const uint8_t*)source, size);
+    } else {
+        Copy_Forward(variant, (uint8_t*)destination, (const uint8_t*)source, size);
+    }
+
+}
+
+/*******************************************************************************
+Memory Set With Variant Function
+*******************************************************************************/
+void memory_set_with_variant (memory_variant variant, void* destination, uint8_t value, size_t size) {
+
+    uint64_t pattern = ((uint64_t)value) * 0x0101010101010101ULL;
+
+    if (size <= MEMORY_SMALL_SIZE) {
+        Set_Small((uint8_t*)destination, pattern, size);
+    } else {
+        Set_Forward(variant, (uint8_t*)destination, pattern, size);
+    }
+
+}
+
+/*******************************************************************************
+Memory Copy Vector Function
+Copy with SIMD registers, non-temporal above the threshold. Thread context
+only, the registers are switched lazily per thread.
+*******************************************************************************/
+void memory_copy_vector (void* destination, const void* source, size_t size) {
+
+    bool large = (memory_features.non_temporal_threshold != 0) && (size >= memory_features.non_temporal_threshold);
+
+    memory_copy_with_variant(large ? memory_variant_non_temporal_sse2 : memory_features.vector_variant, destination, source, size);
+
+}
+
+/*******************************************************************************
+Memory Set Vector Function
+*******************************************************************************/
+void memory_set_vector (void* destination, uint8_t value, size_t size) {
+
+    bool large = (memory_features.non_temporal_threshold != 0) && (size >= memory_features.non_temporal_threshold);
+
+    memory_set_with_variant(large ? memory_variant_non_temporal_sse2 : memory_features.vector_variant, destination, value, size);
+
+}
@@ -0,0 +1,45 @@
+#pragma once
+#include <stdint.h>
+#include <stddef.h>
+
+#define MEMORY_NUM_OF_VARIANTS             6
+#define MEMORY_SMALL_SIZE                  32              // Copied with overlapping moves, no loop.
+#define MEMORY_VECTOR_BLOCK_SIZE           64              // Bytes per SIMD loop iteration.
+#define MEMORY_DEFAULT_NON_TEMPORAL_SIZE   (1024 * 1024)   // Without a last level cache size from CPUID.
+
+/* Ways to copy or fill a block. The string and non-temporal variants only use
+general purpose registers and are safe anywhere; the SSE2 and AVX2 variants use
+vector registers and must only run in thread context, never in an interrupt
+handler. */
+enum memory_variant {
+    memory_variant_rep_qword            = 0, // rep movsq / stosq, every processor.
+    memory_variant_rep_byte             = 1, // rep movsb / stosb, fast with ERMS.
+    memory_variant_sse2                 = 2,
+    memory_variant_avx2                 = 3,
+    memory_variant_non_temporal         = 4, // movnti, bypasses the caches.
+    memory_variant_non_temporal_sse2    = 5  // movntdq.
+};
+
+typedef struct {
+    bool           has_erms;               // Enhanced rep movsb/stosb.
+    bool           has_fsrm;               // Fast short rep movsb.
+    bool           has_avx2;               // Also enabled in XCR0.
+    memory_variant string_variant;         // Used by memcpy/memset below the threshold.
+    memory_variant vector_variant;         // Used by the vector functions.
+    uint64_t       non_temporal_threshold; // Larger blocks bypass the caches, 0 for never.
+} memory_operations_features;
+
+// Called by compiler generated code, general purpose registers only.
+extern "C" void* memcpy  (void* destination, const void* source, size_t size);
+extern "C" void* memmove (void* destination, const void* source, size_t size);
+extern "C" void* memset  (void* destination, int value, size_t size);
+extern "C" int   memcmp  (const void* first, const void* second, size_t size);
+
+void                              Initialize_Memory_Operations      ();
+const memory_operations_features* get_memory_operations_features    ();
+bool                              memory_variant_is_supported       (memory_variant variant);
+const char*                       memory_variant_name               (memory_variant variant);
+void                              memory_copy_with_variant          (memory_variant variant, void* destination, const void* source, size_t size);
+void                              memory_set_with_variant           (memory_variant variant, void* destination, uint8_t value, size_t size);
+void                              memory_copy_vector                (void* destination, const void* source, size_t size);
+void                              memory_set_vector                 (void* destination, uint8_t value, size_t size);
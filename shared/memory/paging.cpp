@@ -1,209 +1,244 @@
 #include "paging.h"
 #include "../uefi/uefi_console.h"
+#include "../trace/trace.h"
+
+/* Number of page tables each processor claims at a time while building the
+page table level. 64 page tables is 256KB of entries, large enough to amortize
+the atomic claim and small enough to balance work between processors. */
+#define PAGE_TABLES_BUILD_CHUNK_SIZE 64
+
+// Shared state of a page table level being built across processors.
+typedef struct {
+    uint64_t* entries;
+    uint64_t  num_of_entries;
+    uint64_t  num_of_mapped_entries;
+    uint64_t  first_address;
+    uint64_t  address_stride;
+    uint64_t  entry_template;
+    uint64_t  num_of_chunks;
+    uint64_t  next_chunk;
+} page_tables_build_context;
 
 /*******************************************************************************
-Setup Kernel Page Tables Function
+Divide Round Up Function
 *******************************************************************************/
-UEFI_STATUS UEFI_API Setup_Kernel_Page_Tables (UEFI_SYSTEM_TABLE* SystemTable, uint64_t& PML4Address, Memory_Map_Info* mmap_info) {
-
-    // Get the size of valid physical memory from the memory map.
-    const uint64_t SIZE_OF_PHYSICAL_MEMORY = Get_Maximum_Memory_Address (mmap_info);
-
-    // Calculate number of page tables needed (minimum 1).
-    uint64_t num_of_page_tables = 1;
-    if ((SIZE_OF_PHYSICAL_MEMORY / PAGE_TABLES_VIRTUAL_ADDRESS_RANGE_SIZE) > 1) {
-        num_of_page_tables = (SIZE_OF_PHYSICAL_MEMORY / PAGE_TABLES_VIRTUAL_ADDRESS_RANGE_SIZE);
-        if ((SIZE_OF_PHYSICAL_MEMORY % PAGE_TABLES_VIRTUAL_ADDRESS_RANGE_SIZE) != 0) {
-            num_of_page_tables = num_of_page_tables + 1;
-        }
-    }
+static uint64_t Divide_Round_Up (uint64_t dividend, uint64_t divisor) {
+    return ((dividend + divisor - 1) / divisor);
+}
 
-    // Calculate number of page directories needed (minimum 1).
-    uint64_t num_of_pd_tables = 1; ;
-    if ((num_of_page_tables / PAGE_TABLES_NUM_OF_ENTRIES) > 1) {
-        num_of_pd_tables = (num_of_page_tables / PAGE_TABLES_NUM_OF_ENTRIES);
-        if ((num_of_page_tables % PAGE_TABLES_NUM_OF_ENTRIES) != 0) {
-            num_of_pd_tables = num_of_pd_tables + 1;
-        }
-    }
+/*******************************************************************************
+Write Page Table Entries Function
 
-    // Calculate number of page directory pointer tables needed (minimum 1).
-    uint64_t num_of_pdpt_tables = 1;
-    if ((num_of_pd_tables / PAGE_TABLES_NUM_OF_ENTRIES) > 1) {
-        num_of_pdpt_tables = (num_of_pd_tables / PAGE_TABLES_NUM_OF_ENTRIES);
-        if ((num_of_pd_tables % PAGE_TABLES_NUM_OF_ENTRIES) != 0) {
-            num_of_pdpt_tables = num_of_pdpt_tables + 1;
-        }
+Streams raw 64-bit entries directly into their final location. Entry i maps the
+address first_address + (i * address_stride) using the given flag template;
+entries at or beyond the number of mapped entries are written as not present.
+*******************************************************************************/
+static void Write_Page_Table_Entries (
+    page_tables_build_context* context,
+    uint64_t                   first_index,
+    uint64_t                   last_index
+) {
+
+    uint64_t* entries     = context->entries;
+    uint64_t  last_mapped = last_index;
+    if (last_mapped > context->num_of_mapped_entries) {
+        last_mapped = context->num_of_mapped_entries;
     }
 
-    // Only 1 PML4 table exists in 4-level paging.
-    const uint64_t NUM_OF_PML4_TABLES = 1;
+    uint64_t entry = context->entry_template | (context->first_address + (first_index * context->address_stride));
 
-    // Calculate memory/number of pages needed for all levels of paging tables.
-    const uint64_t MEMORY_NEEDED_FOR_PAGE_TABLES  = num_of_page_tables * sizeof(page_table);
-    const uint64_t MEMORY_NEEDED_FOR_PD_TABLES    = num_of_pd_tables   * sizeof(page_directory);
-    const uint64_t MEMORY_NEEDED_FOR_PDPT_TABLES  = num_of_pdpt_tables * sizeof(page_directory_pointer_table);
-    const uint64_t MEMORY_NEEDED_FOR_PML4_TABLES  = NUM_OF_PML4_TABLES * sizeof(page_map_level_4);
-    const uint64_t TOTAL_MEMORY_NEEDED_FOR_TABLES = MEMORY_NEEDED_FOR_PML4_TABLES + MEMORY_NEEDED_FOR_PDPT_TABLES + MEMORY_NEEDED_FOR_PD_TABLES + MEMORY_NEEDED_FOR_PAGE_TABLES;
-
-    uint64_t num_of_pages_needed_for_tables = TOTAL_MEMORY_NEEDED_FOR_TABLES / 4096;
-    if ((TOTAL_MEMORY_NEEDED_FOR_TABLES % 4096) != 0) {
-        num_of_pages_needed_for_tables += 1;
+    uint64_t idx = first_index;
+    for (; idx < last_mapped; idx++) {
+        entries[idx] = entry;
+        entry += context->address_stride;
     }
 
-    /* Allocate the number of pages needed for all levels of paging. Note the 
-    usage of AllocatePages vs AllocatePool, we need to guarantee 4KB aligned 
-    address to write into the CR3 register. */
-    void* paging_memory = nullptr;
-    UEFI_STATUS status = SystemTable->BootServices->AllocatePages (
-        UEFI_ALLOCATE_TYPE::AllocateAnyPages,
-        UEFI_MEMORY_TYPE::UefiLoaderData, 
-        num_of_pages_needed_for_tables,
-        (UEFI_PHYSICAL_ADDRESS*)&paging_memory
-    );
+    // Entries past the mapped range of the last table are not present.
+    for (; idx < last_index; idx++) {
+        entries[idx] = 0;
+    }
 
-    UEFI_PRINT_ERROR (SystemTable, status, u"Could not allocate memory for Kernel Page Tables");
+}
 
-    const uint64_t PDPT_PTR_STARTING_ADDR = (uint64_t)(((uint8_t*)paging_memory) + MEMORY_NEEDED_FOR_PML4_TABLES);
-    const uint64_t PD_PTR_STARTING_ADDR   = (uint64_t)(((uint8_t*)paging_memory) + MEMORY_NEEDED_FOR_PML4_TABLES + MEMORY_NEEDED_FOR_PDPT_TABLES);
-    const uint64_t PT_PTR_STARTING_ADDR   = (uint64_t)(((uint8_t*)paging_memory) + MEMORY_NEEDED_FOR_PML4_TABLES + MEMORY_NEEDED_FOR_PDPT_TABLES + MEMORY_NEEDED_FOR_PD_TABLES);
-
-    PML4Address    = (uint64_t)paging_memory;
-    void* pml4_ptr = paging_memory;
-    void* pdpt_ptr = (void*) PDPT_PTR_STARTING_ADDR;
-    void* pd_ptr   = (void*) PD_PTR_STARTING_ADDR;
-    void* pt_ptr   = (void*) PT_PTR_STARTING_ADDR;
-
-    // Page tables
-    uint64_t pte_frame_address = 0;
-    for (int i = 0; i < num_of_page_tables; i++) {
-        
-        page_table pt = {};
-
-        for (int i = 0; i < PAGE_TABLES_NUM_OF_ENTRIES; i++) {
-            
-            page_table_entry pte = {};
-
-            pte.present                  = 1;
-            pte.read_write               = 1;
-            pte.user_supervisor          = 0;
-            pte.page_level_write_through = 0;
-            pte.page_level_cache_disable = 0;
-            pte.accessed                 = 0;
-            pte.dirty                    = 0;
-            pte.memory_type              = 0;
-            pte.global                   = 0;
-            pte.ignored_0                = 0;
-            pte.frame_memory_address     = (pte_frame_address >> 12);
-            pte.ignored_1                = 0;
-            pte.protection_key           = 0;
-            pte.execute_disable          = 0;
-
-            pt.entries[i] = pte;
-            pte_frame_address += PAGE_TABLES_ENTRY_VIRTUAL_ADDRESS_RANGE_SIZE;
+/*******************************************************************************
+Build Page Table Chunks Function
 
-        }
+Claims chunks of a page table level until none remain. Runs on the bootstrap
+processor and, through the MP Services protocol, on every application processor
+at the same time.
+*******************************************************************************/
+static void UEFI_API Build_Page_Table_Chunks (void* procedure_argument) {
 
-        *((page_table*)pt_ptr) = pt;
-        pt_ptr = (void*)(((uint8_t*)pt_ptr) + sizeof(page_table));       
+    page_tables_build_context* context = (page_tables_build_context*)procedure_argument;
 
-    }
+    const uint64_t ENTRIES_PER_CHUNK = PAGE_TABLES_BUILD_CHUNK_SIZE * PAGE_TABLES_NUM_OF_ENTRIES;
 
-    pt_ptr = (void*) PT_PTR_STARTING_ADDR;
+    while (true) {
 
-    // Page directories
-    for (int i = 0; i < num_of_pd_tables; i++) {
-        
-        page_directory pd = {};
+        uint64_t chunk = __atomic_fetch_add(&context->next_chunk, 1, __ATOMIC_RELAXED);
+        if (chunk >= context->num_of_chunks) {
+            break;
+        }
 
-        for (int i = 0; i < PAGE_TABLES_NUM_OF_ENTRIES; i++) { 
+        uint64_t first_index = chunk * ENTRIES_PER_CHUNK;
+        uint64_t last_index  = first_index + ENTRIES_PER_CHUNK;
+        if (last_index > context->num_of_entries) {
+            last_index = context->num_of_entries;
+        }
 
-            page_directory_entry pde = {};
+        Write_Page_Table_Entries(context, first_index, last_index);
 
-            pde.present                  = 1;
-            pde.read_write               = 1;
-            pde.user_supervisor          = 0;
-            pde.page_level_write_through = 0;
-            pde.page_level_cache_disable = 0;
-            pde.accessed                 = 0;
-            pde.ignored_0                = 0;
-            pde.page_size                = 0;
-            pde.ignored_1                = 0;
-            pde.PT_memory_address        = (((uint64_t) pt_ptr) >> 12);
-            pde.ignored_2                = 0;
-            pde.execute_disable          = 0;
+    }
+}
 
-            pd.entries[i] = pde;
-            pt_ptr = (void*)(((uint8_t*)pt_ptr) + sizeof(page_table));  
+/*******************************************************************************
+Build Page Table Level Function
 
+Fills one level of paging structures. If the MP Services protocol is available
+the application processors are started on the level without waiting, the
+bootstrap processor works alongside them and then waits for them to finish.
+Without it, or if the application processors could not be started, the
+bootstrap processor builds the whole level.
+*******************************************************************************/
+static void Build_Page_Table_Level (
+    UEFI_SYSTEM_TABLE*         SystemTable,
+    UEFI_MP_SERVICES_PROTOCOL* mp_services,
+    page_tables_build_context* context
+) {
+
+    const uint64_t ENTRIES_PER_CHUNK = PAGE_TABLES_BUILD_CHUNK_SIZE * PAGE_TABLES_NUM_OF_ENTRIES;
+
+    context->num_of_chunks = Divide_Round_Up(context->num_of_entries, ENTRIES_PER_CHUNK);
+    context->next_chunk    = 0;
+
+    // Only bother the application processors when there is work to share.
+    UEFI_EVENT aps_done_event = nullptr;
+    if ((mp_services != nullptr) && (context->num_of_chunks > 1)) {
+
+        UEFI_STATUS status = SystemTable->BootServices->CreateEvent(0, 0, nullptr, nullptr, &aps_done_event);
+
+        if (!UEFI_IS_ERROR(status)) {
+            status = mp_services->StartupAllAPs (
+                mp_services,
+                Build_Page_Table_Chunks,
+                false,
+                aps_done_event,
+                0,
+                (void*)context,
+                nullptr
+            );
         }
-    
-        *((page_directory*)pd_ptr) = pd;
-        pd_ptr = (void*)(((uint8_t*)pd_ptr) + sizeof(page_directory));
 
+        // No application processors were started, build the level alone.
+        if (UEFI_IS_ERROR(status)) {
+            if (aps_done_event != nullptr) {
+                SystemTable->BootServices->CloseEvent(aps_done_event);
+            }
+            aps_done_event = nullptr;
+        }
     }
 
-    pd_ptr = (void*) PD_PTR_STARTING_ADDR;
-
-    // Page directory pointer tables
-    for (int i = 0; i < num_of_pdpt_tables; i++) {
-        
-        page_directory_pointer_table pdpt = {};
+    Build_Page_Table_Chunks((void*)context);
 
-        for (int i = 0; i < PAGE_TABLES_NUM_OF_ENTRIES; i++) { 
+    // Wait for the application processors to finish their claimed chunks.
+    if (aps_done_event != nullptr) {
+        uint64_t event_idx;
+        SystemTable->BootServices->WaitForEvent(1, &aps_done_event, &event_idx);
+        SystemTable->BootServices->CloseEvent(aps_done_event);
+    }
 
-            page_directory_pointer_table_entry pdpte = {};
+}
 
-            pdpte.present                  = 1;
-            pdpte.read_write               = 1;
-            pdpte.user_supervisor          = 0;
-            pdpte.page_level_write_through = 0;
-            pdpte.page_level_cache_disable = 0;
-            pdpte.accessed                 = 0;
-            pdpte.ignored_0                = 0;
-            pdpte.page_size                = 0;
-            pdpte.ignored_1                = 0;
-            pdpte.PD_memory_address        = (((uint64_t) pd_ptr) >> 12);
-            pdpte.ignored_2                = 0;
-            pdpte.execute_disable          = 0;
+/*******************************************************************************
+Setup Kernel Page Tables Function
 
-            pdpt.entries[i] = pdpte;
-            pd_ptr = (void*)(((uint8_t*)pd_ptr) + sizeof(page_directory));  
+Identity maps physical memory using 4KB pages. Each level is sized exactly to
+the memory it maps and its entries are streamed straight into the allocated
+paging memory from a precomputed flag template.
+*******************************************************************************/
+UEFI_STATUS UEFI_API Setup_Kernel_Page_Tables (UEFI_SYSTEM_TABLE* SystemTable, uint64_t& PML4Address, Memory_Map_Info* mmap_info) {
 
-        }
-    
-        *((page_directory_pointer_table*)pdpt_ptr) = pdpt;
-        pdpt_ptr = (void*)(((uint8_t*)pdpt_ptr) + sizeof(page_directory_pointer_table));
+    TRACE_BEGIN(TRACE_CATEGORY_PAGING, "Setup_Kernel_Page_Tables");
 
-    }
+    // Get the size of valid physical memory from the memory map.
+    const uint64_t SIZE_OF_PHYSICAL_MEMORY = Get_Maximum_Memory_Address (mmap_info) + 1;
 
-    pdpt_ptr = (void*) PDPT_PTR_STARTING_ADDR;
+    // Calculate the exact number of entries and tables needed at every level.
+    const uint64_t NUM_OF_MAPPED_PAGES = Divide_Round_Up(SIZE_OF_PHYSICAL_MEMORY, PAGE_TABLES_ENTRY_VIRTUAL_ADDRESS_RANGE_SIZE);
+    const uint64_t NUM_OF_PAGE_TABLES  = Divide_Round_Up(NUM_OF_MAPPED_PAGES, PAGE_TABLES_NUM_OF_ENTRIES);
+    const uint64_t NUM_OF_PD_TABLES    = Divide_Round_Up(NUM_OF_PAGE_TABLES, PAGE_TABLES_NUM_OF_ENTRIES);
+    const uint64_t NUM_OF_PDPT_TABLES  = Divide_Round_Up(NUM_OF_PD_TABLES,   PAGE_TABLES_NUM_OF_ENTRIES);
 
-    // PML4
-    page_map_level_4 pml4 = {};
-    for (int i = 0; i < num_of_pdpt_tables; i++) { 
+    // Only 1 PML4 table exists in 4-level paging.
+    const uint64_t NUM_OF_PML4_TABLES = 1;
 
-        page_map_level_4_entry pml4e = {};
+    const uint64_t NUM_OF_PAGES_NEEDED_FOR_TABLES = NUM_OF_PML4_TABLES + NUM_OF_PDPT_TABLES + NUM_OF_PD_TABLES + NUM_OF_PAGE_TABLES;
 
-        pml4e.present                  = 1;
-        pml4e.read_write               = 1;
-        pml4e.user_supervisor          = 0;
-        pml4e.page_level_write_through = 0;
-        pml4e.page_level_cache_disable = 0;
-        pml4e.accessed                 = 0;
-        pml4e.ignored_0                = 0;
-        pml4e.reserved_0               = 0;
-        pml4e.ignored_1                = 0;
-        pml4e.PDPT_memory_address      = (((uint64_t) pdpt_ptr) >> 12);;
-        pml4e.ignored_2                = 0;
-        pml4e.execute_disable          = 0;
+    /* Allocate the number of pages needed for all levels of paging. Note the
+    usage of AllocatePages vs AllocatePool, we need to guarantee 4KB aligned
+    address to write into the CR3 register. */
+    void* paging_memory = nullptr;
+    UEFI_STATUS status = SystemTable->BootServices->AllocatePages (
+        UEFI_ALLOCATE_TYPE::AllocateAnyPages,
+        UEFI_MEMORY_TYPE::UefiLoaderData,
+        NUM_OF_PAGES_NEEDED_FOR_TABLES,
+        (UEFI_PHYSICAL_ADDRESS*)&paging_memory
+    );
 
-        pml4.entries[i] = pml4e;
-        pdpt_ptr = (void*)(((uint8_t*)pdpt_ptr) + sizeof(page_directory_pointer_table));
+    UEFI_PRINT_ERROR (SystemTable, status, u"Could not allocate memory for Kernel Page Tables");
 
+    const uint64_t PML4_STARTING_ADDR = (uint64_t)paging_memory;
+    const uint64_t PDPT_STARTING_ADDR = PML4_STARTING_ADDR + (NUM_OF_PML4_TABLES * PAGE_TABLES_SIZE);
+    const uint64_t PD_STARTING_ADDR   = PDPT_STARTING_ADDR + (NUM_OF_PDPT_TABLES * PAGE_TABLES_SIZE);
+    const uint64_t PT_STARTING_ADDR   = PD_STARTING_ADDR   + (NUM_OF_PD_TABLES   * PAGE_TABLES_SIZE);
+
+    /* Locate the MP Services protocol to build the page table level across all
+    processors. Its absence is not an error, the bootstrap processor builds the
+    tables alone. */
+    UEFI_GUID mp_services_guid = UEFI_MP_SERVICES_PROTOCOL_GUID;
+    UEFI_MP_SERVICES_PROTOCOL* mp_services = nullptr;
+    if (UEFI_IS_ERROR(SystemTable->BootServices->LocateProtocol(&mp_services_guid, nullptr, (void**)&mp_services))) {
+        mp_services = nullptr;
     }
 
-    *((page_map_level_4*)pml4_ptr) = pml4;
+    page_tables_build_context context;
+
+    // Page tables map the physical frames.
+    context.entries               = (uint64_t*)PT_STARTING_ADDR;
+    context.num_of_entries        = NUM_OF_PAGE_TABLES * PAGE_TABLES_NUM_OF_ENTRIES;
+    context.num_of_mapped_entries = NUM_OF_MAPPED_PAGES;
+    context.first_address         = 0;
+    context.address_stride        = PAGE_TABLES_ENTRY_VIRTUAL_ADDRESS_RANGE_SIZE;
+    context.entry_template        = PAGE_TABLES_KERNEL_PAGE_ENTRY_TEMPLATE;
+    Build_Page_Table_Level(SystemTable, mp_services, &context);
+
+    // Page directories point to the page tables.
+    context.entries               = (uint64_t*)PD_STARTING_ADDR;
+    context.num_of_entries        = NUM_OF_PD_TABLES * PAGE_TABLES_NUM_OF_ENTRIES;
+    context.num_of_mapped_entries = NUM_OF_PAGE_TABLES;
+    context.first_address         = PT_STARTING_ADDR;
+    context.address_stride        = PAGE_TABLES_SIZE;
+    context.entry_template        = PAGE_TABLES_KERNEL_TABLE_ENTRY_TEMPLATE;
+    Build_Page_Table_Level(SystemTable, mp_services, &context);
+
+    // Page directory pointer tables point to the page directories.
+    context.entries               = (uint64_t*)PDPT_STARTING_ADDR;
+    context.num_of_entries        = NUM_OF_PDPT_TABLES * PAGE_TABLES_NUM_OF_ENTRIES;
+    context.num_of_mapped_entries = NUM_OF_PD_TABLES;
+    context.first_address         = PD_STARTING_ADDR;
+    Build_Page_Table_Level(SystemTable, mp_services, &context);
+
+    // The PML4 points to the page directory pointer tables.
+    context.entries               = (uint64_t*)PML4_STARTING_ADDR;
+    context.num_of_entries        = NUM_OF_PML4_TABLES * PAGE_TABLES_NUM_OF_ENTRIES;
+    context.num_of_mapped_entries = NUM_OF_PDPT_TABLES;
+    context.first_address         = PDPT_STARTING_ADDR;
+    Build_Page_Table_Level(SystemTable, mp_services, &context);
+
+    PML4Address = PML4_STARTING_ADDR;
+
+    TRACE_COUNTER(TRACE_CATEGORY_PAGING, "page_table_pages", NUM_OF_PAGES_NEEDED_FOR_TABLES);
+    TRACE_END(TRACE_CATEGORY_PAGING, "Setup_Kernel_Page_Tables");
 
     return UEFI_SUCCESS;
 
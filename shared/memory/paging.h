@@ -8,6 +8,24 @@
 #define PAGE_TABLES_NUM_OF_ENTRIES                   512
 #define PAGE_TABLES_VIRTUAL_ADDRESS_RANGE_SIZE (PAGE_TABLES_ENTRY_VIRTUAL_ADDRESS_RANGE_SIZE * PAGE_TABLES_NUM_OF_ENTRIES)         
 
+/* Raw bit positions of the fields shared by every level of paging entry, used
+to build entries as whole 64-bit words rather than one bitfield at a time. */
+#define PAGE_TABLES_ENTRY_PRESENT                  (1ULL << 0)
+#define PAGE_TABLES_ENTRY_READ_WRITE               (1ULL << 1)
+#define PAGE_TABLES_ENTRY_USER_SUPERVISOR          (1ULL << 2)
+#define PAGE_TABLES_ENTRY_PAGE_LEVEL_WRITE_THROUGH (1ULL << 3)
+#define PAGE_TABLES_ENTRY_PAGE_LEVEL_CACHE_DISABLE (1ULL << 4)
+#define PAGE_TABLES_ENTRY_ACCESSED                 (1ULL << 5)
+#define PAGE_TABLES_ENTRY_DIRTY                    (1ULL << 6)
+#define PAGE_TABLES_ENTRY_PAGE_SIZE                (1ULL << 7)
+#define PAGE_TABLES_ENTRY_GLOBAL                   (1ULL << 8)
+#define PAGE_TABLES_ENTRY_EXECUTE_DISABLE          (1ULL << 63)
+#define PAGE_TABLES_ENTRY_ADDRESS_MASK             0x000FFFFFFFFFF000ULL
+
+// Entry templates used for the kernel's identity mapping.
+#define PAGE_TABLES_KERNEL_TABLE_ENTRY_TEMPLATE (PAGE_TABLES_ENTRY_PRESENT | PAGE_TABLES_ENTRY_READ_WRITE)
+#define PAGE_TABLES_KERNEL_PAGE_ENTRY_TEMPLATE  (PAGE_TABLES_ENTRY_PRESENT | PAGE_TABLES_ENTRY_READ_WRITE)
+
 typedef struct {
     uint64_t present                  : 1;
     uint64_t read_write               : 1;
@@ -0,0 +1,93 @@
+#include "mcs_lock.h"
+#include "../assembly_wrappers/registers.h"
+
+/*******************************************************************************
+Initialize Function
+*******************************************************************************/
+void mcs_lock_initialize (mcs_lock* lock) {
+    lock->tail = nullptr;
+}
+
+/*******************************************************************************
+Acquire Function
+Append the node to the queue. An empty queue means the lock is taken at once,
+else link behind the previous tail and spin on the node until handed the lock.
+*******************************************************************************/
+void mcs_lock_acquire (mcs_lock* lock, mcs_lock_node* node) {
+
+    node->next   = nullptr;
+    node->locked = 1;
+
+    mcs_lock_node* previous = __atomic_exchange_n(&lock->tail, node, __ATOMIC_ACQ_REL);
+    if (previous == nullptr) {
+        return;
+    }
+
+    __atomic_store_n(&previous->next, node, __ATOMIC_RELEASE);
+
+    while (__atomic_load_n(&node->locked, __ATOMIC_ACQUIRE) != 0) {
+        __asm__ __volatile__ ("pause");
+    }
+
+}
+
+/*******************************************************************************
+Try Acquire Function
+*******************************************************************************/
+bool mcs_lock_try_acquire (mcs_lock* lock, mcs_lock_node* node) {
+
+    node->next   = nullptr;
+    node->locked = 0;
+
+    mcs_lock_node* expected = nullptr;
+
+    return __atomic_compare_exchange_n(&lock->tail, &expected, node, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+
+}
+
+/*******************************************************************************
+Release Function
+Hand the lock to the next waiter. With no successor linked yet, either the
+queue really is empty and the tail is reset, or a waiter is between swapping
+the tail and linking itself, and is waited for.
+*******************************************************************************/
+void mcs_lock_release (mcs_lock* lock, mcs_lock_node* node) {
+
+    mcs_lock_node* next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE);
+
+    if (next == nullptr) {
+
+        mcs_lock_node* expected = node;
+        if (__atomic_compare_exchange_n(&lock->tail, &expected, nullptr, false, __ATOMIC_RELEASE, __ATOMIC_RELAXED)) {
+            return;
+        }
+
+        while ((next = __atomic_load_n(&node->next, __ATOMIC_ACQUIRE)) == nullptr) {
+            __asm__ __volatile__ ("pause");
+        }
+
+    }
+
+    __atomic_store_n(&next->locked, 0, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Acquire IRQ Save Function
+*******************************************************************************/
+uint64_t mcs_lock_acquire_irq_save (mcs_lock* lock, mcs_lock_node* node) {
+
+    uint64_t rflags = save_and_disable_interrupts();
+    mcs_lock_acquire(lock, node);
+
+    return rflags;
+
+}
+
+/*******************************************************************************
+Release IRQ Restore Function
+*******************************************************************************/
+void mcs_lock_release_irq_restore (mcs_lock* lock, mcs_lock_node* node, uint64_t rflags) {
+    mcs_lock_release(lock, node);
+    restore_interrupts(rflags);
+}
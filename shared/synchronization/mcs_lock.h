@@ -0,0 +1,25 @@
+#pragma once
+#include <stdint.h>
+
+#define MCS_LOCK_CACHE_LINE 64
+
+/* One waiter's place in the queue, supplied by the caller (usually on its stack)
+and kept until the release. Each waiter spins on its own node's line. */
+typedef struct mcs_lock_node {
+    struct mcs_lock_node* next;
+    uint32_t              locked;
+} __attribute__((aligned(MCS_LOCK_CACHE_LINE))) mcs_lock_node;
+
+/* Queue spinlock. Waiters line up behind the tail and are handed the lock one
+by one, so a release touches only the next waiter's line however many
+processors wait. Suits heavily contended locks. */
+typedef struct {
+    mcs_lock_node* tail;
+} mcs_lock;
+
+void     mcs_lock_initialize             (mcs_lock* lock);
+void     mcs_lock_acquire                (mcs_lock* lock, mcs_lock_node* node);
+bool     mcs_lock_try_acquire            (mcs_lock* lock, mcs_lock_node* node);
+void     mcs_lock_release                (mcs_lock* lock, mcs_lock_node* node);
+uint64_t mcs_lock_acquire_irq_save       (mcs_lock* lock, mcs_lock_node* node);
+void     mcs_lock_release_irq_restore    (mcs_lock* lock, mcs_lock_node* node, uint64_t rflags);
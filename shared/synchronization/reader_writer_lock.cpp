@@ -0,0 +1,118 @@
+#include "reader_writer_lock.h"
+#include "../assembly_wrappers/registers.h"
+
+/*******************************************************************************
+Initialize Function
+*******************************************************************************/
+void reader_writer_lock_initialize (reader_writer_lock* lock) {
+    lock->state = 0;
+}
+
+/*******************************************************************************
+Acquire Read Function
+Enter once no writer holds or waits for the lock.
+*******************************************************************************/
+void reader_writer_lock_acquire_read (reader_writer_lock* lock) {
+
+    const uint32_t WRITER_MASK = READER_WRITER_LOCK_WRITER | READER_WRITER_LOCK_WRITER_WAITING;
+
+    uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+    while (true) {
+
+        if ((state & WRITER_MASK) != 0) {
+            __asm__ __volatile__ ("pause");
+            state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+            continue;
+        }
+
+        if (__atomic_compare_exchange_n(&lock->state, &state, state + READER_WRITER_LOCK_READER, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+            return;
+        }
+
+    }
+}
+
+/*******************************************************************************
+Release Read Function
+*******************************************************************************/
+void reader_writer_lock_release_read (reader_writer_lock* lock) {
+    __atomic_sub_fetch(&lock->state, READER_WRITER_LOCK_READER, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+Acquire Write Function
+Announce the wait so no new readers enter, then take the lock once the readers
+inside have left. Taking it clears the waiting flag; other waiting writers set
+it again.
+*******************************************************************************/
+void reader_writer_lock_acquire_write (reader_writer_lock* lock) {
+
+    uint32_t state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+    while (true) {
+
+        if ((state & ~READER_WRITER_LOCK_WRITER_WAITING) == 0) {
+            if (__atomic_compare_exchange_n(&lock->state, &state, READER_WRITER_LOCK_WRITER, true, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED)) {
+                return;
+            }
+            continue;
+        }
+
+        if ((state & READER_WRITER_LOCK_WRITER_WAITING) == 0) {
+            __atomic_or_fetch(&lock->state, READER_WRITER_LOCK_WRITER_WAITING, __ATOMIC_RELAXED);
+        }
+
+        __asm__ __volatile__ ("pause");
+        state = __atomic_load_n(&lock->state, __ATOMIC_RELAXED);
+
+    }
+}
+
+/*******************************************************************************
+Release Write Function
+Keeps the waiting flag of writers still queued.
+*******************************************************************************/
+void reader_writer_lock_release_write (reader_writer_lock* lock) {
+    __atomic_and_fetch(&lock->state, ~READER_WRITER_LOCK_WRITER, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+Acquire Read IRQ Save Function
+*******************************************************************************/
+uint64_t reader_writer_lock_acquire_read_irq_save (reader_writer_lock* lock) {
+
+    uint64_t rflags = save_and_disable_interrupts();
+    reader_writer_lock_acquire_read(lock);
+
+    return rflags;
+
+}
+
+/*******************************************************************************
+Release Read IRQ Restore Function
+*******************************************************************************/
+void reader_writer_lock_release_read_irq_restore (reader_writer_lock* lock, uint64_t rflags) {
+    reader_writer_lock_release_read(lock);
+    restore_interrupts(rflags);
+}
+
+/*******************************************************************************
+Acquire Write IRQ Save Function
+*******************************************************************************/
+uint64_t reader_writer_lock_acquire_write_irq_save (reader_writer_lock* lock) {
+
+    uint64_t rflags = save_and_disable_interrupts();
+    reader_writer_lock_acquire_write(lock);
+
+    return rflags;
+
+}
+
+/*******************************************************************************
+Release Write IRQ Restore Function
+*******************************************************************************/
+void reader_writer_lock_release_write_irq_restore (reader_writer_lock* lock, uint64_t rflags) {
+    reader_writer_lock_release_write(lock);
+    restore_interrupts(rflags);
+}
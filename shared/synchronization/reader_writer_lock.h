@@ -0,0 +1,23 @@
+#pragma once
+#include <stdint.h>
+
+#define READER_WRITER_LOCK_WRITER         (1U << 0)
+#define READER_WRITER_LOCK_WRITER_WAITING (1U << 1)
+#define READER_WRITER_LOCK_READER         (1U << 2) // Readers are counted above the flags.
+
+/* Reader-writer spinlock in one word. Any number of readers share it, a writer
+holds it alone. A waiting writer stops new readers from entering, so a stream
+of readers cannot starve writers. */
+typedef struct {
+    uint32_t state;
+} reader_writer_lock;
+
+void     reader_writer_lock_initialize                (reader_writer_lock* lock);
+void     reader_writer_lock_acquire_read              (reader_writer_lock* lock);
+void     reader_writer_lock_release_read              (reader_writer_lock* lock);
+void     reader_writer_lock_acquire_write             (reader_writer_lock* lock);
+void     reader_writer_lock_release_write             (reader_writer_lock* lock);
+uint64_t reader_writer_lock_acquire_read_irq_save     (reader_writer_lock* lock);
+void     reader_writer_lock_release_read_irq_restore  (reader_writer_lock* lock, uint64_t rflags);
+uint64_t reader_writer_lock_acquire_write_irq_save    (reader_writer_lock* lock);
+void     reader_writer_lock_release_write_irq_restore (reader_writer_lock* lock, uint64_t rflags);
@@ -0,0 +1,87 @@
+#include "ticket_lock.h"
+#include "../assembly_wrappers/registers.h"
+
+/*******************************************************************************
+Initialize Function
+*******************************************************************************/
+void ticket_lock_initialize (ticket_lock* lock) {
+    lock->next_ticket = 0;
+    lock->now_serving = 0;
+}
+
+/*******************************************************************************
+Acquire Function
+Take a ticket and wait for it to be served, backing off in proportion to the
+number of holders ahead so waiters further back touch the line less often.
+*******************************************************************************/
+void ticket_lock_acquire (ticket_lock* lock) {
+
+    uint32_t ticket = __atomic_fetch_add(&lock->next_ticket, 1, __ATOMIC_RELAXED);
+
+    while (true) {
+
+        uint32_t now_serving = __atomic_load_n(&lock->now_serving, __ATOMIC_ACQUIRE);
+        if (now_serving == ticket) {
+            return;
+        }
+
+        for (uint32_t idx = ticket - now_serving; idx != 0; idx--) {
+            __asm__ __volatile__ ("pause");
+        }
+
+    }
+}
+
+/*******************************************************************************
+Try Acquire Function
+Take the lock only if it is free. Nobody took a ticket since now_serving was
+read if next_ticket still equals it, so the ticket taken is the one served.
+*******************************************************************************/
+bool ticket_lock_try_acquire (ticket_lock* lock) {
+
+    uint32_t now_serving = __atomic_load_n(&lock->now_serving, __ATOMIC_ACQUIRE);
+    uint32_t expected    = now_serving;
+
+    return __atomic_compare_exchange_n(&lock->next_ticket, &expected, now_serving + 1, false, __ATOMIC_ACQUIRE, __ATOMIC_RELAXED);
+
+}
+
+/*******************************************************************************
+Release Function
+Only the holder writes now_serving, so a plain increment suffices.
+*******************************************************************************/
+void ticket_lock_release (ticket_lock* lock) {
+
+    uint32_t now_serving = __atomic_load_n(&lock->now_serving, __ATOMIC_RELAXED);
+    __atomic_store_n(&lock->now_serving, now_serving + 1, __ATOMIC_RELEASE);
+
+}
+
+/*******************************************************************************
+Is Locked Function
+*******************************************************************************/
+bool ticket_lock_is_locked (ticket_lock* lock) {
+    return __atomic_load_n(&lock->next_ticket, __ATOMIC_RELAXED) != __atomic_load_n(&lock->now_serving, __ATOMIC_RELAXED);
+}
+
+/*******************************************************************************
+Acquire IRQ Save Function
+For locks also taken by interrupt handlers: disable interrupts on the executing
+processor before acquiring and return the previous RFLAGS.
+*******************************************************************************/
+uint64_t ticket_lock_acquire_irq_save (ticket_lock* lock) {
+
+    uint64_t rflags = save_and_disable_interrupts();
+    ticket_lock_acquire(lock);
+
+    return rflags;
+
+}
+
+/*******************************************************************************
+Release IRQ Restore Function
+*******************************************************************************/
+void ticket_lock_release_irq_restore (ticket_lock* lock, uint64_t rflags) {
+    ticket_lock_release(lock);
+    restore_interrupts(rflags);
+}
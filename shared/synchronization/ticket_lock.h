@@ -0,0 +1,17 @@
+#pragma once
+#include <stdint.h>
+
+/* Fair spinlock, processors are served in the order they arrived. Every waiter
+spins on the same line, so it suits locks with few contenders. */
+typedef struct {
+    uint32_t next_ticket;
+    uint32_t now_serving;
+} ticket_lock;
+
+void     ticket_lock_initialize          (ticket_lock* lock);
+void     ticket_lock_acquire             (ticket_lock* lock);
+bool     ticket_lock_try_acquire         (ticket_lock* lock);
+void     ticket_lock_release             (ticket_lock* lock);
+bool     ticket_lock_is_locked           (ticket_lock* lock);
+uint64_t ticket_lock_acquire_irq_save    (ticket_lock* lock);
+void     ticket_lock_release_irq_restore (ticket_lock* lock, uint64_t rflags);
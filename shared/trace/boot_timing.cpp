@@ -0,0 +1,72 @@
+#include "boot_timing.h"
+#include "trace.h"
+#include "../assembly_wrappers/registers.h"
+
+/*******************************************************************************
+Initialize Function
+*******************************************************************************/
+void boot_timing_initialize (boot_timing* timing, uint64_t uefi_main_tsc) {
+
+    timing->uefi_main_tsc = uefi_main_tsc;
+    timing->idle_tsc      = 0;
+
+    for (uint64_t idx = 0; idx < BOOT_NUM_OF_PHASES; idx++) {
+        timing->phases[idx].first_start_tsc = 0;
+        timing->phases[idx].last_start_tsc  = 0;
+        timing->phases[idx].total_cycles    = 0;
+        timing->phases[idx].num_of_runs     = 0;
+    }
+
+}
+
+/*******************************************************************************
+Begin Phase Function
+Phases are also traced, so they show up in the boot trace.
+*******************************************************************************/
+void boot_timing_begin (boot_timing* timing, boot_phase phase) {
+
+    TRACE_BEGIN(TRACE_CATEGORY_BOOT, boot_phase_name(phase));
+
+    boot_phase_timing* phase_timing = &timing->phases[phase];
+    phase_timing->last_start_tsc    = read_tsc();
+    if (phase_timing->num_of_runs == 0) {
+        phase_timing->first_start_tsc = phase_timing->last_start_tsc;
+    }
+
+}
+
+/*******************************************************************************
+End Phase Function
+A phase run more than once accumulates its runs.
+*******************************************************************************/
+void boot_timing_end (boot_timing* timing, boot_phase phase) {
+
+    boot_phase_timing* phase_timing = &timing->phases[phase];
+    phase_timing->total_cycles     += read_tsc() - phase_timing->last_start_tsc;
+    phase_timing->num_of_runs++;
+
+    TRACE_END(TRACE_CATEGORY_BOOT, boot_phase_name(phase));
+
+}
+
+/*******************************************************************************
+Phase Name Function
+*******************************************************************************/
+const char* boot_phase_name (boot_phase phase) {
+
+    switch (phase) {
+        case boot_phase_menu:               return "menu";
+        case boot_phase_read_kernel:        return "read_kernel";
+        case boot_phase_memory_map:         return "memory_map";
+        case boot_phase_page_tables:        return "page_tables";
+        case boot_phase_font_load:          return "font_load";
+        case boot_phase_exit_boot_services: return "exit_boot_services";
+        case boot_phase_kernel_init:        return "kernel_init";
+        case boot_phase_pmm:                return "pmm";
+        case boot_phase_framebuffer_clear:  return "framebuffer_clear";
+        case boot_phase_benchmarks:         return "benchmarks";
+    }
+
+    return "unknown";
+
+}
@@ -0,0 +1,39 @@
+#pragma once
+#include <stdint.h>
+
+#define BOOT_NUM_OF_PHASES 10
+
+// Boot phases in the order they start, bootloader then kernel.
+enum boot_phase : uint32_t {
+    boot_phase_menu               = 0, // uefi_main until launch is chosen.
+    boot_phase_read_kernel        = 1, // kernel.bin into memory.
+    boot_phase_memory_map         = 2, // Every uefi_get_memory_map call on the way.
+    boot_phase_page_tables        = 3,
+    boot_phase_font_load          = 4,
+    boot_phase_exit_boot_services = 5,
+    boot_phase_kernel_init        = 6, // kernel_main until the framebuffer is cleared.
+    boot_phase_pmm                = 7,
+    boot_phase_framebuffer_clear  = 8,
+    boot_phase_benchmarks         = 9
+};
+
+typedef struct {
+    uint64_t first_start_tsc;   // Zero if the phase never ran.
+    uint64_t last_start_tsc;
+    uint64_t total_cycles;
+    uint64_t num_of_runs;
+} boot_phase_timing;
+
+/* TSC stamps of every phase from uefi_main to the bootstrap processor's idle
+loop. The bootloader owns it and hands it to the kernel, which adds its own
+phases; both read the same invariant TSC. */
+typedef struct {
+    uint64_t          uefi_main_tsc;   // Origin of the report.
+    uint64_t          idle_tsc;        // Kernel reached its idle loop, zero before.
+    boot_phase_timing phases[BOOT_NUM_OF_PHASES];
+} boot_timing;
+
+void        boot_timing_initialize (boot_timing* timing, uint64_t uefi_main_tsc);
+void        boot_timing_begin      (boot_timing* timing, boot_phase phase);
+void        boot_timing_end        (boot_timing* timing, boot_phase phase);
+const char* boot_phase_name        (boot_phase phase);
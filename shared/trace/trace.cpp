@@ -0,0 +1,82 @@
+#include "trace.h"
+#include "../assembly_wrappers/registers.h"
+
+/* Buffer used without a selector, the bootloader's only buffer and the kernel's
+until per processor data exists. */
+static trace_buffer*         trace_default_buffer;
+static trace_buffer_selector trace_selector;
+
+/*******************************************************************************
+Initialize Buffer Function
+*******************************************************************************/
+void trace_buffer_initialize (trace_buffer* buffer, trace_record* records, uint64_t capacity, uint32_t cpu_index) {
+    buffer->records   = records;
+    buffer->capacity  = capacity;
+    buffer->head      = 0;
+    buffer->cpu_index = cpu_index;
+}
+
+/*******************************************************************************
+Number of Records Function
+*******************************************************************************/
+uint64_t trace_buffer_num_of_records (const trace_buffer* buffer) {
+
+    uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+
+    return (head < buffer->capacity) ? head : buffer->capacity;
+
+}
+
+/*******************************************************************************
+Number of Dropped Records Function
+*******************************************************************************/
+uint64_t trace_buffer_num_of_dropped (const trace_buffer* buffer) {
+
+    uint64_t head = __atomic_load_n(&buffer->head, __ATOMIC_ACQUIRE);
+
+    return (head > buffer->capacity) ? (head - buffer->capacity) : 0;
+
+}
+
+/*******************************************************************************
+Set Default Buffer Function
+*******************************************************************************/
+void trace_set_default_buffer (trace_buffer* buffer) {
+    __atomic_store_n(&trace_default_buffer, buffer, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+Set Buffer Selector Function
+*******************************************************************************/
+void trace_set_buffer_selector (trace_buffer_selector selector) {
+    __atomic_store_n(&trace_selector, selector, __ATOMIC_RELEASE);
+}
+
+/*******************************************************************************
+Record Event Function
+Reserve the next slot of the executing processor's buffer and fill it in. An
+interrupt handler tracing between the reservation and the timestamp leaves the
+two records out of timestamp order, so readers sort by timestamp.
+*******************************************************************************/
+void trace_record_event (trace_event_type type, const char* name, uint64_t value) {
+
+    trace_buffer_selector selector = __atomic_load_n(&trace_selector, __ATOMIC_ACQUIRE);
+    trace_buffer*         buffer   = (selector != nullptr) ? selector() : __atomic_load_n(&trace_default_buffer, __ATOMIC_ACQUIRE);
+
+    if (buffer == nullptr) {
+        return;
+    }
+
+    uint64_t slot = __atomic_fetch_add(&buffer->head, 1, __ATOMIC_RELAXED);
+    if (slot >= buffer->capacity) {
+        return;
+    }
+
+    trace_record* record = &buffer->records[slot];
+    record->tsc       = read_tsc();
+    record->name      = name;
+    record->value     = value;
+    record->type      = type;
+    record->cpu_index = buffer->cpu_index;
+
+}
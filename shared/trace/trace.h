@@ -0,0 +1,67 @@
+#pragma once
+#include <stdint.h>
+
+// Tracepoint categories, one bit each.
+#define TRACE_CATEGORY_BOOT     (1U << 0)
+#define TRACE_CATEGORY_MEMORY   (1U << 1)
+#define TRACE_CATEGORY_PAGING   (1U << 2)
+#define TRACE_CATEGORY_GRAPHICS (1U << 3)
+#define TRACE_CATEGORY_ALL      0xFFFFFFFFU
+
+/* Categories compiled in, e.g. -DTRACE_ENABLED_CATEGORIES=0 removes every
+tracepoint from the binary. */
+#ifndef TRACE_ENABLED_CATEGORIES
+#define TRACE_ENABLED_CATEGORIES TRACE_CATEGORY_ALL
+#endif
+
+enum trace_event_type : uint32_t {
+    trace_event_begin   = 0,
+    trace_event_end     = 1,
+    trace_event_instant = 2,
+    trace_event_counter = 3
+};
+
+/* One event, half a cache line. The name must outlive the buffer, e.g. a string
+literal; names recorded by the bootloader stay valid in the kernel since loader
+memory is never handed to the PMM. */
+typedef struct {
+    uint64_t         tsc;
+    const char*      name;
+    uint64_t         value;     // Counter value, zero for the other types.
+    trace_event_type type;
+    uint32_t         cpu_index;
+} trace_record;
+
+/* Records of one processor. Only its owner records into it, reserving a slot
+with an atomic add so its interrupt handlers cannot take the same slot. Once
+full, later records are dropped rather than overwrite the earliest ones. */
+typedef struct {
+    trace_record* records;
+    uint64_t      capacity;
+    uint64_t      head;         // Slots reserved, may pass the capacity.
+    uint32_t      cpu_index;
+} trace_buffer;
+
+// Returns the buffer of the executing processor, nullptr to drop the record.
+typedef trace_buffer* (*trace_buffer_selector) ();
+
+void     trace_buffer_initialize     (trace_buffer* buffer, trace_record* records, uint64_t capacity, uint32_t cpu_index);
+uint64_t trace_buffer_num_of_records (const trace_buffer* buffer);
+uint64_t trace_buffer_num_of_dropped (const trace_buffer* buffer);
+void     trace_set_default_buffer    (trace_buffer* buffer);
+void     trace_set_buffer_selector   (trace_buffer_selector selector);
+void     trace_record_event          (trace_event_type type, const char* name, uint64_t value);
+
+/* Tracepoints. A category outside TRACE_ENABLED_CATEGORIES compiles to nothing,
+arguments included. */
+#define TRACE_EVENT(category, type, name, value)                      \
+    do {                                                              \
+        if constexpr ((TRACE_ENABLED_CATEGORIES & (category)) != 0) { \
+            trace_record_event(type, name, value);                    \
+        }                                                             \
+    } while (0)
+
+#define TRACE_BEGIN(category, name)          TRACE_EVENT(category, trace_event_begin,   name, 0)
+#define TRACE_END(category, name)            TRACE_EVENT(category, trace_event_end,     name, 0)
+#define TRACE_INSTANT(category, name)        TRACE_EVENT(category, trace_event_instant, name, 0)
+#define TRACE_COUNTER(category, name, value) TRACE_EVENT(category, trace_event_counter, name, (uint64_t)(value))
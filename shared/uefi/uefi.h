@@ -687,6 +687,13 @@ typedef struct{
     void*     VendorTable;
 } UEFI_CONFIGURATION_TABLE;
 
+/* UEFI Specification v2.10 4.6.1.1 */
+#define UEFI_ACPI_20_TABLE_GUID \
+{0x8868e871, 0xe4f1, 0x11d3, 0xbc, 0x22, {0x00, 0x80, 0xc7, 0x3c, 0x88, 0x81}}
+
+#define UEFI_ACPI_TABLE_GUID \
+{0xeb9d2d30, 0x2d88, 0x11d3, 0x9a, 0x16, {0x00, 0x90, 0x27, 0x3f, 0xc1, 0x4d}}
+
 /******************************************************************************
 UEFI SIMPLE TEXT INPUT PROTOCOL DECLARATIONS
 ******************************************************************************/
@@ -1502,3 +1509,102 @@ typedef struct {
         EFI_PARTITION_ENTRY  Gpt;
     } Info;
 } __attribute__((packed)) UEFI_PARTITION_INFO_PROTOCOL;
+
+/******************************************************************************
+UEFI MP SERVICES PROTOCOL (UEFI Platform Initialization Specification v1.8 
+Volume 2 13.4)
+******************************************************************************/
+#define UEFI_MP_SERVICES_PROTOCOL_GUID \
+{0x3fdda605, 0xa76e, 0x4f46, 0xad, 0x29, {0x12, 0xf4, 0x53, 0x1b, 0x3d, 0x08}}
+
+#define UEFI_PROCESSOR_AS_BSP_BIT        0x00000001
+#define UEFI_PROCESSOR_ENABLED_BIT       0x00000002
+#define UEFI_PROCESSOR_HEALTH_STATUS_BIT 0x00000004
+
+// Forward declaration because of circular dependencies.
+typedef struct UEFI_MP_SERVICES_PROTOCOL UEFI_MP_SERVICES_PROTOCOL;
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.2 */
+typedef void (UEFI_API* UEFI_AP_PROCEDURE) (
+    OPTIONAL IN void* ProcedureArgument
+);
+
+typedef struct {
+    uint32_t Package;
+    uint32_t Core;
+    uint32_t Thread;
+} UEFI_CPU_PHYSICAL_LOCATION;
+
+typedef struct {
+    uint64_t                   ProcessorId;
+    uint32_t                   StatusFlag;
+    UEFI_CPU_PHYSICAL_LOCATION Location;
+} UEFI_PROCESSOR_INFORMATION;
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.3 */
+typedef UEFI_STATUS (UEFI_API* UEFI_MP_SERVICES_GET_NUMBER_OF_PROCESSORS) (
+    IN UEFI_MP_SERVICES_PROTOCOL* This,
+    OUT uint64_t*                 NumberOfProcessors,
+    OUT uint64_t*                 NumberOfEnabledProcessors
+);
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.4 */
+typedef UEFI_STATUS (UEFI_API* UEFI_MP_SERVICES_GET_PROCESSOR_INFO) (
+    IN UEFI_MP_SERVICES_PROTOCOL*   This,
+    IN uint64_t                     ProcessorNumber,
+    OUT UEFI_PROCESSOR_INFORMATION* ProcessorInfoBuffer
+);
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.5 */
+typedef UEFI_STATUS (UEFI_API* UEFI_MP_SERVICES_STARTUP_ALL_APS) (
+    IN UEFI_MP_SERVICES_PROTOCOL* This,
+    IN UEFI_AP_PROCEDURE          Procedure,
+    IN uint8_t                    SingleThread,
+    OPTIONAL IN UEFI_EVENT        WaitEvent,
+    IN uint64_t                   TimeoutInMicroSeconds,
+    OPTIONAL IN void*             ProcedureArgument,
+    OPTIONAL OUT uint64_t**       FailedCpuList
+);
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.6 */
+typedef UEFI_STATUS (UEFI_API* UEFI_MP_SERVICES_STARTUP_THIS_AP) (
+    IN UEFI_MP_SERVICES_PROTOCOL* This,
+    IN UEFI_AP_PROCEDURE          Procedure,
+    IN uint64_t                   ProcessorNumber,
+    OPTIONAL IN UEFI_EVENT        WaitEvent,
+    IN uint64_t                   TimeoutInMicroseconds,
+    OPTIONAL IN void*             ProcedureArgument,
+    OPTIONAL OUT uint8_t*         Finished
+);
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.7 */
+typedef UEFI_STATUS (UEFI_API* UEFI_MP_SERVICES_SWITCH_BSP) (
+    IN UEFI_MP_SERVICES_PROTOCOL* This,
+    IN uint64_t                   ProcessorNumber,
+    IN uint8_t                    EnableOldBSP
+);
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.8 */
+typedef UEFI_STATUS (UEFI_API* UEFI_MP_SERVICES_ENABLEDISABLEAP) (
+    IN UEFI_MP_SERVICES_PROTOCOL* This,
+    IN uint64_t                   ProcessorNumber,
+    IN uint8_t                    EnableAP,
+    OPTIONAL IN uint32_t*         HealthFlag
+);
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.9 */
+typedef UEFI_STATUS (UEFI_API* UEFI_MP_SERVICES_WHOAMI) (
+    IN UEFI_MP_SERVICES_PROTOCOL* This,
+    OUT uint64_t*                 ProcessorNumber
+);
+
+/* UEFI Platform Initialization Specification v1.8 Volume 2 13.4.1 */
+typedef struct UEFI_MP_SERVICES_PROTOCOL {
+    UEFI_MP_SERVICES_GET_NUMBER_OF_PROCESSORS GetNumberOfProcessors;
+    UEFI_MP_SERVICES_GET_PROCESSOR_INFO       GetProcessorInfo;
+    UEFI_MP_SERVICES_STARTUP_ALL_APS          StartupAllAPs;
+    UEFI_MP_SERVICES_STARTUP_THIS_AP          StartupThisAP;
+    UEFI_MP_SERVICES_SWITCH_BSP               SwitchBSP;
+    UEFI_MP_SERVICES_ENABLEDISABLEAP          EnableDisableAP;
+    UEFI_MP_SERVICES_WHOAMI                   WhoAmI;
+} UEFI_MP_SERVICES_PROTOCOL;
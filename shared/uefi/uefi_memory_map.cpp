@@ -19,8 +19,10 @@ UEFI_STATUS uefi_get_memory_map (
 
     // Allocate buffer for actual memory map from given size. Additional buffer
     // size needs to be allocated equal to 2 additional memory descriptors due 
-    // to this allocation itself (could cause a memory segment to split into 2).
-    MemoryMapSize += (DescriptorSize * 2);  
+    // to this allocation itself (could cause a memory segment to split into 2),
+    // plus slack so the map can be taken again into the same buffer.
+    MemoryMapSize += (DescriptorSize * (2 + UEFI_MEMORY_MAP_NUM_OF_SLACK_DESCRIPTORS));
+    uint64_t Capacity = MemoryMapSize;
     status = SystemTable->BootServices->AllocatePool (
         UefiLoaderData, 
         MemoryMapSize,
@@ -40,6 +42,28 @@ UEFI_STATUS uefi_get_memory_map (
     mmap->key          = MapKey;
     mmap->desc_size    = DescriptorSize;
     mmap->desc_version = DescriptorVersion;
+    mmap->capacity     = Capacity;
+
+    return UEFI_SUCCESS;
+
+}
+
+/* Take the memory map again into the buffer of an earlier uefi_get_memory_map,
+without allocating or printing, so it may be called after a failed
+ExitBootServices. Fails if the map outgrew the buffer's slack. */
+UEFI_STATUS uefi_refresh_memory_map (
+    UEFI_SYSTEM_TABLE* SystemTable, 
+    Memory_Map_Info*   mmap
+) {
+
+    uint64_t MemoryMapSize = mmap->capacity;
+
+    UEFI_STATUS status = SystemTable->BootServices->GetMemoryMap (&MemoryMapSize, mmap->map, &mmap->key, &mmap->desc_size, &mmap->desc_version);
+    if (UEFI_IS_ERROR(status)) {
+        return status;
+    }
+
+    mmap->size = MemoryMapSize;
 
     return UEFI_SUCCESS;
 